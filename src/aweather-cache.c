@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+#include "aweather-cache.h"
+
+#define CACHE_KEY       "aweather-cache"
+#define CACHE_INTERVAL  (5*60)   // Seconds between passes
+#define CACHE_RECENT    (10*60)  // Files used this many seconds ago are kept whatever the budget
+#define CACHE_LOW_WATER 0.9      // Passes that evict go this far under budget, so the next few have nothing to do
+#define CACHE_TRIM      GINT_TO_POINTER(-1) // Pool data of passes that only keep to the budgets, cleaning passes get age+1
+
+/* Suffixes of files made from the cached file they are named after, longest match first. A .part.tag left without its .part is removed like other orphans */
+static const gchar *cache_twins[] = {".split.rsl.gz", ".rsl.gz", ".raw", ".part.tag", ".part", NULL};
+
+static const gchar *cache_categories[] = {"level2", "conus", "alerts", "other"};
+
+/* This code is also built into the plugins, everything is found through the one struct on the viewer.
+ * Passes only run from the application's copy, which is never unloaded. */
+struct _AWeatherCache {
+	GritsViewer        *viewer;
+	GritsPrefs         *prefs;
+	gchar              *root;       // ~/.cache/grits
+	GThreadPool        *pool;       // One thread for passes
+	guint               timer;
+	gboolean            stopping;
+
+	GMutex              mutex;
+	GHashTable         *used;       // Path -> last aweather_cache_used, in seconds since the epoch
+	AWeatherCacheStats  stats[AWEATHER_CACHE_CATEGORIES];
+};
+
+/* A cached file and its twins */
+typedef struct {
+	gboolean  source;  // The file the twins were made from is there
+	gboolean  part;    // An unfinished download is there
+	gint64    size;
+	time_t    used;    // Newest last use of the files
+	GSList   *paths;
+} CacheGroup;
+
+static void _cache_group_free(CacheGroup *group)
+{
+	g_slist_free_full(group->paths, g_free);
+	g_free(group);
+}
+
+static gint _cache_group_compare(gconstpointer _a, gconstpointer _b)
+{
+	const CacheGroup *a = *(CacheGroup**)_a, *b = *(CacheGroup**)_b;
+	return (a->used > b->used) - (a->used < b->used);
+}
+
+static AWeatherCacheCategory _cache_category(AWeatherCache *cache, const gchar *path)
+{
+	const gchar *rel = path + strlen(cache->root);
+	while (*rel == G_DIR_SEPARATOR)
+		rel++;
+	if (g_str_has_prefix(rel, "nexrad" G_DIR_SEPARATOR_S "level2" G_DIR_SEPARATOR_S))
+		return AWEATHER_CACHE_LEVEL2;
+	if (g_str_has_prefix(rel, "nexrad" G_DIR_SEPARATOR_S "conus" G_DIR_SEPARATOR_S))
+		return AWEATHER_CACHE_CONUS;
+	if (g_str_has_prefix(rel, "alerts" G_DIR_SEPARATOR_S))
+		return AWEATHER_CACHE_ALERTS;
+	return AWEATHER_CACHE_OTHER;
+}
+
+/* Adds the files below path to groups */
+static void _cache_scan(AWeatherCache *cache, const gchar *path, GHashTable *groups)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	if (!dir)
+		return;
+	const gchar *child;
+	while (!cache->stopping && (child = g_dir_read_name(dir))) {
+		gchar   *child_path = g_build_filename(path, child, NULL);
+		GStatBuf st;
+		if (g_lstat(child_path, &st) != 0) {
+			g_free(child_path);
+		} else if (S_ISDIR(st.st_mode)) {
+			_cache_scan(cache, child_path, groups);
+			g_free(child_path);
+		} else {
+			/* Twins are grouped under the name of their source */
+			gchar *key = g_strdup(child_path);
+			gboolean twin = FALSE, part = FALSE;
+			for (const gchar **suffix = cache_twins; *suffix && !twin; suffix++) {
+				if (g_str_has_suffix(key, *suffix)) {
+					key[strlen(key) - strlen(*suffix)] = '\0';
+					twin = TRUE;
+					part = g_str_equal(*suffix, ".part");
+				}
+			}
+			CacheGroup *group = g_hash_table_lookup(groups, key);
+			if (!group) {
+				group = g_new0(CacheGroup, 1);
+				g_hash_table_insert(groups, key, group);
+			} else {
+				g_free(key);
+			}
+			time_t used = MAX(st.st_atime, st.st_mtime);
+			g_mutex_lock(&cache->mutex);
+			gpointer recorded = g_hash_table_lookup(cache->used, child_path);
+			g_mutex_unlock(&cache->mutex);
+			if (recorded)
+				used = MAX(used, (time_t)GPOINTER_TO_SIZE(recorded));
+			group->source |= !twin;
+			group->part   |= part;
+			group->size   += st.st_size;
+			group->used    = MAX(group->used, used);
+			group->paths   = g_slist_prepend(group->paths, child_path);
+		}
+	}
+	g_dir_close(dir);
+}
+
+/* Removes the empty directories below path */
+static void _cache_remove_dirs(AWeatherCache *cache, const gchar *path)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	if (!dir)
+		return;
+	const gchar *child;
+	while ((child = g_dir_read_name(dir))) {
+		gchar *child_path = g_build_filename(path, child, NULL);
+		if (g_file_test(child_path, G_FILE_TEST_IS_DIR) &&
+		    !g_file_test(child_path, G_FILE_TEST_IS_SYMLINK)) {
+			_cache_remove_dirs(cache, child_path);
+			g_rmdir(child_path);
+		}
+		g_free(child_path);
+	}
+	g_dir_close(dir);
+}
+
+/* Removes the files of group, returns the bytes freed */
+static gint64 _cache_remove(AWeatherCache *cache, CacheGroup *group,
+		AWeatherCacheCategory category)
+{
+	gint files = 0;
+	g_mutex_lock(&cache->mutex);
+	for (GSList *cur = group->paths; cur; cur = cur->next) {
+		if (g_remove(cur->data) == 0)
+			files++;
+		g_hash_table_remove(cache->used, cur->data);
+	}
+	cache->stats[category].evicted       += files;
+	cache->stats[category].evicted_bytes += group->size;
+	g_mutex_unlock(&cache->mutex);
+	return group->size;
+}
+
+/* Runs on the pool, see CACHE_TRIM */
+static void _cache_pass(gpointer _age, gpointer _cache)
+{
+	AWeatherCache *cache = _cache;
+	gint    age   = _age == CACHE_TRIM ? -1 : GPOINTER_TO_INT(_age) - 1;
+	time_t  now   = time(NULL);
+	gint64  start = g_get_monotonic_time();
+	GHashTable *groups = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)_cache_group_free);
+	_cache_scan(cache, cache->root, groups);
+
+	/* Sort each category oldest first */
+	GPtrArray *sorted[AWEATHER_CACHE_CATEGORIES];
+	gint64     size[AWEATHER_CACHE_CATEGORIES] = {};
+	gint64     files[AWEATHER_CACHE_CATEGORIES] = {};
+	for (gint i = 0; i < AWEATHER_CACHE_CATEGORIES; i++)
+		sorted[i] = g_ptr_array_new();
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init(&iter, groups);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		CacheGroup *group = value;
+		AWeatherCacheCategory category = _cache_category(cache, key);
+		gboolean recent = group->used + CACHE_RECENT > now;
+		/* Twins of a file that is gone are no use, unless a download is still writing it */
+		if (!recent && ((!group->source && !group->part) ||
+		                (age >= 0 && group->used + age < now))) {
+			g_debug("AWeatherCache: pass - remove %s%s", (gchar*)key,
+					group->source ? "" : " (source gone)");
+			_cache_remove(cache, group, category);
+			continue;
+		}
+		size[category]  += group->size;
+		files[category] += g_slist_length(group->paths);
+		if (!recent)
+			g_ptr_array_add(sorted[category], group);
+	}
+
+	/* Evict the least recently used groups of categories over budget */
+	for (gint i = 0; i < AWEATHER_CACHE_CATEGORIES; i++) {
+		gchar *name   = g_strdup_printf("aweather/cache_%s_mb", cache_categories[i]);
+		gint64 budget = (gint64)grits_prefs_get_integer(cache->prefs, name, NULL) * 1024 * 1024;
+		g_free(name);
+		if (budget > 0 && size[i] > budget) {
+			g_ptr_array_sort(sorted[i], _cache_group_compare);
+			gint64 target = budget * CACHE_LOW_WATER;
+			for (guint j = 0; j < sorted[i]->len && size[i] > target; j++) {
+				CacheGroup *group = sorted[i]->pdata[j];
+				files[i] -= g_slist_length(group->paths);
+				size[i]  -= _cache_remove(cache, group, i);
+			}
+			if (size[i] > budget)
+				g_debug("AWeatherCache: pass - %s is over budget with recent files only",
+						cache_categories[i]);
+		}
+		g_ptr_array_free(sorted[i], TRUE);
+	}
+
+	if (age >= 0)
+		_cache_remove_dirs(cache, cache->root);
+
+	/* Forget uses of files that are gone */
+	g_mutex_lock(&cache->mutex);
+	g_hash_table_iter_init(&iter, cache->used);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		if (!g_file_test(key, G_FILE_TEST_EXISTS))
+			g_hash_table_iter_remove(&iter);
+	for (gint i = 0; i < AWEATHER_CACHE_CATEGORIES; i++) {
+		AWeatherCacheStats *stats = &cache->stats[i];
+		stats->size  = size[i];
+		stats->files = files[i];
+		g_debug("AWeatherCache: pass - %-6s %5"G_GINT64_FORMAT" files %6"G_GINT64_FORMAT" KB, "
+				"%"G_GINT64_FORMAT" hits %"G_GINT64_FORMAT" misses, "
+				"%"G_GINT64_FORMAT" KB saved %"G_GINT64_FORMAT" KB fetched, "
+				"%"G_GINT64_FORMAT" files %"G_GINT64_FORMAT" KB evicted",
+				cache_categories[i], stats->files, stats->size/1024,
+				stats->hits, stats->misses,
+				stats->bytes_saved/1024, stats->bytes_fetched/1024,
+				stats->evicted, stats->evicted_bytes/1024);
+	}
+	g_mutex_unlock(&cache->mutex);
+	g_hash_table_destroy(groups);
+	g_debug("AWeatherCache: pass - done in %dms",
+			(gint)((g_get_monotonic_time() - start) / 1000));
+}
+
+static gboolean _cache_timer(gpointer _cache)
+{
+	AWeatherCache *cache = _cache;
+	/* Passes do not pile up behind a slow one */
+	if (g_thread_pool_unprocessed(cache->pool) == 0)
+		g_thread_pool_push(cache->pool, CACHE_TRIM, NULL);
+	return TRUE;
+}
+
+AWeatherCache *aweather_cache_new(GritsViewer *viewer, GritsPrefs *prefs)
+{
+	g_debug("AWeatherCache: new");
+	AWeatherCache *cache = g_new0(AWeatherCache, 1);
+	cache->viewer = viewer;
+	cache->prefs  = g_object_ref(prefs);
+	cache->root   = g_build_filename(g_get_user_cache_dir(), "grits", NULL);
+	cache->used   = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init(&cache->mutex);
+	cache->pool   = g_thread_pool_new(_cache_pass, cache, 1, FALSE, NULL);
+	cache->timer  = g_timeout_add_seconds(CACHE_INTERVAL, _cache_timer, cache);
+	g_thread_pool_push(cache->pool, CACHE_TRIM, NULL);
+	if (viewer)
+		g_object_set_data(G_OBJECT(viewer), CACHE_KEY, cache);
+	return cache;
+}
+
+void aweather_cache_free(AWeatherCache *cache)
+{
+	g_debug("AWeatherCache: free");
+	if (cache->viewer)
+		g_object_set_data(G_OBJECT(cache->viewer), CACHE_KEY, NULL);
+	g_source_remove(cache->timer);
+	cache->stopping = TRUE;
+	g_thread_pool_free(cache->pool, TRUE, TRUE);
+	g_hash_table_destroy(cache->used);
+	g_mutex_clear(&cache->mutex);
+	g_object_unref(cache->prefs);
+	g_free(cache->root);
+	g_free(cache);
+}
+
+AWeatherCache *aweather_cache_get(GritsViewer *viewer)
+{
+	return g_object_get_data(G_OBJECT(viewer), CACHE_KEY);
+}
+
+void aweather_cache_used(AWeatherCache *cache, const gchar *path, gboolean hit, gint64 bytes)
+{
+	if (!cache)
+		return;
+	AWeatherCacheStats *stats = &cache->stats[_cache_category(cache, path)];
+	g_mutex_lock(&cache->mutex);
+	g_hash_table_insert(cache->used, g_strdup(path), GSIZE_TO_POINTER(time(NULL)));
+	if (hit) {
+		stats->hits++;
+		stats->bytes_saved += bytes;
+	} else {
+		stats->misses++;
+		stats->bytes_fetched += bytes;
+	}
+	g_mutex_unlock(&cache->mutex);
+}
+
+void aweather_cache_clean(AWeatherCache *cache, gint age)
+{
+	g_debug("AWeatherCache: clean - %ds", age);
+	g_thread_pool_push(cache->pool, GINT_TO_POINTER(MAX(age, 0) + 1), NULL);
+}
+
+void aweather_cache_get_stats(AWeatherCache *cache, AWeatherCacheCategory category,
+		AWeatherCacheStats *stats)
+{
+	g_mutex_lock(&cache->mutex);
+	*stats = cache->stats[category];
+	g_mutex_unlock(&cache->mutex);
+}
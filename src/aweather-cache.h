@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_CACHE_H__
+#define __AWEATHER_CACHE_H__
+
+#include <glib.h>
+#include <grits.h>
+
+/* Keeps the grits disk cache (~/.cache/grits) within a byte budget per category, aweather/cache_<category>_mb
+ * (0 for no limit). A pass on a background thread every few minutes adds up each category and removes the least
+ * recently used files until it is back under budget. Files used in the last few minutes are never removed.
+ *
+ * Files made from a cached file are kept with it: a volume's .raw, .rsl.gz and .split.rsl.gz twins and a
+ * partial download's .part are removed together, and twins whose source is gone are removed on their own.
+ * Last use is the newest of the access and modification times and of aweather_cache_used calls, since many
+ * file systems do not keep access times up to date. */
+
+typedef enum {
+	AWEATHER_CACHE_LEVEL2,     /* nexrad/level2: Level II volumes, Level III products and real-time chunks */
+	AWEATHER_CACHE_CONUS,      /* nexrad/conus */
+	AWEATHER_CACHE_ALERTS,     /* alerts */
+	AWEATHER_CACHE_OTHER,      /* Everything else, eg. map tiles */
+	AWEATHER_CACHE_CATEGORIES,
+} AWeatherCacheCategory;
+
+typedef struct {
+	gint64 hits;          // Fetches answered from the cache, including revalidated files
+	gint64 misses;        // Fetches that had to download the file
+	gint64 bytes_saved;   // Size of the files hits did not download
+	gint64 bytes_fetched;
+	gint64 size;          // Bytes on disk at the last pass
+	gint64 files;
+	gint64 evicted;       // Files removed to stay in budget or because their source was gone
+	gint64 evicted_bytes;
+} AWeatherCacheStats;
+
+typedef struct _AWeatherCache AWeatherCache;
+
+/* Made once by the application and stored on the viewer, before any plugins are loaded.
+ * viewer is NULL when running without one. The first pass runs right away. */
+AWeatherCache *aweather_cache_new(GritsViewer *viewer, GritsPrefs *prefs);
+
+/* Waits for a running pass. Plugins must be freed first. */
+void aweather_cache_free(AWeatherCache *cache);
+
+/* Returns the cache manager of viewer, or NULL if the application did not make one */
+AWeatherCache *aweather_cache_get(GritsViewer *viewer);
+
+/* Records a use of the cached file at path, a hit if it did not have to be downloaded.
+ * bytes is the size saved by a hit or the bytes downloaded by a miss. Does nothing if cache is NULL.
+ * Can be called from any thread. */
+void aweather_cache_used(AWeatherCache *cache, const gchar *path, gboolean hit, gint64 bytes);
+
+/* Queues a pass that also removes every file not used for age seconds, and the empty directories */
+void aweather_cache_clean(AWeatherCache *cache, gint age);
+
+void aweather_cache_get_stats(AWeatherCache *cache, AWeatherCacheCategory category,
+		AWeatherCacheStats *stats);
+
+#endif
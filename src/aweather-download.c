@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+
+#include "aweather-download.h"
+#include "aweather-cache.h"
+
+#define DOWNLOAD_KEY          "aweather-download"
+#define DOWNLOAD_URGENT_SLOTS 2          // Urgent fetches never wait behind the others
+#define DOWNLOAD_PER_HOST     4          // Kept-alive connections per host
+#define DOWNLOAD_CHUNK        (64*1024)
+
+/* There is no static state, each plugin has its own copy of this code but they all use the one struct
+ * found on the viewer */
+struct _AWeatherDownload {
+	gint                  refs;
+	GritsViewer          *viewer;
+	SoupSession          *soup;
+	AWeatherCache        *cache;     // Told about hits and misses, NULL if there is no cache manager
+
+	GMutex                mutex;
+	GCond                 cond;      // Signalled when a slot or a path is freed
+	GHashTable           *paths;     // Cache paths being fetched, only one fetch writes each .part
+	gint                  max;       // Slots for visible and background fetches
+	gint                  max_background;
+	gint                  running[AWEATHER_DOWNLOAD_PRIORITIES];
+	gint                  waiting[AWEATHER_DOWNLOAD_PRIORITIES];
+	AWeatherDownloadStats stats[AWEATHER_DOWNLOAD_PRIORITIES];
+};
+
+AWeatherDownload *aweather_download_new(GritsPrefs *prefs, AWeatherCache *cache)
+{
+	g_debug("AWeatherDownload: new");
+	AWeatherDownload *download = g_new0(AWeatherDownload, 1);
+	download->refs   = 1;
+	download->cache  = cache;
+	download->max    = MAX(1, grits_prefs_get_integer(prefs, "aweather/download_max", NULL));
+	download->max_background = CLAMP(grits_prefs_get_integer(prefs,
+				"aweather/download_max_background", NULL), 1, download->max);
+	download->soup   = soup_session_new_with_options(
+			SOUP_SESSION_MAX_CONNS,          download->max + DOWNLOAD_URGENT_SLOTS,
+			SOUP_SESSION_MAX_CONNS_PER_HOST, DOWNLOAD_PER_HOST,
+			SOUP_SESSION_USER_AGENT,         PACKAGE_STRING,
+			NULL);
+	download->paths  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init(&download->mutex);
+	g_cond_init(&download->cond);
+	return download;
+}
+
+AWeatherDownload *aweather_download_ref(GritsViewer *viewer, GritsPrefs *prefs)
+{
+	AWeatherDownload *download = g_object_get_data(G_OBJECT(viewer), DOWNLOAD_KEY);
+	if (download) {
+		download->refs++;
+		return download;
+	}
+	download = aweather_download_new(prefs, aweather_cache_get(viewer));
+	download->viewer = viewer;
+	g_object_set_data(G_OBJECT(viewer), DOWNLOAD_KEY, download);
+	return download;
+}
+
+void aweather_download_unref(AWeatherDownload *download)
+{
+	if (--download->refs > 0)
+		return;
+	g_debug("AWeatherDownload: free");
+	if (download->viewer)
+		g_object_set_data(G_OBJECT(download->viewer), DOWNLOAD_KEY, NULL);
+	soup_session_abort(download->soup);
+	g_object_unref(download->soup);
+	g_hash_table_destroy(download->paths);
+	g_mutex_clear(&download->mutex);
+	g_cond_clear(&download->cond);
+	g_free(download);
+}
+
+static gboolean _download_can_start(AWeatherDownload *download, AWeatherDownloadPriority priority)
+{
+	gint *running = download->running;
+	if (priority == AWEATHER_DOWNLOAD_URGENT)
+		return running[AWEATHER_DOWNLOAD_URGENT] < DOWNLOAD_URGENT_SLOTS;
+	if (running[AWEATHER_DOWNLOAD_VISIBLE] + running[AWEATHER_DOWNLOAD_BACKGROUND] >= download->max)
+		return FALSE;
+	if (priority == AWEATHER_DOWNLOAD_BACKGROUND)
+		return running[AWEATHER_DOWNLOAD_BACKGROUND] < download->max_background &&
+			download->waiting[AWEATHER_DOWNLOAD_VISIBLE] == 0;
+	return TRUE;
+}
+
+static void _download_wake(GCancellable *cancellable, AWeatherDownload *download)
+{
+	g_mutex_lock(&download->mutex);
+	g_cond_broadcast(&download->cond);
+	g_mutex_unlock(&download->mutex);
+}
+
+/* Waits for a slot, returns FALSE if cancelled first */
+static gboolean _download_acquire(AWeatherDownload *download,
+		AWeatherDownloadPriority priority, GCancellable *cancellable)
+{
+	gulong id = cancellable ? g_cancellable_connect(cancellable,
+			G_CALLBACK(_download_wake), download, NULL) : 0;
+	g_mutex_lock(&download->mutex);
+	download->waiting[priority]++;
+	while (!_download_can_start(download, priority) &&
+	       !g_cancellable_is_cancelled(cancellable))
+		g_cond_wait(&download->cond, &download->mutex);
+	download->waiting[priority]--;
+	gboolean ok = !g_cancellable_is_cancelled(cancellable);
+	if (ok)
+		download->running[priority]++;
+	/* A background fetch may be able to go now that this one stopped waiting */
+	g_cond_broadcast(&download->cond);
+	g_mutex_unlock(&download->mutex);
+	if (id)
+		g_cancellable_disconnect(cancellable, id);
+	return ok;
+}
+
+/* Waits until no other fetch is writing path, returns FALSE if cancelled first */
+static gboolean _download_claim(AWeatherDownload *download, const gchar *path,
+		GCancellable *cancellable)
+{
+	gulong id = cancellable ? g_cancellable_connect(cancellable,
+			G_CALLBACK(_download_wake), download, NULL) : 0;
+	g_mutex_lock(&download->mutex);
+	while (g_hash_table_contains(download->paths, path) &&
+	       !g_cancellable_is_cancelled(cancellable))
+		g_cond_wait(&download->cond, &download->mutex);
+	gboolean ok = !g_cancellable_is_cancelled(cancellable);
+	if (ok)
+		g_hash_table_add(download->paths, g_strdup(path));
+	g_mutex_unlock(&download->mutex);
+	if (id)
+		g_cancellable_disconnect(cancellable, id);
+	return ok;
+}
+
+static void _download_unclaim(AWeatherDownload *download, const gchar *path)
+{
+	g_mutex_lock(&download->mutex);
+	g_hash_table_remove(download->paths, path);
+	g_cond_broadcast(&download->cond);
+	g_mutex_unlock(&download->mutex);
+}
+
+static void _download_release(AWeatherDownload *download, AWeatherDownloadPriority priority,
+		AWeatherDownloadStats *request)
+{
+	g_mutex_lock(&download->mutex);
+	download->running[priority]--;
+	AWeatherDownloadStats *stats = &download->stats[priority];
+	stats->requests    += request->requests;
+	stats->failed      += request->failed;
+	stats->resumed     += request->resumed;
+	stats->bytes       += request->bytes;
+	stats->wait_us     += request->wait_us;
+	stats->transfer_us += request->transfer_us;
+	g_cond_broadcast(&download->cond);
+	g_mutex_unlock(&download->mutex);
+}
+
+/* The ETag, or failing that the Last-Modified date, the .part was started from */
+static gchar *_download_validator(SoupMessage *msg)
+{
+	const gchar *etag = soup_message_headers_get_one(msg->response_headers, "ETag");
+	const gchar *date = soup_message_headers_get_one(msg->response_headers, "Last-Modified");
+	/* Weak ETags can not be used with If-Range */
+	if (etag && !g_str_has_prefix(etag, "W/"))
+		return g_strdup(etag);
+	return g_strdup(date);
+}
+
+/* Fetches uri into path, through path.part so an interrupted transfer can be resumed.
+ * The validator of the response is kept in path.part.tag and sent back with If-Range,
+ * so a part of a file that changed since is started over instead of appended to. */
+static gboolean _download_transfer(AWeatherDownload *download, const gchar *uri,
+		const gchar *path, gboolean exists, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable, AWeatherDownloadStats *request)
+{
+	SoupMessage *msg = soup_message_new("GET", uri);
+	if (!msg)
+		return FALSE;
+	gchar   *part   = g_strconcat(path, ".part", NULL);
+	gchar   *tag    = g_strconcat(path, ".part.tag", NULL);
+	gchar   *saved  = NULL;
+	goffset  offset = 0;
+	GStatBuf st;
+	if (g_stat(part, &st) == 0 && st.st_size > 0 &&
+	    g_file_get_contents(tag, &saved, NULL, NULL) && saved[0]) {
+		offset = st.st_size;
+		soup_message_headers_set_range(msg->request_headers, offset, -1);
+		soup_message_headers_replace(msg->request_headers, "If-Range", saved);
+	} else if (exists && g_stat(path, &st) == 0) {
+		SoupDate *date = soup_date_new_from_time_t(st.st_mtime);
+		gchar    *str  = soup_date_to_string(date, SOUP_DATE_HTTP);
+		soup_message_headers_append(msg->request_headers, "If-Modified-Since", str);
+		g_free(str);
+		soup_date_free(date);
+	}
+
+	GError       *error = NULL;
+	GInputStream *in    = soup_session_send(download->soup, msg, cancellable, &error);
+	gboolean      ok    = FALSE;
+	guint         status = msg->status_code;
+	goffset       start  = 0;
+	if (!in) {
+		g_debug("AWeatherDownload: transfer - %s - %s", uri, error->message);
+		g_error_free(error);
+	} else if (status == SOUP_STATUS_NOT_MODIFIED) {
+		ok = TRUE;
+	} else if (status == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+		/* The partial file does not match the remote one anymore */
+		g_remove(part);
+		g_remove(tag);
+	} else if (status == SOUP_STATUS_PARTIAL_CONTENT && (!soup_message_headers_get_content_range(
+			msg->response_headers, &start, NULL, NULL) || start != offset)) {
+		/* Not the rest of the part, start over next time */
+		g_debug("AWeatherDownload: transfer - %s - range does not follow the part", uri);
+		g_remove(part);
+		g_remove(tag);
+	} else if (SOUP_STATUS_IS_SUCCESSFUL(status)) {
+		gchar *dir = g_path_get_dirname(path);
+		g_mkdir_with_parents(dir, 0755);
+		g_free(dir);
+
+		/* A changed file, or a server that ignores the range, is sent whole and replaces the part */
+		if (status != SOUP_STATUS_PARTIAL_CONTENT) {
+			offset = 0;
+			gchar *validator = _download_validator(msg);
+			if (validator)
+				g_file_set_contents(tag, validator, -1, NULL);
+			else
+				g_remove(tag);
+			g_free(validator);
+		} else {
+			request->resumed++;
+		}
+		goffset total = offset + soup_message_headers_get_content_length(msg->response_headers);
+		goffset cur   = offset;
+
+		FILE   *fd  = g_fopen(part, offset ? "ab" : "wb");
+		guint8 *buf = g_malloc(DOWNLOAD_CHUNK);
+		gssize  len = fd ? 0 : -1;
+		while (fd && (len = g_input_stream_read(in, buf, DOWNLOAD_CHUNK,
+				cancellable, NULL)) > 0) {
+			if (fwrite(buf, 1, len, fd) != (gsize)len) {
+				len = -1;
+				break;
+			}
+			cur += len;
+			request->bytes += len;
+			if (callback)
+				callback((gchar*)path, cur, MAX(total, cur), user_data);
+		}
+		g_free(buf);
+		if (fd)
+			fclose(fd);
+		/* A short read is kept for resuming */
+		ok = len == 0 && (total <= offset || cur >= total) &&
+			g_rename(part, path) == 0;
+		if (ok)
+			g_remove(tag);
+	} else {
+		g_debug("AWeatherDownload: transfer - %s - status %d", uri, status);
+	}
+
+	if (in)
+		g_object_unref(in);
+	g_object_unref(msg);
+	g_free(saved);
+	g_free(part);
+	g_free(tag);
+	return ok;
+}
+
+gchar *aweather_download_fetch(AWeatherDownload *download, const gchar *prefix,
+		const gchar *uri, const gchar *local, GritsCacheType mode,
+		AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable)
+{
+	return aweather_download_fetch_full(download, prefix, uri, local, mode,
+			priority, callback, user_data, cancellable, NULL);
+}
+
+gchar *aweather_download_fetch_full(AWeatherDownload *download, const gchar *prefix,
+		const gchar *uri, const gchar *local, GritsCacheType mode,
+		AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable, AWeatherDownloadStats *result)
+{
+	AWeatherDownloadStats unused;
+	if (!result)
+		result = &unused;
+	*result = (AWeatherDownloadStats){};
+
+	gchar   *path   = g_build_filename(g_get_user_cache_dir(), "grits",
+			prefix, local, NULL);
+	GStatBuf st;
+	gboolean exists = g_stat(path, &st) == 0;
+	if (mode == GRITS_LOCAL || (mode == GRITS_ONCE && exists)) {
+		if (exists) {
+			aweather_cache_used(download->cache, path, TRUE, st.st_size);
+			return path;
+		}
+		g_free(path);
+		return NULL;
+	}
+
+	/* Another fetch of the same file may have finished it while this one waited */
+	AWeatherDownloadStats request = {.requests = 1};
+	gint64 queued = g_get_monotonic_time();
+	if (!_download_claim(download, path, cancellable)) {
+		g_free(path);
+		return NULL;
+	}
+	exists = g_stat(path, &st) == 0;
+	if (mode == GRITS_ONCE && exists) {
+		_download_unclaim(download, path);
+		aweather_cache_used(download->cache, path, TRUE, st.st_size);
+		return path;
+	}
+	if (!_download_acquire(download, priority, cancellable)) {
+		_download_unclaim(download, path);
+		g_free(path);
+		return NULL;
+	}
+	gint64 started = g_get_monotonic_time();
+	request.wait_us = started - queued;
+
+	gboolean ok = _download_transfer(download, uri, path, exists,
+			callback, user_data, cancellable, &request);
+	request.transfer_us = g_get_monotonic_time() - started;
+	request.failed      = !ok;
+	g_debug("AWeatherDownload: fetch - %s - %s, waited %dms, %"G_GINT64_FORMAT" bytes in %dms%s",
+			uri, ok ? "done" : "failed", (gint)(request.wait_us/1000), request.bytes,
+			(gint)(request.transfer_us/1000), request.resumed ? " (resumed)" : "");
+	_download_release(download, priority, &request);
+	_download_unclaim(download, path);
+	*result = request;
+
+	/* Like grits_http_fetch, an old copy is better than nothing */
+	if (g_stat(path, &st) != 0) {
+		g_free(path);
+		return NULL;
+	}
+	/* Nothing received means the server said the cached file is still good, or it was kept after a failure */
+	if (!ok || request.bytes == 0)
+		aweather_cache_used(download->cache, path, TRUE, st.st_size);
+	else
+		aweather_cache_used(download->cache, path, FALSE, request.bytes);
+	return path;
+}
+
+GList *aweather_download_available(AWeatherDownload *download, const gchar *prefix,
+		const gchar *filter, const gchar *cache, const gchar *extract, const gchar *index,
+		AWeatherDownloadPriority priority, GCancellable *cancellable, gboolean *listed)
+{
+	GRegex *filter_re = g_regex_new(filter, 0, 0, NULL);
+	GList  *files     = NULL;
+	if (listed)
+		*listed = TRUE;
+
+	if (cache) {
+		gchar *path = g_build_filename(g_get_user_cache_dir(), "grits", prefix, cache, NULL);
+		GDir  *dir  = g_dir_open(path, 0, NULL);
+		const gchar *name;
+		while (dir && (name = g_dir_read_name(dir)))
+			if (g_regex_match(filter_re, name, 0, NULL))
+				files = g_list_prepend(files, g_strdup(name));
+		if (dir)
+			g_dir_close(dir);
+		g_free(path);
+	}
+
+	if (index) {
+		/* Kept under a name made from index, so the next listing only asks whether it changed.
+		 * An old copy kept after a failed fetch is not a listing */
+		gchar *sum   = g_compute_checksum_for_string(G_CHECKSUM_MD5, index, -1);
+		gchar *local = g_strconcat(".index", G_DIR_SEPARATOR_S, sum, NULL);
+		AWeatherDownloadStats result;
+		gchar *path  = aweather_download_fetch_full(download, prefix, index, local,
+				GRITS_REFRESH, priority, NULL, NULL, cancellable, &result);
+		gchar *text  = NULL;
+		if (!path || result.failed || !g_file_get_contents(path, &text, NULL, NULL)) {
+			g_debug("AWeatherDownload: available - %s - not listed", index);
+			if (listed)
+				*listed = FALSE;
+		} else {
+			GRegex     *extract_re = g_regex_new(extract, 0, 0, NULL);
+			GMatchInfo *info;
+			gboolean    matched    = FALSE;
+			g_regex_match(extract_re, text, 0, &info);
+			while (g_match_info_matches(info)) {
+				matched = TRUE;
+				gchar *name = g_match_info_fetch(info, 1);
+				if (name && g_regex_match(filter_re, name, 0, NULL))
+					files = g_list_prepend(files, name);
+				else
+					g_free(name);
+				g_match_info_next(info, NULL);
+			}
+			/* Text that extract finds nothing in is not a listing, say an error page */
+			if (listed && !matched && *g_strstrip(text))
+				*listed = FALSE;
+			g_match_info_free(info);
+			g_regex_unref(extract_re);
+		}
+		g_free(text);
+		g_free(path);
+		g_free(local);
+		g_free(sum);
+	}
+
+	g_regex_unref(filter_re);
+	return files;
+}
+
+void aweather_download_get_stats(AWeatherDownload *download,
+		AWeatherDownloadPriority priority, AWeatherDownloadStats *stats)
+{
+	g_mutex_lock(&download->mutex);
+	*stats = download->stats[priority];
+	g_mutex_unlock(&download->mutex);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_DOWNLOAD_H__
+#define __AWEATHER_DOWNLOAD_H__
+
+#include <gio/gio.h>
+#include <grits.h>
+
+#include "aweather-cache.h"
+
+/* Download manager shared by the plugins of a viewer, so radar volumes, CONUS images and alerts
+ * share one HTTP session (and its per host keep-alive connections) and one set of limits.
+ *
+ * Fetches are synchronous like grits_http_fetch and are made from worker threads. At most
+ * aweather/download_max transfers run at once, background ones at most aweather/download_max_background
+ * and only while no visible fetch is waiting. Urgent fetches (alerts) have their own slots and never wait
+ * behind radar data. Interrupted transfers are kept next to the cache file and resumed with a range request. */
+
+typedef enum {
+	AWEATHER_DOWNLOAD_URGENT,     /* Small and important, eg. alerts */
+	AWEATHER_DOWNLOAD_VISIBLE,    /* Data for what the user is looking at */
+	AWEATHER_DOWNLOAD_BACKGROUND, /* Hidden sites, animation frames and polling for new data */
+	AWEATHER_DOWNLOAD_PRIORITIES,
+} AWeatherDownloadPriority;
+
+typedef struct {
+	gint   requests;   // Fetches that went to the network
+	gint   failed;
+	gint   resumed;    // Transfers continued from a partial file
+	gint64 bytes;      // Bytes received
+	gint64 wait_us;    // Time spent waiting for a free slot
+	gint64 transfer_us;
+} AWeatherDownloadStats;
+
+typedef struct _AWeatherDownload AWeatherDownload;
+
+/* Makes a download manager of its own, for use without a viewer. Free it with aweather_download_unref.
+ * cache may be NULL. */
+AWeatherDownload *aweather_download_new(GritsPrefs *prefs, AWeatherCache *cache);
+
+/* Returns the download manager of viewer, made by the first plugin to ask for it.
+ * Each plugin holds a reference until it is disposed. */
+AWeatherDownload *aweather_download_ref(GritsViewer *viewer, GritsPrefs *prefs);
+
+void aweather_download_unref(AWeatherDownload *download);
+
+/* Like grits_http_fetch, local is relative to prefix in the cache (the prefix of the plugin's GritsHttp).
+ * Returns the path of the cached file or NULL. cancellable may be NULL, cancelling it stops the transfer
+ * and keeps what was received for the next try. Fetches of the same file wait for each other. */
+gchar *aweather_download_fetch(AWeatherDownload *download, const gchar *prefix,
+		const gchar *uri, const gchar *local, GritsCacheType mode,
+		AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable);
+
+/* Like aweather_download_fetch, and result (which may be NULL) is set to the numbers of just this fetch.
+ * Its requests is 0 if the cached file was used without asking the server. */
+gchar *aweather_download_fetch_full(AWeatherDownload *download, const gchar *prefix,
+		const gchar *uri, const gchar *local, GritsCacheType mode,
+		AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable, AWeatherDownloadStats *result);
+
+/* Like grits_http_available, the names matching filter among the files cached in cache (relative to prefix,
+ * skipped if NULL) and the ones the first group of extract finds in index. index (skipped if NULL) is fetched
+ * like any other file at priority and cached below prefix/.index. If listed is not NULL, it is set to FALSE if index
+ * could not be fetched or extract found nothing in it, so an empty listing can be told apart from a failed one. */
+GList *aweather_download_available(AWeatherDownload *download, const gchar *prefix,
+		const gchar *filter, const gchar *cache, const gchar *extract, const gchar *index,
+		AWeatherDownloadPriority priority, GCancellable *cancellable, gboolean *listed);
+
+/* Totals of the fetches made at priority so far */
+void aweather_download_get_stats(AWeatherDownload *download,
+		AWeatherDownloadPriority priority, AWeatherDownloadStats *stats);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "aweather-geometry.h"
+
+#define GEOMETRY_KEY "aweather-geometry"
+
+struct _AWeatherGeometry {
+	GMappedFile     *mapped;
+	gchar           *data;
+	GeometryHeader  *header;
+	GeometryFeature *features;
+	guint64         *polys;
+	gchar           *strings;
+	gsize            nstrings;
+};
+
+/* Checks everything the polygons are made from, so a damaged pack can only fall back to the text */
+static gboolean _geometry_check(AWeatherGeometry *geometry, gsize size)
+{
+	GeometryHeader *header = geometry->header;
+	if (size < sizeof(GeometryHeader) ||
+	    memcmp(header->magic, GEOMETRY_MAGIC, sizeof(header->magic)) ||
+	    header->order   != GEOMETRY_ORDER   ||
+	    header->version != GEOMETRY_VERSION ||
+	    header->radius  != EARTH_R          ||
+	    header->size    != size)
+		return FALSE;
+
+	/* Parts follow each other, the points and the polygons they hold must be aligned */
+	if (header->features != sizeof(GeometryHeader) ||
+	    header->polys    != header->features + header->nfeatures * sizeof(GeometryFeature) ||
+	    header->points   != header->polys    + header->npolys    * sizeof(guint64)         ||
+	    header->strings  != header->points   + header->npoints   * 3 * sizeof(gdouble)     ||
+	    header->strings  >= size || header->points % 8 != 0)
+		return FALSE;
+
+	/* Every polygon ends with a 0,0,0 point, so the last point is one */
+	gdouble (*points)[3] = (gpointer)(geometry->data + header->points);
+	if (header->npoints == 0 || points[header->npoints-1][0] ||
+	    points[header->npoints-1][1] || points[header->npoints-1][2])
+		return FALSE;
+	for (guint i = 0; i < header->npolys; i++)
+		if (geometry->polys[i] <  header->points  ||
+		    geometry->polys[i] >= header->strings ||
+		    (geometry->polys[i] - header->points) % (3*sizeof(gdouble)) != 0)
+			return FALSE;
+
+	/* Keys are inside the strings, which end with a nul */
+	if (geometry->strings[geometry->nstrings-1] != '\0')
+		return FALSE;
+	for (guint i = 0; i < header->nfeatures; i++) {
+		GeometryFeature *feature = &geometry->features[i];
+		if (feature->key >= geometry->nstrings ||
+		    (guint64)feature->poly + feature->npolys > header->npolys)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+AWeatherGeometry *aweather_geometry_open(const gchar *path, const gchar *text)
+{
+	GStatBuf pstat, tstat;
+	if (g_stat(path, &pstat) != 0)
+		return NULL;
+	if (text && g_stat(text, &tstat) == 0 && tstat.st_mtime > pstat.st_mtime) {
+		g_debug("AWeatherGeometry: open - %s is older than %s", path, text);
+		return NULL;
+	}
+
+	/* Installed packs are not ours to write, the file is opened read only and writable
+	 * only makes the mapping copy on write in case grits touches the points */
+	int fd = g_open(path, O_RDONLY, 0);
+	if (fd < 0) {
+		g_debug("AWeatherGeometry: open - %s: %s", path, g_strerror(errno));
+		return NULL;
+	}
+	GError *error = NULL;
+	GMappedFile *mapped = g_mapped_file_new_from_fd(fd, TRUE, &error);
+	close(fd);
+	if (!mapped) {
+		g_warning("AWeatherGeometry: open - %s", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	AWeatherGeometry *geometry = g_new0(AWeatherGeometry, 1);
+	gsize size = g_mapped_file_get_length(mapped);
+	geometry->mapped = mapped;
+	geometry->data   = g_mapped_file_get_contents(mapped);
+	geometry->header = (GeometryHeader*)geometry->data;
+	if (size >= sizeof(GeometryHeader) && geometry->header->strings < size) {
+		geometry->features = (GeometryFeature*)(geometry->data + geometry->header->features);
+		geometry->polys    = (guint64*)(geometry->data + geometry->header->polys);
+		geometry->strings  = geometry->data + geometry->header->strings;
+		geometry->nstrings = size - geometry->header->strings;
+	}
+	if (!_geometry_check(geometry, size)) {
+		g_warning("AWeatherGeometry: open - %s is not a valid geometry pack", path);
+		aweather_geometry_free(geometry);
+		return NULL;
+	}
+	g_debug("AWeatherGeometry: open - %s, %u features, %u polygons",
+			path, geometry->header->nfeatures, geometry->header->npolys);
+	return geometry;
+}
+
+void aweather_geometry_free(AWeatherGeometry *geometry)
+{
+	g_mapped_file_unref(geometry->mapped);
+	g_free(geometry);
+}
+
+gint aweather_geometry_count(AWeatherGeometry *geometry)
+{
+	return geometry->header->nfeatures;
+}
+
+gint64 aweather_geometry_id(AWeatherGeometry *geometry, gint i)
+{
+	return geometry->features[i].id;
+}
+
+const gchar *aweather_geometry_key(AWeatherGeometry *geometry, gint i)
+{
+	return geometry->strings + geometry->features[i].key;
+}
+
+GritsPoly *aweather_geometry_poly(AWeatherGeometry *geometry, gint i)
+{
+	GeometryFeature *feature = &geometry->features[i];
+
+	/* Only the list of polygons is allocated, the points are in the pack */
+	gdouble (**points)[3] = (gpointer)g_new0(gpointer, feature->npolys+1);
+	for (gint pi = 0; pi < feature->npolys; pi++)
+		points[pi] = (gpointer)(geometry->data + geometry->polys[feature->poly + pi]);
+
+	GritsPoly *poly = grits_poly_new(points);
+	GRITS_OBJECT(poly)->center.lat  = (feature->n + feature->s)/2;
+	GRITS_OBJECT(poly)->center.lon  = lon_avg(feature->e, feature->w);
+	GRITS_OBJECT(poly)->center.elev = 0;
+	GRITS_OBJECT(poly)->skip        = GRITS_SKIP_CENTER;
+	g_object_weak_ref(G_OBJECT(poly), (GWeakNotify)g_free, points);
+	g_object_set_data_full(G_OBJECT(poly), GEOMETRY_KEY,
+			g_mapped_file_ref(geometry->mapped), (GDestroyNotify)g_mapped_file_unref);
+	return poly;
+}
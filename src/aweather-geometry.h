@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_GEOMETRY_H__
+#define __AWEATHER_GEOMETRY_H__
+
+#include <glib.h>
+#include <grits.h>
+
+/* Geometry packs, fips.pack and borders.pack, are fips.txt and borders.txt compiled by aweather-geopack at
+ * build time. They are mapped as they are and the polygons point straight into them, so nothing is parsed.
+ *
+ * A pack is in the byte order of the machine that made it and holds, each part 8 byte aligned:
+ *   GeometryHeader
+ *   GeometryFeature[nfeatures] - a county or border, with its key and bounds
+ *   guint64[npolys]            - file offsets of the first point of each polygon, by feature
+ *   gdouble[npoints][3]        - x,y,z of the points from lle2xyz, each polygon ends with a 0,0,0 point
+ *   gchar[]                    - keys, nul terminated */
+
+#define GEOMETRY_MAGIC   "AWGEOM\r\n"
+#define GEOMETRY_ORDER   0x01020304
+#define GEOMETRY_VERSION 1
+
+typedef struct {
+	gchar    magic[8];
+	guint32  order;      // GEOMETRY_ORDER, as written by the machine that made the pack
+	guint32  version;
+	gdouble  radius;     // EARTH_R the points were made with
+	guint64  size;       // Of the whole file
+	guint32  nfeatures;
+	guint32  npolys;
+	guint64  npoints;    // Including the end of polygon points
+	guint64  features;   // File offsets of each part
+	guint64  polys;
+	guint64  points;
+	guint64  strings;
+} GeometryHeader;
+
+typedef struct {
+	gint64   id;         // FIPS code of counties, the line number of borders
+	guint32  key;        // Offset in the strings of the state of counties and the name of borders
+	guint32  poly;       // Index of the first polygon
+	guint32  npolys;
+	guint32  pad;
+	gdouble  n, s, e, w; // Bounds of the points, lat/lon
+} GeometryFeature;
+
+typedef struct _AWeatherGeometry AWeatherGeometry;
+
+/* Maps the pack at path. Returns NULL if it is missing, not valid on this machine, or older than text,
+ * the file it was made from, in which case the text file should be parsed instead. */
+AWeatherGeometry *aweather_geometry_open(const gchar *path, const gchar *text);
+
+/* The mapping stays until the polygons made from it are freed too */
+void aweather_geometry_free(AWeatherGeometry *geometry);
+
+gint aweather_geometry_count(AWeatherGeometry *geometry);
+
+gint64 aweather_geometry_id(AWeatherGeometry *geometry, gint i);
+
+const gchar *aweather_geometry_key(AWeatherGeometry *geometry, gint i);
+
+/* Makes the polygon of feature i, the same one grits_poly_parse would make from the text */
+GritsPoly *aweather_geometry_poly(AWeatherGeometry *geometry, gint i);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compiles fips.txt or borders.txt into a geometry pack, see aweather-geometry.h
+ *   aweather-geopack fips    fips.txt    fips.pack
+ *   aweather-geopack borders borders.txt borders.pack */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "aweather-geometry.h"
+
+typedef struct {
+	GArray  *features; // GeometryFeature
+	GArray  *polys;    // guint64, point index until written
+	GArray  *points;   // gdouble[3]
+	GString *strings;
+} Pack;
+
+/* Adds a feature from polygons separated by tabs, made of lat,lon points separated by spaces,
+ * the way grits_poly_parse reads them */
+static void pack_feature(Pack *pack, gint64 id, const gchar *key, const gchar *text)
+{
+	GeometryFeature feature = {
+		.id     = id,
+		.key    = pack->strings->len,
+		.poly   = pack->polys->len,
+		.n = -90, .s = 90, .e = -180, .w = 180,
+	};
+	g_string_append_len(pack->strings, key, strlen(key)+1);
+
+	static const gdouble end[3] = {0, 0, 0};
+	gchar **spolys = g_strsplit(text, "\t", -1);
+	for (gint pi = 0; spolys[pi]; pi++) {
+		guint64 first = pack->points->len;
+		g_array_append_val(pack->polys, first);
+		gchar **scoords = g_strsplit(spolys[pi], " ", -1);
+		for (gint ci = 0; scoords[ci]; ci++) {
+			gdouble lat, lon, xyz[3];
+			if (sscanf(scoords[ci], "%lf,%lf", &lat, &lon) != 2)
+				continue;
+			if (lat > feature.n) feature.n = lat;
+			if (lat < feature.s) feature.s = lat;
+			if (lon > feature.e) feature.e = lon;
+			if (lon < feature.w) feature.w = lon;
+			lle2xyz(lat, lon, 0, &xyz[0], &xyz[1], &xyz[2]);
+			g_array_append_val(pack->points, xyz);
+		}
+		g_array_append_val(pack->points, end);
+		g_strfreev(scoords);
+		feature.npolys++;
+	}
+	g_strfreev(spolys);
+	g_array_append_val(pack->features, feature);
+}
+
+/* Same lines fips_parse uses: fips_id<tab>county<tab>state<tab>polygons */
+static void pack_fips(Pack *pack, gchar **lines)
+{
+	for (gint li = 0; lines[li]; li++) {
+		gchar **sparts = g_strsplit(lines[li], "\t", 4);
+		if (g_strv_length(sparts) >= 4)
+			pack_feature(pack, g_ascii_strtoll(sparts[0], NULL, 10),
+					sparts[2], sparts[3]);
+		g_strfreev(sparts);
+	}
+}
+
+/* Same lines borders_parse uses: a header line, then name<tab>polygons */
+static void pack_borders(Pack *pack, gchar **lines)
+{
+	for (gint li = 1; lines[0] && lines[li]; li++) {
+		gchar **sparts = g_strsplit(lines[li], "\t", 2);
+		if (g_strv_length(sparts) >= 2)
+			pack_feature(pack, li, sparts[0], sparts[1]);
+		g_strfreev(sparts);
+	}
+}
+
+static gboolean pack_write(Pack *pack, const gchar *path)
+{
+	/* Pad the strings so the file size is aligned too */
+	while (pack->strings->len % 8 != 0)
+		g_string_append_c(pack->strings, '\0');
+
+	GeometryHeader header = {
+		.order     = GEOMETRY_ORDER,
+		.version   = GEOMETRY_VERSION,
+		.radius    = EARTH_R,
+		.nfeatures = pack->features->len,
+		.npolys    = pack->polys->len,
+		.npoints   = pack->points->len,
+	};
+	memcpy(header.magic, GEOMETRY_MAGIC, sizeof(header.magic));
+	header.features = sizeof(GeometryHeader);
+	header.polys    = header.features + header.nfeatures * sizeof(GeometryFeature);
+	header.points   = header.polys    + header.npolys    * sizeof(guint64);
+	header.strings  = header.points   + header.npoints   * 3 * sizeof(gdouble);
+	header.size     = header.strings  + pack->strings->len;
+
+	/* Polygons were recorded as point indexes */
+	for (guint i = 0; i < pack->polys->len; i++)
+		g_array_index(pack->polys, guint64, i) =
+			header.points + g_array_index(pack->polys, guint64, i) * 3 * sizeof(gdouble);
+
+	/* Written next to path and moved over it, so a failed build never leaves half a pack */
+	gchar *tmp  = g_strconcat(path, ".tmp", NULL);
+	FILE  *file = g_fopen(tmp, "wb");
+	gboolean ok = file &&
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(pack->features->data, sizeof(GeometryFeature), pack->features->len, file) == pack->features->len &&
+		fwrite(pack->polys->data,    sizeof(guint64),         pack->polys->len,    file) == pack->polys->len    &&
+		fwrite(pack->points->data,   3*sizeof(gdouble),       pack->points->len,   file) == pack->points->len   &&
+		fwrite(pack->strings->str,   1,                       pack->strings->len,  file) == pack->strings->len;
+	if (file && fclose(file) != 0)
+		ok = FALSE;
+	if (ok && g_rename(tmp, path) != 0)
+		ok = FALSE;
+	if (!ok)
+		g_unlink(tmp);
+	g_free(tmp);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 4 || (!g_str_equal(argv[1], "fips") && !g_str_equal(argv[1], "borders"))) {
+		g_printerr("usage: %s fips|borders <input.txt> <output.pack>\n", argv[0]);
+		return 1;
+	}
+
+	gchar *text; gsize len;
+	GError *error = NULL;
+	if (!g_file_get_contents(argv[2], &text, &len, &error)) {
+		g_printerr("%s: %s\n", argv[0], error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	Pack pack = {
+		.features = g_array_new(FALSE, FALSE, sizeof(GeometryFeature)),
+		.polys    = g_array_new(FALSE, FALSE, sizeof(guint64)),
+		.points   = g_array_new(FALSE, FALSE, 3*sizeof(gdouble)),
+		.strings  = g_string_new(NULL),
+	};
+	gchar **lines = g_strsplit(text, "\n", -1);
+	if (g_str_equal(argv[1], "fips"))
+		pack_fips(&pack, lines);
+	else
+		pack_borders(&pack, lines);
+	g_strfreev(lines);
+	g_free(text);
+
+	gboolean ok = pack.points->len > 0 && pack_write(&pack, argv[3]);
+	if (!ok)
+		g_printerr("%s: error writing %s\n", argv[0], argv[3]);
+	else
+		g_print("%s: %u features, %u polygons, %u points\n", argv[3],
+				pack.features->len, pack.polys->len, pack.points->len);
+
+	g_array_free(pack.features, TRUE);
+	g_array_free(pack.polys,    TRUE);
+	g_array_free(pack.points,   TRUE);
+	g_string_free(pack.strings, TRUE);
+	return ok ? 0 : 1;
+}
@@ -25,6 +25,7 @@
 
 #include "aweather-gui.h"
 #include "aweather-location.h"
+#include "aweather-startup.h"
 
 /* Autohide */
 typedef struct {
@@ -99,33 +100,11 @@ G_MODULE_EXPORT gboolean on_gui_key_press(GtkWidget *widget, GdkEventKey *event,
 	return FALSE;
 }
 
-static void cleancache_r(gchar *path)
-{
-	GDir *dir = g_dir_open(path, 0, NULL);
-	if (!dir)
-		return;
-	const gchar *child;
-	while ((child = g_dir_read_name(dir))) {
-		gchar *child_path = g_build_filename(path, child, NULL);
-		if (g_file_test(child_path, G_FILE_TEST_IS_DIR)) {
-			cleancache_r(child_path);
-		} else {
-			struct stat st;
-			g_stat(child_path, &st);
-			if (st.st_atime < time(NULL)-60*60*24)
-				g_remove(child_path);
-		}
-		g_free(child_path);
-	}
-	g_dir_close(dir);
-	g_rmdir(path);
-}
 G_MODULE_EXPORT void on_cleancache(GtkMenuItem *menu, AWeatherGui *self)
 {
 	g_debug("AWeatherGui: on_cleancache");
-	/* Todo: move this to grits */
-	gchar *cache = g_build_filename(g_get_user_cache_dir(), "grits", NULL);
-	cleancache_r(cache);
+	/* Runs in the background, with the cache manager's regular passes */
+	aweather_cache_clean(self->cache, 60*60*24);
 }
 
 G_MODULE_EXPORT void on_help(GtkMenuItem *menu, AWeatherGui *self)
@@ -434,6 +413,15 @@ G_MODULE_EXPORT int on_download_radar_files_for_non_visible_sites_changed(GtkTog
 	return TRUE;
 }
 
+G_MODULE_EXPORT int on_realtime_changed(GtkToggleAction *action, AWeatherGui *self)
+{
+	gboolean value = gtk_toggle_action_get_active(action);
+	g_debug("AWeatherGui: on_realtime_changed - %p, realtime=%i", self, value);
+	grits_prefs_set_boolean(self->prefs, "aweather/realtime", value);
+
+	return TRUE;
+}
+
 
 G_MODULE_EXPORT int on_animation_frames_changed(GtkSpinButton *spinner, AWeatherGui *self)
 {
@@ -459,6 +447,22 @@ G_MODULE_EXPORT int on_animation_end_frame_hold_ms_changed(GtkSpinButton *spinne
 	return TRUE;
 }
 
+G_MODULE_EXPORT int on_animation_memory_budget_mb_changed(GtkSpinButton *spinner, AWeatherGui *self)
+{
+	gint value = gtk_spin_button_get_value_as_int(spinner);
+	g_debug("AWeatherGui: on_animation_memory_budget_mb_changed - %p, animation_memory_budget_mb=%d", self, value);
+	grits_prefs_set_integer(self->prefs, "aweather/animation_memory_budget_mb", value);
+	return TRUE;
+}
+
+G_MODULE_EXPORT int on_level3_below_kbps_changed(GtkSpinButton *spinner, AWeatherGui *self)
+{
+	gint value = gtk_spin_button_get_value_as_int(spinner);
+	g_debug("AWeatherGui: on_level3_below_kbps_changed - %p, level3_below_kbps=%d", self, value);
+	grits_prefs_set_integer(self->prefs, "aweather/level3_below_kbps", value);
+	return TRUE;
+}
+
 /*****************
  * Setup helpers *
  *****************/
@@ -538,27 +542,36 @@ static void prefs_setup(AWeatherGui *self)
 	gint   ll = grits_prefs_get_integer(self->prefs, "aweather/log_level",    NULL);
 	gboolean ns = grits_prefs_get_boolean(self->prefs, "aweather/RSL_wsr88d_merge_split_cuts_off", NULL);
 	gboolean nv = grits_prefs_get_boolean(self->prefs, "aweather/download_radar_files_for_non_visible_sites", NULL);
+	gboolean rt = grits_prefs_get_boolean(self->prefs, "aweather/realtime", NULL);
 	gint   af = get_and_clamp_pref_integer(self->prefs, "aweather/animation_frames", 1, 100);
 	gint   ai = grits_prefs_get_integer(self->prefs, "aweather/animation_frame_interval_ms", NULL);
 	gint   ae = grits_prefs_get_integer(self->prefs, "aweather/animation_end_frame_hold_ms", NULL);
+	gint   am = get_and_clamp_pref_integer(self->prefs, "aweather/animation_memory_budget_mb", 64, 65536);
+	gint   lb = get_and_clamp_pref_integer(self->prefs, "aweather/level3_below_kbps", 0, 100000);
 	gchar *is = grits_prefs_get_string (self->prefs, "aweather/initial_site", NULL);
 	GtkWidget *ufw = aweather_gui_get_widget(self, "prefs_general_freq");
 	GtkWidget *nuw = aweather_gui_get_widget(self, "prefs_general_url");
 	GtkWidget *llw = aweather_gui_get_widget(self, "prefs_general_log");
 	GObject *ans = aweather_gui_get_object(self, "RSL_wsr88d_merge_split_cuts_off");
 	GObject *anv = aweather_gui_get_object(self, "download_radar_files_for_non_visible_sites");
+	GObject *art = aweather_gui_get_object(self, "realtime");
 	GtkWidget *afw = aweather_gui_get_widget(self, "prefs_general_animation_frames");
 	GtkWidget *aiw = aweather_gui_get_widget(self, "prefs_general_animation_frame_interval_ms");
 	GtkWidget *aew = aweather_gui_get_widget(self, "prefs_general_animation_end_frame_hold_ms");
+	GtkWidget *amw = aweather_gui_get_widget(self, "prefs_general_animation_memory_budget_mb");
+	GtkWidget *lbw = aweather_gui_get_widget(self, "prefs_general_level3_below_kbps");
 	GtkWidget *isw = aweather_gui_get_widget(self, "prefs_general_site");
 	if (uf) gtk_spin_button_set_value(GTK_SPIN_BUTTON(ufw), uf);
 	if (nu) gtk_entry_set_text(GTK_ENTRY(nuw), nu), g_free(nu);
 	if (ll) gtk_spin_button_set_value(GTK_SPIN_BUTTON(llw), ll);
 	if (ns) gtk_toggle_action_set_active(GTK_TOGGLE_ACTION(ans), ns);
 	if (nv) gtk_toggle_action_set_active(GTK_TOGGLE_ACTION(anv), nv);
+	if (rt) gtk_toggle_action_set_active(GTK_TOGGLE_ACTION(art), rt);
 	if (af) gtk_spin_button_set_value(GTK_SPIN_BUTTON(afw), af);
 	if (ai) gtk_spin_button_set_value(GTK_SPIN_BUTTON(aiw), ai);
 	if (ae) gtk_spin_button_set_value(GTK_SPIN_BUTTON(aew), ae);
+	if (am) gtk_spin_button_set_value(GTK_SPIN_BUTTON(amw), am);
+	if (lb) gtk_spin_button_set_value(GTK_SPIN_BUTTON(lbw), lb);
 	if (is) {
 		GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(isw));
 		GtkTreeIter iter;
@@ -708,6 +721,7 @@ void aweather_gui_deattach_plugin(AWeatherGui *self, const gchar *name)
 void aweather_gui_load_plugins(AWeatherGui *self)
 {
 	g_debug("AWeatherGui: load_plugins");
+	AWeatherStartup *startup = aweather_startup_get(self->viewer);
 	GtkTreeIter iter;
 	for (GList *cur = grits_plugins_available(self->plugins); cur; cur = cur->next) {
 		gchar *name = cur->data;
@@ -717,8 +731,13 @@ void aweather_gui_load_plugins(AWeatherGui *self)
 			enabled = TRUE;
 		gtk_list_store_append(self->gtk_plugins, &iter);
 		gtk_list_store_set(self->gtk_plugins, &iter, 0, name, 1, enabled, -1);
-		if (enabled)
+		if (enabled) {
+			gint64 start = g_get_monotonic_time();
 			aweather_gui_attach_plugin(self, name);
+			gchar *phase = g_strdup_printf("plugin %s", name);
+			aweather_startup_phase(startup, phase, start);
+			g_free(phase);
+		}
 	}
 }
 
@@ -741,6 +760,7 @@ static void aweather_gui_parser_finished(GtkBuildable *_self, GtkBuilder *builde
 	self->viewer  = GRITS_VIEWER(aweather_gui_get_widget(self, "main_viewer"));
 	self->gtk_plugins = GTK_LIST_STORE(aweather_gui_get_object(self, "plugins"));
 	grits_viewer_setup(self->viewer, self->plugins, self->prefs);
+	self->cache   = aweather_cache_new(self->viewer, self->prefs);
 	g_free(config);
 	g_free(defaults);
 
@@ -797,6 +817,11 @@ static void aweather_gui_dispose(GObject *_self)
 		self->plugins = NULL;
 		grits_plugins_free(plugins);
 	}
+	if (self->cache) {
+		AWeatherCache *cache = self->cache;
+		self->cache = NULL;
+		aweather_cache_free(cache);
+	}
 	if (self->builder) {
 		GtkBuilder *builder = self->builder;
 		self->builder = NULL;
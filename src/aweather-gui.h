@@ -23,6 +23,8 @@
 
 #include <grits.h>
 
+#include "aweather-cache.h"
+
 /* Type macros */
 #define AWEATHER_TYPE_GUI            (aweather_gui_get_type())
 #define AWEATHER_GUI(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   AWEATHER_TYPE_GUI, AWeatherGui))
@@ -42,6 +44,7 @@ struct _AWeatherGui {
 	GritsViewer  *viewer;
 	GritsPlugins *plugins;
 	GritsPrefs   *prefs;
+	AWeatherCache *cache;
 	GtkListStore *gtk_plugins;
 	guint         update_source;
 };
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "aweather-startup.h"
+
+#define STARTUP_KEY  "aweather-startup"
+#define STARTUP_WAIT 60 // Seconds the report waits for deferred phases once the window is up
+
+typedef struct {
+	gchar    *name;
+	gint64    start;
+	gint64    end;
+	gboolean  background; // Recorded off the main thread
+} StartupPhase;
+
+/* This code is also built into the plugins, everything is found through the one struct on the viewer */
+struct _AWeatherStartup {
+	gint64    start;
+	GThread  *main;
+	gint      budget;     // aweather/startup_budget_ms
+	guint     report_id;  // _startup_report idle source
+	guint     wait_id;    // _startup_wait timeout
+
+	GMutex    mutex;
+	GArray   *phases;     // StartupPhase, in the order they ended
+	gint      deferred;
+	gboolean  ready;
+	gboolean  reported;
+};
+
+static gint _startup_compare(gconstpointer _a, gconstpointer _b)
+{
+	const StartupPhase *a = _a, *b = _b;
+	return (a->start <  b->start) ? -1 :
+	       (a->start == b->start) ?  0 : 1;
+}
+
+/* Runs on the main loop, after ready and the last deferred phase or once STARTUP_WAIT runs out */
+static gboolean _startup_report(gpointer _startup)
+{
+	AWeatherStartup *startup = _startup;
+	g_mutex_lock(&startup->mutex);
+	startup->report_id = 0;
+	if (startup->reported) {
+		g_mutex_unlock(&startup->mutex);
+		return FALSE;
+	}
+	if (startup->wait_id)
+		g_source_remove(startup->wait_id);
+	startup->wait_id  = 0;
+	startup->reported = TRUE;
+	g_array_sort(startup->phases, _startup_compare);
+
+	gint64 end = startup->start;
+	for (gint i = 0; i < startup->phases->len; i++) {
+		StartupPhase *phase = &g_array_index(startup->phases, StartupPhase, i);
+		g_message("AWeatherStartup: %-24s %7.1f ms at %7.1f ms%s", phase->name,
+				(phase->end   - phase->start)   / 1000.0,
+				(phase->start - startup->start) / 1000.0,
+				phase->background ? " (background)" : "");
+		end = MAX(end, phase->end);
+	}
+	gint64 total = (end - startup->start) / 1000;
+	if (startup->deferred > 0)
+		g_message("AWeatherStartup: %d phases still running", startup->deferred);
+	if (startup->budget > 0 && total > startup->budget)
+		g_warning("AWeatherStartup: startup took %d ms, over the budget of %d ms",
+				(gint)total, startup->budget);
+	else
+		g_message("AWeatherStartup: startup took %d ms", (gint)total);
+	g_mutex_unlock(&startup->mutex);
+	return FALSE;
+}
+
+static gboolean _startup_wait(gpointer _startup)
+{
+	AWeatherStartup *startup = _startup;
+	g_mutex_lock(&startup->mutex);
+	startup->wait_id = 0;
+	g_mutex_unlock(&startup->mutex);
+	return _startup_report(startup);
+}
+
+/* Must hold the mutex */
+static void _startup_check(AWeatherStartup *startup)
+{
+	if (startup->ready && startup->deferred <= 0 && !startup->report_id)
+		startup->report_id = g_idle_add(_startup_report, startup);
+}
+
+AWeatherStartup *aweather_startup_new(gint64 start)
+{
+	g_debug("AWeatherStartup: new");
+	AWeatherStartup *startup = g_new0(AWeatherStartup, 1);
+	startup->start  = start;
+	startup->main   = g_thread_self();
+	startup->phases = g_array_new(FALSE, FALSE, sizeof(StartupPhase));
+	g_mutex_init(&startup->mutex);
+	return startup;
+}
+
+void aweather_startup_attach(AWeatherStartup *startup, GritsViewer *viewer, GritsPrefs *prefs)
+{
+	if (!startup)
+		return;
+	g_debug("AWeatherStartup: attach");
+	startup->budget = grits_prefs_get_integer(prefs, "aweather/startup_budget_ms", NULL);
+	g_object_set_data(G_OBJECT(viewer), STARTUP_KEY, startup);
+}
+
+void aweather_startup_free(AWeatherStartup *startup)
+{
+	if (!startup)
+		return;
+	g_debug("AWeatherStartup: free");
+	if (startup->report_id)
+		g_source_remove(startup->report_id);
+	if (startup->wait_id)
+		g_source_remove(startup->wait_id);
+	for (gint i = 0; i < startup->phases->len; i++)
+		g_free(g_array_index(startup->phases, StartupPhase, i).name);
+	g_array_free(startup->phases, TRUE);
+	g_mutex_clear(&startup->mutex);
+	g_free(startup);
+}
+
+AWeatherStartup *aweather_startup_get(GritsViewer *viewer)
+{
+	return g_object_get_data(G_OBJECT(viewer), STARTUP_KEY);
+}
+
+void aweather_startup_phase(AWeatherStartup *startup, const gchar *name, gint64 start)
+{
+	if (!startup)
+		return;
+	StartupPhase phase = {
+		.name       = g_strdup(name),
+		.start      = start,
+		.end        = g_get_monotonic_time(),
+		.background = g_thread_self() != startup->main,
+	};
+	g_debug("AWeatherStartup: phase - %s %.1f ms", name, (phase.end - phase.start) / 1000.0);
+	g_mutex_lock(&startup->mutex);
+	if (!startup->reported)
+		g_array_append_val(startup->phases, phase);
+	else
+		g_free(phase.name);
+	g_mutex_unlock(&startup->mutex);
+}
+
+void aweather_startup_defer(AWeatherStartup *startup)
+{
+	if (!startup)
+		return;
+	g_mutex_lock(&startup->mutex);
+	if (!startup->reported)
+		startup->deferred++;
+	g_mutex_unlock(&startup->mutex);
+}
+
+void aweather_startup_done(AWeatherStartup *startup, const gchar *name, gint64 start)
+{
+	if (!startup)
+		return;
+	aweather_startup_phase(startup, name, start);
+	g_mutex_lock(&startup->mutex);
+	if (!startup->reported) {
+		startup->deferred--;
+		_startup_check(startup);
+	}
+	g_mutex_unlock(&startup->mutex);
+}
+
+void aweather_startup_ready(AWeatherStartup *startup)
+{
+	if (!startup)
+		return;
+	g_debug("AWeatherStartup: ready");
+	g_mutex_lock(&startup->mutex);
+	startup->ready   = TRUE;
+	startup->wait_id = g_timeout_add_seconds(STARTUP_WAIT, _startup_wait, startup);
+	_startup_check(startup);
+	g_mutex_unlock(&startup->mutex);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_STARTUP_H__
+#define __AWEATHER_STARTUP_H__
+
+#include <glib.h>
+#include <grits.h>
+
+/* Startup timing report. Each phase of startup is recorded with its start and end, on the main loop or on
+ * a background thread. Plugins that finish loading in the background announce it with aweather_startup_defer
+ * while they are being enabled and end it with aweather_startup_done. The report is logged once the window
+ * is up and the deferred phases have ended, one line per phase and a total since aweather started. A total
+ * over aweather/startup_budget_ms (0 for no budget) is logged as a warning.
+ *
+ * Phases recorded after the report, eg. by plugins enabled later on, are ignored. All functions do nothing
+ * if startup is NULL and can be called from any thread. */
+typedef struct _AWeatherStartup AWeatherStartup;
+
+/* Made by the application first thing, start is when it started in g_get_monotonic_time */
+AWeatherStartup *aweather_startup_new(gint64 start);
+
+/* Stores startup on the viewer for the plugins, before they are loaded */
+void aweather_startup_attach(AWeatherStartup *startup, GritsViewer *viewer, GritsPrefs *prefs);
+
+/* Plugins must be freed first */
+void aweather_startup_free(AWeatherStartup *startup);
+
+/* Returns the startup timing of viewer, or NULL if the application did not make one */
+AWeatherStartup *aweather_startup_get(GritsViewer *viewer);
+
+/* Records phase name, which ran from start to now */
+void aweather_startup_phase(AWeatherStartup *startup, const gchar *name, gint64 start);
+
+/* Holds the report back until a matching aweather_startup_done */
+void aweather_startup_defer(AWeatherStartup *startup);
+
+/* Records phase name like aweather_startup_phase and ends a deferred phase */
+void aweather_startup_done(AWeatherStartup *startup, const gchar *name, gint64 start);
+
+/* Called once the window is shown, the report is logged when nothing is deferred any more */
+void aweather_startup_ready(AWeatherStartup *startup);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <glib-unix.h>
+#endif
+
+#include "aweather-warm.h"
+#include "aweather-cache.h"
+#include "aweather-download.h"
+#include "plugins/mirrors.h"
+#include "plugins/level2-file.h"
+
+#define WARM_CACHE_PREFIX G_DIR_SEPARATOR_S "nexrad" G_DIR_SEPARATOR_S "level2" G_DIR_SEPARATOR_S
+#define WARM_STATUS       10  // Seconds between status file updates
+
+typedef struct {
+	gchar   *code;
+	gboolean busy;        // Queued or running on the pool
+	time_t   newest;      // Scan time of the newest volume warmed
+	time_t   checked;     // Wall time the last pass finished
+	gint     volumes;     // Ready at the end of the last pass
+	gint     fetched;     // Totals since start
+	gint     decoded;
+	gint     failed;
+	gint64   fetch_us;
+	gint64   decode_us;
+} AWeatherWarmSite;
+
+struct _AWeatherWarm {
+	GritsPrefs       *prefs;
+	AWeatherCache    *cache;
+	AWeatherDownload *download;
+	RadarMirrors     *mirrors;
+	GPtrArray        *sites;       // AWeatherWarmSite
+	GThreadPool      *pool;
+	GMutex            mutex;       // Protects the sites
+	GCancellable     *cancellable;
+	GMainLoop        *loop;
+	gchar            *status;      // Path of the status file
+	time_t            start;
+};
+
+/* Runs on the pool, warms the newest volumes of one site */
+static void _warm_site(gpointer _site, gpointer _warm)
+{
+	AWeatherWarm     *warm = _warm;
+	AWeatherWarmSite *site = _site;
+	gint volumes = grits_prefs_get_integer(warm->prefs, "aweather/warm_volumes", NULL) ?: 6;
+	g_debug("AWeatherWarm: site - %s", site->code);
+
+	/* Also keeps the ranking of the other mirrors current */
+	gchar     *url   = NULL;
+	GList     *files = radar_mirrors_list(warm->mirrors, warm->download, WARM_CACHE_PREFIX,
+			site->code, FALSE, TRUE, warm->cancellable, &url);
+	files = g_list_sort(files, (GCompareFunc)g_strcmp0);
+
+	/* Newest first, so a slow pass still has the volume the viewer wants most */
+	gint   ready = 0, fetched = 0, decoded = 0, failed = 0;
+	gint64 fetch_us = 0, decode_us = 0;
+	time_t newest = 0;
+	for (GList *cur = g_list_last(files); cur && ready < volumes; cur = cur->prev) {
+		if (g_cancellable_is_cancelled(warm->cancellable))
+			break;
+		gint64 start = g_get_monotonic_time();
+		gchar *file  = radar_mirrors_fetch(warm->mirrors, warm->download,
+				WARM_CACHE_PREFIX, site->code, url, cur->data, GRITS_ONCE,
+				AWEATHER_DOWNLOAD_BACKGROUND, NULL, NULL, warm->cancellable);
+		fetch_us += g_get_monotonic_time() - start;
+		if (!file) {
+			failed++;
+			continue;
+		}
+		fetched++;
+
+		if (!level2_file_spill_is_fresh(file, warm->prefs)) {
+			start = g_get_monotonic_time();
+			Radar *radar = level2_file_read(file, site->code, warm->prefs,
+					warm->cancellable);
+			if (radar && !level2_file_write_spill(radar, file, warm->prefs)) {
+				RSL_free_radar(radar);
+				radar = NULL;
+			}
+			decode_us += g_get_monotonic_time() - start;
+			g_free(file);
+			if (!radar) {
+				failed++;
+				continue;
+			}
+			RSL_free_radar(radar);
+			decoded++;
+		} else {
+			g_free(file);
+		}
+		newest = MAX(newest, radar_mirrors_volume_time(cur->data));
+		ready++;
+	}
+	g_list_free_full(files, g_free);
+	g_free(url);
+
+	g_debug("AWeatherWarm: site - %s - %d ready, %d decoded, %d failed",
+			site->code, ready, decoded, failed);
+	g_mutex_lock(&warm->mutex);
+	site->busy       = FALSE;
+	site->newest     = MAX(site->newest, newest);
+	site->checked    = time(NULL);
+	site->volumes    = ready;
+	site->fetched   += fetched;
+	site->decoded   += decoded;
+	site->failed    += failed;
+	site->fetch_us  += fetch_us;
+	site->decode_us += decode_us;
+	g_mutex_unlock(&warm->mutex);
+}
+
+/* Queues the sites that are not still busy with the last pass */
+static gboolean _warm_poll(gpointer _warm)
+{
+	AWeatherWarm *warm = _warm;
+	g_mutex_lock(&warm->mutex);
+	for (guint i = 0; i < warm->sites->len; i++) {
+		AWeatherWarmSite *site = warm->sites->pdata[i];
+		if (site->busy)
+			continue;
+		site->busy = TRUE;
+		g_thread_pool_push(warm->pool, site, NULL);
+	}
+	g_mutex_unlock(&warm->mutex);
+	return TRUE;
+}
+
+static gboolean _warm_write_status(gpointer _warm)
+{
+	AWeatherWarm *warm = _warm;
+	time_t now = time(NULL);
+	AWeatherDownloadStats download;
+	AWeatherCacheStats    cache;
+	aweather_download_get_stats(warm->download, AWEATHER_DOWNLOAD_BACKGROUND, &download);
+	aweather_cache_get_stats(warm->cache, AWEATHER_CACHE_LEVEL2, &cache);
+	gint64 lookups = cache.hits + cache.misses;
+
+	GString *status = g_string_new(NULL);
+	g_string_append_printf(status,
+			"time=%ld uptime=%ld requests=%d failed=%d bytes=%" G_GINT64_FORMAT
+			" rate_kbs=%" G_GINT64_FORMAT " cache_hit_pct=%d cache_mb=%" G_GINT64_FORMAT "\n",
+			(glong)now, (glong)(now - warm->start),
+			download.requests, download.failed, download.bytes,
+			download.transfer_us ? download.bytes * G_USEC_PER_SEC / 1024 / download.transfer_us : 0,
+			lookups ? (gint)(cache.hits * 100 / lookups) : 0,
+			cache.size / (1024*1024));
+	g_mutex_lock(&warm->mutex);
+	for (guint i = 0; i < warm->sites->len; i++) {
+		AWeatherWarmSite *site = warm->sites->pdata[i];
+		g_string_append_printf(status,
+				"site=%s busy=%d newest=%ld lag=%ld checked=%ld volumes=%d"
+				" fetched=%d decoded=%d failed=%d fetch_ms=%" G_GINT64_FORMAT
+				" decode_ms=%" G_GINT64_FORMAT "\n",
+				site->code, site->busy, (glong)site->newest,
+				site->newest ? (glong)(now - site->newest) : -1L,
+				(glong)site->checked, site->volumes,
+				site->fetched, site->decoded, site->failed,
+				site->fetch_us / 1000, site->decode_us / 1000);
+	}
+	g_mutex_unlock(&warm->mutex);
+
+	GError *error = NULL;
+	if (!g_file_set_contents(warm->status, status->str, status->len, &error)) {
+		g_warning("AWeatherWarm: write_status - %s", error->message);
+		g_error_free(error);
+	}
+	g_string_free(status, TRUE);
+	return TRUE;
+}
+
+#ifdef G_OS_UNIX
+static gboolean _warm_quit(gpointer _warm)
+{
+	AWeatherWarm *warm = _warm;
+	g_message("AWeatherWarm: quit - stopping");
+	g_cancellable_cancel(warm->cancellable);
+	g_main_loop_quit(warm->loop);
+	return TRUE;
+}
+#endif
+
+AWeatherWarm *aweather_warm_new(GritsPrefs *prefs, const gchar *sites)
+{
+	AWeatherWarm *warm = g_new0(AWeatherWarm, 1);
+	warm->prefs       = g_object_ref(prefs);
+	warm->cache       = aweather_cache_new(NULL, prefs);
+	warm->download    = aweather_download_new(prefs, warm->cache);
+	warm->mirrors     = radar_mirrors_new(prefs);
+	warm->sites       = g_ptr_array_new();
+	warm->cancellable = g_cancellable_new();
+	warm->loop        = g_main_loop_new(NULL, FALSE);
+	warm->status      = g_build_filename(g_get_user_cache_dir(),
+			PACKAGE, "warm.status", NULL);
+	g_mutex_init(&warm->mutex);
+
+	gchar *pref  = sites ? NULL :
+		grits_prefs_get_string(prefs, "aweather/warm_sites", NULL);
+	gchar **codes = g_strsplit_set(sites ?: pref ?: "", " \t,;", -1);
+	for (gchar **code = codes; *code; code++) {
+		if (**code == '\0')
+			continue;
+		AWeatherWarmSite *site = g_new0(AWeatherWarmSite, 1);
+		site->code = g_ascii_strup(*code, -1);
+		g_ptr_array_add(warm->sites, site);
+	}
+	g_strfreev(codes);
+	g_free(pref);
+
+	/* Transfers are limited by the download manager and decoding is serialized,
+	 * more threads than background transfers would only wait */
+	gint threads = grits_prefs_get_integer(prefs, "aweather/download_max_background", NULL);
+	warm->pool = g_thread_pool_new(_warm_site, warm,
+			CLAMP(threads, 1, MAX((gint)warm->sites->len, 1)), FALSE, NULL);
+	return warm;
+}
+
+gboolean aweather_warm_run(AWeatherWarm *warm)
+{
+	if (warm->sites->len == 0) {
+		g_warning("AWeatherWarm: run - no sites, set aweather/warm_sites or use --site");
+		return FALSE;
+	}
+	gint interval = grits_prefs_get_integer(warm->prefs, "aweather/warm_interval", NULL) ?: 60;
+	g_message("AWeatherWarm: run - %d sites every %ds, status in %s",
+			warm->sites->len, interval, warm->status);
+
+	gchar *dir = g_path_get_dirname(warm->status);
+	g_mkdir_with_parents(dir, 0755);
+	g_free(dir);
+
+	warm->start = time(NULL);
+	_warm_poll(warm);
+	_warm_write_status(warm);
+	guint poll   = g_timeout_add_seconds(interval, _warm_poll, warm);
+	guint status = g_timeout_add_seconds(WARM_STATUS, _warm_write_status, warm);
+#ifdef G_OS_UNIX
+	guint sigint  = g_unix_signal_add(SIGINT,  _warm_quit, warm);
+	guint sigterm = g_unix_signal_add(SIGTERM, _warm_quit, warm);
+#endif
+	g_main_loop_run(warm->loop);
+#ifdef G_OS_UNIX
+	g_source_remove(sigint);
+	g_source_remove(sigterm);
+#endif
+	g_source_remove(status);
+	g_source_remove(poll);
+
+	/* Let the passes that are running notice the cancel */
+	g_thread_pool_free(warm->pool, TRUE, TRUE);
+	warm->pool = NULL;
+	_warm_write_status(warm);
+	return TRUE;
+}
+
+void aweather_warm_free(AWeatherWarm *warm)
+{
+	if (warm->pool) {
+		g_cancellable_cancel(warm->cancellable);
+		g_thread_pool_free(warm->pool, TRUE, TRUE);
+	}
+	for (guint i = 0; i < warm->sites->len; i++) {
+		AWeatherWarmSite *site = warm->sites->pdata[i];
+		g_free(site->code);
+		g_free(site);
+	}
+	g_ptr_array_free(warm->sites, TRUE);
+	radar_mirrors_free(warm->mirrors);
+	aweather_download_unref(warm->download);
+	aweather_cache_free(warm->cache);
+	g_main_loop_unref(warm->loop);
+	g_object_unref(warm->cancellable);
+	g_mutex_clear(&warm->mutex);
+	g_free(warm->status);
+	g_object_unref(warm->prefs);
+	g_free(warm);
+}
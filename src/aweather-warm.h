@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_WARM_H__
+#define __AWEATHER_WARM_H__
+
+#include <glib.h>
+#include <grits.h>
+
+/* Headless cache warming, aweather --warm. Keeps the newest aweather/warm_volumes Level II volumes of each
+ * site in aweather/warm_sites downloaded, decompressed and decoded in the disk cache, polling every
+ * aweather/warm_interval seconds, so the viewer finds them ready. Uses the same download manager, mirror
+ * ranking and decoding as the radar plugin, without a display or OpenGL.
+ *
+ * Progress is written every few seconds to ~/.cache/aweather/warm.status, one line for the whole daemon
+ * with the download throughput and cache hit rate, then one line per site with its lag behind the newest
+ * volume. Runs until interrupted. */
+typedef struct _AWeatherWarm AWeatherWarm;
+
+/* sites is a list of site codes separated by spaces or commas, NULL to use aweather/warm_sites */
+AWeatherWarm *aweather_warm_new(GritsPrefs *prefs, const gchar *sites);
+
+/* Returns FALSE if there were no sites to warm, otherwise runs until SIGINT or SIGTERM */
+gboolean aweather_warm_run(AWeatherWarm *warm);
+
+void aweather_warm_free(AWeatherWarm *warm);
+
+#endif
@@ -17,6 +17,7 @@
 
 #define _XOPEN_SOURCE
 #include <sys/time.h>
+#include <string.h>
 #include <config.h>
 #include <gtk/gtk.h>
 #include <glib/gstdio.h>
@@ -29,6 +30,10 @@
 
 #include "aweather-gui.h"
 #include "aweather-location.h"
+#include "aweather-startup.h"
+#ifdef HAVE_RSL
+#include "aweather-warm.h"
+#endif
 
 static gint log_levels = 0;
 
@@ -110,11 +115,51 @@ static void setup_mac(AWeatherGui *gui)
 #endif
 }
 
+#ifdef HAVE_RSL
+/* Parses a copy of the arguments without gtk, which needs a display, ignoring gtk's own options */
+static gboolean pre_parse(int argc, char *argv[], GOptionEntry *entries)
+{
+	gchar **args = g_new0(gchar*, argc+1);
+	memcpy(args, argv, sizeof(gchar*) * argc);
+	GOptionContext *context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_set_help_enabled(context, FALSE);
+	g_option_context_set_ignore_unknown_options(context, TRUE);
+	gboolean ok = g_option_context_parse(context, &argc, &args, NULL);
+	g_option_context_free(context);
+	g_free(args);
+	return ok;
+}
+
+static int warm_main(gint debug, gchar *site)
+{
+	gchar *config   = g_build_filename(g_get_user_config_dir(), PACKAGE, "config.ini", NULL);
+	gchar *defaults = g_build_filename(PKGDATADIR, "defaults.ini", NULL);
+	GritsPrefs *prefs = grits_prefs_new(config, defaults);
+	g_free(config);
+	g_free(defaults);
+
+	GError *err = NULL;
+	gint prefs_debug = grits_prefs_get_integer(prefs, "aweather/log_level", &err);
+	g_log_set_handler(NULL, G_LOG_LEVEL_MASK, log_func, NULL);
+	log_levels = int2log(debug >= 0 ? debug : err == NULL ? prefs_debug : 2);
+	g_clear_error(&err);
+
+	AWeatherWarm *warm = aweather_warm_new(prefs, site);
+	gboolean ok = aweather_warm_run(warm);
+	aweather_warm_free(warm);
+	g_object_unref(prefs);
+	return ok ? 0 : -1;
+}
+#endif
+
 /********
  * Main *
  ********/
 int main(int argc, char *argv[])
 {
+	gint64 start = g_get_monotonic_time();
+
 	/* Defaults */
 	gint     debug      = 2; // G_LOG_LEVEL_WARNING
 	gchar   *site       = NULL;
@@ -130,6 +175,9 @@ int main(int argc, char *argv[])
 	gboolean opt_offline    = FALSE;
 	gboolean opt_autoupdate = FALSE;
 	gboolean opt_fullscreen = FALSE;
+#ifdef HAVE_RSL
+	gboolean opt_warm       = FALSE;
+#endif
 	GOptionEntry entries[] = {
 		//long         short flg type                 location         description                 arg desc
 		{"debug",      'd',  0,  G_OPTION_ARG_INT,    &opt_debug,      "Change default log level", "[0-5]"},
@@ -138,19 +186,31 @@ int main(int argc, char *argv[])
 		{"offline",    'o',  0,  G_OPTION_ARG_NONE,   &opt_offline,    "Run in offline mode",      NULL},
 		{"autoupdate", 'a',  0,  G_OPTION_ARG_NONE,   &opt_autoupdate, "Auto update radar",        NULL},
 		{"fullscreen", 'f',  0,  G_OPTION_ARG_NONE,   &opt_fullscreen, "Open in fullscreen mode",  NULL},
+#ifdef HAVE_RSL
+		{"warm",       'w',  0,  G_OPTION_ARG_NONE,   &opt_warm,       "Keep the radar cache warm, without a window", NULL},
+#endif
 		{NULL}
 	};
 
 	/* All times in UTC */
 	g_setenv("TZ", "UTC", TRUE);
 
+#ifdef HAVE_RSL
+	/* Cache warming runs without a display, so it is picked out before gtk is initialized */
+	if (pre_parse(argc, argv, entries) && opt_warm)
+		return warm_main(opt_debug, opt_site);
+#endif
+
 	/* Init */
+	AWeatherStartup *startup = aweather_startup_new(start);
 	GError *error = NULL;
 	if (!gtk_init_with_args(&argc, &argv, "aweather", entries, NULL, &error)) {
 		g_print("%s\n", error->message);
 		g_error_free(error);
+		aweather_startup_free(startup);
 		return -1;
 	}
+	aweather_startup_phase(startup, "gtk init", start);
 
 	/* Use external handler for link buttons */
 #if ! GTK_CHECK_VERSION(3,0,0)
@@ -167,10 +227,13 @@ int main(int argc, char *argv[])
 	/* Pre-load some types for gtkbuilder */
 	GRITS_TYPE_OPENGL;
 	AWEATHER_TYPE_GUI;
+	gint64 phase = g_get_monotonic_time();
 	GtkBuilder *builder = gtk_builder_new();
 	if (!gtk_builder_add_from_file(builder, PKGDATADIR "/main.ui", &error))
 		g_error("Failed to create gtk builder: %s", error->message);
 	AWeatherGui *gui = AWEATHER_GUI(gtk_builder_get_object(builder, "main_window"));
+	aweather_startup_phase(startup, "main window", phase);
+	aweather_startup_attach(startup, gui->viewer, gui->prefs);
 	g_signal_connect(gui, "destroy", gtk_main_quit, NULL);
 	GObject *action = aweather_gui_get_object(gui, "prefs_general_log");
 	g_signal_connect(action, "changed", G_CALLBACK(on_log_level_changed), NULL);
@@ -197,11 +260,15 @@ int main(int argc, char *argv[])
 	set_toggle_action(gui, "fullscreen", fullscreen);
 	g_free(prefs_site);
 
-	/* Done with init, show gui */
+	/* Done with init, show gui, plugins are loaded when the viewer is realized */
+	phase = g_get_monotonic_time();
 	gtk_widget_show_all(GTK_WIDGET(gui));
 	set_toggle_action(gui, "fullscreen", fullscreen); // Resest widget hiding
 	setup_mac(gui);	// done after show_all
+	aweather_startup_phase(startup, "show window", phase);
+	aweather_startup_ready(startup);
 	gtk_main();
+	aweather_startup_free(startup);
 	//gdk_display_close(gdk_display_get_default());
 	return 0;
 }
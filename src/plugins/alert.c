@@ -24,9 +24,11 @@
 
 #include "alert.h"
 #include "alert-info.h"
+#include "../aweather-geometry.h"
 
 #include "../compat.h"
 
+#define ALERT_CACHE_PREFIX G_DIR_SEPARATOR_S "alerts" G_DIR_SEPARATOR_S "cap" G_DIR_SEPARATOR_S
 #define MSG_INDEX "https://api.weather.gov/alerts/active.atom?region_type=land"
 #define CONFIG_HEIGHT 3
 
@@ -301,13 +303,15 @@ gchar *msg_find_nearest(GritsHttp *http, time_t when, gboolean offline)
 		return NULL;
 }
 
-GList *msg_load_index(GritsHttp *http, time_t when, time_t *updated, gboolean offline)
+GList *msg_load_index(GritsPluginAlert *alert, time_t when, time_t *updated, gboolean offline)
 {
 	/* Fetch current alerts */
-	gchar *tmp = msg_find_nearest(http, when, offline);
+	gchar *tmp = msg_find_nearest(alert->http, when, offline);
 	if (!tmp)
 		return NULL;
-	gchar *file = grits_http_fetch(http, MSG_INDEX, tmp, GRITS_ONCE, NULL, NULL);
+	gchar *file = aweather_download_fetch(alert->download, ALERT_CACHE_PREFIX,
+			MSG_INDEX, tmp, GRITS_ONCE, AWEATHER_DOWNLOAD_URGENT,
+			NULL, NULL, alert->cancellable);
 	g_free(tmp);
 	if (!file)
 		return NULL;
@@ -336,7 +340,7 @@ GList *msg_load_index(GritsHttp *http, time_t when, time_t *updated, gboolean of
 	return msgs;
 }
 
-gboolean msg_load_cap(GritsHttp *http, AlertMsg *msg)
+gboolean msg_load_cap(GritsPluginAlert *alert, AlertMsg *msg)
 {
 	if (msg->description || msg->instruction || msg->polygon)
 		return TRUE;
@@ -348,7 +352,9 @@ gboolean msg_load_cap(GritsHttp *http, AlertMsg *msg)
 	//if (!id) return FALSE; id++;
 	gchar *dir  = g_strdelimit(g_strdup(msg->info->abbr), " ", '_');
 	gchar *tmp  = g_strdup_printf("%s/%s.xml", dir, cFileName);
-	gchar *file = grits_http_fetch(http, msg->link, tmp, GRITS_ONCE, NULL, NULL);
+	gchar *file = aweather_download_fetch(alert->download, ALERT_CACHE_PREFIX,
+			msg->link, tmp, GRITS_ONCE, AWEATHER_DOWNLOAD_URGENT,
+			NULL, NULL, alert->cancellable);
 	g_free(tmp);
 	g_free(dir);
 	g_free(cFileName);
@@ -423,12 +429,21 @@ gboolean fips_group_state(gpointer key, gpointer value, gpointer data)
 	return FALSE;
 }
 
-void fips_parse(gchar *text, GTree **_counties, GList **_states)
+void fips_insert(GTree *counties, GTree *states, glong id,
+		const gchar *state, GritsPoly *poly)
+{
+	/* Insert polys into the tree */
+	g_tree_insert(counties, (gpointer)id, poly);
+
+	/* Insert into states list */
+	GList *list = g_tree_lookup(states, state);
+	list = g_list_prepend(list, poly);
+	g_tree_replace(states, g_strdup(state), list);
+}
+
+void fips_parse(gchar *text, GTree *counties, GTree *states)
 {
 	g_debug("GritsPluginAlert: fips_parse");
-	GTree *counties = g_tree_new((GCompareFunc)fips_compare);
-	GTree *states   = g_tree_new_full((GCompareDataFunc)g_strcmp0,
-			NULL, g_free, NULL);
 	gchar **lines = g_strsplit(text, "\n", -1);
 	for (gint li = 0; lines[li]; li++) {
 		/* Split line */
@@ -441,25 +456,53 @@ void fips_parse(gchar *text, GTree **_counties, GList **_states)
 
 		/* Create GritsPoly */
 		GritsPoly *poly = grits_poly_parse(sparts[3], "\t", " ", ",");
-
-		/* Insert polys into the tree */
 		glong id = g_ascii_strtoll(sparts[0], NULL, 10);
-		g_tree_insert(counties, (gpointer)id, poly);
-
-		/* Insert into states list */
-		GList *list = g_tree_lookup(states, sparts[2]);
-		list = g_list_prepend(list, poly);
-		g_tree_replace(states, g_strdup(sparts[2]), list);
+		fips_insert(counties, states, id, sparts[2], poly);
 
 		g_strfreev(sparts);
 	}
 	g_strfreev(lines);
+}
+
+/* Same counties as fips_parse, from the geometry pack */
+void fips_unpack(AWeatherGeometry *geometry, GTree *counties, GTree *states)
+{
+	g_debug("GritsPluginAlert: fips_unpack");
+	for (gint i = 0; i < aweather_geometry_count(geometry); i++)
+		fips_insert(counties, states, aweather_geometry_id(geometry, i),
+				aweather_geometry_key(geometry, i),
+				aweather_geometry_poly(geometry, i));
+}
+
+/* Loads fips.pack, or parses fips.txt if it can not be used. Returns the name of the one that was read */
+const gchar *fips_load(GTree **_counties, GList **_states)
+{
+	GTree *counties = g_tree_new((GCompareFunc)fips_compare);
+	GTree *states   = g_tree_new_full((GCompareDataFunc)g_strcmp0,
+			NULL, g_free, NULL);
+
+	const gchar *file = PKGDATADIR G_DIR_SEPARATOR_S "fips.txt";
+	const gchar *pack = PKGDATADIR G_DIR_SEPARATOR_S "fips.pack";
+	const gchar *source = "fips.pack";
+	AWeatherGeometry *geometry = aweather_geometry_open(pack, file);
+	if (geometry) {
+		fips_unpack(geometry, counties, states);
+		aweather_geometry_free(geometry);
+	} else {
+		source = "fips.txt";
+		gchar *text; gsize len;
+		if (!g_file_get_contents(file, &text, &len, NULL))
+			g_error("GritsPluginAlert: fips_load - error loading fips polygons");
+		fips_parse(text, counties, states);
+		g_free(text);
+	}
 
 	/* Group state counties */
 	*_counties = counties;
 	*_states   = NULL;
 	g_tree_foreach(states, (GTraverseFunc)fips_group_state, _states);
 	g_tree_destroy(states);
+	return source;
 }
 
 /********************
@@ -524,7 +567,7 @@ static gboolean _show_details(GritsPoly *county, GdkEvent *_, GritsPluginAlert *
 	AlertMsg *msg = g_object_get_data(G_OBJECT(county), "msg");
 
 	// TODO: move this to a thread since it blocks on net access
-	if (!msg_load_cap(alert->http, msg))
+	if (!msg_load_cap(alert, msg))
 		return FALSE;
 
 	GtkWidget *dialog   = alert->details;
@@ -599,7 +642,7 @@ static GritsPoly *_load_storm_based(GritsPluginAlert *alert, AlertMsg *msg)
 	if (!msg->info->ispoly)
 		return NULL;
 
-	if (!msg_load_cap(alert->http, msg))
+	if (!msg_load_cap(alert, msg))
 		return NULL;
 
 	if (!msg->polygon)
@@ -795,19 +838,55 @@ static void _update_warnings(GritsPluginAlert *alert, GList *old)
 	g_debug("GritsPluginAlert: _load_warnings - end");
 }
 
+static gboolean _add_states(GritsPluginAlert *alert)
+{
+	g_debug("GritsPluginAlert: _add_states");
+	for (GList *cur = alert->states; cur; cur = cur->next)
+		grits_viewer_add(alert->viewer, cur->data, GRITS_LEVEL_WORLD+1, FALSE);
+	grits_viewer_queue_draw(alert->viewer);
+	g_mutex_lock(&alert->states_lock);
+	alert->states_source = 0;
+	g_mutex_unlock(&alert->states_lock);
+	return FALSE;
+}
+
+/* Ends the deferred startup phase, once, whether or not the counties were loaded.
+ * name is the file the counties were read from */
+static void _load_done(GritsPluginAlert *alert, const gchar *name, gint64 start)
+{
+	aweather_startup_done(alert->startup, name, start);
+	alert->startup = NULL;
+}
+
+/* Counties are loaded by the first update, the states are added to the viewer on the main loop */
+static void _load_fips(GritsPluginAlert *alert)
+{
+	gint64 start = g_get_monotonic_time();
+	const gchar *source = fips_load(&alert->counties, &alert->states);
+	/* _add_states can run before g_idle_add returns, it must not clear the source before it is set */
+	g_mutex_lock(&alert->states_lock);
+	alert->states_source = g_idle_add((GSourceFunc)_add_states, alert);
+	g_mutex_unlock(&alert->states_lock);
+	_load_done(alert, source, start);
+}
+
 /* Callbacks */
 static void _update(gpointer _, gpointer _alert)
 {
 	GritsPluginAlert *alert = _alert;
-	if (alert->aborted)
+	if (alert->aborted) {
+		_load_done(alert, "fips", g_get_monotonic_time());
 		return;
+	}
+	if (!alert->counties)
+		_load_fips(alert);
 	GList *old = alert->msgs;
 	g_debug("GritsPluginAlert: _update");
 
 	time_t   when    = grits_viewer_get_time(alert->viewer);
 	gboolean offline = grits_viewer_get_offline(alert->viewer);
 	/* Load the new alerts. If we fail to load the alerts, alert->msgs will be NULL. We must continue on so that we don't leak the old alerts (stored in old), however. */
-	alert->msgs = msg_load_index(alert->http, when, &alert->updated, offline);
+	alert->msgs = msg_load_index(alert, when, &alert->updated, offline);
 
 	if (!alert->update_source){
 		/* Determine which buttons to show.
@@ -931,15 +1010,14 @@ GritsPluginAlert *grits_plugin_alert_new(GritsViewer *viewer, GritsPrefs *prefs)
 	alert->details = _make_details(viewer);
 	alert->viewer  = g_object_ref(viewer);
 	alert->prefs   = g_object_ref(prefs);
+	alert->download = aweather_download_ref(viewer, prefs);
+	alert->startup  = aweather_startup_get(viewer);
 
 	alert->refresh_id      = g_signal_connect_swapped(alert->viewer, "refresh",
 			G_CALLBACK(_on_update), alert);
 	alert->time_changed_id = g_signal_connect_swapped(alert->viewer, "time_changed",
 			G_CALLBACK(_on_update), alert);
 
-	for (GList *cur = alert->states; cur; cur = cur->next)
-		grits_viewer_add(viewer, cur->data, GRITS_LEVEL_WORLD+1, FALSE);
-
 	gboolean   chide   = grits_prefs_get_boolean(alert->prefs, "alert/hide_county_based", NULL);
 	gboolean   shide   = grits_prefs_get_boolean(alert->prefs, "alert/hide_storm_based",  NULL);
 	GtkWidget *ctoggle = g_object_get_data(G_OBJECT(alert->config), "county_based");
@@ -947,6 +1025,8 @@ GritsPluginAlert *grits_plugin_alert_new(GritsViewer *viewer, GritsPrefs *prefs)
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ctoggle), !chide);
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(stoggle), !shide);
 
+	/* The first update loads the counties */
+	aweather_startup_defer(alert->startup);
 	_on_update(alert);
 	return alert;
 }
@@ -973,19 +1053,11 @@ static void grits_plugin_alert_init(GritsPluginAlert *alert)
 {
 	g_debug("GritsPluginAlert: init");
 	/* Set defaults */
+	g_mutex_init(&alert->states_lock);
 	alert->threads = g_thread_pool_new(_update, alert, 1, FALSE, NULL);
 	alert->config  = _make_config(alert);
-	alert->http    = grits_http_new(G_DIR_SEPARATOR_S
-			"alerts" G_DIR_SEPARATOR_S
-			"cap"    G_DIR_SEPARATOR_S);
-
-	/* Load counties */
-	gchar *text; gsize len;
-	const gchar *file = PKGDATADIR G_DIR_SEPARATOR_S "fips.txt";
-	if (!g_file_get_contents(file, &text, &len, NULL))
-		g_error("GritsPluginAlert: init - error loading fips polygons");
-	fips_parse(text, &alert->counties, &alert->states);
-	g_free(text);
+	alert->http    = grits_http_new(ALERT_CACHE_PREFIX);
+	alert->cancellable = g_cancellable_new();
 }
 static void grits_plugin_alert_dispose(GObject *gobject)
 {
@@ -998,9 +1070,15 @@ static void grits_plugin_alert_dispose(GObject *gobject)
 		g_signal_handler_disconnect(viewer, alert->refresh_id);
 		g_signal_handler_disconnect(viewer, alert->time_changed_id);
 		grits_http_abort(alert->http);
+		g_cancellable_cancel(alert->cancellable);
 		g_thread_pool_free(alert->threads, TRUE, TRUE);
+		/* The first update may have been dropped from the pool before it ran */
+		_load_done(alert, "fips", g_get_monotonic_time());
+		aweather_download_unref(alert->download);
 		if (alert->update_source)
 			g_source_remove(alert->update_source);
+		if (alert->states_source)
+			g_source_remove(alert->states_source);
 		alert->viewer = NULL;
 		for (GList *cur = alert->msgs; cur; cur = cur->next) {
 			AlertMsg *msg = cur->data;
@@ -1027,9 +1105,13 @@ static void grits_plugin_alert_finalize(GObject *gobject)
 	g_list_foreach(alert->msgs, (GFunc)msg_free, NULL);
 	g_list_free(alert->msgs);
 	g_list_free(alert->states);
-	g_tree_foreach(alert->counties, (GTraverseFunc)_unref_county, NULL);
-	g_tree_destroy(alert->counties);
+	if (alert->counties) {
+		g_tree_foreach(alert->counties, (GTraverseFunc)_unref_county, NULL);
+		g_tree_destroy(alert->counties);
+	}
 	grits_http_free(alert->http);
+	g_object_unref(alert->cancellable);
+	g_mutex_clear(&alert->states_lock);
 	G_OBJECT_CLASS(grits_plugin_alert_parent_class)->finalize(gobject);
 }
 static void grits_plugin_alert_class_init(GritsPluginAlertClass *klass)
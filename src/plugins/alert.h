@@ -21,6 +21,9 @@
 #include <glib-object.h>
 #include <grits.h>
 
+#include "../aweather-download.h"
+#include "../aweather-startup.h"
+
 #define GRITS_TYPE_PLUGIN_ALERT            (grits_plugin_alert_get_type ())
 #define GRITS_PLUGIN_ALERT(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   GRITS_TYPE_PLUGIN_ALERT, GritsPluginAlert))
 #define GRITS_IS_PLUGIN_ALERT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),   GRITS_TYPE_PLUGIN_ALERT))
@@ -41,11 +44,16 @@ struct _GritsPluginAlert {
 	GtkWidget   *details;
 
 	GritsHttp   *http;
+	AWeatherDownload *download; // Shared with the other plugins, alerts are fetched ahead of radar data
+	GCancellable *cancellable;
 	guint        refresh_id;
 	guint        time_changed_id;
 	guint        update_source;
+	guint        states_source; // Adds the states once the counties are loaded
+	GMutex       states_lock;   // Held while states_source is set from the update thread
 	GThreadPool *threads;
 	gboolean     aborted;
+	AWeatherStartup *startup;   // Cleared once the deferred fips.txt phase is done
 
 	GList       *msgs;
 	time_t       updated;
@@ -22,11 +22,35 @@
 #include <string.h>
 
 #include "borders.h"
+#include "../aweather-geometry.h"
 
 
 /********
  * Border Logic - this plugin draws state / country borders loaded from the data/borders.txt file. *
  ********/
+/* Borders look the same however they were loaded */
+static GritsPoly* borders_style(GritsPoly *poly){
+	/* Force the polygon to always display no matter what the user is zoomed to. */
+	GRITS_OBJECT(poly)->lod    = 0;
+
+	/* Make boarders 2px wide */
+	poly->width = 2;
+
+	/* Configure polygon fill */
+	poly->color[0]  = 1; /* fill red (0-1) */
+	poly->color[1]  = 1; /* fill green */
+	poly->color[2]  = 1; /* fill blue */
+	poly->color[3]  = 0; /* fill alpha (0=transparent, 1=opaque) */
+
+	/* Configure polygon outline */
+	poly->border[0] = 1; /* line red */
+	poly->border[1] = 1; /* line green */
+	poly->border[2] = 1; /* line blue */
+	poly->border[3] = 1; /* line alpha ? */
+
+	return poly;
+}
+
 GList* borders_parse(gchar *text){
 	g_debug("GritsPluginBorders: borders_parse");
 	
@@ -44,24 +68,7 @@ GList* borders_parse(gchar *text){
 		}
 
 		/* Create GritsPoly */
-		GritsPoly *poly = grits_poly_parse(sparts[1], "\t", " ", ",");
-		/* Force the polygon to always display no matter what the user is zoomed to. */
-		GRITS_OBJECT(poly)->lod    = 0;
-
-		/* Make boarders 2px wide */
-		poly->width = 2;
-
-		/* Configure polygon fill */
-		poly->color[0]  = 1; /* fill red (0-1) */
-		poly->color[1]  = 1; /* fill green */
-		poly->color[2]  = 1; /* fill blue */
-		poly->color[3]  = 0; /* fill alpha (0=transparent, 1=opaque) */
-
-		/* Configure polygon outline */
-		poly->border[0] = 1; /* line red */
-		poly->border[1] = 1; /* line green */
-		poly->border[2] = 1; /* line blue */
-		poly->border[3] = 1; /* line alpha ? */
+		GritsPoly *poly = borders_style(grits_poly_parse(sparts[1], "\t", " ", ","));
 
 		/* Insert polygon into output list */
 		aBoarders = g_list_prepend(aBoarders, poly);
@@ -73,9 +80,60 @@ GList* borders_parse(gchar *text){
 	return aBoarders;
 }
 
+/* Same borders as borders_parse, from the geometry pack */
+GList* borders_unpack(AWeatherGeometry *geometry){
+	g_debug("GritsPluginBorders: borders_unpack");
+
+	GList* aBoarders = NULL;
+	for (gint i = 0; i < aweather_geometry_count(geometry); i++)
+		aBoarders = g_list_prepend(aBoarders, borders_style(aweather_geometry_poly(geometry, i)));
+	return aBoarders;
+}
+
 /* Callbacks */
+static gboolean _on_loaded(gpointer _borders)
+{
+	GritsPluginBorders *borders = _borders;
+	g_debug("GritsPluginBorders: _on_loaded");
+	for (GList *cur = borders->borders; cur; cur = cur->next)
+		grits_viewer_add(borders->viewer, cur->data, GRITS_LEVEL_WORLD+1, FALSE);
+	grits_viewer_queue_draw(borders->viewer);
+	borders->update_source = 0;
+	return FALSE;
+}
+
+/* Loads the borders in the background, they are added to the viewer on the main loop */
+static void _load(gpointer _, gpointer _borders)
+{
+	GritsPluginBorders *borders = _borders;
+	gint64 start = g_get_monotonic_time();
+	const gchar *source = "borders";
+	if (!borders->aborted && !borders->borders) {
+		/* Use borders.pack unless it is missing or older than borders.txt */
+		const gchar *file = PKGDATADIR G_DIR_SEPARATOR_S "borders.txt";
+		const gchar *pack = PKGDATADIR G_DIR_SEPARATOR_S "borders.pack";
+		AWeatherGeometry *geometry = aweather_geometry_open(pack, file);
+		if (geometry) {
+			source = "borders.pack";
+			borders->borders = borders_unpack(geometry);
+			aweather_geometry_free(geometry);
+		} else {
+			source = "borders.txt";
+			gchar *text; gsize len;
+			if (!g_file_get_contents(file, &text, &len, NULL))
+				g_error("GritsPluginBorders: _load - error loading borders.txt polygons");
+			borders->borders = borders_parse(text);
+			g_free(text);
+		}
+		if (!borders->aborted)
+			borders->update_source = g_idle_add(_on_loaded, borders);
+	}
+	aweather_startup_done(borders->startup, source, start);
+}
+
 static void _on_update(GritsPluginBorders *border)
 {
+	aweather_startup_defer(border->startup);
 	g_thread_pool_push(border->threads, NULL+1, NULL);
 }
 
@@ -87,10 +145,7 @@ GritsPluginBorders *grits_plugin_borders_new(GritsViewer *viewer, GritsPrefs *pr
 	GritsPluginBorders *borders = g_object_new(GRITS_TYPE_PLUGIN_BORDERS, NULL);
 	borders->viewer  = g_object_ref(viewer);
 	borders->prefs   = g_object_ref(prefs);
-
-	for (GList *cur = borders->borders; cur; cur = cur->next)
-		grits_viewer_add(viewer, cur->data, GRITS_LEVEL_WORLD+1, FALSE);
-
+	borders->startup = aweather_startup_get(viewer);
 
 	_on_update(borders);
 	return borders;
@@ -117,14 +172,8 @@ static void grits_plugin_borders_plugin_init(GritsPluginInterface *iface)
 static void grits_plugin_borders_init(GritsPluginBorders *borders)
 {
 	g_debug("GritsPluginBorders: init");
-
-	/* Load borders */
-	gchar *text; gsize len;
-	const gchar *file = PKGDATADIR G_DIR_SEPARATOR_S "borders.txt";
-	if (!g_file_get_contents(file, &text, &len, NULL))
-		g_error("GritsPluginBorders: init - error loading borders.txt polygons");
-	borders->borders = borders_parse(text);
-	g_free(text);
+	/* Borders are loaded in the background once the plugin is made */
+	borders->threads = g_thread_pool_new(_load, borders, 1, FALSE, NULL);
 }
 static void grits_plugin_borders_dispose(GObject *gobject)
 {
@@ -134,6 +183,7 @@ static void grits_plugin_borders_dispose(GObject *gobject)
 	/* Drop references */
 	if (borders->viewer) {
 		GritsViewer *viewer = borders->viewer;
+		g_thread_pool_free(borders->threads, FALSE, TRUE);
 		if (borders->update_source)
 			g_source_remove(borders->update_source);
 		borders->viewer = NULL;
@@ -21,6 +21,8 @@
 #include <glib-object.h>
 #include <grits.h>
 
+#include "../aweather-startup.h"
+
 #define GRITS_TYPE_PLUGIN_BORDERS            (grits_plugin_borders_get_type ())
 #define GRITS_PLUGIN_BORDERS(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   GRITS_TYPE_PLUGIN_BORDERS, GritsPluginBorders))
 #define GRITS_IS_PLUGIN_BORDERS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),   GRITS_TYPE_PLUGIN_BORDERS))
@@ -43,8 +45,9 @@ struct _GritsPluginBorders {
 	guint        refresh_id;
 	guint        time_changed_id;
 	guint        update_source;
-	GThreadPool *threads;
+	GThreadPool *threads;      // Loads borders.txt
 	gboolean     aborted;
+	AWeatherStartup *startup;
 
 	time_t       updated;
 	GList       *borders;
@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <math.h>
+#include <bzlib.h>
+#include <glib.h>
+#include <rsl.h>
+
+#include "level2-decoder.h"
+
+#define VOLUME_HEADER   24             // "AR2V0006.nnn", date, time, ICAO
+#define CTM_SIZE        12             // Legacy channel terminal manager header in front of every message
+#define MESSAGE_HEADER  16
+#define RECORD_SIZE     2432           // Size of every message except message 31
+#define MAX_RECORD      (50*1024*1024) // Same sanity check as wsr88ddec
+#define MAX_CUTS        32
+
+/* Moments in message 31 and the RSL volumes they are decoded into */
+static const struct {
+	const gchar *name;
+	gint         index;
+	const gchar *type;
+	float      (*f)(Range);
+	Range      (*invf)(float);
+} moments[] = {
+	{ "REF", DZ_INDEX, "DZ", DZ_F, DZ_INVF },
+	{ "VEL", VR_INDEX, "VR", VR_F, VR_INVF },
+	{ "SW ", SW_INDEX, "SW", SW_F, SW_INVF },
+	{ "ZDR", DR_INDEX, "DR", DR_F, DR_INVF },
+	{ "PHI", PH_INDEX, "PH", PH_F, PH_INVF },
+	{ "RHO", RH_INDEX, "RH", RH_F, RH_INVF },
+};
+
+struct _Level2Decoder {
+	Radar      *radar;
+	gchar      *site;
+	gboolean    merge;
+
+	/* Input that does not make up a whole record yet */
+	GByteArray *input;
+	gboolean    header;     // Volume header has been skipped
+	gboolean    failed;
+	gboolean    complete;
+
+	/* Site and scan strategy */
+	gboolean    started;    // Radar header has been filled in
+	gfloat      lat, lon, height;
+	gfloat      cut_elev[MAX_CUTS];  // Target elevation of each cut from message 5, 0 if unknown
+	gint        ref_cut;    // Last cut with reflectivity but no velocity, the first half of a split cut
+	gfloat      ref_elev;
+	gint        last_cut;   // Elevation number of the last radial
+
+	/* Decoded so far, only touched by level2_decoder_feed */
+	Volume     *volumes[MAX_RADAR_VOLUMES];
+	gint        cut[MAX_RADAR_VOLUMES];     // Elevation number of the last sweep in each volume
+	gint        nsweeps[MAX_RADAR_VOLUMES];
+	gint        nrays[MAX_RADAR_VOLUMES][LEVEL2_DECODER_MAX_SWEEPS];
+
+	/* Copy of the counts above for level2_decoder_sync, taken after each record */
+	GMutex      mutex;
+	gint        shared_sweeps[MAX_RADAR_VOLUMES];
+	gint        shared_rays[MAX_RADAR_VOLUMES][LEVEL2_DECODER_MAX_SWEEPS];
+	gboolean    shared_complete;
+	gboolean    published_complete;
+};
+
+static guint _get16(const guint8 *p)
+{
+	return p[0] << 8 | p[1];
+}
+
+static guint32 _get32(const guint8 *p)
+{
+	return (guint32)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static gfloat _getf(const guint8 *p)
+{
+	union { guint32 i; gfloat f; } u = { _get32(p) };
+	return u.f;
+}
+
+/* Decompresses one record, every record is a separate bzip2 stream */
+static guint8 *_bunzip2(const guint8 *input, gsize len, gsize *out_len)
+{
+	bz_stream stream = {};
+	if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK)
+		return NULL;
+	stream.next_in  = (char*)input;
+	stream.avail_in = len;
+
+	gint    status = BZ_OK;
+	gsize   size   = 0;
+	guint8 *output = NULL;
+	while (status == BZ_OK && size < MAX_RECORD) {
+		size   = size ? size*2 : MAX(len*8, 64*1024);
+		output = g_realloc(output, size);
+		stream.next_out  = (char*)output + stream.total_out_lo32;
+		stream.avail_out = size - stream.total_out_lo32;
+		status = BZ2_bzDecompress(&stream);
+		/* Out of input before the end of the stream */
+		if (status == BZ_OK && stream.avail_out > 0)
+			break;
+	}
+	*out_len = stream.total_out_lo32;
+	BZ2_bzDecompressEnd(&stream);
+	if (status != BZ_STREAM_END) {
+		g_free(output);
+		return NULL;
+	}
+	return output;
+}
+
+/* Message 5, the volume coverage pattern */
+static void _decode_vcp(Level2Decoder *dec, const guint8 *body, gsize len)
+{
+	if (len < 22)
+		return;
+	gint ncuts = MIN(_get16(body+6), MAX_CUTS);
+	for (gint i = 0; i < ncuts && 22 + (i+1)*46 <= len; i++) {
+		/* Coded in units of 180/2^15 degrees, round to what the VCP tables list */
+		gfloat elev = _get16(body + 22 + i*46) * 180.0 / 32768;
+		dec->cut_elev[i] = roundf(elev * 100) / 100;
+	}
+	dec->radar->h.vcp = _get16(body+4);
+}
+
+/* Fills in the radar header from the first radial */
+static void _start_radar(Level2Decoder *dec, GDateTime *date, const guint8 *vol)
+{
+	Radar_header *h = &dec->radar->h;
+	h->year   = g_date_time_get_year(date);
+	h->month  = g_date_time_get_month(date);
+	h->day    = g_date_time_get_day_of_month(date);
+	h->hour   = g_date_time_get_hour(date);
+	h->minute = g_date_time_get_minute(date);
+	h->sec    = g_date_time_get_seconds(date);
+	if (vol) {
+		dec->lat    = _getf(vol+8);
+		dec->lon    = _getf(vol+12);
+		dec->height = (gint16)_get16(vol+16) + _get16(vol+18);
+		h->vcp      = _get16(vol+40);
+	}
+	h->latd = dec->lat; h->latm = (dec->lat - h->latd) * 60; h->lats = ((dec->lat - h->latd) * 60 - h->latm) * 60;
+	h->lond = dec->lon; h->lonm = (dec->lon - h->lond) * 60; h->lons = ((dec->lon - h->lond) * 60 - h->lonm) * 60;
+	h->height = dec->height;
+	g_strlcpy(h->radar_type, "wsr88d",  sizeof(h->radar_type));
+	g_strlcpy(h->name,       dec->site, sizeof(h->name));
+	g_strlcpy(h->radar_name, dec->site, sizeof(h->radar_name));
+	dec->started = TRUE;
+}
+
+/* Returns the sweep of volume vi for the given cut, starting a new one when the cut changes */
+static Sweep *_get_sweep(Level2Decoder *dec, gint m, gint cut, gfloat elev, gfloat spacing)
+{
+	gint    vi  = moments[m].index;
+	Volume *vol = dec->volumes[vi];
+	if (!vol) {
+		vol = RSL_new_volume(LEVEL2_DECODER_MAX_SWEEPS);
+		vol->h.nsweeps  = 0;
+		vol->h.type_str = strdup(moments[m].type);
+		vol->h.f        = moments[m].f;
+		vol->h.invf     = moments[m].invf;
+		dec->volumes[vi] = vol;
+	}
+	if (dec->nsweeps[vi] > 0 && dec->cut[vi] == cut)
+		return vol->sweep[dec->nsweeps[vi]-1];
+	if (dec->nsweeps[vi] == LEVEL2_DECODER_MAX_SWEEPS)
+		return NULL;
+
+	Sweep *sweep = RSL_new_sweep(LEVEL2_DECODER_MAX_RAYS);
+	sweep->h.nrays        = 0;
+	sweep->h.sweep_num    = dec->nsweeps[vi] + 1;
+	sweep->h.elev         = elev;
+	sweep->h.beam_width   = spacing;
+	sweep->h.horz_half_bw = spacing / 2;
+	sweep->h.vert_half_bw = spacing / 2;
+	sweep->h.f            = moments[m].f;
+	sweep->h.invf         = moments[m].invf;
+	vol->sweep[dec->nsweeps[vi]++] = sweep;
+	dec->cut[vi] = cut;
+	return sweep;
+}
+
+/* Message 31, one radial with all of its moments */
+static void _decode_radial(Level2Decoder *dec, const guint8 *body, gsize len)
+{
+	if (len < 32)
+		return;
+	guint32 ms      = _get32(body+4);
+	gint    date    = _get16(body+8);
+	gfloat  azimuth = _getf(body+12);
+	gfloat  spacing = body[20] == 1 ? 0.5 : 1.0;
+	gint    status  = body[21];
+	gint    cut     = body[22];
+	gfloat  elev    = _getf(body+24);
+	gint    nblocks = MIN(_get16(body+30), 10);
+	if (32 + nblocks*4 > len)
+		return;
+
+	/* Radial constants and which moments there are */
+	const guint8 *vol = NULL, *rad = NULL, *data[G_N_ELEMENTS(moments)] = {};
+	for (gint i = 0; i < nblocks; i++) {
+		guint32 off = _get32(body + 32 + i*4);
+		if (off == 0 || off + 28 > len)
+			continue;
+		const guint8 *blk = body + off;
+		if      (blk[0] == 'R' && !memcmp(blk+1, "VOL", 3) && off + 44 <= len) vol = blk;
+		else if (blk[0] == 'R' && !memcmp(blk+1, "RAD", 3)) rad = blk;
+		else if (blk[0] == 'D')
+			for (gint m = 0; m < G_N_ELEMENTS(moments); m++)
+				if (!memcmp(blk+1, moments[m].name, 3))
+					data[m] = blk;
+	}
+
+	GDateTime *time = g_date_time_new_from_unix_utc(
+			(gint64)(date-1)*24*60*60 + ms/1000);
+	if (!time)
+		return;
+	if (!dec->started)
+		_start_radar(dec, time, vol);
+	dec->last_cut = cut;
+
+	/* Target elevation of the cut, measured angles wander a bit */
+	gfloat fixed = roundf(elev * 10) / 10;
+	if (cut > 0 && cut <= MAX_CUTS && dec->cut_elev[cut-1] > 0)
+		fixed = dec->cut_elev[cut-1];
+
+	/* The Doppler half of a split cut has reflectivity too, merging keeps only the surveillance one */
+	if (data[0] && !data[1]) {
+		dec->ref_cut  = cut;
+		dec->ref_elev = fixed;
+	}
+	if (dec->merge && data[0] && data[1] && cut == dec->ref_cut + 1 &&
+	    fabs(fixed - dec->ref_elev) < 0.05)
+		data[0] = NULL;
+
+	for (gint m = 0; m < G_N_ELEMENTS(moments); m++) {
+		const guint8 *blk = data[m];
+		if (!blk)
+			continue;
+		gint   ngates = _get16(blk+8);
+		gint   first  = (gint16)_get16(blk+10);
+		gint   gate   = (gint16)_get16(blk+12);
+		gint   words  = blk[19];
+		gfloat scale  = _getf(blk+20);
+		gfloat offset = _getf(blk+24);
+		if (ngates <= 0 || scale == 0 || (words != 8 && words != 16) ||
+		    (blk - body) + 28 + ngates*(words/8) > len)
+			continue;
+
+		gint   vi    = moments[m].index;
+		Sweep *sweep = _get_sweep(dec, m, cut, fixed, spacing);
+		if (!sweep || dec->nrays[vi][dec->nsweeps[vi]-1] == LEVEL2_DECODER_MAX_RAYS)
+			continue;
+
+		Ray *ray = RSL_new_ray(ngates);
+		ray->h.year       = g_date_time_get_year(time);
+		ray->h.month      = g_date_time_get_month(time);
+		ray->h.day        = g_date_time_get_day_of_month(time);
+		ray->h.hour       = g_date_time_get_hour(time);
+		ray->h.minute     = g_date_time_get_minute(time);
+		ray->h.sec        = (ms % 60000) / 1000.0;
+		ray->h.azimuth    = azimuth;
+		ray->h.ray_num    = dec->nrays[vi][dec->nsweeps[vi]-1] + 1;
+		ray->h.elev       = elev;
+		ray->h.elev_num   = cut;
+		ray->h.fix_angle  = fixed;
+		ray->h.range_bin1 = first;
+		ray->h.gate_size  = gate;
+		ray->h.beam_width = spacing;
+		ray->h.lat        = dec->lat;
+		ray->h.lon        = dec->lon;
+		ray->h.alt        = dec->height;
+		ray->h.f          = moments[m].f;
+		ray->h.invf       = moments[m].invf;
+		if (rad) {
+			ray->h.unam_rng = (gint16)_get16(rad+6) / 10.0;
+			ray->h.nyq_vel  = (gint16)_get16(rad+16) / 100.0;
+		}
+		if (vi == VR_INDEX)
+			ray->h.vel_res = 1 / scale;
+
+		/* 0 is below threshold, 1 is range folded */
+		const guint8 *raw = blk + 28;
+		for (gint bi = 0; bi < ngates; bi++) {
+			guint level = words == 8 ? raw[bi] : _get16(raw + bi*2);
+			float value = level == 0 ? BADVAL :
+			              level == 1 ? RFVAL  : (level - offset) / scale;
+			ray->range[bi] = moments[m].invf(value);
+		}
+
+		sweep->ray[dec->nrays[vi][dec->nsweeps[vi]-1]++] = ray;
+	}
+	g_date_time_unref(time);
+
+	if (status == 4)
+		dec->complete = TRUE;
+}
+
+/* Decodes the messages of one decompressed record */
+static gboolean _decode_record(Level2Decoder *dec, const guint8 *record, gsize len)
+{
+	for (gsize pos = 0; pos + CTM_SIZE + MESSAGE_HEADER <= len;) {
+		const guint8 *msg = record + pos + CTM_SIZE;
+		gsize size = _get16(msg) * 2;
+		gint  type = msg[3];
+		if (type == 31) {
+			if (size < MESSAGE_HEADER || pos + CTM_SIZE + size > len)
+				break;
+			_decode_radial(dec, msg + MESSAGE_HEADER, size - MESSAGE_HEADER);
+			pos += CTM_SIZE + size;
+			continue;
+		}
+		/* Volumes from before message 31 are left to RSL */
+		if (type == 1) {
+			g_debug("Level2Decoder: decode_record - legacy message 1 data");
+			return FALSE;
+		}
+		if (type == 5 && size > MESSAGE_HEADER &&
+		    pos + CTM_SIZE + size <= len)
+			_decode_vcp(dec, msg + MESSAGE_HEADER, size - MESSAGE_HEADER);
+		pos += RECORD_SIZE;
+	}
+	return TRUE;
+}
+
+/* Makes the counts of everything decoded so far available to level2_decoder_sync */
+static void _publish(Level2Decoder *dec)
+{
+	g_mutex_lock(&dec->mutex);
+	memcpy(dec->shared_sweeps, dec->nsweeps, sizeof(dec->nsweeps));
+	memcpy(dec->shared_rays,   dec->nrays,   sizeof(dec->nrays));
+	dec->shared_complete = dec->complete;
+	g_mutex_unlock(&dec->mutex);
+}
+
+Level2Decoder *level2_decoder_new(Radar *radar, const gchar *site,
+		gboolean merge_split_cuts)
+{
+	Level2Decoder *dec = g_new0(Level2Decoder, 1);
+	dec->radar = radar;
+	dec->site  = g_strdup(site);
+	dec->merge = merge_split_cuts;
+	dec->input = g_byte_array_new();
+	g_mutex_init(&dec->mutex);
+	return dec;
+}
+
+gboolean level2_decoder_feed(Level2Decoder *dec, const guint8 *data, gsize len)
+{
+	if (dec->failed || dec->complete)
+		return !dec->failed;
+	g_byte_array_append(dec->input, data, len);
+
+	guint8 *buf   = dec->input->data;
+	gsize   avail = dec->input->len;
+	gsize   pos   = 0;
+
+	if (!dec->header) {
+		if (avail < VOLUME_HEADER)
+			return TRUE;
+		if (memcmp(buf, "AR2V", 4) && memcmp(buf, "ARCH", 4)) {
+			g_warning("Level2Decoder: feed - not an Archive II volume");
+			dec->failed = TRUE;
+			return FALSE;
+		}
+		dec->header = TRUE;
+		pos = VOLUME_HEADER;
+	}
+
+	/* Records are a size followed by that many bytes, the size of the last one is negative */
+	while (!dec->failed && !dec->complete && avail - pos >= 4) {
+		gint32 size = _get32(buf+pos);
+		gboolean last = size < 0;
+		size = ABS(size);
+		if (size <= 0 || size > MAX_RECORD) {
+			g_warning("Level2Decoder: feed - bad record size %d", size);
+			dec->failed = TRUE;
+			break;
+		}
+		if (avail - pos - 4 < (gsize)size)
+			break;
+
+		gsize   len;
+		guint8 *record = _bunzip2(buf+pos+4, size, &len);
+		if (!record) {
+			g_warning("Level2Decoder: feed - bad compressed record");
+			dec->failed = TRUE;
+			break;
+		}
+		dec->failed = !_decode_record(dec, record, len);
+		g_free(record);
+		pos += 4 + size;
+		if (last)
+			dec->complete = TRUE;
+
+		/* Let the other thread see each record as it is done */
+		_publish(dec);
+	}
+
+	g_byte_array_remove_range(dec->input, 0, pos);
+	if (dec->complete)
+		g_byte_array_set_size(dec->input, 0);
+	return !dec->failed;
+}
+
+gboolean level2_decoder_is_complete(Level2Decoder *dec)
+{
+	return dec->complete;
+}
+
+gint level2_decoder_get_cut(Level2Decoder *dec)
+{
+	return dec->last_cut;
+}
+
+Volume *level2_decoder_get_volume(Level2Decoder *dec, gint vi, gint *nsweeps, const gint **nrays)
+{
+	*nsweeps = dec->nsweeps[vi];
+	*nrays   = dec->nrays[vi];
+	return dec->volumes[vi];
+}
+
+Level2DecoderChanges level2_decoder_sync(Level2Decoder *dec)
+{
+	Level2DecoderChanges changes = 0;
+	g_mutex_lock(&dec->mutex);
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		if (dec->shared_sweeps[vi] == 0)
+			continue;
+		Volume *vol = dec->volumes[vi];
+		if (dec->radar->v[vi] != vol || vol->h.nsweeps != dec->shared_sweeps[vi])
+			changes |= LEVEL2_DECODER_SWEEPS;
+		dec->radar->v[vi] = vol;
+		vol->h.nsweeps    = dec->shared_sweeps[vi];
+		for (gint si = 0; si < vol->h.nsweeps; si++) {
+			if (vol->sweep[si]->h.nrays != dec->shared_rays[vi][si])
+				changes |= LEVEL2_DECODER_RAYS;
+			vol->sweep[si]->h.nrays = dec->shared_rays[vi][si];
+		}
+	}
+	if (dec->shared_complete && !dec->published_complete)
+		changes |= LEVEL2_DECODER_COMPLETE;
+	dec->published_complete = dec->shared_complete;
+	g_mutex_unlock(&dec->mutex);
+	return changes;
+}
+
+void level2_decoder_free(Level2Decoder *dec)
+{
+	/* Everything decoded belongs to the radar from now on */
+	_publish(dec);
+	level2_decoder_sync(dec);
+	g_mutex_clear(&dec->mutex);
+	g_byte_array_free(dec->input, TRUE);
+	g_free(dec->site);
+	g_free(dec);
+}
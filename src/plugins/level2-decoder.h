@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LEVEL2_DECODER_H__
+#define __LEVEL2_DECODER_H__
+
+#include <glib.h>
+#include <rsl.h>
+
+/* Sweeps are allocated this many rays up front so they never move while they are filled in */
+#define LEVEL2_DECODER_MAX_RAYS   760
+#define LEVEL2_DECODER_MAX_SWEEPS 32
+
+/* Incremental Archive II (Message 31) decoder.
+ * Data is fed in as it arrives, eg. one real-time chunk at a time, and each radial is added to the radar
+ * as soon as its record is decompressed. Rays are written past the end of the published sweeps, so the
+ * part of the radar made visible by level2_decoder_sync can be read by one other thread while decoding. */
+typedef struct _Level2Decoder Level2Decoder;
+
+typedef enum {
+	LEVEL2_DECODER_RAYS     = 1 << 0, // Rays were added to sweeps
+	LEVEL2_DECODER_SWEEPS   = 1 << 1, // Sweeps or volumes were added
+	LEVEL2_DECODER_COMPLETE = 1 << 2, // The end of the volume scan has been decoded
+} Level2DecoderChanges;
+
+/* Decodes into radar, which must be empty (RSL_new_radar(MAX_RADAR_VOLUMES)).
+ * Unless merging split cuts, the reflectivity of the Doppler half of split cuts is kept as a separate sweep. */
+Level2Decoder *level2_decoder_new(Radar *radar, const gchar *site,
+		gboolean merge_split_cuts);
+
+/* Feeds the next part of the volume: the volume header followed by bzip2 compressed records,
+ * split anywhere. Returns FALSE once the data turns out not to be decodable. */
+gboolean level2_decoder_feed(Level2Decoder *decoder, const guint8 *data, gsize len);
+
+/* Returns TRUE once the end of the volume has been fed */
+gboolean level2_decoder_is_complete(Level2Decoder *decoder);
+
+/* Returns the elevation number (starting at 1) of the last radial fed, 0 before the first one.
+ * Cuts are scanned bottom up, so the ones below it are done. Only for the thread feeding the decoder. */
+gint level2_decoder_get_cut(Level2Decoder *decoder);
+
+/* Returns volume vi as decoded so far, NULL if it has not started, with its sweep count and the ray count of each
+ * sweep. These are ahead of the radar's own counts until the next level2_decoder_sync.
+ * Only for the thread feeding the decoder. */
+Volume *level2_decoder_get_volume(Level2Decoder *decoder, gint vi, gint *nsweeps, const gint **nrays);
+
+/* Publishes everything decoded so far, the radar's volumes, sweep counts and ray counts are updated.
+ * Returns what changed since the last call. */
+Level2DecoderChanges level2_decoder_sync(Level2Decoder *decoder);
+
+/* Publishes everything and frees the decoder, the radar is left alone */
+void level2_decoder_free(Level2Decoder *decoder);
+
+#endif
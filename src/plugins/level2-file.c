@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+#include <grits.h>
+#include <rsl.h>
+
+#include "level2-file.h"
+
+/* Decompress a radar file using wsr88dec */
+static gboolean _decompress_radar(const gchar *file, const gchar *raw)
+{
+	g_debug("Level2File: _decompress_radar - \n\t%s\n\t%s", file, raw);
+	char *argv[] = {"wsr88ddec", (gchar*)file, (gchar*)raw, NULL};
+	gint status;
+	GError *error = NULL;
+	g_spawn_sync(
+		NULL,    // const gchar *working_directory
+		argv,    // gchar **argv
+		NULL,    // gchar **envp
+		G_SPAWN_SEARCH_PATH, // GSpawnFlags flags
+		NULL,    // GSpawnChildSetupFunc child_setup
+		NULL,    // gpointer user_data
+		NULL,    // gchar *standard_output
+		NULL,    // gchar *standard_output
+		&status, // gint *exit_status
+		&error); // GError **error
+	if (error) {
+		g_warning("Level2File: _decompress_radar - %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+	if (status != 0) {
+		gchar *msg = g_strdup_printf("wsr88ddec exited with status %d", status);
+		g_warning("Level2File: _decompress_radar - %s", msg);
+		g_free(msg);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* TRUE if path exists and was modified after file */
+static gboolean _is_newer(const gchar *path, const gchar *file)
+{
+	struct stat files, paths;
+	return g_stat(path, &paths) == 0 && g_stat(file, &files) == 0 &&
+		paths.st_mtime >= files.st_mtime;
+}
+
+void level2_file_readahead(const gchar *file, GritsPrefs *prefs)
+{
+#ifdef POSIX_FADV_WILLNEED
+	/* Same order the loaders try them in, a fresh spill file is read instead of the volume */
+	gchar *spill = level2_file_spill_path(file, prefs);
+	gchar *raw   = g_strconcat(file, ".raw", NULL);
+	const gchar *path = _is_newer(spill, file) ? spill :
+	                    _is_newer(raw,   file) ? raw   : file;
+	gint   fd    = g_open(path, O_RDONLY, 0);
+	if (fd >= 0) {
+		g_debug("Level2File: readahead - %s", path);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+	g_free(raw);
+	g_free(spill);
+#endif
+}
+
+gboolean level2_file_raw_is_fresh(const gchar *file)
+{
+	gchar *raw = g_strconcat(file, ".raw", NULL);
+	gboolean fresh = _is_newer(raw, file);
+	g_free(raw);
+	return fresh;
+}
+
+Radar *level2_file_read(const gchar *file, const gchar *site, GritsPrefs *prefs,
+		GCancellable *cancellable)
+{
+	g_debug("Level2File: read %s %s", site, file);
+
+	/* Decompress radar */
+	gchar *raw = g_strconcat(file, ".raw", NULL);
+	if (!_is_newer(raw, file) && !_decompress_radar(file, raw)) {
+		g_free(raw);
+		return NULL;
+	}
+
+	/* Decompressing takes a while, don't bother reading a radar nobody wants anymore */
+	if (g_cancellable_is_cancelled(cancellable)) {
+		g_debug("Level2File: read - cancelled");
+		g_free(raw);
+		return NULL;
+	}
+
+	/* Load the radar file. RSL keeps its options in globals, so the options and the decode
+	 * they apply to are done under one lock, another thread may want other options */
+	static GMutex rsl_lock;
+	g_mutex_lock(&rsl_lock);
+	RSL_read_these_sweeps("all", NULL);
+	g_debug("Level2File: rsl read start");
+
+	/* If the user wants to show the reflectivity data from the velocity sweeps, then disable the "merge split cuts" option in RSL so those
+	 * sweeps are not removed.
+	 * Enabling this option (setting it to true) will cause extra reflectivity sweeps to show up,
+	 * which can be useful when looking for closer to real-time data.
+	 */
+	if(grits_prefs_get_boolean(prefs, "aweather/RSL_wsr88d_merge_split_cuts_off", NULL)){
+		RSL_wsr88d_merge_split_cuts_off();
+	} else {
+		RSL_wsr88d_merge_split_cuts_on();
+	}
+
+	Radar *radar = RSL_wsr88d_to_radar(raw, (gchar*)site);
+	g_mutex_unlock(&rsl_lock);
+	g_debug("Level2File: rsl read done");
+	g_free(raw);
+	if (radar && g_cancellable_is_cancelled(cancellable)) {
+		g_debug("Level2File: read - cancelled");
+		RSL_free_radar(radar);
+		return NULL;
+	}
+	return radar;
+}
+
+/* Radars loaded with and without merged split cuts differ, so they get separate files */
+gchar *level2_file_spill_path(const gchar *file, GritsPrefs *prefs)
+{
+	if(grits_prefs_get_boolean(prefs, "aweather/RSL_wsr88d_merge_split_cuts_off", NULL))
+		return g_strconcat(file, ".split.rsl.gz", NULL);
+	return g_strconcat(file, ".rsl.gz", NULL);
+}
+
+gboolean level2_file_spill_is_fresh(const gchar *file, GritsPrefs *prefs)
+{
+	gchar *spill = level2_file_spill_path(file, prefs);
+	gboolean fresh = _is_newer(spill, file);
+	g_free(spill);
+	return fresh;
+}
+
+gboolean level2_file_write_spill(Radar *radar, const gchar *file, GritsPrefs *prefs)
+{
+	/* Only rewrite the spill file if the level2 file it was made from changed */
+	if (level2_file_spill_is_fresh(file, prefs))
+		return TRUE;
+	gchar *spill = level2_file_spill_path(file, prefs);
+	g_debug("Level2File: write_spill - %s", spill);
+	gboolean ok = RSL_write_radar_gzip(radar, spill) > 0;
+	if (!ok) {
+		g_warning("Level2File: write_spill - failed to write %s", spill);
+		g_remove(spill);
+	}
+	g_free(spill);
+	return ok;
+}
+
+Radar *level2_file_read_spill(const gchar *file, GritsPrefs *prefs)
+{
+	gchar *spill = level2_file_spill_path(file, prefs);
+	g_debug("Level2File: read_spill %s", spill);
+	Radar *radar = NULL;
+	if (g_file_test(spill, G_FILE_TEST_EXISTS))
+		radar = RSL_read_radar(spill);
+	g_free(spill);
+	return radar;
+}
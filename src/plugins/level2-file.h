@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LEVEL2_FILE_H__
+#define __LEVEL2_FILE_H__
+
+#include <gio/gio.h>
+#include <grits.h>
+#include <rsl.h>
+
+/* Decoding of Level II files with RSL, without any drawing, so it can also be used without a viewer.
+ * A volume foo.bz2 is decompressed to foo.bz2.raw, and its decoded radar can be written to a spill file
+ * (foo.bz2.rsl.gz, or foo.bz2.split.rsl.gz when aweather/RSL_wsr88d_merge_split_cuts_off is set).
+ * RSL keeps its options in globals, level2_file_read sets them and decodes under a lock of its own. */
+
+/* Returns TRUE if the .raw of file is newer than file */
+gboolean level2_file_raw_is_fresh(const gchar *file);
+
+/* Decompresses file unless its .raw is up to date, then decodes it. Returns NULL on failure or if
+ * cancellable is cancelled. Free with RSL_free_radar. */
+Radar *level2_file_read(const gchar *file, const gchar *site, GritsPrefs *prefs,
+		GCancellable *cancellable);
+
+/* Asks the kernel to start reading what the next load of file reads, its spill file or .raw if one is up to date
+ * and otherwise file itself, into the page cache in the background. Used to load the next few files of a
+ * sequence while the current one decodes. Does nothing where posix_fadvise is missing. */
+void level2_file_readahead(const gchar *file, GritsPrefs *prefs);
+
+/* Returns the path of the spill file for file, free with g_free */
+gchar *level2_file_spill_path(const gchar *file, GritsPrefs *prefs);
+
+/* Returns TRUE if the spill file of file is newer than file */
+gboolean level2_file_spill_is_fresh(const gchar *file, GritsPrefs *prefs);
+
+/* Writes radar to the spill file of file unless it is up to date. Returns FALSE on failure. */
+gboolean level2_file_write_spill(Radar *radar, const gchar *file, GritsPrefs *prefs);
+
+/* Reads the spill file of file, NULL if there is none */
+Radar *level2_file_read_spill(const gchar *file, GritsPrefs *prefs);
+
+#endif
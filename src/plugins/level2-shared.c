@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+#include "level2-shared.h"
+
+#define SHARED_MAGIC   "AWL2SHM"
+#define SHARED_VERSION 1
+#define SHARED_SUFFIX  ".l2m"
+#define SHARED_POLL    (100*1000)           // Microseconds between tries for a lock held by another process
+#define SHARED_WAIT    (60*G_USEC_PER_SEC)  // Longest wait for another process, in case it hangs
+#define SHARED_ALIGN(n) (((n) + 7) & ~(guint64)7)
+
+/* Volumes that are published and the functions to put back into their headers,
+ * function pointers are only good in the process that wrote them */
+static const struct {
+	gint         index;
+	const gchar *type;
+	float      (*f)(Range);
+	Range      (*invf)(float);
+} shared_volumes[] = {
+	{ DZ_INDEX, "DZ", DZ_F, DZ_INVF },
+	{ VR_INDEX, "VR", VR_F, VR_INVF },
+	{ SW_INDEX, "SW", SW_F, SW_INVF },
+	{ DR_INDEX, "DR", DR_F, DR_INVF },
+	{ PH_INDEX, "PH", PH_F, PH_INVF },
+	{ RH_INDEX, "RH", RH_F, RH_INVF },
+};
+
+/* File layout, in the byte order of the machine: the radar record, then each volume record followed by
+ * its sweep records each followed by its ray records, then the range data of each ray, 8 byte aligned */
+typedef struct {
+	gchar        magic[8];
+	guint32      version;
+	guint32      sizes[5];  // Of the RSL headers and Range, files from builds that disagree are ignored
+	guint64      size;      // Of the whole file, a shorter one was cut off
+	guint32      nvolumes;
+	guint32      pad;
+	Radar_header h;
+} SharedRadar;
+
+typedef struct {
+	gint32        index;
+	gint32        nsweeps;
+	Volume_header h;
+} SharedVolume;
+
+typedef struct {
+	gint32       nrays;
+	gint32       pad;
+	Sweep_header h;
+} SharedSweep;
+
+typedef struct {
+	guint64    range;  // Offset of h.nbins Ranges
+	Ray_header h;
+} SharedRay;
+
+static void _shared_sizes(guint32 *sizes)
+{
+	sizes[0] = sizeof(Radar_header);
+	sizes[1] = sizeof(Volume_header);
+	sizes[2] = sizeof(Sweep_header);
+	sizes[3] = sizeof(Ray_header);
+	sizes[4] = sizeof(Range);
+}
+
+static gint _shared_type(gint index)
+{
+	for (gint i = 0; i < G_N_ELEMENTS(shared_volumes); i++)
+		if (shared_volumes[i].index == index)
+			return i;
+	return -1;
+}
+
+static gboolean _shared_enabled(GritsPrefs *prefs)
+{
+#ifdef G_OS_UNIX
+	return grits_prefs_get_integer(prefs, "aweather/shared_mb", NULL) > 0;
+#else
+	return FALSE;
+#endif
+}
+
+static gchar *_shared_dir(GritsPrefs *prefs)
+{
+	gchar *dir = grits_prefs_get_string(prefs, "aweather/shared_dir", NULL);
+	if (dir && *dir)
+		return dir;
+	g_free(dir);
+	return g_build_filename(g_get_user_runtime_dir(), PACKAGE, "shared", NULL);
+}
+
+/* Volume names include the site and scan time, so they are the same in every process's cache */
+static gchar *_shared_path(const gchar *file, GritsPrefs *prefs)
+{
+	gboolean split = grits_prefs_get_boolean(prefs,
+			"aweather/RSL_wsr88d_merge_split_cuts_off", NULL);
+	gchar *dir  = _shared_dir(prefs);
+	gchar *base = g_path_get_basename(file);
+	gchar *name = g_strconcat(base, split ? ".split" : "", SHARED_SUFFIX, NULL);
+	gchar *path = g_build_filename(dir, name, NULL);
+	g_free(name);
+	g_free(base);
+	g_free(dir);
+	return path;
+}
+
+/********************
+ * Mapping a volume *
+ ********************/
+static gboolean _shared_take(const gchar *data, gsize len, gsize *pos, gpointer out, gsize size)
+{
+	if (*pos + size > len)
+		return FALSE;
+	memcpy(out, data + *pos, size);
+	*pos += size;
+	return TRUE;
+}
+
+/* Builds a radar whose rays point into the mapped data, NULL if the data does not make sense */
+static Radar *_shared_parse(const gchar *data, gsize len)
+{
+	SharedRadar head;
+	gsize pos = 0;
+	guint32 sizes[5];
+	_shared_sizes(sizes);
+	if (!_shared_take(data, len, &pos, &head, sizeof(head)) ||
+	    memcmp(head.magic, SHARED_MAGIC, sizeof(head.magic)) != 0 ||
+	    head.version != SHARED_VERSION ||
+	    memcmp(head.sizes, sizes, sizeof(sizes)) != 0 ||
+	    head.size != len)
+		return NULL;
+
+	Radar *radar = RSL_new_radar(MAX_RADAR_VOLUMES);
+	radar->h = head.h;
+	radar->h.nvolumes = MAX_RADAR_VOLUMES;
+	for (guint32 vi = 0; vi < head.nvolumes; vi++) {
+		SharedVolume svol;
+		if (!_shared_take(data, len, &pos, &svol, sizeof(svol)))
+			goto fail;
+		gint type = _shared_type(svol.index);
+		if (type < 0 || radar->v[svol.index] || svol.nsweeps < 0)
+			goto fail;
+		Volume *vol = RSL_new_volume(svol.nsweeps);
+		radar->v[svol.index] = vol;
+		vol->h          = svol.h;
+		vol->h.nsweeps  = svol.nsweeps;
+		vol->h.type_str = strdup(shared_volumes[type].type);
+		vol->h.f        = shared_volumes[type].f;
+		vol->h.invf     = shared_volumes[type].invf;
+		for (gint si = 0; si < svol.nsweeps; si++) {
+			SharedSweep ssweep;
+			if (!_shared_take(data, len, &pos, &ssweep, sizeof(ssweep)) ||
+			    ssweep.nrays < 0)
+				goto fail;
+			Sweep *sweep = RSL_new_sweep(ssweep.nrays);
+			vol->sweep[si] = sweep;
+			sweep->h        = ssweep.h;
+			sweep->h.nrays  = ssweep.nrays;
+			sweep->h.f      = vol->h.f;
+			sweep->h.invf   = vol->h.invf;
+			for (gint ri = 0; ri < ssweep.nrays; ri++) {
+				SharedRay sray;
+				if (!_shared_take(data, len, &pos, &sray, sizeof(sray)) ||
+				    sray.h.nbins < 0 || sray.range % 8 != 0 || sray.range > len ||
+				    (guint64)sray.h.nbins * sizeof(Range) > len - sray.range)
+					goto fail;
+				/* Allocated like RSL does, RSL_free_ray frees it */
+				Ray *ray = calloc(1, sizeof(Ray));
+				sweep->ray[ri] = ray;
+				ray->h      = sray.h;
+				ray->h.f    = vol->h.f;
+				ray->h.invf = vol->h.invf;
+				ray->range  = (Range*)(data + sray.range);
+			}
+		}
+	}
+	return radar;
+
+fail:
+	g_warning("Level2Shared: parse - bad file");
+	level2_shared_free_radar(radar, NULL);
+	return NULL;
+}
+
+static Radar *_shared_map(const gchar *path, GMappedFile **mapped)
+{
+	GError *error = NULL;
+	GMappedFile *map = g_mapped_file_new(path, FALSE, &error);
+	if (!map) {
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_warning("Level2Shared: map - %s", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	Radar *radar = _shared_parse(g_mapped_file_get_contents(map),
+			g_mapped_file_get_length(map));
+	if (!radar) {
+		g_mapped_file_unref(map);
+		return NULL;
+	}
+	g_debug("Level2Shared: map - %s", path);
+	/* Keeps the volume from being the next one trimmed */
+	g_utime(path, NULL);
+	*mapped = map;
+	return radar;
+}
+
+/***********************
+ * Publishing a volume *
+ ***********************/
+/* Volume vi and its counts, taken from the decoder when there is one since it is ahead of the radar */
+static Volume *_shared_volume(Radar *radar, Level2Decoder *decoder, gint vi,
+		gint *nsweeps, const gint **nrays)
+{
+	if (decoder)
+		return level2_decoder_get_volume(decoder, vi, nsweeps, nrays);
+	*nrays   = NULL;
+	*nsweeps = radar->v[vi] ? radar->v[vi]->h.nsweeps : 0;
+	return radar->v[vi];
+}
+
+static gint _shared_nrays(Sweep *sweep, const gint *nrays, gint si)
+{
+	gint count = 0;
+	for (gint ri = 0; ri < (nrays ? nrays[si] : sweep->h.nrays); ri++)
+		count += sweep->ray[ri] != NULL;
+	return count;
+}
+
+/* Writes the records, or only adds up their size when fd is NULL, and returns the offset of the range data */
+static guint64 _shared_write(FILE *fd, Radar *radar, Level2Decoder *decoder, guint64 size)
+{
+	guint64 header = sizeof(SharedRadar);
+	guint64 range  = 0;
+	guint32 nvolumes = 0;
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		gint nsweeps; const gint *nrays;
+		if (_shared_type(vi) >= 0 && _shared_volume(radar, decoder, vi, &nsweeps, &nrays))
+			nvolumes++;
+	}
+
+	if (fd) {
+		SharedRadar head = {};
+		memcpy(head.magic, SHARED_MAGIC, sizeof(head.magic));
+		head.version  = SHARED_VERSION;
+		head.size     = size;
+		head.nvolumes = nvolumes;
+		head.h        = radar->h;
+		_shared_sizes(head.sizes);
+		fwrite(&head, sizeof(head), 1, fd);
+		range = SHARED_ALIGN(_shared_write(NULL, radar, decoder, 0));
+	}
+
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		gint nsweeps; const gint *nrays;
+		Volume *vol = _shared_volume(radar, decoder, vi, &nsweeps, &nrays);
+		if (!vol || _shared_type(vi) < 0)
+			continue;
+		header += sizeof(SharedVolume);
+		if (fd) {
+			SharedVolume svol = {vi, nsweeps, vol->h};
+			fwrite(&svol, sizeof(svol), 1, fd);
+		}
+		for (gint si = 0; si < nsweeps; si++) {
+			Sweep *sweep = vol->sweep[si];
+			gint   count = _shared_nrays(sweep, nrays, si);
+			header += sizeof(SharedSweep) + count * sizeof(SharedRay);
+			if (!fd)
+				continue;
+			SharedSweep ssweep = {count, 0, sweep->h};
+			fwrite(&ssweep, sizeof(ssweep), 1, fd);
+			for (gint ri = 0; ri < (nrays ? nrays[si] : sweep->h.nrays); ri++) {
+				Ray *ray = sweep->ray[ri];
+				if (!ray)
+					continue;
+				SharedRay sray = {range, ray->h};
+				fwrite(&sray, sizeof(sray), 1, fd);
+				range = SHARED_ALIGN(range + ray->h.nbins * sizeof(Range));
+			}
+		}
+	}
+	return header;
+}
+
+/* The range data, in the same order as the ray records. Returns the size of the file. */
+static guint64 _shared_write_ranges(FILE *fd, Radar *radar, Level2Decoder *decoder, guint64 start)
+{
+	static const gchar zeros[8];
+	guint64 pos = start;
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		gint nsweeps; const gint *nrays;
+		Volume *vol = _shared_volume(radar, decoder, vi, &nsweeps, &nrays);
+		if (!vol || _shared_type(vi) < 0)
+			continue;
+		for (gint si = 0; si < nsweeps; si++) {
+			Sweep *sweep = vol->sweep[si];
+			for (gint ri = 0; ri < (nrays ? nrays[si] : sweep->h.nrays); ri++) {
+				Ray *ray = sweep->ray[ri];
+				if (!ray)
+					continue;
+				gsize size = ray->h.nbins * sizeof(Range);
+				if (fd) {
+					fwrite(ray->range, 1, size, fd);
+					fwrite(zeros, 1, SHARED_ALIGN(pos + size) - (pos + size), fd);
+				}
+				pos = SHARED_ALIGN(pos + size);
+			}
+		}
+	}
+	return pos;
+}
+
+static gint _shared_compare_mtime(gconstpointer _a, gconstpointer _b)
+{
+	const GStatBuf *a = *(GStatBuf**)_a, *b = *(GStatBuf**)_b;
+	return (a->st_mtime > b->st_mtime) - (a->st_mtime < b->st_mtime);
+}
+
+/* Removes the least recently used volumes until the rest fit in aweather/shared_mb, except keep */
+static void _shared_trim(const gchar *dir, const gchar *keep, GritsPrefs *prefs)
+{
+	gint64 budget = (gint64)grits_prefs_get_integer(prefs, "aweather/shared_mb", NULL) * 1024 * 1024;
+	GDir  *gdir   = g_dir_open(dir, 0, NULL);
+	if (!gdir)
+		return;
+	GPtrArray  *files = g_ptr_array_new_with_free_func(g_free);
+	GHashTable *paths = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	gint64 total = 0;
+	const gchar *name;
+	while ((name = g_dir_read_name(gdir))) {
+		if (!g_str_has_suffix(name, SHARED_SUFFIX))
+			continue;
+		gchar    *path = g_build_filename(dir, name, NULL);
+		GStatBuf *st   = g_new0(GStatBuf, 1);
+		if (g_stat(path, st) == 0)
+			total += st->st_size;
+		if (st->st_size == 0 || g_str_equal(path, keep)) {
+			g_free(path);
+			g_free(st);
+			continue;
+		}
+		g_ptr_array_add(files, st);
+		g_hash_table_insert(paths, st, path);
+	}
+	g_dir_close(gdir);
+
+	g_ptr_array_sort(files, _shared_compare_mtime);
+	for (guint i = 0; i < files->len && total > budget; i++) {
+		GStatBuf *st   = files->pdata[i];
+		gchar    *path = g_hash_table_lookup(paths, st);
+		gchar    *lock = g_strconcat(path, ".lock", NULL);
+		g_debug("Level2Shared: trim - %s", path);
+		/* Processes that mapped it keep their mapping */
+		if (g_remove(path) == 0)
+			total -= st->st_size;
+		g_remove(lock);
+		g_free(lock);
+	}
+	g_hash_table_destroy(paths);
+	g_ptr_array_free(files, TRUE);
+}
+
+/***********
+ * Methods *
+ ***********/
+Radar *level2_shared_get(const gchar *file, GritsPrefs *prefs, GCancellable *cancellable,
+		GMappedFile **mapped, gint *lock)
+{
+	*lock = -1;
+	if (!_shared_enabled(prefs))
+		return NULL;
+	gchar *path  = _shared_path(file, prefs);
+	Radar *radar = _shared_map(path, mapped);
+#ifdef G_OS_UNIX
+	if (!radar) {
+		gchar *dir  = g_path_get_dirname(path);
+		gchar *name = g_strconcat(path, ".lock", NULL);
+		g_mkdir_with_parents(dir, 0755);
+		gint   fd    = g_open(name, O_RDWR | O_CREAT, 0666);
+		gint64 start = g_get_monotonic_time();
+		/* Another process decoding it holds the lock until it is published */
+		while (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+			if (g_cancellable_is_cancelled(cancellable) ||
+			    g_get_monotonic_time() - start > SHARED_WAIT) {
+				close(fd);
+				fd = -1;
+				break;
+			}
+			g_usleep(SHARED_POLL);
+		}
+		if (fd >= 0)
+			radar = _shared_map(path, mapped);
+		if (radar)
+			close(fd);
+		else
+			*lock = fd;
+		g_free(name);
+		g_free(dir);
+	}
+#endif
+	g_free(path);
+	return radar;
+}
+
+void level2_shared_publish(Radar *radar, Level2Decoder *decoder, const gchar *file,
+		GritsPrefs *prefs, gint lock)
+{
+	if (radar && _shared_enabled(prefs)) {
+		gchar *path = _shared_path(file, prefs);
+		gchar *dir  = g_path_get_dirname(path);
+		gchar *tmp  = g_strconcat(path, ".XXXXXX", NULL);
+		g_mkdir_with_parents(dir, 0755);
+		gint   fd   = g_mkstemp(tmp);
+		FILE  *out  = fd >= 0 ? fdopen(fd, "wb") : NULL;
+		if (out) {
+			/* Written whole and then renamed, so a file that is there can be mapped */
+			guint64 start = SHARED_ALIGN(_shared_write(NULL, radar, decoder, 0));
+			guint64 size  = _shared_write_ranges(NULL, radar, decoder, start);
+			_shared_write(out, radar, decoder, size);
+			fseek(out, start, SEEK_SET);
+			_shared_write_ranges(out, radar, decoder, start);
+			gboolean ok = !ferror(out);
+			ok = fclose(out) == 0 && ok;
+			g_chmod(tmp, 0644);
+			if (ok && g_rename(tmp, path) == 0) {
+				g_debug("Level2Shared: publish - %s, %" G_GUINT64_FORMAT " bytes", path, size);
+				_shared_trim(dir, path, prefs);
+			} else {
+				g_warning("Level2Shared: publish - failed to write %s", path);
+				g_remove(tmp);
+			}
+		} else {
+			g_warning("Level2Shared: publish - cannot create %s", tmp);
+			if (fd >= 0)
+				close(fd);
+		}
+		g_free(tmp);
+		g_free(dir);
+		g_free(path);
+	}
+#ifdef G_OS_UNIX
+	if (lock >= 0)
+		close(lock);
+#endif
+}
+
+void level2_shared_free_radar(Radar *radar, GMappedFile *mapped)
+{
+	/* Only the structures are ours, the range data is in the mapping */
+	for (gint vi = 0; vi < radar->h.nvolumes; vi++) {
+		Volume *vol = radar->v[vi];
+		for (gint si = 0; vol && si < vol->h.nsweeps; si++) {
+			Sweep *sweep = vol->sweep[si];
+			for (gint ri = 0; sweep && ri < sweep->h.nrays; ri++)
+				if (sweep->ray[ri])
+					sweep->ray[ri]->range = NULL;
+		}
+	}
+	RSL_free_radar(radar);
+	if (mapped)
+		g_mapped_file_unref(mapped);
+}
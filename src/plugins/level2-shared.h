@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LEVEL2_SHARED_H__
+#define __LEVEL2_SHARED_H__
+
+#include <glib.h>
+#include <grits.h>
+#include <rsl.h>
+#include "level2-decoder.h"
+
+/* Decoded volumes shared between the aweather processes of a machine, eg. the seats of one workstation watching
+ * the same sites. The first process to load a volume decodes it and publishes its sweeps in a file under
+ * aweather/shared_dir (by default the user's runtime directory, which is memory backed). The others map that
+ * file read-only instead of decoding their own copy, so the range data of a volume is in memory once however
+ * many viewers show it. A lock per volume keeps two processes from decoding the same one at the same time.
+ *
+ * Disabled unless aweather/shared_mb is set, published volumes are kept within that many megabytes, least
+ * recently used first. Processes of different users can share a shared_dir that all of them can write to.
+ * Only the volumes that have a colormap (DZ, VR, SW, DR, PH and RH) are published. */
+
+/* Returns the published radar of file, NULL if there is none or sharing is disabled.
+ * The range data of the radar is mapped and belongs to mapped, free the radar with level2_shared_free_radar.
+ *
+ * If another process is decoding file this waits for it. When NULL is returned, lock is set to a lock on
+ * decoding file (-1 if sharing is disabled), which must be given back with level2_shared_publish. */
+Radar *level2_shared_get(const gchar *file, GritsPrefs *prefs, GCancellable *cancellable,
+		GMappedFile **mapped, gint *lock);
+
+/* Publishes radar, decoded from file, and gives back lock. radar may be NULL to only give back the lock.
+ * decoder is the decoder filling in radar, if any, only the thread feeding it may call this. */
+void level2_shared_publish(Radar *radar, Level2Decoder *decoder, const gchar *file,
+		GritsPrefs *prefs, gint lock);
+
+/* Frees a radar returned by level2_shared_get, without freeing its mapped range data */
+void level2_shared_free_radar(Radar *radar, GMappedFile *mapped);
+
+#endif
@@ -18,16 +18,20 @@
 #include <bits/types/locale_t.h>
 #include <config.h>
 #include <math.h>
+#include <fcntl.h>
 #include <glib/gstdio.h>
 #include <grits.h>
 #include <rsl.h>
 #include <stdbool.h>
 
 #include "level2.h"
+#include "level2-file.h"
+#include "level2-shared.h"
 
 #include "../compat.h"
 
 #define ISO_MIN 30
+#define PROGRESSIVE_READ (64*1024) // Bytes fed to the decoder at a time, a few radials compressed
 #define ISO_MAX 80
 
 
@@ -177,26 +181,19 @@ out:
 	return opobjArray;
 }
 
-/* Convert a sweep to an 2d array of data points. */
-static void _bscan_sweep(Sweep *sweep, AWeatherColormap *colormap,
-		guint8 **data, int *width, int *height)
+/* Convert rays first to last-1 of a sweep to an 2d array of data points, max_bins wide. */
+static guint8 *_bscan_rays(Sweep *sweep, AWeatherColormap *colormap,
+		int first, int last, int max_bins)
 {
-	g_debug("AWeatherLevel2: _bscan_sweep - %p, %p, %p",
-			sweep, colormap, data);
-	/* Calculate max number of bins */
-	int max_bins = 0;
-	for (int i = 0; i < sweep->h.nrays; i++)
-		max_bins = MAX(max_bins, sweep->ray[i]->h.nbins);
-
 	/* Allocate buffer using max number of bins for each ray */
-	guint8 *buf = g_malloc0(sweep->h.nrays * max_bins * 4);
+	guint8 *buf = g_malloc0((last-first) * max_bins * 4);
 
 	/* Fill the data */
-	for (int ri = 0; ri < sweep->h.nrays; ri++) {
+	for (int ri = first; ri < last; ri++) {
 		Ray *ray  = sweep->ray[ri];
 
-		for (int bi = 0; bi < ray->h.nbins; bi++) {
-			guint  buf_i = (ri*max_bins+bi)*4;
+		for (int bi = 0; bi < MIN(ray->h.nbins, max_bins); bi++) {
+			guint  buf_i = ((ri-first)*max_bins+bi)*4;
 			float  value = ray->h.f(ray->range[bi]);
 
 			/* Check for bad values */
@@ -214,15 +211,28 @@ static void _bscan_sweep(Sweep *sweep, AWeatherColormap *colormap,
 			buf[buf_i+3] = data[3]*0.75; // TESTING
 		}
 	}
+	return buf;
+}
+
+/* Convert a sweep to an 2d array of data points. */
+static void _bscan_sweep(Sweep *sweep, AWeatherColormap *colormap,
+		guint8 **data, int *width, int *height)
+{
+	g_debug("AWeatherLevel2: _bscan_sweep - %p, %p, %p",
+			sweep, colormap, data);
+	/* Calculate max number of bins */
+	int max_bins = 0;
+	for (int i = 0; i < sweep->h.nrays; i++)
+		max_bins = MAX(max_bins, sweep->ray[i]->h.nbins);
 
 	/* set output */
 	*width  = max_bins;
 	*height = sweep->h.nrays;
-	*data   = buf;
+	*data   = _bscan_rays(sweep, colormap, 0, sweep->h.nrays, max_bins);
 }
 
-/* Load a sweep into an OpenGL texture */
-static SweepTexture* _load_sweep_gl(Sweep* ipobjRslSweep, AWeatherColormap* ipobjColormap)
+/* Load a sweep into an OpenGL texture. The texture has room for ipiMaxRays rows if that is more than the sweep has rays */
+static SweepTexture* _load_sweep_gl(Sweep* ipobjRslSweep, AWeatherColormap* ipobjColormap, gint ipiMaxRays)
 {
 	g_debug("AWeatherLevel2: _load_sweep_gl");
 
@@ -232,9 +242,12 @@ static SweepTexture* _load_sweep_gl(Sweep* ipobjRslSweep, AWeatherColormap* ipob
 	gint width, height;
 	_bscan_sweep(ipobjRslSweep, ipobjColormap, &data, &width, &height);
 	gint tex_width  = pow(2, ceil(log(width )/log(2)));
-	gint tex_height = pow(2, ceil(log(height)/log(2)));
+	gint tex_height = pow(2, ceil(log(MAX(height, ipiMaxRays))/log(2)));
 	objSweepTexture->sweep_coords[0] = (double)width  / tex_width;
 	objSweepTexture->sweep_coords[1] = (double)height / tex_height;
+	objSweepTexture->width  = width;
+	objSweepTexture->rows   = height;
+	objSweepTexture->height = tex_height;
 
 	glGenTextures(1, &objSweepTexture->sweep_tex);
 	glBindTexture(GL_TEXTURE_2D, objSweepTexture->sweep_tex);
@@ -252,6 +265,26 @@ static SweepTexture* _load_sweep_gl(Sweep* ipobjRslSweep, AWeatherColormap* ipob
 	return objSweepTexture;
 }
 
+/* Uploads the rays added to a sweep since its texture was loaded */
+static void _update_sweep_gl(SweepTexture* ipobjSweepTexture, Sweep* ipobjRslSweep, AWeatherColormap* ipobjColormap)
+{
+	gint first = ipobjSweepTexture->rows;
+	gint last  = MIN(ipobjRslSweep->h.nrays, ipobjSweepTexture->height);
+	if (last <= first)
+		return;
+	g_debug("AWeatherLevel2: _update_sweep_gl - rays %d-%d", first, last);
+
+	guint8 *data = _bscan_rays(ipobjRslSweep, ipobjColormap, first, last, ipobjSweepTexture->width);
+	glBindTexture(GL_TEXTURE_2D, ipobjSweepTexture->sweep_tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0,first, ipobjSweepTexture->width,last-first,
+			GL_RGBA, GL_UNSIGNED_BYTE, data);
+	g_free(data);
+
+	ipobjSweepTexture->rows = last;
+	ipobjSweepTexture->sweep_coords[1] = (double)last / ipobjSweepTexture->height;
+}
+
 void aweatherLevel2UpdateSweepTimestampGui(AWeatherLevel2* level2){
 	/* Update the GUI to show the user when the sweep started and ended */
 	RslDateTime sweepStartTime, sweepFinishTime;
@@ -264,38 +297,6 @@ void aweatherLevel2UpdateSweepTimestampGui(AWeatherLevel2* level2){
 
 }
 
-/* Decompress a radar file using wsr88dec */
-static gboolean _decompress_radar(const gchar *file, const gchar *raw)
-{
-	g_debug("AWeatherLevel2: _decompress_radar - \n\t%s\n\t%s", file, raw);
-	char *argv[] = {"wsr88ddec", (gchar*)file, (gchar*)raw, NULL};
-	gint status;
-	GError *error = NULL;
-	g_spawn_sync(
-		NULL,    // const gchar *working_directory
-		argv,    // gchar **argv
-		NULL,    // gchar **envp
-		G_SPAWN_SEARCH_PATH, // GSpawnFlags flags
-		NULL,    // GSpawnChildSetupFunc child_setup
-		NULL,    // gpointer user_data
-		NULL,    // gchar *standard_output
-		NULL,    // gchar *standard_output
-		&status, // gint *exit_status
-		&error); // GError **error
-	if (error) {
-		g_warning("AWeatherLevel2: _decompress_radar - %s", error->message);
-		g_error_free(error);
-		return FALSE;
-	}
-	if (status != 0) {
-		gchar *msg = g_strdup_printf("wsr88ddec exited with status %d", status);
-		g_warning("AWeatherLevel2: _decompress_radar - %s", msg);
-		g_free(msg);
-		return FALSE;
-	}
-	return TRUE;
-}
-
 /* Load the radar into a Grits Volume */
 static void _cart_to_sphere(VolCoord *out, VolCoord *in)
 {
@@ -526,7 +527,8 @@ static gboolean _set_sweep_cb(gpointer _level2)
 
 	if(objSweepTexture == NULL){
 		/* If there was no cached sweep texture, then compute the texture and upload it to the GPU. */
-		objSweepTexture = _load_sweep_gl(objSelectedSweep, level2->sweep_colors);
+		objSweepTexture = _load_sweep_gl(objSelectedSweep, level2->sweep_colors,
+				level2->decoder ? LEVEL2_DECODER_MAX_RAYS : 0);
 	}
 
 	/* Switch over to the new seep. This must happn on the UI thread to prevent race conditions */
@@ -625,10 +627,8 @@ void aweather_level2_set_iso(AWeatherLevel2 *level2, gfloat level, bool iplAsync
 	}
 }
 
-AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap)
+static AWeatherLevel2 *_level2_new(Radar *radar, AWeatherColormap *colormap)
 {
-	g_debug("AWeatherLevel2: new - %s", radar->h.radar_name);
-	RSL_sort_radar(radar);
 	AWeatherLevel2 *level2 = g_object_new(AWEATHER_TYPE_LEVEL2, NULL);
 	level2->fAfterSetSweepOneTimeCustomCallback = NULL; /* Ensure the callback function pointer is not pointing to anything */
 	level2->objAfterSetSweepOneTimeCustomCallbackData = NULL;
@@ -648,61 +648,211 @@ AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap)
 	/* Default to no sweep / volume selected yet */
 	level2->iSelectedSweepId = AWEATHER_LEVEL2_SELECTED_SWEEP_ID_NONE;
 	level2->iSelectedVolumeId = AWEATHER_LEVEL2_SELECTED_VOLUME_ID_NONE;
+	return level2;
+}
 
-	aweather_level2_set_sweep(level2, DZ_INDEX, 0);
-
+static void _level2_set_center(AWeatherLevel2 *level2)
+{
 	GritsPoint center;
-	Radar_header *h = &radar->h;
+	Radar_header *h = &level2->radar->h;
 	center.lat  = (double)h->latd + (double)h->latm/60 + (double)h->lats/(60*60);
 	center.lon  = (double)h->lond + (double)h->lonm/60 + (double)h->lons/(60*60);
 	center.elev = h->height;
 	GRITS_OBJECT(level2)->center = center;
+}
+
+AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap)
+{
+	g_debug("AWeatherLevel2: new - %s", radar->h.radar_name);
+	RSL_sort_radar(radar);
+	AWeatherLevel2 *level2 = _level2_new(radar, colormap);
+	aweather_level2_set_sweep(level2, DZ_INDEX, 0);
+	_level2_set_center(level2);
 	return level2;
 }
 
-AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
+AWeatherLevel2 *aweather_level2_new_decoding(const gchar *site,
 		AWeatherColormap *colormap, GritsPrefs *prefs)
 {
-	g_debug("AWeatherLevel2: new_from_file %s %s", site, file);
+	g_debug("AWeatherLevel2: new_decoding - %s", site);
+	/* Rays stay in the order they were scanned, sorting would move them under the decoder */
+	Radar *radar = RSL_new_radar(MAX_RADAR_VOLUMES);
+	AWeatherLevel2 *level2 = _level2_new(radar, colormap);
+	level2->decoder = level2_decoder_new(radar, site, !grits_prefs_get_boolean(prefs,
+				"aweather/RSL_wsr88d_merge_split_cuts_off", NULL));
+	return level2;
+}
 
-	/* Decompress radar */
-	gchar *raw = g_strconcat(file, ".raw", NULL);
-	if (g_file_test(raw, G_FILE_TEST_EXISTS)) {
-		struct stat files, raws;
-		g_stat(file, &files);
-		g_stat(raw,  &raws);
-		if (files.st_mtime > raws.st_mtime)
-			if (!_decompress_radar(file, raw))
-				return NULL;
-	} else {
-		if (!_decompress_radar(file, raw))
-			return NULL;
+Level2DecoderChanges aweather_level2_sync(AWeatherLevel2 *level2)
+{
+	if (!level2->decoder)
+		return 0;
+	Level2DecoderChanges changes = level2_decoder_sync(level2->decoder);
+
+	/* Show the first sweep once there is something to show */
+	if (level2->iSelectedSweepId == AWEATHER_LEVEL2_SELECTED_SWEEP_ID_NONE) {
+		Volume *volume = RSL_get_volume(level2->radar, DZ_INDEX);
+		if (volume && volume->h.nsweeps > 0 && volume->sweep[0]->h.nrays > 0) {
+			_level2_set_center(level2);
+			aweather_level2_set_sweep(level2, DZ_INDEX, 0);
+		}
+	} else if (level2->sweep && level2->objSweepTexture &&
+	           level2->sweep->h.nrays > level2->objSweepTexture->rows) {
+		_update_sweep_gl(level2->objSweepTexture, level2->sweep, level2->sweep_colors);
+		aweatherLevel2UpdateSweepTimestampGui(level2);
+		grits_object_queue_draw(GRITS_OBJECT(level2));
 	}
+	return changes;
+}
+
+Level2DecoderChanges aweather_level2_finish(AWeatherLevel2 *level2)
+{
+	if (!level2->decoder)
+		return 0;
+	g_debug("AWeatherLevel2: finish - %p", level2);
+	Level2DecoderChanges changes = aweather_level2_sync(level2);
+	level2_decoder_free(level2->decoder);
+	level2->decoder = NULL;
+	return changes;
+}
 
-	/* Load the radar file */
-	RSL_read_these_sweeps("all", NULL);
-	g_debug("AWeatherLevel2: rsl read start");
+AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs, GCancellable *cancellable)
+{
+	g_debug("AWeatherLevel2: new_from_file %s %s", site, file);
 
-	/* If the user wants to show the reflectivity data from the velocity sweeps, then disable the "merge split cuts" option in RSL so those
-	 * sweeps are not removed.
-	 * Enabling this option (setting it to true) will cause extra reflectivity sweeps to show up,
-	 * which can be useful when looking for closer to real-time data.
-	 */
-	if(grits_prefs_get_boolean(prefs, "aweather/RSL_wsr88d_merge_split_cuts_off", NULL)){
-		RSL_wsr88d_merge_split_cuts_off();
-	} else {
-		RSL_wsr88d_merge_split_cuts_on();
+	/* Another process may have decoded it already, or be decoding it */
+	GMappedFile *mapped = NULL;
+	gint         lock   = -1;
+	Radar *radar = level2_shared_get(file, prefs, cancellable, &mapped, &lock);
+	if (radar) {
+		AWeatherLevel2 *level2 = aweather_level2_new(radar, colormaps);
+		level2->mapped = mapped;
+		return level2;
 	}
 
-	Radar *radar = RSL_wsr88d_to_radar(raw, (gchar*)site);
-	g_debug("AWeatherLevel2: rsl read done");
-	g_free(raw);
+	/* A spill file left by an earlier load or by the warming daemon is quicker to read than the volume */
+	if (level2_file_spill_is_fresh(file, prefs))
+		radar = level2_file_read_spill(file, prefs);
+	if (!radar)
+		radar = level2_file_read(file, site, prefs, cancellable);
+	level2_shared_publish(radar, NULL, file, prefs, lock);
 	if (!radar)
 		return NULL;
 
 	return aweather_level2_new(radar, colormaps);
 }
 
+AWeatherLevel2 *aweather_level2_new_from_file_progressive(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs, GCancellable *cancellable,
+		AWeatherLevel2Callback first_sweep, gpointer user_data)
+{
+	g_debug("AWeatherLevel2: new_from_file_progressive %s %s", site, file);
+
+	/* Reading what an earlier load or the warming daemon left next to the file beats decoding it again */
+	if (level2_file_spill_is_fresh(file, prefs) || level2_file_raw_is_fresh(file))
+		return aweather_level2_new_from_file(file, site, colormap, prefs, cancellable);
+
+	/* Mapping a volume another process published is quicker than showing the first sweep early */
+	GMappedFile *mapped = NULL;
+	gint         lock   = -1;
+	Radar *radar = level2_shared_get(file, prefs, cancellable, &mapped, &lock);
+	if (radar) {
+		AWeatherLevel2 *level2 = aweather_level2_new(radar, colormap);
+		level2->mapped = mapped;
+		return level2;
+	}
+
+	FILE *fd = g_fopen(file, "rb");
+	if (!fd) {
+		level2_shared_publish(NULL, NULL, file, prefs, lock);
+		return NULL;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fileno(fd), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	AWeatherLevel2 *level2  = aweather_level2_new_decoding(site, colormap, prefs);
+	Level2Decoder  *decoder = level2->decoder;
+	guint8   *buf   = g_malloc(PROGRESSIVE_READ);
+	gboolean  ok    = TRUE;
+	gboolean  shown = FALSE;
+	gsize     len;
+	while (ok && !level2_decoder_is_complete(decoder) &&
+	       !g_cancellable_is_cancelled(cancellable) &&
+	       (len = fread(buf, 1, PROGRESSIVE_READ, fd)) > 0) {
+		ok = level2_decoder_feed(decoder, buf, len);
+		/* The lowest cut is done once the next one starts */
+		if (ok && !shown && first_sweep && (level2_decoder_get_cut(decoder) > 1 ||
+		                     level2_decoder_is_complete(decoder))) {
+			g_debug("AWeatherLevel2: new_from_file_progressive - lowest cut done");
+			first_sweep(level2, user_data);
+			shown = TRUE;
+		}
+	}
+	fclose(fd);
+	g_free(buf);
+
+	if (g_cancellable_is_cancelled(cancellable)) {
+		g_debug("AWeatherLevel2: new_from_file_progressive - cancelled");
+		level2_shared_publish(NULL, NULL, file, prefs, lock);
+		g_object_unref(level2);
+		return NULL;
+	}
+	if (!shown && (!ok || level2_decoder_get_cut(decoder) == 0)) {
+		g_debug("AWeatherLevel2: new_from_file_progressive - not message 31, using RSL");
+		level2_shared_publish(NULL, NULL, file, prefs, lock);
+		g_object_unref(level2);
+		return aweather_level2_new_from_file(file, site, colormap, prefs, cancellable);
+	}
+	level2_shared_publish(ok && level2_decoder_is_complete(decoder) ? level2->radar : NULL,
+			decoder, file, prefs, lock);
+	return level2;
+}
+
+gsize aweather_level2_get_memory_size(AWeatherLevel2 *level2)
+{
+	Radar *radar = level2->radar;
+	gsize size = sizeof(Radar) + sizeof(Volume*) * radar->h.nvolumes;
+	for (int v = 0; v < radar->h.nvolumes; v++) {
+		Volume *volume = radar->v[v];
+		if (!volume)
+			continue;
+		size += sizeof(Volume) + sizeof(Sweep*) * volume->h.nsweeps;
+		for (int s = 0; s < volume->h.nsweeps; s++) {
+			Sweep *sweep = volume->sweep[s];
+			if (!sweep)
+				continue;
+			size += sizeof(Sweep) + sizeof(Ray*) * sweep->h.nrays;
+			for (int r = 0; r < sweep->h.nrays; r++)
+				if (sweep->ray[r])
+					size += sizeof(Ray) + sizeof(Range) * sweep->ray[r]->h.nbins;
+		}
+	}
+	return size;
+}
+
+gboolean aweather_level2_write_spill_file(AWeatherLevel2 *level2, const gchar *file,
+		GritsPrefs *prefs)
+{
+	if (level2->mapped)
+		return TRUE;
+	return level2_file_write_spill(level2->radar, file, prefs);
+}
+
+AWeatherLevel2 *aweather_level2_new_from_spill_file(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs)
+{
+	g_debug("AWeatherLevel2: new_from_spill_file %s", file);
+
+	/* Fall back to decoding the level2 file if the spill file is missing */
+	Radar *radar = level2_file_read_spill(file, prefs);
+	if (!radar)
+		return aweather_level2_new_from_file(file, site, colormap, prefs, NULL);
+
+	return aweather_level2_new(radar, colormap);
+}
+
 static void _on_sweep_clicked(GtkRadioButton *button, gpointer _level2)
 {
 	AWeatherLevel2 *level2 = _level2;
@@ -908,7 +1058,12 @@ static void aweather_level2_finalize(GObject *_level2)
 {
 	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
 	g_debug("AWeatherLevel2: finalize - %p", _level2);
-	RSL_free_radar(level2->radar);
+	if (level2->decoder)
+		level2_decoder_free(level2->decoder);
+	if (level2->mapped)
+		level2_shared_free_radar(level2->radar, level2->mapped);
+	else
+		RSL_free_radar(level2->radar);
 	/* Delete any sweep textures that need to be deleted from the cache and the current sweep texture */
 	_free_sweep_texture_cache(level2);
 	_free_sweep_texture((level2->objSweepTexture));
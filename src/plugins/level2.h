@@ -18,8 +18,10 @@
 #ifndef __AWEATHER_LEVEL2_H__
 #define __AWEATHER_LEVEL2_H__
 
+#include <gio/gio.h>
 #include <grits.h>
 #include "radar-info.h"
+#include "level2-decoder.h"
 
 /* Level2 */
 #define AWEATHER_TYPE_LEVEL2            (aweather_level2_get_type())
@@ -43,12 +45,17 @@ typedef struct _AWeatherLevel2Class AWeatherLevel2Class;
 typedef struct {
 	guint             sweep_tex;
 	gdouble           sweep_coords[2];
+	gint              width;  /* Bins per row */
+	gint              rows;   /* Rays in the texture. Sweeps that are still being decoded get rows added as rays arrive */
+	gint              height; /* Rows the texture has room for */
 } SweepTexture;
 
 struct _AWeatherLevel2 {
 	GritsObject       parent;
 	Radar            *radar;
 	AWeatherColormap *colormap;
+	Level2Decoder    *decoder; /* Set if radar is filled in as it is decoded, see aweather_level2_new_decoding */
+	GMappedFile      *mapped;  /* Set if the range data of radar was published by another process, see level2-shared.h */
 
 	/* Private */
 	GritsVolume      *volume;
@@ -105,7 +112,47 @@ GType aweather_level2_get_type(void);
 
 AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap);
 
+/* Decodes a level2 file, or reads its spill file if that is up to date. Returns NULL if decoding fails or
+ * cancellable (which may be NULL) is cancelled part way through */
 AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs, GCancellable *cancellable);
+
+typedef void (*AWeatherLevel2Callback)(AWeatherLevel2 *level2, gpointer user_data);
+
+/* Like aweather_level2_new_from_file, but Message 31 volumes are decoded record by record into a level2 from
+ * aweather_level2_new_decoding. It is passed to first_sweep (on the calling thread) as soon as the lowest cut
+ * is decoded, while the higher ones are still being decoded, unless first_sweep is NULL. Other volumes, and volumes
+ * with an up to date spill file or .raw, are read by aweather_level2_new_from_file. */
+AWeatherLevel2 *aweather_level2_new_from_file_progressive(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs, GCancellable *cancellable,
+		AWeatherLevel2Callback first_sweep, gpointer user_data);
+
+/* Creates a level2 with an empty radar that level2->decoder fills in as data is fed to it, from any one thread.
+ * Nothing is shown until aweather_level2_sync is called. */
+AWeatherLevel2 *aweather_level2_new_decoding(const gchar *site,
+		AWeatherColormap *colormap, GritsPrefs *prefs);
+
+/* Shows what the decoder has decoded since the last call, only new rays are added to the sweep texture.
+ * The first reflectivity sweep is selected once it has rays. When sweeps were added the config from
+ * aweather_level2_get_config is out of date. Must be called on the UI thread. */
+Level2DecoderChanges aweather_level2_sync(AWeatherLevel2 *level2);
+
+/* Syncs the rest of the volume and frees the decoder, once nothing feeds it any more.
+ * Must be called on the UI thread. */
+Level2DecoderChanges aweather_level2_finish(AWeatherLevel2 *level2);
+
+/* Returns an estimate of the memory used by the radar data of the given level2 object in bytes */
+gsize aweather_level2_get_memory_size(AWeatherLevel2 *level2);
+
+/* Writes the decoded radar to a compact spill file next to the level2 file so it can be reloaded with
+ * aweather_level2_new_from_spill_file without decoding the level2 file again. Returns FALSE on failure.
+ * Radars mapped from the shared cache are not written, reloading maps them again.
+ */
+gboolean aweather_level2_write_spill_file(AWeatherLevel2 *level2, const gchar *file,
+		GritsPrefs *prefs);
+
+/* Loads a level2 object from the spill file written for the given level2 file. Decodes the level2 file instead if there is no spill file. */
+AWeatherLevel2 *aweather_level2_new_from_spill_file(const gchar *file, const gchar *site,
 		AWeatherColormap *colormap, GritsPrefs *prefs);
 
 void aweather_level2_set_sweep(AWeatherLevel2 *level2,
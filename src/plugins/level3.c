@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <bzlib.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "level3.h"
+
+/* Message header block plus product description block */
+#define HEADER_SIZE     120
+
+/* Largest decompressed product we accept, super resolution products are about 1.5 MB */
+#define MAX_PRODUCT     (16*1024*1024)
+
+/* Products and velocity products of the same scan are stamped a few seconds apart */
+#define MAX_SCAN_SKEW   120       // Seconds
+
+/* How far back scans are looked for */
+#define MAX_HOURS       6
+
+/* Packet code of the digital radial data array */
+#define DIGITAL_RADIALS 16
+
+/* Supported products, all of them are digital radial data arrays */
+typedef struct {
+	gint    code;
+	gint    index;      // RSL volume index
+	gchar  *type;
+	gfloat  gate_size;  // Meters
+	gfloat  (*f)(Range);
+	Range   (*invf)(float);
+} Level3Product;
+
+static const Level3Product products[] = {
+	{  94, DZ_INDEX, "DZ", 1000, DZ_F, DZ_INVF }, // N0Q, 1 km x 1 deg
+	{  99, VR_INDEX, "VR",  250, VR_F, VR_INVF }, // N0U, 250 m x 1 deg
+	{ 153, DZ_INDEX, "DZ",  250, DZ_F, DZ_INVF }, // N0B, 250 m x 0.5 deg
+	{ 154, VR_INDEX, "VR",  250, VR_F, VR_INVF }, // N0G, 250 m x 0.5 deg
+};
+
+/* Reflectivity and velocity product names to list, newest first. Older archives only have N0Q/N0U */
+static const gchar *names[][2] = {
+	{ "N0B", "N0G" },
+	{ "N0Q", "N0U" },
+};
+
+static gint _get16(const guint8 *p)
+{
+	return (gint16)(p[0] << 8 | p[1]);
+}
+
+static gint _get32(const guint8 *p)
+{
+	return (gint32)((guint32)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+}
+
+static const Level3Product *_get_product(gint code)
+{
+	for (gint i = 0; i < G_N_ELEMENTS(products); i++)
+		if (products[i].code == code)
+			return &products[i];
+	return NULL;
+}
+
+/* Finds the message header, products are sent with WMO and AWIPS headers in front of it */
+static const guint8 *_find_message(const guint8 *buf, gsize len)
+{
+	for (gsize i = 0; i < 64 && i + HEADER_SIZE <= len; i++) {
+		const guint8 *msg = buf + i;
+		/* The message code is repeated as the product code after the block divider */
+		if (_get16(msg+18) == -1 && _get16(msg) == _get16(msg+30) && _get16(msg) > 16)
+			return msg;
+	}
+	return NULL;
+}
+
+/* Fills in the radar header from the product description block */
+static void _set_radar_header(Radar *radar, const guint8 *msg, const gchar *site)
+{
+	Radar_header *h = &radar->h;
+	gint64 time = (gint64)(_get16(msg+40) - 1) * 24*60*60 + _get32(msg+42);
+	GDateTime *date = g_date_time_new_from_unix_utc(time);
+	h->year   = g_date_time_get_year(date);
+	h->month  = g_date_time_get_month(date);
+	h->day    = g_date_time_get_day_of_month(date);
+	h->hour   = g_date_time_get_hour(date);
+	h->minute = g_date_time_get_minute(date);
+	h->sec    = g_date_time_get_second(date);
+	g_date_time_unref(date);
+
+	gdouble lat = _get32(msg+20) / 1000.0;
+	gdouble lon = _get32(msg+24) / 1000.0;
+	h->latd = lat; h->latm = (lat - h->latd) * 60; h->lats = ((lat - h->latd) * 60 - h->latm) * 60;
+	h->lond = lon; h->lonm = (lon - h->lond) * 60; h->lons = ((lon - h->lond) * 60 - h->lonm) * 60;
+	h->height = _get16(msg+28) * 0.3048;
+	h->vcp    = _get16(msg+34);
+	g_strlcpy(h->radar_type, "wsr88d", sizeof(h->radar_type));
+	g_strlcpy(h->name,       site,     sizeof(h->name));
+	g_strlcpy(h->radar_name, site,     sizeof(h->radar_name));
+}
+
+/* Converts the digital radial data array of a product into a single sweep volume */
+static Volume *_read_radials(const Level3Product *prod, Radar *radar,
+		const guint8 *msg, const guint8 *pkt, const guint8 *end)
+{
+	gint   first = _get16(pkt+2);
+	gint   nbins = _get16(pkt+4);
+	gint   nrays = _get16(pkt+12);
+	gfloat elev  = _get16(msg+58) / 10.0;
+	gfloat min   = _get16(msg+60) / 10.0;
+	gfloat inc   = _get16(msg+62) / 10.0;
+	pkt += 14;
+	if (nbins <= 0 || nrays <= 0)
+		return NULL;
+
+	Volume *vol = RSL_new_volume(1);
+	vol->h.type_str = strdup(prod->type);
+	vol->h.f        = prod->f;
+	vol->h.invf     = prod->invf;
+
+	Sweep *sweep = vol->sweep[0] = RSL_new_sweep(nrays);
+	sweep->h.sweep_num = 1;
+	sweep->h.elev      = elev;
+	sweep->h.f         = prod->f;
+	sweep->h.invf      = prod->invf;
+
+	for (gint ri = 0; ri < nrays; ri++) {
+		if (pkt + 6 > end)
+			goto fail;
+		gint   nbytes = _get16(pkt);
+		gfloat start  = _get16(pkt+2) / 10.0;
+		gfloat width  = _get16(pkt+4) / 10.0;
+		pkt += 6;
+		if (nbytes < 0 || pkt + nbytes > end)
+			goto fail;
+
+		Ray *ray = sweep->ray[ri] = RSL_new_ray(nbins);
+		ray->h.year       = radar->h.year;
+		ray->h.month      = radar->h.month;
+		ray->h.day        = radar->h.day;
+		ray->h.hour       = radar->h.hour;
+		ray->h.minute     = radar->h.minute;
+		ray->h.sec        = radar->h.sec;
+		ray->h.azimuth    = fmod(start + width/2, 360);
+		ray->h.beam_width = width;
+		ray->h.ray_num    = ri + 1;
+		ray->h.elev       = elev;
+		ray->h.elev_num   = 1;
+		ray->h.gate_size  = prod->gate_size;
+		ray->h.range_bin1 = (first + 0.5) * prod->gate_size;
+		ray->h.lat        = _get32(msg+20) / 1000.0;
+		ray->h.lon        = _get32(msg+24) / 1000.0;
+		ray->h.alt        = radar->h.height;
+		ray->h.vel_res    = prod->index == VR_INDEX ? inc : 0;
+		ray->h.f          = prod->f;
+		ray->h.invf       = prod->invf;
+
+		/* Level 0 is below threshold, 1 is range folded */
+		for (gint bi = 0; bi < nbins; bi++) {
+			gint level = bi < nbytes ? pkt[bi] : 0;
+			float value = level == 0 ? BADVAL :
+			              level == 1 ? RFVAL  : min + (level-2) * inc;
+			ray->range[bi] = prod->invf(value);
+		}
+		pkt += (nbytes + 1) & ~1;
+
+		sweep->h.beam_width   = width;
+		sweep->h.horz_half_bw = width / 2;
+		sweep->h.vert_half_bw = width / 2;
+	}
+	return vol;
+
+fail:
+	g_warning("AWeatherLevel3: _read_radials - truncated product");
+	RSL_free_volume(vol);
+	return NULL;
+}
+
+/* Decodes one product file and adds it to radar */
+static gboolean _read_product(const gchar *file, const gchar *site, Radar *radar)
+{
+	g_debug("AWeatherLevel3: _read_product - %s", file);
+	gchar *contents;
+	gsize  length;
+	if (!g_file_get_contents(file, &contents, &length, NULL))
+		return FALSE;
+
+	guint8   *data = NULL;
+	Volume   *vol  = NULL;
+	gboolean  ok   = FALSE;
+	const Level3Product *prod;
+	const guint8 *msg = _find_message((guint8*)contents, length);
+	if (!msg) {
+		g_warning("AWeatherLevel3: _read_product - not a product - %s", file);
+		goto out;
+	}
+	gsize msglen = length - (msg - (guint8*)contents);
+
+	prod = _get_product(_get16(msg+30));
+	if (!prod) {
+		g_warning("AWeatherLevel3: _read_product - unsupported product %d - %s",
+				_get16(msg+30), file);
+		goto out;
+	}
+
+	/* Digital products are bzip2 compressed after the product description block */
+	if (_get16(msg+100) == 1) {
+		guint size = _get32(msg+102);
+		if (size == 0 || size > MAX_PRODUCT)
+			goto out;
+		data = g_malloc(HEADER_SIZE + size);
+		memcpy(data, msg, HEADER_SIZE);
+		if (BZ2_bzBuffToBuffDecompress((char*)data+HEADER_SIZE, &size,
+				(char*)msg+HEADER_SIZE, msglen-HEADER_SIZE, 0, 0) != BZ_OK) {
+			g_warning("AWeatherLevel3: _read_product - bad compressed data - %s", file);
+			goto out;
+		}
+		msg    = data;
+		msglen = HEADER_SIZE + size;
+	}
+
+	/* Symbology block header and the header of its first layer come before the packet */
+	gsize off = (gsize)_get32(msg+108) * 2;
+	if (off < HEADER_SIZE || off + 10 + 6 + 14 > msglen ||
+	    _get16(msg+off) != -1 || _get16(msg+off+2) != 1) {
+		g_warning("AWeatherLevel3: _read_product - no symbology block - %s", file);
+		goto out;
+	}
+	const guint8 *pkt = msg + off + 10 + 6;
+	if (_get16(pkt) != DIGITAL_RADIALS) {
+		g_warning("AWeatherLevel3: _read_product - unsupported packet %d - %s",
+				_get16(pkt), file);
+		goto out;
+	}
+
+	if (radar->h.year == 0)
+		_set_radar_header(radar, msg, site);
+	vol = _read_radials(prod, radar, msg, pkt, msg + msglen);
+	if (vol && !radar->v[prod->index]) {
+		radar->v[prod->index] = vol;
+		vol = NULL;
+		ok  = TRUE;
+	}
+
+out:
+	if (vol)
+		RSL_free_volume(vol);
+	g_free(data);
+	g_free(contents);
+	return ok;
+}
+
+AWeatherLevel2 *aweather_level3_new_from_files(const gchar **files, const gchar *site,
+		AWeatherColormap *colormap)
+{
+	Radar *radar = RSL_new_radar(MAX_RADAR_VOLUMES);
+	gboolean any = FALSE;
+	for (gint i = 0; files[i]; i++)
+		any |= _read_product(files[i], site, radar);
+	if (!any || !radar->v[DZ_INDEX]) {
+		RSL_free_radar(radar);
+		return NULL;
+	}
+	return aweather_level2_new(radar, colormap);
+}
+
+
+/***********
+ * Listing *
+ ***********/
+/* Scan time of a product, names look like LSX_N0B_2024_05_10_03_23_00 */
+static time_t _product_time(const gchar *name)
+{
+	gint year, mon, day, hour, min, sec;
+	if (strlen(name) < 8 || sscanf(name+8, "%4d_%2d_%2d_%2d_%2d_%2d",
+			&year, &mon, &day, &hour, &min, &sec) != 6)
+		return 0;
+	GDateTime *date = g_date_time_new_utc(year, mon, day, hour, min, sec);
+	if (!date)
+		return 0;
+	time_t time = g_date_time_to_unix(date);
+	g_date_time_unref(date);
+	return time;
+}
+
+/* Adds the names of product in hour (or all cached ones if hour is NULL) to table */
+static gint _list_product(AWeatherDownload *download, const gchar *prefix, const gchar *url,
+		const gchar *site, const gchar *product, GDateTime *hour, GCancellable *cancellable,
+		GHashTable *table)
+{
+	gchar *filter = g_strdup_printf("^%s_%s_\\d{4}_\\d{2}_\\d{2}_\\d{2}_\\d{2}_\\d{2}$",
+			site+1, product);
+	gchar *index  = NULL;
+	if (hour) {
+		gchar *start = g_date_time_format(hour, "%Y_%m_%d_%H");
+		index = g_strdup_printf("%s/?prefix=%s_%s_%s", url, site+1, product, start);
+		g_free(start);
+	}
+	GList *files = aweather_download_available(download, prefix, filter, site,
+			"<Key>([^<]*)</Key>", index, AWEATHER_DOWNLOAD_BACKGROUND, cancellable, NULL);
+	gint found = 0;
+	for (GList *cur = files; cur; cur = cur->next) {
+		/* Cached products of other hours are listed as well */
+		time_t time = _product_time(cur->data);
+		if (hour && (time < g_date_time_to_unix(hour) ||
+		             time >= g_date_time_to_unix(hour) + 60*60)) {
+			g_free(cur->data);
+			continue;
+		}
+		if (!g_hash_table_contains(table, cur->data))
+			found++;
+		g_hash_table_add(table, cur->data);
+	}
+	g_list_free(files);
+	g_free(filter);
+	g_free(index);
+	return found;
+}
+
+static gint _compare_scans(gconstpointer _a, gconstpointer _b)
+{
+	const AWeatherLevel3Scan *a = _a, *b = _b;
+	return (b->time > a->time) - (b->time < a->time);
+}
+
+/* Pairs each reflectivity product with the velocity product of the same scan */
+static GList *_pair_products(GHashTable *refl, GHashTable *vel)
+{
+	GList *scans = NULL;
+	GList *vels  = g_hash_table_get_keys(vel);
+	GHashTableIter iter;
+	gpointer name;
+	g_hash_table_iter_init(&iter, refl);
+	while (g_hash_table_iter_next(&iter, &name, NULL)) {
+		AWeatherLevel3Scan *scan = g_new0(AWeatherLevel3Scan, 1);
+		scan->time         = _product_time(name);
+		scan->reflectivity = g_strdup(name);
+		time_t skew = MAX_SCAN_SKEW + 1;
+		for (GList *cur = vels; cur; cur = cur->next) {
+			time_t diff = ABS(_product_time(cur->data) - scan->time);
+			if (diff < skew) {
+				g_free(scan->velocity);
+				scan->velocity = g_strdup(cur->data);
+				skew = diff;
+			}
+		}
+		scans = g_list_prepend(scans, scan);
+	}
+	g_list_free(vels);
+	return g_list_sort(scans, _compare_scans);
+}
+
+GList *aweather_level3_scans_list(AWeatherDownload *download, const gchar *prefix,
+		const gchar *url, const gchar *site, time_t time, gint count, gboolean offline,
+		GCancellable *cancellable)
+{
+	g_debug("AWeatherLevel3: scans_list - %s", site);
+	GHashTable *refl = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GHashTable *vel  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	if (offline) {
+		for (gint p = 0; p < G_N_ELEMENTS(names); p++) {
+			_list_product(download, prefix, url, site, names[p][0], NULL, NULL, refl);
+			_list_product(download, prefix, url, site, names[p][1], NULL, NULL, vel);
+		}
+	} else {
+		/* Listing an hour at a time keeps the index small */
+		GDateTime *date = g_date_time_new_from_unix_utc(time);
+		GDateTime *hour = g_date_time_add_full(date, 0, 0, 0, 0,
+				-g_date_time_get_minute(date), -g_date_time_get_seconds(date));
+		gint before = 0;
+		for (gint h = 0; h < MAX_HOURS && before < count &&
+				!g_cancellable_is_cancelled(cancellable); h++) {
+			for (gint p = 0; p < G_N_ELEMENTS(names); p++) {
+				gint found = _list_product(download, prefix, url, site,
+						names[p][0], hour, cancellable, refl);
+				if (found == 0)
+					continue;
+				_list_product(download, prefix, url, site,
+						names[p][1], hour, cancellable, vel);
+				before += found;
+				break;
+			}
+			GDateTime *prev = g_date_time_add_hours(hour, -1);
+			g_date_time_unref(hour);
+			hour = prev;
+		}
+		g_date_time_unref(hour);
+		g_date_time_unref(date);
+	}
+
+	GList *scans = _pair_products(refl, vel);
+	g_hash_table_destroy(refl);
+	g_hash_table_destroy(vel);
+	g_debug("AWeatherLevel3: scans_list - %s - %d scans", site, g_list_length(scans));
+	return scans;
+}
+
+static void _scan_free(AWeatherLevel3Scan *scan)
+{
+	g_free(scan->reflectivity);
+	g_free(scan->velocity);
+	g_free(scan);
+}
+
+void aweather_level3_scans_free(GList *scans)
+{
+	g_list_free_full(scans, (GDestroyNotify)_scan_free);
+}
+
+GList *aweather_level3_scans_nearest(GList *scans, time_t time)
+{
+	GList *nearest = NULL;
+	time_t delta   = 0;
+	for (GList *cur = scans; cur; cur = cur->next) {
+		AWeatherLevel3Scan *scan = cur->data;
+		time_t diff = ABS(scan->time - time);
+		if (!nearest || diff < delta) {
+			nearest = cur;
+			delta   = diff;
+		}
+	}
+	return nearest;
+}
+
+
+/************
+ * Fetching *
+ ************/
+static gchar *_fetch_product(AWeatherDownload *download, const gchar *prefix,
+		const gchar *url, const gchar *site, const gchar *name, gboolean offline,
+		AWeatherDownloadPriority priority, GritsChunkCallback callback, gpointer user_data,
+		GCancellable *cancellable)
+{
+	gchar *local = g_strconcat(site, "/", name, NULL);
+	gchar *uri   = g_strconcat(url, "/", name, NULL);
+	/* Products never change once they are listed */
+	gchar *file  = aweather_download_fetch(download, prefix, uri, local,
+			offline ? GRITS_LOCAL : GRITS_ONCE, priority, callback, user_data, cancellable);
+	g_free(local);
+	g_free(uri);
+	return file;
+}
+
+AWeatherLevel2 *aweather_level3_fetch(AWeatherDownload *download, const gchar *prefix,
+		const gchar *url, const gchar *site, AWeatherLevel3Scan *scan, AWeatherColormap *colormap,
+		gboolean offline, AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable, gchar **file)
+{
+	g_debug("AWeatherLevel3: fetch - %s", scan->reflectivity);
+	const gchar *files[3] = {};
+	files[0] = _fetch_product(download, prefix, url, site, scan->reflectivity,
+			offline, priority, callback, user_data, cancellable);
+	if (files[0] && scan->velocity && !g_cancellable_is_cancelled(cancellable))
+		files[1] = _fetch_product(download, prefix, url, site, scan->velocity,
+				offline, priority, callback, user_data, cancellable);
+
+	AWeatherLevel2 *level2 = NULL;
+	if (files[0] && !g_cancellable_is_cancelled(cancellable))
+		level2 = aweather_level3_new_from_files(files, site, colormap);
+
+	if (file)
+		*file = g_strdup(files[0]);
+	g_free((gchar*)files[0]);
+	g_free((gchar*)files[1]);
+	return level2;
+}
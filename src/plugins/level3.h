@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_LEVEL3_H__
+#define __AWEATHER_LEVEL3_H__
+
+#include <time.h>
+#include <gio/gio.h>
+#include <grits.h>
+
+#include "level2.h"
+#include "../aweather-download.h"
+
+/* NEXRAD Level III products are single sweeps of one moment, tens of KB each instead of the
+ * 10-20 MB of a Level II volume. A scan is the lowest tilt reflectivity and velocity products
+ * of one volume scan, decoded into the same Radar structure AWeatherLevel2 draws.
+ *
+ * Products are listed from and fetched below url (the Unidata Level III bucket layout,
+ * names look like LSX_N0B_2024_05_10_03_23_00) and cached next to the site's Level II volumes. */
+typedef struct {
+	time_t  time;
+	gchar  *reflectivity; // Product names, velocity may be NULL
+	gchar  *velocity;
+} AWeatherLevel3Scan;
+
+/* Lists the scans of site (the 4 letter id) in the hour of time and the hours before it,
+ * until count scans at or before time are found. Cached products are found below prefix and
+ * the listings are fetched through download in the background, until cancellable (which may be
+ * NULL) is cancelled. Returns a list of AWeatherLevel3Scan, newest first. Free it with
+ * aweather_level3_scans_free. */
+GList *aweather_level3_scans_list(AWeatherDownload *download, const gchar *prefix,
+		const gchar *url, const gchar *site, time_t time, gint count, gboolean offline,
+		GCancellable *cancellable);
+
+void aweather_level3_scans_free(GList *scans);
+
+/* Returns the link of the scan closest to time, or NULL if there are none */
+GList *aweather_level3_scans_nearest(GList *scans, time_t time);
+
+/* Fetches the products of scan through download, at priority and cached below prefix, and decodes them
+ * into one radar. Returns NULL if fetching or decoding fails or cancellable (which may be NULL) is cancelled.
+ * If file is not NULL, it is set to the path of the cached reflectivity product, which can be passed to the
+ * level2 spill file functions. */
+AWeatherLevel2 *aweather_level3_fetch(AWeatherDownload *download, const gchar *prefix,
+		const gchar *url, const gchar *site, AWeatherLevel3Scan *scan, AWeatherColormap *colormap,
+		gboolean offline, AWeatherDownloadPriority priority, GritsChunkCallback callback,
+		gpointer user_data, GCancellable *cancellable, gchar **file);
+
+/* Decodes Level III product files into one radar, one volume per moment. Files that cannot be read
+ * are skipped. Returns NULL if none of them could be read. */
+AWeatherLevel2 *aweather_level3_new_from_files(const gchar **files, const gchar *site,
+		AWeatherColormap *colormap);
+
+#endif
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <math.h>
+#include <gtk/gtk.h>
+#include <grits.h>
+
+#include "markers.h"
+
+#include "../compat.h"
+
+/* A cluster is split once its children are further apart than this fraction of the distance to the eye */
+#define MARKERS_EXPAND      0.06
+
+/* Half size of the dot in pixels, clusters get a bigger one */
+#define MARKERS_DOT_SIZE(node) ((node)->count > 1 ? 5 : 3)
+
+/* Glyph texture, printable ASCII in a grid of equal cells */
+#define MARKERS_FONT        "Sans"
+#define MARKERS_FONT_SIZE   12
+#define MARKERS_GLYPH_FIRST 32
+#define MARKERS_GLYPH_LAST  126
+#define MARKERS_GLYPH_COLS  16
+#define MARKERS_GLYPH_PAD   2   // Room for the outline around each glyph
+
+typedef struct _MarkerNode MarkerNode;
+
+/* A node in the cluster tree, leaves are single sites */
+struct _MarkerNode {
+	city_t     *city;         // The site, or the most important site in a cluster
+	MarkerNode *child[2];     // NULL for leaves
+	gint        count;        // Sites in the cluster
+	gdouble     xyz[3];       // Centroid
+	GritsPoint  pos;          // Centroid
+	gdouble     spread;       // Distance between the children's centroids, 0 for leaves
+	gchar      *label;
+};
+
+/* Screen area of a drawn marker, for clicks */
+typedef struct {
+	gdouble     x0, y0, x1, y1;
+	gdouble     px, py;       // Projected position, GL window coordinates
+	MarkerNode *node;
+} MarkerHit;
+
+struct _RadarMarkers {
+	GritsViewer        *viewer;
+	GritsCallback      *callback;
+	RadarMarkersClicked clicked;
+	gpointer            data;
+
+	MarkerNode         *root;
+	GPtrArray          *nodes;    // Every node, for freeing
+
+	/* Glyph texture, drawn with cairo at startup and uploaded on the first draw */
+	guchar             *glyphs;
+	gint                glyphs_width, glyphs_height;
+	gint                cell_width, cell_height;
+	gdouble             ascent;
+	gdouble             advance[MARKERS_GLYPH_LAST-MARKERS_GLYPH_FIRST+1];
+	guint               tex;
+
+	GArray             *hits;     // MarkerHits from the last draw
+	gboolean            hover;    // The cursor is over a marker
+	guint               press_id;
+	guint               motion_id;
+};
+
+
+/***********
+ * Helpers *
+ ***********/
+static MarkerNode *_marker_node_new(RadarMarkers *markers)
+{
+	MarkerNode *node = g_new0(MarkerNode, 1);
+	g_ptr_array_add(markers->nodes, node);
+	return node;
+}
+
+/* Agglomerative clustering, the two closest clusters are merged until one is left.
+ * Quadratic per merge, with a couple hundred sites this only takes a moment at startup. */
+static MarkerNode *_markers_cluster(RadarMarkers *markers, city_t *cities)
+{
+	GPtrArray *active = g_ptr_array_new();
+	for (city_t *city = cities; city->type; city++) {
+		if (city->type != LOCATION_CITY)
+			continue;
+		MarkerNode *node = _marker_node_new(markers);
+		node->city  = city;
+		node->count = 1;
+		node->pos   = city->pos;
+		node->label = g_strdup(city->name);
+		lle2xyz(city->pos.lat, city->pos.lon, city->pos.elev,
+				&node->xyz[0], &node->xyz[1], &node->xyz[2]);
+		g_ptr_array_add(active, node);
+	}
+
+	while (active->len > 1) {
+		guint   best_a = 0, best_b = 1;
+		gdouble best   = G_MAXDOUBLE;
+		for (guint a = 0; a < active->len; a++)
+		for (guint b = a+1; b < active->len; b++) {
+			MarkerNode *na = g_ptr_array_index(active, a);
+			MarkerNode *nb = g_ptr_array_index(active, b);
+			gdouble dist = distd(na->xyz, nb->xyz);
+			if (dist < best) {
+				best   = dist;
+				best_a = a;
+				best_b = b;
+			}
+		}
+
+		MarkerNode *a    = g_ptr_array_index(active, best_a);
+		MarkerNode *b    = g_ptr_array_index(active, best_b);
+		MarkerNode *node = _marker_node_new(markers);
+		node->child[0] = a;
+		node->child[1] = b;
+		node->count    = a->count + b->count;
+		node->spread   = best;
+		node->city     = a->city->lod >= b->city->lod ? a->city : b->city;
+		for (int i = 0; i < 3; i++)
+			node->xyz[i] = (a->xyz[i]*a->count + b->xyz[i]*b->count) / node->count;
+		xyz2lle(node->xyz[0], node->xyz[1], node->xyz[2],
+				&node->pos.lat, &node->pos.lon, &node->pos.elev);
+		node->pos.elev = 0;
+		lle2xyz(node->pos.lat, node->pos.lon, 0,
+				&node->xyz[0], &node->xyz[1], &node->xyz[2]);
+		node->label = g_strdup_printf("%s +%d", node->city->name, node->count-1);
+
+		/* Remove the higher index first so the lower one stays valid */
+		g_ptr_array_remove_index_fast(active, best_b);
+		g_ptr_array_remove_index_fast(active, best_a);
+		g_ptr_array_add(active, node);
+	}
+
+	MarkerNode *root = active->len ? g_ptr_array_index(active, 0) : NULL;
+	g_ptr_array_free(active, TRUE);
+	return root;
+}
+
+/* Renders white glyphs with a black outline, like GritsMarker labels */
+static void _markers_render_glyphs(RadarMarkers *markers)
+{
+	cairo_surface_t *dummy = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+	cairo_t *cairo = cairo_create(dummy);
+	cairo_select_font_face(cairo, MARKERS_FONT,
+			CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+	cairo_set_font_size(cairo, MARKERS_FONT_SIZE);
+	cairo_font_extents_t font;
+	cairo_font_extents(cairo, &font);
+	cairo_destroy(cairo);
+	cairo_surface_destroy(dummy);
+
+	gint nglyphs = MARKERS_GLYPH_LAST - MARKERS_GLYPH_FIRST + 1;
+	gint rows    = (nglyphs + MARKERS_GLYPH_COLS - 1) / MARKERS_GLYPH_COLS;
+	markers->ascent        = font.ascent;
+	markers->cell_width    = ceil(font.max_x_advance) + 2*MARKERS_GLYPH_PAD;
+	markers->cell_height   = ceil(font.ascent + font.descent) + 2*MARKERS_GLYPH_PAD;
+	markers->glyphs_width  = markers->cell_width  * MARKERS_GLYPH_COLS;
+	markers->glyphs_height = markers->cell_height * rows;
+
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			markers->glyphs_width, markers->glyphs_height);
+	cairo = cairo_create(surface);
+	cairo_select_font_face(cairo, MARKERS_FONT,
+			CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+	cairo_set_font_size(cairo, MARKERS_FONT_SIZE);
+	cairo_set_line_width(cairo, 2);
+	for (gint i = 0; i < nglyphs; i++) {
+		gchar text[2] = {MARKERS_GLYPH_FIRST + i, '\0'};
+		cairo_text_extents_t extents;
+		cairo_text_extents(cairo, text, &extents);
+		markers->advance[i] = extents.x_advance;
+		cairo_move_to(cairo,
+				(i % MARKERS_GLYPH_COLS) * markers->cell_width  + MARKERS_GLYPH_PAD,
+				(i / MARKERS_GLYPH_COLS) * markers->cell_height + MARKERS_GLYPH_PAD + font.ascent);
+		cairo_text_path(cairo, text);
+		cairo_set_source_rgba(cairo, 0, 0, 0, 1);
+		cairo_stroke_preserve(cairo);
+		cairo_set_source_rgba(cairo, 1, 1, 1, 1);
+		cairo_fill(cairo);
+	}
+	cairo_destroy(cairo);
+	cairo_surface_flush(surface);
+
+	/* Cairo rows may be padded, keep a tightly packed copy */
+	gint    stride = cairo_image_surface_get_stride(surface);
+	guchar *data   = cairo_image_surface_get_data(surface);
+	markers->glyphs = g_malloc(markers->glyphs_width * markers->glyphs_height * 4);
+	for (gint y = 0; y < markers->glyphs_height; y++)
+		memcpy(&markers->glyphs[y * markers->glyphs_width * 4],
+				&data[y * stride], markers->glyphs_width * 4);
+	cairo_surface_destroy(surface);
+}
+
+static gint _markers_glyph(gchar c)
+{
+	if (c < MARKERS_GLYPH_FIRST || c > MARKERS_GLYPH_LAST)
+		c = '?';
+	return c - MARKERS_GLYPH_FIRST;
+}
+
+static gdouble _markers_text_width(RadarMarkers *markers, const gchar *text)
+{
+	gdouble width = 0;
+	for (const gchar *c = text; *c; c++)
+		width += markers->advance[_markers_glyph(*c)];
+	return width;
+}
+
+/* Picks the nodes to draw: clusters that look small from the eye are drawn as one marker */
+static void _markers_collect(RadarMarkers *markers, MarkerNode *node,
+		const gdouble eye[3], gdouble horizon, GPtrArray *shown)
+{
+	gdouble dist = distd(node->xyz, eye);
+	if (node->child[0] && node->spread > MARKERS_EXPAND*dist) {
+		_markers_collect(markers, node->child[0], eye, horizon, shown);
+		_markers_collect(markers, node->child[1], eye, horizon, shown);
+		return;
+	}
+	if (dist <= horizon)
+		g_ptr_array_add(shown, node);
+}
+
+
+/*************
+ * Callbacks *
+ *************/
+static void _markers_draw(GritsCallback *callback, GritsOpenGL *opengl, gpointer _markers)
+{
+	RadarMarkers *markers = _markers;
+	GtkWidget    *widget  = GTK_WIDGET(opengl);
+	gint          width   = gtk_widget_get_allocated_width(widget);
+	gint          height  = gtk_widget_get_allocated_height(widget);
+	g_array_set_size(markers->hits, 0);
+	if (!markers->root)
+		return;
+
+	/* Nodes to draw */
+	gdouble lat, lon, elev, eye[3];
+	grits_viewer_get_location(markers->viewer, &lat, &lon, &elev);
+	lle2xyz(lat, lon, elev, &eye[0], &eye[1], &eye[2]);
+	gdouble    horizon = sqrt((EARTH_R+elev)*(EARTH_R+elev) - EARTH_R*EARTH_R);
+	GPtrArray *shown   = g_ptr_array_new();
+	_markers_collect(markers, markers->root, eye, horizon, shown);
+
+	/* Setup OpenGL */
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+	glMatrixMode(GL_PROJECTION); glLoadIdentity();
+	glOrtho(0, width, 0, height, -1, 1);
+	glMatrixMode(GL_MODELVIEW ); glLoadIdentity();
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_ALPHA_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glEnable(GL_COLOR_MATERIAL);
+
+	/* Dots, one batch */
+	glDisable(GL_TEXTURE_2D);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBegin(GL_QUADS);
+	for (guint i = 0; i < shown->len; i++) {
+		MarkerNode *node = g_ptr_array_index(shown, i);
+		gdouble px, py, pz;
+		grits_viewer_project(markers->viewer, node->pos.lat, node->pos.lon,
+				node->pos.elev, &px, &py, &pz);
+		if (pz > 1 || px < -width || px > 2*width || py < -height || py > 2*height)
+			continue;
+		gdouble size = MARKERS_DOT_SIZE(node);
+		for (int outline = 1; outline >= 0; outline--) {
+			gdouble s = size + outline;
+			glColor4f(!outline, !outline, !outline, 1);
+			glVertex2d(px-s, py-s);
+			glVertex2d(px+s, py-s);
+			glVertex2d(px+s, py+s);
+			glVertex2d(px-s, py+s);
+		}
+		MarkerHit hit = {px-size-1, py - markers->cell_height/2.0,
+			px + size + 4 + _markers_text_width(markers, node->label),
+			py + markers->cell_height/2.0, px, py, node};
+		g_array_append_val(markers->hits, hit);
+	}
+	glEnd();
+
+	/* Labels, one batch from the glyph texture */
+	if (!markers->tex) {
+		glGenTextures(1, &markers->tex);
+		glBindTexture(GL_TEXTURE_2D, markers->tex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, markers->glyphs_width, markers->glyphs_height, 0,
+				GL_BGRA, GL_UNSIGNED_BYTE, markers->glyphs);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, markers->tex);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // Cairo alpha is premultiplied
+	glColor4f(1, 1, 1, 1);
+	glBegin(GL_QUADS);
+	gdouble cw = markers->cell_width, ch = markers->cell_height;
+	for (guint i = 0; i < markers->hits->len; i++) {
+		MarkerHit *hit = &g_array_index(markers->hits, MarkerHit, i);
+		/* Right of the dot, roughly centered on it. Snapped to pixels so the glyphs stay sharp */
+		gdouble x   = floor(hit->px + MARKERS_DOT_SIZE(hit->node) + 4) - MARKERS_GLYPH_PAD;
+		gdouble top = floor(hit->py - markers->ascent*0.4) + markers->ascent + MARKERS_GLYPH_PAD;
+		for (const gchar *c = hit->node->label; *c; c++) {
+			gint    glyph = _markers_glyph(*c);
+			gdouble s0 = (glyph % MARKERS_GLYPH_COLS) * cw / markers->glyphs_width;
+			gdouble t0 = (glyph / MARKERS_GLYPH_COLS) * ch / markers->glyphs_height;
+			gdouble s1 = s0 + cw / markers->glyphs_width;
+			gdouble t1 = t0 + ch / markers->glyphs_height;
+			glTexCoord2d(s0, t1); glVertex2d(x,    top-ch);
+			glTexCoord2d(s1, t1); glVertex2d(x+cw, top-ch);
+			glTexCoord2d(s1, t0); glVertex2d(x+cw, top);
+			glTexCoord2d(s0, t0); glVertex2d(x,    top);
+			x += markers->advance[glyph];
+		}
+	}
+	glEnd();
+	glPopAttrib();
+
+	g_ptr_array_free(shown, TRUE);
+}
+
+/* Returns the marker under a point in window coordinates */
+static MarkerHit *_markers_hit(RadarMarkers *markers, gdouble x, gdouble y)
+{
+	/* Events have y going down, GL has it going up */
+	y = gtk_widget_get_allocated_height(GTK_WIDGET(markers->viewer)) - y;
+	for (gint i = markers->hits->len-1; i >= 0; i--) {
+		MarkerHit *hit = &g_array_index(markers->hits, MarkerHit, i);
+		if (hit->x0 <= x && x <= hit->x1 && hit->y0 <= y && y <= hit->y1)
+			return hit;
+	}
+	return NULL;
+}
+
+static gboolean _markers_on_press(GtkWidget *widget, GdkEventButton *event,
+		RadarMarkers *markers)
+{
+	if (event->type != GDK_BUTTON_PRESS || event->button != 1)
+		return FALSE;
+	MarkerHit *hit = _markers_hit(markers, event->x, event->y);
+	if (!hit)
+		return FALSE;
+
+	MarkerNode *node = hit->node;
+	if (node->child[0]) {
+		/* Zoom in far enough for the cluster to split */
+		gdouble elev = MAX(node->spread / MARKERS_EXPAND / 2, EARTH_R/35);
+		grits_viewer_set_location(markers->viewer,
+				node->pos.lat, node->pos.lon, elev);
+	} else {
+		markers->clicked(node->city, markers->data);
+	}
+	return TRUE;
+}
+
+static gboolean _markers_on_motion(GtkWidget *widget, GdkEventMotion *event,
+		RadarMarkers *markers)
+{
+	gboolean hover = _markers_hit(markers, event->x, event->y) != NULL;
+	if (hover != markers->hover) {
+		GdkCursor *cursor = hover ? gdk_cursor_new(GDK_HAND2) : NULL;
+		gdk_window_set_cursor(gtk_widget_get_window(widget), cursor);
+		if (cursor)
+			g_object_unref(cursor);
+		markers->hover = hover;
+	}
+	return FALSE;
+}
+
+
+/***********
+ * Methods *
+ ***********/
+RadarMarkers *radar_markers_new(GritsViewer *viewer, city_t *cities,
+		RadarMarkersClicked clicked, gpointer data)
+{
+	RadarMarkers *markers = g_new0(RadarMarkers, 1);
+	markers->viewer  = g_object_ref(viewer);
+	markers->clicked = clicked;
+	markers->data    = data;
+	markers->nodes   = g_ptr_array_new();
+	markers->hits    = g_array_new(FALSE, FALSE, sizeof(MarkerHit));
+	markers->root    = _markers_cluster(markers, cities);
+	_markers_render_glyphs(markers);
+
+	markers->callback = grits_callback_new(_markers_draw, markers);
+	grits_viewer_add(viewer, GRITS_OBJECT(markers->callback),
+			GRITS_LEVEL_HUD, FALSE);
+	markers->press_id = g_signal_connect(viewer, "button-press-event",
+			G_CALLBACK(_markers_on_press), markers);
+	markers->motion_id = g_signal_connect(viewer, "motion-notify-event",
+			G_CALLBACK(_markers_on_motion), markers);
+	return markers;
+}
+
+void radar_markers_free(RadarMarkers *markers)
+{
+	g_signal_handler_disconnect(markers->viewer, markers->press_id);
+	g_signal_handler_disconnect(markers->viewer, markers->motion_id);
+	grits_object_destroy_pointer(&markers->callback);
+	if (markers->tex)
+		glDeleteTextures(1, &markers->tex);
+
+	for (guint i = 0; i < markers->nodes->len; i++) {
+		MarkerNode *node = g_ptr_array_index(markers->nodes, i);
+		g_free(node->label);
+		g_free(node);
+	}
+	g_ptr_array_free(markers->nodes, TRUE);
+	g_array_free(markers->hits, TRUE);
+	g_free(markers->glyphs);
+	g_object_unref(markers->viewer);
+	g_free(markers);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RADAR_MARKERS_H__
+#define __RADAR_MARKERS_H__
+
+#include <gtk/gtk.h>
+#include <grits.h>
+
+#include "../aweather-location.h"
+
+/* Map markers for all radar sites, drawn as a single HUD object.
+ * Sites are clustered once at startup, nearby sites are shown as one marker until the eye is close enough to tell them apart.
+ * All labels are drawn from one glyph texture in a single batch. */
+typedef struct _RadarMarkers RadarMarkers;
+
+/* Called when the marker of a single site is clicked */
+typedef void (*RadarMarkersClicked)(city_t *city, gpointer data);
+
+RadarMarkers *radar_markers_new(GritsViewer *viewer, city_t *cities,
+		RadarMarkersClicked clicked, gpointer data);
+
+void radar_markers_free(RadarMarkers *markers);
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "mirrors.h"
+
+#define MIRRORS_SMOOTHING     0.3                  // Weight of a new measurement
+#define MIRRORS_VOLUME_BYTES  (15*1024*1024)       // Typical Level II volume, for weighing throughput against latency
+#define MIRRORS_MIN_BYTES     (256*1024)           // Smaller transfers say more about latency than throughput
+#define MIRRORS_BACKOFF       (30*G_USEC_PER_SEC)  // Skipped this long after the first failure
+#define MIRRORS_BACKOFF_MAX   (30*60*G_USEC_PER_SEC)
+#define MIRRORS_PROBE         (10*60*G_USEC_PER_SEC) // Listings older than this are refreshed by the watch
+
+typedef struct {
+	time_t  newest;   // Scan time of the newest volume listed
+	gint64  checked;  // Monotonic time of the listing
+} RadarMirrorSite;
+
+typedef struct {
+	gdouble     latency;    // Smoothed listing time in us, 0 until listed
+	gdouble     throughput; // Smoothed bytes per second of volume transfers, 0 until known
+	gint        failures;   // In a row
+	gint64      retry;      // Monotonic time the mirror is tried again after failing
+	GHashTable *sites;      // Site code -> RadarMirrorSite
+} RadarMirror;
+
+struct _RadarMirrors {
+	GritsPrefs *prefs;
+	GMutex      mutex;
+	GHashTable *mirrors;    // Url -> RadarMirror, kept when a mirror is removed from the prefs
+};
+
+typedef struct {
+	const gchar *url;
+	gint         order;     // Position in the prefs
+	gboolean     healthy;
+	gboolean     lagging;   // Listing of the site is older than another mirror's
+	gdouble      cost;      // Expected us to list and fetch a volume
+} RadarMirrorRank;
+
+static void _mirror_free(RadarMirror *mirror)
+{
+	g_hash_table_destroy(mirror->sites);
+	g_free(mirror);
+}
+
+/* Called with the mutex held */
+static RadarMirror *_mirrors_get(RadarMirrors *mirrors, const gchar *url)
+{
+	RadarMirror *mirror = g_hash_table_lookup(mirrors->mirrors, url);
+	if (!mirror) {
+		mirror = g_new0(RadarMirror, 1);
+		mirror->sites = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, g_free);
+		g_hash_table_insert(mirrors->mirrors, g_strdup(url), mirror);
+	}
+	return mirror;
+}
+
+static gdouble _mirrors_smooth(gdouble old, gdouble now)
+{
+	return old ? old + (now - old) * MIRRORS_SMOOTHING : now;
+}
+
+/* Called with the mutex held */
+static void _mirrors_result(const gchar *url, RadarMirror *mirror, gboolean ok)
+{
+	if (ok) {
+		if (mirror->failures)
+			g_debug("RadarMirrors: result - %s is back", url);
+		mirror->failures = 0;
+		mirror->retry    = 0;
+		return;
+	}
+	mirror->failures++;
+	gint64 backoff = MIN((gint64)MIRRORS_BACKOFF << MIN(mirror->failures-1, 10),
+			MIRRORS_BACKOFF_MAX);
+	mirror->retry  = g_get_monotonic_time() + backoff;
+	g_debug("RadarMirrors: result - %s failed %d times, skipped for %ds", url,
+			mirror->failures, (gint)(backoff/G_USEC_PER_SEC));
+}
+
+/* nexrad_url first, then the extra mirrors, without repeats or trailing slashes */
+static gchar **_mirrors_urls(RadarMirrors *mirrors)
+{
+	gchar *primary = grits_prefs_get_string(mirrors->prefs, "aweather/nexrad_url", NULL);
+	gchar *extra   = grits_prefs_get_string(mirrors->prefs, "aweather/nexrad_mirrors", NULL);
+	gchar *all     = g_strjoin(" ", primary ?: "", extra ?: "", NULL);
+	gchar **split  = g_strsplit_set(all, " \t,;", -1);
+	GPtrArray *urls = g_ptr_array_new();
+	for (gchar **url = split; *url; url++) {
+		gsize len = strlen(*url);
+		while (len > 0 && (*url)[len-1] == '/')
+			(*url)[--len] = '\0';
+		if (len == 0)
+			continue;
+		gboolean found = FALSE;
+		for (guint i = 0; i < urls->len && !found; i++)
+			found = g_str_equal(urls->pdata[i], *url);
+		if (!found)
+			g_ptr_array_add(urls, g_strdup(*url));
+	}
+	g_ptr_array_add(urls, NULL);
+	g_strfreev(split);
+	g_free(all);
+	g_free(extra);
+	g_free(primary);
+	return (gchar**)g_ptr_array_free(urls, FALSE);
+}
+
+static gint _mirrors_compare(gconstpointer _a, gconstpointer _b)
+{
+	const RadarMirrorRank *a = _a, *b = _b;
+	if (a->healthy != b->healthy)
+		return a->healthy ? -1 : 1;
+	if (a->lagging != b->lagging)
+		return a->lagging ? 1 : -1;
+	if (a->cost != b->cost)
+		return a->cost < b->cost ? -1 : 1;
+	return a->order - b->order;
+}
+
+RadarMirrors *radar_mirrors_new(GritsPrefs *prefs)
+{
+	RadarMirrors *mirrors = g_new0(RadarMirrors, 1);
+	mirrors->prefs   = g_object_ref(prefs);
+	mirrors->mirrors = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)_mirror_free);
+	g_mutex_init(&mirrors->mutex);
+	return mirrors;
+}
+
+void radar_mirrors_free(RadarMirrors *mirrors)
+{
+	g_hash_table_destroy(mirrors->mirrors);
+	g_mutex_clear(&mirrors->mutex);
+	g_object_unref(mirrors->prefs);
+	g_free(mirrors);
+}
+
+gchar **radar_mirrors_rank(RadarMirrors *mirrors, const gchar *site, gint *healthy)
+{
+	gchar **urls  = _mirrors_urls(mirrors);
+	gint    count = g_strv_length(urls);
+	RadarMirrorRank *ranks = g_new0(RadarMirrorRank, count);
+	gint64 now    = g_get_monotonic_time();
+	time_t newest = 0;
+
+	g_mutex_lock(&mirrors->mutex);
+	for (gint i = 0; i < count; i++) {
+		RadarMirror     *mirror = _mirrors_get(mirrors, urls[i]);
+		RadarMirrorSite *known  = g_hash_table_lookup(mirror->sites, site);
+		ranks[i].url     = urls[i];
+		ranks[i].order   = i;
+		ranks[i].healthy = mirror->retry <= now;
+		/* Unmeasured mirrors cost nothing, so each one gets tried */
+		ranks[i].cost    = mirror->latency + (mirror->throughput ?
+				MIRRORS_VOLUME_BYTES / mirror->throughput * G_USEC_PER_SEC : 0);
+		if (known && ranks[i].healthy)
+			newest = MAX(newest, known->newest);
+	}
+	for (gint i = 0; i < count; i++) {
+		RadarMirror     *mirror = _mirrors_get(mirrors, urls[i]);
+		RadarMirrorSite *known  = g_hash_table_lookup(mirror->sites, site);
+		ranks[i].lagging = known && known->newest < newest;
+	}
+	g_mutex_unlock(&mirrors->mutex);
+
+	qsort(ranks, count, sizeof(RadarMirrorRank), _mirrors_compare);
+	gchar **ranked = g_new0(gchar*, count+1);
+	gint    good   = 0;
+	for (gint i = 0; i < count; i++) {
+		ranked[i] = g_strdup(ranks[i].url);
+		good += ranks[i].healthy;
+	}
+	g_free(ranks);
+	g_strfreev(urls);
+	if (healthy)
+		*healthy = good;
+	return ranked;
+}
+
+gboolean radar_mirrors_needs_probe(RadarMirrors *mirrors, const gchar *url, const gchar *site)
+{
+	g_mutex_lock(&mirrors->mutex);
+	RadarMirror     *mirror = _mirrors_get(mirrors, url);
+	RadarMirrorSite *known  = g_hash_table_lookup(mirror->sites, site);
+	gint64           now    = g_get_monotonic_time();
+	gboolean probe = mirror->retry <= now &&
+		(!known || known->checked + MIRRORS_PROBE <= now);
+	g_mutex_unlock(&mirrors->mutex);
+	return probe;
+}
+
+void radar_mirrors_listed(RadarMirrors *mirrors, const gchar *url, const gchar *site,
+		gboolean ok, time_t newest, gint64 us)
+{
+	g_debug("RadarMirrors: listed - %s %s in %dms, ok %d, newest %ld", url, site,
+			(gint)(us/1000), ok, (glong)newest);
+	g_mutex_lock(&mirrors->mutex);
+	RadarMirror *mirror = _mirrors_get(mirrors, url);
+	_mirrors_result(url, mirror, ok);
+	/* An empty listing is an answer too, the mirror just lags for this site */
+	if (ok) {
+		RadarMirrorSite *known = g_new0(RadarMirrorSite, 1);
+		known->newest  = newest;
+		known->checked = g_get_monotonic_time();
+		g_hash_table_insert(mirror->sites, g_strdup(site), known);
+		mirror->latency = _mirrors_smooth(mirror->latency, us);
+	}
+	g_mutex_unlock(&mirrors->mutex);
+}
+
+void radar_mirrors_fetched(RadarMirrors *mirrors, const gchar *url, gboolean ok,
+		gint64 bytes, gint64 us)
+{
+	g_mutex_lock(&mirrors->mutex);
+	RadarMirror *mirror = _mirrors_get(mirrors, url);
+	_mirrors_result(url, mirror, ok);
+	if (ok && bytes >= MIRRORS_MIN_BYTES && us > 0)
+		mirror->throughput = _mirrors_smooth(mirror->throughput,
+				(gdouble)bytes * G_USEC_PER_SEC / us);
+	g_mutex_unlock(&mirrors->mutex);
+}
+
+time_t radar_mirrors_volume_time(const gchar *name)
+{
+	gint year, mon, day, hour, min, sec;
+	if (strlen(name) < 5 || sscanf(name+5, "%4d%2d%2d_%2d%2d%2d",
+			&year, &mon, &day, &hour, &min, &sec) != 6)
+		return 0;
+	GDateTime *date = g_date_time_new_utc(year, mon, day, hour, min, sec);
+	if (!date)
+		return 0;
+	time_t time = g_date_time_to_unix(date);
+	g_date_time_unref(date);
+	return time;
+}
+
+GList *radar_mirrors_list(RadarMirrors *mirrors, AWeatherDownload *download, const gchar *prefix,
+		const gchar *code, gboolean offline, gboolean probe, GCancellable *cancellable, gchar **url)
+{
+	GList  *files   = NULL;
+	gchar **urls    = offline ? NULL : radar_mirrors_rank(mirrors, code, NULL);
+	*url = NULL;
+	for (gchar **mirror = urls; mirror && *mirror && !g_cancellable_is_cancelled(cancellable); mirror++) {
+		if (*url && !(probe && radar_mirrors_needs_probe(mirrors, *mirror, code)))
+			continue;
+		gchar *dir_list = g_strconcat(*mirror, "/", code, "/", "dir.list", NULL);
+		gint64 start    = g_get_monotonic_time();
+		gboolean ok;
+		GList *listed   = aweather_download_available(download, prefix,
+				"^\\w{4}_\\d{8}_\\d{6}.bz2$", NULL, "\\d+ (.*)", dir_list,
+				AWEATHER_DOWNLOAD_BACKGROUND, cancellable, &ok);
+		time_t newest   = 0;
+		for (GList *cur = listed; cur; cur = cur->next)
+			newest = MAX(newest, radar_mirrors_volume_time(cur->data));
+		/* A listing we gave up on says nothing about the mirror */
+		if (!g_cancellable_is_cancelled(cancellable))
+			radar_mirrors_listed(mirrors, *mirror, code, ok, newest,
+					g_get_monotonic_time() - start);
+		g_free(dir_list);
+		if (!*url && newest) {
+			*url  = g_strdup(*mirror);
+			files = listed;
+		} else {
+			g_list_free_full(listed, g_free);
+		}
+	}
+	g_strfreev(urls);
+
+	/* Volumes fetched before, from any mirror */
+	GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+	for (GList *cur = files; cur; cur = cur->next)
+		g_hash_table_add(seen, cur->data);
+	GList *cached = aweather_download_available(download, prefix,
+			"^\\w{4}_\\d{8}_\\d{6}.bz2$", code, NULL, NULL,
+			AWEATHER_DOWNLOAD_BACKGROUND, NULL, NULL);
+	for (GList *cur = cached; cur; cur = cur->next) {
+		if (g_hash_table_contains(seen, cur->data))
+			g_free(cur->data);
+		else
+			files = g_list_prepend(files, cur->data);
+	}
+	g_list_free(cached);
+	g_hash_table_destroy(seen);
+	return files;
+}
+
+gchar *radar_mirrors_fetch(RadarMirrors *mirrors, AWeatherDownload *download,
+		const gchar *prefix, const gchar *code, const gchar *url, const gchar *name,
+		GritsCacheType mode, AWeatherDownloadPriority priority,
+		GritsChunkCallback callback, gpointer user_data, GCancellable *cancellable)
+{
+	gchar *local = g_strconcat(code, "/", name, NULL);
+	gchar *file  = NULL;
+	if (!url) {
+		file = aweather_download_fetch(download, prefix,
+				NULL, local, GRITS_LOCAL, priority, NULL, NULL, NULL);
+		g_free(local);
+		return file;
+	}
+
+	gchar **urls = radar_mirrors_rank(mirrors, code, NULL);
+	for (gint i = -1; !file && (i < 0 || urls[i]); i++) {
+		const gchar *mirror = i < 0 ? url : urls[i];
+		if (i >= 0 && g_str_equal(mirror, url))
+			continue;
+		AWeatherDownloadStats result;
+		gchar *uri = g_strconcat(mirror, "/", local, NULL);
+		file = aweather_download_fetch_full(download, prefix,
+				uri, local, mode, priority, callback, user_data, cancellable, &result);
+		g_free(uri);
+		if (g_cancellable_is_cancelled(cancellable))
+			break;
+		/* Volumes never change, an old copy returned after a failure is as good as a new one */
+		if (result.requests)
+			radar_mirrors_fetched(mirrors, mirror, !result.failed,
+					result.bytes, result.transfer_us);
+	}
+	g_strfreev(urls);
+	g_free(local);
+	return file;
+}
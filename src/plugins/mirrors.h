@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RADAR_MIRRORS_H__
+#define __RADAR_MIRRORS_H__
+
+#include <time.h>
+#include <glib.h>
+#include <grits.h>
+
+#include "../aweather-download.h"
+
+/* Level II mirrors, aweather/nexrad_url followed by the ones in aweather/nexrad_mirrors (separated by
+ * spaces, commas or semicolons). They all serve the same tree: <url>/<SITE>/dir.list and <url>/<SITE>/<volume>.
+ *
+ * Every listing and volume fetch is reported back. Mirrors are ranked by whether their listing of a site
+ * is as new as the newest one seen, then by listing latency plus the time a volume takes at their
+ * throughput. Mirrors that fail are skipped for a while, twice as long each time they fail again.
+ * The prefs are read on every ranking, so edits to nexrad_url apply right away. Can be used from any thread. */
+typedef struct _RadarMirrors RadarMirrors;
+
+RadarMirrors *radar_mirrors_new(GritsPrefs *prefs);
+
+void radar_mirrors_free(RadarMirrors *mirrors);
+
+/* Returns the urls of the mirrors, best first for site, free with g_strfreev.
+ * Mirrors that are waiting to be tried again come last and are not counted in healthy. */
+gchar **radar_mirrors_rank(RadarMirrors *mirrors, const gchar *site, gint *healthy);
+
+/* Returns TRUE if site has not been listed on url for a while */
+gboolean radar_mirrors_needs_probe(RadarMirrors *mirrors, const gchar *url, const gchar *site);
+
+/* Records a listing of site that took us, ok is FALSE if it could not be fetched or parsed.
+ * newest is the scan time of its newest volume, 0 if the listing was empty */
+void radar_mirrors_listed(RadarMirrors *mirrors, const gchar *url, const gchar *site,
+		gboolean ok, time_t newest, gint64 us);
+
+/* Records a volume fetch of bytes that took us */
+void radar_mirrors_fetched(RadarMirrors *mirrors, const gchar *url, gboolean ok,
+		gint64 bytes, gint64 us);
+
+/* Scan time of a volume, names look like KLSX_20090510_032300.bz2, 0 if it does not parse */
+time_t radar_mirrors_volume_time(const gchar *name);
+
+/* Lists the Level II volumes of site code, the ones cached below prefix and those on the best mirror that
+ * answers. When probing, the other mirrors that have not listed the site for a while are listed too, to
+ * keep their ranking current. Listings are fetched through download in the background and stop when
+ * cancellable (which may be NULL) is cancelled. Sets url to the mirror that answered, NULL if none did
+ * or when offline. */
+GList *radar_mirrors_list(RadarMirrors *mirrors, AWeatherDownload *download, const gchar *prefix,
+		const gchar *code, gboolean offline, gboolean probe, GCancellable *cancellable, gchar **url);
+
+/* Fetches volume name of site code from url, and from the other mirrors in turn if that fails.
+ * Only the cache under prefix is used when url is NULL. */
+gchar *radar_mirrors_fetch(RadarMirrors *mirrors, AWeatherDownload *download,
+		const gchar *prefix, const gchar *code, const gchar *url, const gchar *name,
+		GritsCacheType mode, AWeatherDownloadPriority priority,
+		GritsChunkCallback callback, gpointer user_data, GCancellable *cancellable);
+
+#endif
@@ -0,0 +1,535 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <gtk/gtk.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "mosaic.h"
+
+#include "../compat.h"
+
+/* Grid covering the CONUS (and Puerto Rico), split into square tiles */
+#define MOSAIC_NORTH        53.0
+#define MOSAIC_WEST       -128.0
+#define MOSAIC_DEG_PER_CELL  0.02
+#define MOSAIC_TILE_CELLS    512
+#define MOSAIC_TILES_X       7
+#define MOSAIC_TILES_Y       4
+#define MOSAIC_WIDTH        (MOSAIC_TILES_X*MOSAIC_TILE_CELLS)
+#define MOSAIC_HEIGHT       (MOSAIC_TILES_Y*MOSAIC_TILE_CELLS)
+
+/* Rows per pool task */
+#define MOSAIC_BAND_ROWS     64
+
+/* Resolution of the azimuth to ray lookup table */
+#define MOSAIC_AZIMUTH_BINS  720
+
+#define MOSAIC_METERS_PER_DEG (EARTH_R*G_PI/180)
+
+/* A site's lowest reflectivity sweep, shared between the mosaic and running updates */
+typedef struct {
+	gchar          *code;
+	gdouble         lat, lon;
+	gdouble         coslat;
+	AWeatherLevel2 *level2;    // Reference held so the sweep stays around
+	Sweep          *sweep;
+	gdouble         range;     // Distance to the end of the furthest bin
+	gint            x0, y0, x1, y1; // Cells covered by the sweep, [x0,x1) [y0,y1)
+	gint16          rays[MOSAIC_AZIMUTH_BINS]; // Ray covering each azimuth bin, -1 for none
+	gint            refs;
+} MosaicSite;
+
+typedef struct _MosaicJob MosaicJob;
+
+typedef struct {
+	MosaicJob *job;
+	gint       y0, y1;
+} MosaicBand;
+
+/* One update of a region of the grid, split in bands of rows that run in parallel */
+struct _MosaicJob {
+	RadarMosaic    *mosaic;
+	MosaicSite    **sites;     // Sites that cover part of the region
+	gint            nsites;
+	gint            x0, y0, x1, y1;
+	gboolean        merge_max;
+	MosaicBand     *bands;
+	RadarPoolTask **tasks;
+	gint            nbands;
+	gint            bands_left;
+};
+
+struct _RadarMosaic {
+	GritsViewer      *viewer;
+	GritsPrefs       *prefs;
+	RadarPool        *pool;
+	GtkWidget        *config;
+	GtkWidget        *status;
+	gboolean          hidden;
+
+	GHashTable       *sites;   // city code -> MosaicSite
+	AWeatherColormap *colormap;
+	guint8           *pixels;  // MOSAIC_WIDTH*MOSAIC_HEIGHT RGBA cells, allocated by the first update
+	GritsTile        *tiles[MOSAIC_TILES_Y][MOSAIC_TILES_X];
+
+	/* Region that changed since the last update */
+	gboolean          dirty;
+	gint              x0, y0, x1, y1;
+
+	MosaicJob        *job;     // Update in progress, the last band queues _mosaic_update_end with it
+};
+
+
+/***************
+ * MosaicSites *
+ ***************/
+static MosaicSite *_mosaic_site_new(const gchar *code, gdouble lat, gdouble lon,
+		AWeatherLevel2 *level2)
+{
+	Volume *volume = level2->radar->v[DZ_INDEX];
+	if (!volume)
+		return NULL;
+
+	/* Lowest elevation */
+	Sweep *sweep = NULL;
+	for (int i = 0; i < volume->h.nsweeps; i++)
+		if (volume->sweep[i] && volume->sweep[i]->h.nrays > 0 &&
+		    (!sweep || volume->sweep[i]->h.elev < sweep->h.elev))
+			sweep = volume->sweep[i];
+	if (!sweep)
+		return NULL;
+
+	MosaicSite *site = g_new0(MosaicSite, 1);
+	site->code   = g_strdup(code);
+	site->lat    = lat;
+	site->lon    = lon;
+	site->coslat = cos(deg2rad(lat));
+	site->level2 = g_object_ref(level2);
+	site->sweep  = sweep;
+	site->refs   = 1;
+
+	/* Map azimuths to rays */
+	for (int i = 0; i < MOSAIC_AZIMUTH_BINS; i++)
+		site->rays[i] = -1;
+	for (int ri = 0; ri < sweep->h.nrays; ri++) {
+		Ray *ray = sweep->ray[ri];
+		if (!ray)
+			continue;
+		gdouble width = MAX(ray->h.beam_width, 360.0/MOSAIC_AZIMUTH_BINS);
+		gint first = floor((ray->h.azimuth - width/2) * MOSAIC_AZIMUTH_BINS/360);
+		gint last  = ceil ((ray->h.azimuth + width/2) * MOSAIC_AZIMUTH_BINS/360);
+		for (gint i = first; i < last; i++)
+			site->rays[(i + MOSAIC_AZIMUTH_BINS) % MOSAIC_AZIMUTH_BINS] = ri;
+		site->range = MAX(site->range, ray->h.range_bin1 +
+				(gdouble)ray->h.nbins * ray->h.gate_size);
+	}
+
+	/* Cells in range */
+	gdouble dlat = site->range / MOSAIC_METERS_PER_DEG;
+	gdouble dlon = dlat / MAX(site->coslat, 0.1);
+	site->x0 = floor((lon - dlon - MOSAIC_WEST ) / MOSAIC_DEG_PER_CELL);
+	site->x1 = ceil ((lon + dlon - MOSAIC_WEST ) / MOSAIC_DEG_PER_CELL);
+	site->y0 = floor((MOSAIC_NORTH - lat - dlat) / MOSAIC_DEG_PER_CELL);
+	site->y1 = ceil ((MOSAIC_NORTH - lat + dlat) / MOSAIC_DEG_PER_CELL);
+	site->x0 = CLAMP(site->x0, 0, MOSAIC_WIDTH);
+	site->x1 = CLAMP(site->x1, 0, MOSAIC_WIDTH);
+	site->y0 = CLAMP(site->y0, 0, MOSAIC_HEIGHT);
+	site->y1 = CLAMP(site->y1, 0, MOSAIC_HEIGHT);
+	return site;
+}
+
+static MosaicSite *_mosaic_site_ref(MosaicSite *site)
+{
+	site->refs++;
+	return site;
+}
+
+static void _mosaic_site_unref(MosaicSite *site)
+{
+	if (--site->refs > 0)
+		return;
+	g_object_unref(site->level2);
+	g_free(site->code);
+	g_free(site);
+}
+
+/* Looks up the reflectivity the site measured over the given point. Called from the workers */
+static gboolean _mosaic_site_sample(MosaicSite *site, gdouble lat, gdouble lon,
+		gfloat *value, gdouble *range)
+{
+	gdouble dy = (lat - site->lat) * MOSAIC_METERS_PER_DEG;
+	gdouble dx = (lon - site->lon) * MOSAIC_METERS_PER_DEG * site->coslat;
+	gdouble dist = sqrt(dx*dx + dy*dy);
+	if (dist > site->range)
+		return FALSE;
+
+	gdouble azimuth = atan2(dx, dy) * 180 / G_PI;
+	if (azimuth < 0)
+		azimuth += 360;
+	gint ri = site->rays[(gint)(azimuth * MOSAIC_AZIMUTH_BINS/360) % MOSAIC_AZIMUTH_BINS];
+	if (ri < 0)
+		return FALSE;
+
+	Ray *ray = site->sweep->ray[ri];
+	gint bi = (dist - ray->h.range_bin1) / ray->h.gate_size;
+	if (bi < 0 || bi >= ray->h.nbins)
+		return FALSE;
+
+	gfloat v = ray->h.f(ray->range[bi]);
+	if (v == BADVAL     || v == RFVAL      || v == APFLAG ||
+	    v == NOTFOUND_H || v == NOTFOUND_V || v == NOECHO)
+		return FALSE;
+
+	*value = v;
+	*range = dist;
+	return TRUE;
+}
+
+
+/***************
+ * Mosaic jobs *
+ ***************/
+static gboolean _mosaic_update_end(gpointer _job);
+
+/* Resamples the rows of one band. Each band owns its rows of mosaic->pixels */
+static void _mosaic_update_band(gpointer _band)
+{
+	MosaicBand  *band   = _band;
+	MosaicJob   *job    = band->job;
+	RadarMosaic *mosaic = job->mosaic;
+
+	for (gint y = band->y0; y < band->y1; y++) {
+		gdouble lat = MOSAIC_NORTH - (y + 0.5) * MOSAIC_DEG_PER_CELL;
+		for (gint x = job->x0; x < job->x1; x++) {
+			gdouble lon = MOSAIC_WEST + (x + 0.5) * MOSAIC_DEG_PER_CELL;
+			gboolean found = FALSE;
+			gfloat   best_value = 0;
+			gdouble  best_range = 0;
+			for (gint i = 0; i < job->nsites; i++) {
+				MosaicSite *site = job->sites[i];
+				if (x < site->x0 || x >= site->x1 ||
+				    y < site->y0 || y >= site->y1)
+					continue;
+				gfloat  value;
+				gdouble range;
+				if (!_mosaic_site_sample(site, lat, lon, &value, &range))
+					continue;
+				if (!found || (job->merge_max ? value > best_value
+				                              : range < best_range)) {
+					found      = TRUE;
+					best_value = value;
+					best_range = range;
+				}
+			}
+
+			guint8 *cell = &mosaic->pixels[(y*MOSAIC_WIDTH + x)*4];
+			if (found) {
+				guint8 *color = colormap_get(mosaic->colormap, best_value);
+				cell[0] = color[0];
+				cell[1] = color[1];
+				cell[2] = color[2];
+				cell[3] = color[3]*0.75;
+			} else {
+				cell[3] = 0x00; // transparent
+			}
+		}
+	}
+
+	/* The source is found again by its job, so nothing is written to the mosaic here */
+	if (g_atomic_int_dec_and_test(&job->bands_left))
+		g_idle_add(_mosaic_update_end, job);
+}
+
+static RadarPoolPriority _mosaic_update_priority(gpointer _band)
+{
+	MosaicBand *band = _band;
+	return band->job->mosaic->hidden ? RADAR_POOL_PRIORITY_BACKGROUND
+	                                 : RADAR_POOL_PRIORITY_VISIBLE;
+}
+
+/* Cancels bands that have not started and waits for the rest */
+static void _mosaic_job_finish(MosaicJob *job)
+{
+	for (gint i = 0; i < job->nbands; i++) {
+		if (job->tasks[i])
+			radar_pool_task_finish(job->mosaic->pool, job->tasks[i]);
+		job->tasks[i] = NULL;
+	}
+}
+
+static void _mosaic_job_free(MosaicJob *job)
+{
+	_mosaic_job_finish(job);
+	for (gint i = 0; i < job->nsites; i++)
+		_mosaic_site_unref(job->sites[i]);
+	g_free(job->sites);
+	g_free(job->bands);
+	g_free(job->tasks);
+	g_free(job);
+}
+
+static void _mosaic_update_tile(RadarMosaic *mosaic, gint tx, gint ty)
+{
+	GritsTile *tile = mosaic->tiles[ty][tx];
+	if (!tile->tex) {
+		glGenTextures(1, &tile->tex);
+		glBindTexture(GL_TEXTURE_2D, tile->tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, MOSAIC_TILE_CELLS, MOSAIC_TILE_CELLS, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		tile->coords.n = 0;
+		tile->coords.w = 0;
+		tile->coords.s = 1;
+		tile->coords.e = 1;
+	}
+	glBindTexture(GL_TEXTURE_2D, tile->tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, MOSAIC_WIDTH);
+	guint8 *pixels = &mosaic->pixels[(ty*MOSAIC_TILE_CELLS*MOSAIC_WIDTH +
+			tx*MOSAIC_TILE_CELLS)*4];
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0, MOSAIC_TILE_CELLS,MOSAIC_TILE_CELLS,
+			GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+static void _mosaic_update_status(RadarMosaic *mosaic)
+{
+	gchar *msg = g_strdup_printf("%d radar sites%s",
+			g_hash_table_size(mosaic->sites),
+			mosaic->job || mosaic->dirty ? ", updating..." : "");
+	gtk_label_set_text(GTK_LABEL(mosaic->status), msg);
+	g_free(msg);
+}
+
+static void _mosaic_update(RadarMosaic *mosaic)
+{
+	if (mosaic->job || !mosaic->dirty || mosaic->hidden)
+		return;
+
+	/* Most sessions never show the mosaic */
+	if (!mosaic->pixels)
+		mosaic->pixels = g_malloc0(MOSAIC_WIDTH*MOSAIC_HEIGHT*4);
+
+	MosaicJob *job = g_new0(MosaicJob, 1);
+	job->mosaic    = mosaic;
+	job->x0        = mosaic->x0;
+	job->y0        = mosaic->y0;
+	job->x1        = mosaic->x1;
+	job->y1        = mosaic->y1;
+	job->merge_max = grits_prefs_get_boolean(mosaic->prefs,
+			"aweather/mosaic_merge_max", NULL);
+	mosaic->dirty  = FALSE;
+
+	/* Only sites covering part of the region take part */
+	GHashTableIter iter;
+	MosaicSite *site;
+	job->sites = g_new0(MosaicSite*, g_hash_table_size(mosaic->sites));
+	g_hash_table_iter_init(&iter, mosaic->sites);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*)&site))
+		if (site->x0 < job->x1 && site->x1 > job->x0 &&
+		    site->y0 < job->y1 && site->y1 > job->y0)
+			job->sites[job->nsites++] = _mosaic_site_ref(site);
+
+	g_debug("RadarMosaic: update - %d,%d..%d,%d from %d sites",
+			job->x0, job->y0, job->x1, job->y1, job->nsites);
+
+	job->nbands     = (job->y1 - job->y0 + MOSAIC_BAND_ROWS - 1) / MOSAIC_BAND_ROWS;
+	job->bands_left = job->nbands;
+	job->bands      = g_new0(MosaicBand, job->nbands);
+	job->tasks      = g_new0(RadarPoolTask*, job->nbands);
+	mosaic->job     = job;
+	for (gint i = 0; i < job->nbands; i++) {
+		job->bands[i].job = job;
+		job->bands[i].y0  = job->y0 + i*MOSAIC_BAND_ROWS;
+		job->bands[i].y1  = MIN(job->bands[i].y0 + MOSAIC_BAND_ROWS, job->y1);
+		job->tasks[i] = radar_pool_push(mosaic->pool,
+				_mosaic_update_band, _mosaic_update_priority, &job->bands[i]);
+	}
+	_mosaic_update_status(mosaic);
+}
+
+/* Copies the updated region to graphics memory and starts the next update if more changes came in */
+static gboolean _mosaic_update_end(gpointer _job)
+{
+	MosaicJob   *job    = _job;
+	RadarMosaic *mosaic = job->mosaic;
+	mosaic->job = NULL;
+
+	for (gint ty = job->y0 / MOSAIC_TILE_CELLS; ty*MOSAIC_TILE_CELLS < job->y1; ty++)
+		for (gint tx = job->x0 / MOSAIC_TILE_CELLS; tx*MOSAIC_TILE_CELLS < job->x1; tx++)
+			_mosaic_update_tile(mosaic, tx, ty);
+	glFlush();
+	_mosaic_job_free(job);
+
+	grits_viewer_queue_draw(mosaic->viewer);
+	_mosaic_update(mosaic);
+	_mosaic_update_status(mosaic);
+	return FALSE;
+}
+
+static void _mosaic_mark_dirty(RadarMosaic *mosaic, gint x0, gint y0, gint x1, gint y1)
+{
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	if (mosaic->dirty) {
+		mosaic->x0 = MIN(mosaic->x0, x0);
+		mosaic->y0 = MIN(mosaic->y0, y0);
+		mosaic->x1 = MAX(mosaic->x1, x1);
+		mosaic->y1 = MAX(mosaic->y1, y1);
+	} else {
+		mosaic->x0 = x0;
+		mosaic->y0 = y0;
+		mosaic->x1 = x1;
+		mosaic->y1 = y1;
+	}
+	mosaic->dirty = TRUE;
+}
+
+static void _mosaic_mark_all_sites_dirty(RadarMosaic *mosaic)
+{
+	GHashTableIter iter;
+	MosaicSite *site;
+	g_hash_table_iter_init(&iter, mosaic->sites);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*)&site))
+		_mosaic_mark_dirty(mosaic, site->x0, site->y0, site->x1, site->y1);
+}
+
+static void _on_merge_max_toggled(GtkToggleButton *button, RadarMosaic *mosaic)
+{
+	grits_prefs_set_boolean(mosaic->prefs, "aweather/mosaic_merge_max",
+			gtk_toggle_button_get_active(button));
+	_mosaic_mark_all_sites_dirty(mosaic);
+	_mosaic_update(mosaic);
+	_mosaic_update_status(mosaic);
+}
+
+
+/***********
+ * Methods *
+ ***********/
+void radar_mosaic_set_site(RadarMosaic *mosaic, const gchar *code,
+		gdouble lat, gdouble lon, AWeatherLevel2 *level2)
+{
+	/* Redo the cells the old and the new sweep cover */
+	MosaicSite *old = g_hash_table_lookup(mosaic->sites, code);
+	if (old) {
+		_mosaic_mark_dirty(mosaic, old->x0, old->y0, old->x1, old->y1);
+		g_hash_table_remove(mosaic->sites, code);
+	}
+	MosaicSite *site = level2 ? _mosaic_site_new(code, lat, lon, level2) : NULL;
+	if (site) {
+		_mosaic_mark_dirty(mosaic, site->x0, site->y0, site->x1, site->y1);
+		g_hash_table_insert(mosaic->sites, site->code, site);
+	}
+	if (!old && !site)
+		return;
+	g_debug("RadarMosaic: set_site - %s", code);
+	_mosaic_update(mosaic);
+	_mosaic_update_status(mosaic);
+}
+
+void radar_mosaic_set_hidden(RadarMosaic *mosaic, gboolean hidden)
+{
+	mosaic->hidden = hidden;
+	for (gint ty = 0; ty < MOSAIC_TILES_Y; ty++)
+		for (gint tx = 0; tx < MOSAIC_TILES_X; tx++)
+			grits_object_hide(GRITS_OBJECT(mosaic->tiles[ty][tx]), hidden);
+	_mosaic_update(mosaic);
+}
+
+RadarMosaic *radar_mosaic_new(GtkWidget *pconfig, GritsViewer *viewer,
+		GritsPrefs *prefs, RadarPool *pool)
+{
+	RadarMosaic *mosaic = g_new0(RadarMosaic, 1);
+	mosaic->viewer = g_object_ref(viewer);
+	mosaic->prefs  = g_object_ref(prefs);
+	mosaic->pool   = pool;
+	mosaic->hidden = TRUE;
+	mosaic->sites  = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)_mosaic_site_unref);
+
+	for (int i = 0; colormaps[i].file; i++)
+		if (colormaps[i].type == DZ_INDEX)
+			mosaic->colormap = &colormaps[i];
+	if (!mosaic->colormap)
+		mosaic->colormap = &colormaps[0];
+
+	/* Tiles */
+	for (gint ty = 0; ty < MOSAIC_TILES_Y; ty++) {
+		for (gint tx = 0; tx < MOSAIC_TILES_X; tx++) {
+			gdouble size  = MOSAIC_TILE_CELLS*MOSAIC_DEG_PER_CELL;
+			gdouble north = MOSAIC_NORTH - ty*size;
+			gdouble west  = MOSAIC_WEST  + tx*size;
+			GritsTile *tile = grits_tile_new(NULL, north, north-size, west+size, west);
+			grits_object_hide(GRITS_OBJECT(tile), TRUE);
+			grits_viewer_add(viewer, GRITS_OBJECT(tile), GRITS_LEVEL_WORLD+2, FALSE);
+			mosaic->tiles[ty][tx] = tile;
+		}
+	}
+
+	/* Config */
+	GtkWidget *box  = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+	GtkWidget *info = gtk_label_new("Lowest reflectivity sweep of all loaded radar sites");
+	GtkWidget *near = gtk_radio_button_new_with_label(NULL, "Nearest radar");
+	GtkWidget *max  = gtk_radio_button_new_with_label_from_widget(
+			GTK_RADIO_BUTTON(near), "Maximum reflectivity");
+	mosaic->status  = gtk_label_new(NULL);
+	gtk_label_set_line_wrap(GTK_LABEL(info), TRUE);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(max), grits_prefs_get_boolean(
+			prefs, "aweather/mosaic_merge_max", NULL));
+	g_signal_connect(max, "toggled", G_CALLBACK(_on_merge_max_toggled), mosaic);
+	gtk_box_pack_start(GTK_BOX(box), info,           FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box), near,           FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box), max,            FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box), mosaic->status, FALSE, FALSE, 0);
+	_mosaic_update_status(mosaic);
+
+	mosaic->config = gtk_alignment_new(0, 0, 1, 1);
+	gtk_container_add(GTK_CONTAINER(mosaic->config), box);
+	g_object_set_data(G_OBJECT(mosaic->config), "mosaic", mosaic);
+	gtk_notebook_append_page(GTK_NOTEBOOK(pconfig), mosaic->config,
+			gtk_label_new("Mosaic"));
+	gtk_widget_show_all(mosaic->config);
+
+	return mosaic;
+}
+
+void radar_mosaic_free(RadarMosaic *mosaic)
+{
+	/* The last band queues _mosaic_update_end, so wait for the bands before removing it */
+	if (mosaic->job) {
+		_mosaic_job_finish(mosaic->job);
+		g_idle_remove_by_data(mosaic->job);
+		_mosaic_job_free(mosaic->job);
+	}
+
+	for (gint ty = 0; ty < MOSAIC_TILES_Y; ty++)
+		for (gint tx = 0; tx < MOSAIC_TILES_X; tx++)
+			grits_object_destroy_pointer(&mosaic->tiles[ty][tx]);
+
+	g_hash_table_destroy(mosaic->sites);
+	g_free(mosaic->pixels);
+	g_object_unref(mosaic->prefs);
+	g_object_unref(mosaic->viewer);
+	g_free(mosaic);
+}
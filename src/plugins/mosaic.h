@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RADAR_MOSAIC_H__
+#define __RADAR_MOSAIC_H__
+
+#include <gtk/gtk.h>
+#include <grits.h>
+
+#include "level2.h"
+#include "radar-pool.h"
+
+/* Reflectivity mosaic of all loaded radar sites.
+ * The lowest reflectivity sweep of each site is resampled onto a lat/lon grid covering the CONUS on the radar worker pool.
+ * Overlapping sites are merged by nearest radar or by maximum value. When a site changes, only the cells that site covers are redone.
+ */
+typedef struct _RadarMosaic RadarMosaic;
+
+RadarMosaic *radar_mosaic_new(GtkWidget *pconfig, GritsViewer *viewer,
+		GritsPrefs *prefs, RadarPool *pool);
+
+void radar_mosaic_free(RadarMosaic *mosaic);
+
+/* Sets the volume used for the given site, or removes the site if level2 is NULL.
+ * The mosaic keeps a reference to level2 until it is replaced. */
+void radar_mosaic_set_site(RadarMosaic *mosaic, const gchar *code,
+		gdouble lat, gdouble lon, AWeatherLevel2 *level2);
+
+/* The mosaic is only recomputed while it is shown */
+void radar_mosaic_set_hidden(RadarMosaic *mosaic, gboolean hidden);
+
+#endif
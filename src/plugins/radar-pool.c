@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include "radar-pool.h"
+
+typedef enum {
+	TASK_QUEUED,
+	TASK_RUNNING,
+	TASK_DONE,
+	TASK_CANCELLED,
+} RadarPoolTaskState;
+
+struct _RadarPoolTask {
+	RadarPoolFunc          func;
+	RadarPoolPriorityFunc  priority;
+	gpointer               data;
+	RadarPoolTaskState     state;
+	gboolean               background; // Counted in RadarPool.background while running
+	gint                   refs;       // One for the caller's handle, one while queued or running
+};
+
+struct _RadarPool {
+	GMutex     mutex;
+	GCond      cond;                   // Signaled when tasks are queued or finish
+	GQueue    *queue;                  // Queued tasks, oldest first
+	GThread  **threads;
+	gint       nthreads;
+	gint       background;             // Number of running tasks that are not for the visible site
+	gboolean   stopping;
+};
+
+/* Must be called with the pool locked */
+static void _radar_pool_task_unref(RadarPoolTask *task)
+{
+	if (--task->refs == 0)
+		g_free(task);
+}
+
+/* Returns the most urgent task that is allowed to run right now, or NULL. Must be called with the pool locked */
+static RadarPoolTask *_radar_pool_pop(RadarPool *pool)
+{
+	GList *best = NULL;
+	RadarPoolPriority best_priority = 0;
+	for (GList *cur = pool->queue->head; cur; cur = cur->next) {
+		RadarPoolTask *task = cur->data;
+		RadarPoolPriority priority = task->priority(task->data);
+		if (!best || priority < best_priority) {
+			best = cur;
+			best_priority = priority;
+		}
+		if (best_priority == RADAR_POOL_PRIORITY_VISIBLE)
+			break;
+	}
+	if (!best)
+		return NULL;
+
+	/* Keep one worker free for the visible site */
+	if (best_priority != RADAR_POOL_PRIORITY_VISIBLE &&
+	    pool->background >= pool->nthreads - 1)
+		return NULL;
+
+	RadarPoolTask *task = best->data;
+	g_queue_delete_link(pool->queue, best);
+	task->state      = TASK_RUNNING;
+	task->background = best_priority != RADAR_POOL_PRIORITY_VISIBLE;
+	if (task->background)
+		pool->background++;
+	return task;
+}
+
+static gpointer _radar_pool_worker(gpointer _pool)
+{
+	RadarPool *pool = _pool;
+	g_mutex_lock(&pool->mutex);
+	while (!pool->stopping) {
+		RadarPoolTask *task = _radar_pool_pop(pool);
+		if (!task) {
+			g_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+		g_mutex_unlock(&pool->mutex);
+		task->func(task->data);
+		g_mutex_lock(&pool->mutex);
+
+		if (task->background)
+			pool->background--;
+		task->state = TASK_DONE;
+		_radar_pool_task_unref(task);
+		g_cond_broadcast(&pool->cond);
+	}
+	g_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+RadarPool *radar_pool_new(gint threads)
+{
+	RadarPool *pool = g_new0(RadarPool, 1);
+	g_mutex_init(&pool->mutex);
+	g_cond_init(&pool->cond);
+	pool->queue    = g_queue_new();
+	pool->nthreads = MAX(threads, 2);
+	pool->threads  = g_new0(GThread*, pool->nthreads);
+	for (gint i = 0; i < pool->nthreads; i++)
+		pool->threads[i] = g_thread_new("radar-pool", _radar_pool_worker, pool);
+	return pool;
+}
+
+void radar_pool_free(RadarPool *pool)
+{
+	g_mutex_lock(&pool->mutex);
+	pool->stopping = TRUE;
+	RadarPoolTask *task;
+	while ((task = g_queue_pop_head(pool->queue))) {
+		task->state = TASK_CANCELLED;
+		_radar_pool_task_unref(task);
+	}
+	g_cond_broadcast(&pool->cond);
+	g_mutex_unlock(&pool->mutex);
+
+	for (gint i = 0; i < pool->nthreads; i++)
+		g_thread_join(pool->threads[i]);
+
+	g_free(pool->threads);
+	g_queue_free(pool->queue);
+	g_cond_clear(&pool->cond);
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+RadarPoolTask *radar_pool_push(RadarPool *pool, RadarPoolFunc func,
+		RadarPoolPriorityFunc priority, gpointer data)
+{
+	RadarPoolTask *task = g_new0(RadarPoolTask, 1);
+	task->func     = func;
+	task->priority = priority;
+	task->data     = data;
+	task->state    = TASK_QUEUED;
+	task->refs     = 2;
+
+	g_mutex_lock(&pool->mutex);
+	g_queue_push_tail(pool->queue, task);
+	g_cond_broadcast(&pool->cond);
+	g_mutex_unlock(&pool->mutex);
+	return task;
+}
+
+gboolean radar_pool_task_finish(RadarPool *pool, RadarPoolTask *task)
+{
+	g_mutex_lock(&pool->mutex);
+	if (task->state == TASK_QUEUED) {
+		g_queue_remove(pool->queue, task);
+		task->state = TASK_CANCELLED;
+		_radar_pool_task_unref(task);
+	}
+	while (task->state == TASK_RUNNING)
+		g_cond_wait(&pool->cond, &pool->mutex);
+	gboolean ran = task->state == TASK_DONE;
+	_radar_pool_task_unref(task);
+	g_mutex_unlock(&pool->mutex);
+	return ran;
+}
+
+gboolean radar_pool_task_try_finish(RadarPool *pool, RadarPoolTask *task)
+{
+	g_mutex_lock(&pool->mutex);
+	if (task->state == TASK_QUEUED) {
+		g_queue_remove(pool->queue, task);
+		task->state = TASK_CANCELLED;
+		_radar_pool_task_unref(task);
+	}
+	gboolean finished = task->state != TASK_RUNNING;
+	if (finished)
+		_radar_pool_task_unref(task);
+	g_mutex_unlock(&pool->mutex);
+	return finished;
+}
+
+gboolean radar_pool_task_join(RadarPool *pool, RadarPoolTask *task)
+{
+	g_mutex_lock(&pool->mutex);
+	while (task->state == TASK_QUEUED || task->state == TASK_RUNNING)
+		g_cond_wait(&pool->cond, &pool->mutex);
+	gboolean ran = task->state == TASK_DONE;
+	_radar_pool_task_unref(task);
+	g_mutex_unlock(&pool->mutex);
+	return ran;
+}
+
+void radar_pool_task_release(RadarPool *pool, RadarPoolTask *task)
+{
+	g_mutex_lock(&pool->mutex);
+	_radar_pool_task_unref(task);
+	g_mutex_unlock(&pool->mutex);
+}
+
+void radar_pool_reprioritize(RadarPool *pool)
+{
+	g_mutex_lock(&pool->mutex);
+	g_cond_broadcast(&pool->cond);
+	g_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RADAR_POOL_H__
+#define __RADAR_POOL_H__
+
+#include <glib.h>
+
+/* Worker pool shared by all radar loads (site volumes and animation frames).
+ * Queued tasks are run in priority order. A task's priority is asked for each time a worker looks for work,
+ * so a site that becomes visible moves to the front of the queue without re-queueing anything.
+ * One worker is always kept free of background work so the visible site never waits behind hidden sites.
+ */
+
+/* Priority classes, most urgent first */
+typedef enum {
+	RADAR_POOL_PRIORITY_VISIBLE,    /* Data for the radar site the user is looking at */
+	RADAR_POOL_PRIORITY_ANIMATION,  /* Animation frames */
+	RADAR_POOL_PRIORITY_BACKGROUND, /* Hidden sites and prefetching */
+} RadarPoolPriority;
+
+typedef struct _RadarPool     RadarPool;
+typedef struct _RadarPoolTask RadarPoolTask;
+
+typedef void              (*RadarPoolFunc)(gpointer data);
+typedef RadarPoolPriority (*RadarPoolPriorityFunc)(gpointer data);
+
+RadarPool *radar_pool_new(gint threads);
+
+/* Drops queued tasks and waits for running tasks to finish */
+void radar_pool_free(RadarPool *pool);
+
+/* Queues func to run on a worker. priority is called with data (with the pool locked) whenever the queue is searched.
+ * The returned handle must be passed to radar_pool_task_finish or radar_pool_task_release.
+ */
+RadarPoolTask *radar_pool_push(RadarPool *pool, RadarPoolFunc func,
+		RadarPoolPriorityFunc priority, gpointer data);
+
+/* Waits for the task to finish and releases the handle. A task that has not started yet is removed from the queue and never runs.
+ * Returns TRUE if the task ran.
+ */
+gboolean radar_pool_task_finish(RadarPool *pool, RadarPoolTask *task);
+
+/* Like radar_pool_task_finish, but never waits. Returns FALSE if the task is running, the handle is then kept and this has to be called again later.
+ * Returns TRUE once the handle is released.
+ */
+gboolean radar_pool_task_try_finish(RadarPool *pool, RadarPoolTask *task);
+
+/* Waits for the task to run and finish, then releases the handle. Returns TRUE if the task ran (it does not when the pool is freed first) */
+gboolean radar_pool_task_join(RadarPool *pool, RadarPoolTask *task);
+
+/* Releases the handle without waiting. The task still runs */
+void radar_pool_task_release(RadarPool *pool, RadarPoolTask *task);
+
+/* Call after something a priority function depends on changed, so idle workers look at the queue again */
+void radar_pool_reprioritize(RadarPool *pool);
+
+#endif
@@ -17,7 +17,6 @@
 
 #define _XOPEN_SOURCE
 #include <time.h>
-#include <stdatomic.h>
 #include <stdbool.h>
 #include <config.h>
 #include <glib/gstdio.h>
@@ -31,7 +30,15 @@
 
 #include "radar.h"
 #include "level2.h"
+#include "level2-file.h"
+#include "level3.h"
+#include "radar-pool.h"
+#include "mosaic.h"
+#include "markers.h"
+#include "spool.h"
+#include "mirrors.h"
 #include "../aweather-location.h"
+#include "../aweather-cache.h"
 
 #include "../compat.h"
 
@@ -44,6 +51,9 @@ static void aweather_bin_set_child(GtkBin *bin, GtkWidget *new)
 	gtk_widget_show_all(new);
 }
 
+/* Defined with the plugin methods, the colormaps are loaded by the first caller */
+static AWeatherColormap *_get_colormaps(void);
+
 
 /* Internal function used by _find_nearest_return_GList_pointer - parses the file name into a time_t */
 static time_t _parse_file_time(const gchar *file, gsize offset) {
@@ -145,6 +155,36 @@ typedef enum {
 	STATUS_LOADED,
 } RadarSiteStatus;
 
+/* How long the time has to stay put before a superseded site load is restarted */
+#define SITE_UPDATE_DEBOUNCE_MS 150
+
+/* Cache directory of Level II volumes, relative to the grits cache */
+#define SITE_CACHE_PREFIX G_DIR_SEPARATOR_S "nexrad" G_DIR_SEPARATOR_S "level2" G_DIR_SEPARATOR_S
+
+/* How often a loading site checks for sweeps of the volume that have been decoded */
+#define SITE_UPDATE_PARTIAL_MS  200
+
+/* While autoupdate is on and a shown site has the latest volume, the listing is polled for the next one.
+ * A volume is listed once its scan is done, about one interval after its scan time, plus some upload latency. */
+#define SITE_WATCH_LATENCY    60        // Seconds
+#define SITE_WATCH_MIN_POLL   30        // Seconds between polls once a volume is due
+#define SITE_WATCH_INTERVAL   300       // Assumed time between volumes until it has been seen
+#define SITE_WATCH_HISTORY    8         // Volumes the interval is worked out from
+#define SITE_WATCH_LIVE       (30*60)   // Sites showing older volumes than this are browsing history
+
+/* With aweather/realtime on, the volume being scanned is followed in the real-time chunk listing instead.
+ * The radar uploads a chunk every several seconds, each holding the radials scanned since the last one. */
+#define SITE_STREAM_POLL      10        // Seconds between chunk polls
+#define SITE_STREAM_STALE     (10*60)   // Seconds without chunks before the newest volume is looked up again
+#define SITE_STREAM_VOLUMES   999       // Volume numbers in the listing wrap around after this
+
+/* Level II downloads are timed, while they are slower than aweather/level3_below_kbps sites load
+ * the much smaller Level III products instead. All sites share one link, so the rate is global. */
+#define LEVEL2_RATE_MIN_TIME  2         // Seconds a download has to run before its rate is trusted
+#define LEVEL2_RATE_RETRY     (30*60)   // Seconds before Level II is tried again after it was too slow
+static gint level2_rate      = -1;      // KB/s of the last timed Level II download, -1 until one was timed
+static gint level2_rate_time = 0;       // Monotonic seconds level2_rate was measured at
+
 /* Types of frame modes - determines how we advance to the next frame */
 typedef enum {
 	NEXT_FRAME_FORWARD,
@@ -152,10 +192,50 @@ typedef enum {
 	NEXT_FRAME_UNCHANGED,
 } NextFrameMode;
 
+/* Number of frames ahead of the playhead that are read back from the disk cache when the animation does not fit in its memory budget,
+ * and of cached frames the disk is asked to read while the one before them decodes */
+#define ANIMATION_READ_AHEAD_FRAMES 3
+
+/* User commands for the animation. The buttons and keyboard shortcuts post them to RadarAnimation.iAnimationCommands and the scheduler tick acts on them */
+typedef enum {
+	ANIMATION_COMMAND_TOGGLE_PAUSE    = 1 << 0,
+	ANIMATION_COMMAND_STEP_FORWARD    = 1 << 1,
+	ANIMATION_COMMAND_STEP_BACKWARDS  = 1 << 2,
+} AnimationCommand;
+
+/* How often the loading task publishes the progress of the frame download it is waiting for, in ms */
+#define ANIMATION_FETCH_PROGRESS_MS 100
+
+/* How often a stopping animation checks whether its loading task returned, in ms */
+#define ANIMATION_STOP_POLL_MS 20
+
+/* Called on the UI thread once a stop requested with _animation_stop finished */
+typedef void (*AnimationStoppedFunc)(RadarSite* site);
+
+/* Number of progress snapshots the loading task can publish before the UI thread picks them up. Snapshots published while the ring is full are dropped, a later one supersedes them */
+#define ANIMATION_LOAD_PROGRESS_SLOTS 8
+
+/* Progress of the animation loading task at one point in time */
+typedef struct {
+	int		iFramesLoaded;		/* Frames loaded so far */
+	goffset		iFileBytesDone;		/* Bytes downloaded of the file being fetched, or -1 between files */
+	goffset		iFileBytesTotal;	/* Size of the file being fetched */
+} AnimationLoadProgress;
+
+/* Single producer / single consumer ring the loading task publishes its progress through. The loading task only writes iHead and the UI thread only writes iTail,
+ * so neither side takes a lock or waits on the other.
+ */
+typedef struct {
+	AnimationLoadProgress aSlots[ANIMATION_LOAD_PROGRESS_SLOTS];
+	gint		iHead;			/* Stores the number of snapshots published. Written by the loading task */
+	gint		iTail;			/* Stores the number of snapshots consumed. Written by the UI thread */
+	gint		lDone;			/* Stores TRUE once the loading task finished with the frames. Written by the loading task */
+} AnimationLoadChannel;
 
 /* Animation details - this struct is only created when the user starts the animation. A pointer is stored in the RadarSite struct */
 typedef struct {
-	GThread*	objAnimationThread;	/* Stores a pointer to the GThread that executes the loading and playback of the animation loop */
+	RadarPoolTask*	objAnimationLoadTask;	/* Stores the task on the plugin's worker pool that downloads and parses the animation frames */
+	GCancellable*	objAnimationCancellable; /* Cancelled when the animation is stopped so the loading task drops the frame it is decoding */
 	bool		lUserWantsToAnimate;	/* Stures TRUE if the user pressed the animate button to start animating or FALSE if they pressed the stop button to stop animating */
 	bool		lIsAnimating;		/* Stores TRUE if we are actively animating or FALSE if we are not animating. */
 	bool		lIsAnimationCleanupInProgress; /* Stores TRUE if the animation cleanup process needs to run or is running. Stores FALSE if the cleanup is done or not needed (cleaning up buttons in the UI) */
@@ -165,13 +245,11 @@ typedef struct {
 	GtkWidget*	objAnimateButton;	/* Stores a reference to the animate button widget */
 	int		iAnimationFrames;	/* Stores the number of animation frames */
 	AWeatherLevel2 **aAnimationLevel2Frames; /* Stores an array of pointers to the level2 objects that contain each frame of data */
-	guint		iAnimationFrameChangeIdleSource; /* Stores the callback that runs when all frames of the animation finish loading. */
 	GtkWidget*	objAnimationFrameControlHbox; /* Stores a pointer to the horizontal box that contains the frame selection toggle buttons */
 	GtkWidget**	aAnimationFrameSelectionToggleButtons; /* Stores an array of buttons (corresponds to aAnimationLevel2Frames) that allows the user to toggle the frames (enable them or disable them) */
 	int		iAnimationFrameSelectionToggleButtonsLength; /* Stores the laength of the aFrameSelectionToggleButtons array. */
 	int		iAnimationFrameLimit;	/* Stores the max number of animation frames we are allowed to load for this site */
 	int		iAnimationSubframeNbr;	/* Stores the frame number inside of the curent file that we are currently animating on */
-	char*		cAnimationCurrentFrameTimestampMsg; /* Stores the timestamp for the current frame in a string to be displayed to the user. This is produced by the animation thread and consumed by the UI thread */
 	int		iAnimationPreviousFrameShownInUi; /* Stores the frame number that we previously showed as the current frame in the frame selection UI. This allows us to efficiently show which frame is live */
 	bool*		aAnimationFrameDisabled; /* Stores an array of the frames that are enabled (false) or disabled (true) */
 	GtkWidget*	objAnimateProgressBar;	/* Stores a pointer to the progress bar widget, which shows the download status */
@@ -179,24 +257,88 @@ typedef struct {
 	time_t		iAnimationFinishTime;	/* Stores the time that the last frame in the animation was captured */
 	time_t		iAnimationCurrentFrameTime; /* Stores the time that the current frame in the animation was captured */
 	GArray*		aAnimationCurrentFileSortedSubframes; /* Stores the array of sorted subframes (RslSweepDateTime structs) of the current level2 frame */
-	NextFrameMode	eAnimationNextFrameMode;	/* Stores which direction the user wants the animation to run in */
-	bool		lIsAnimationPaused;		/* Stores true if the user paused the animation */
+	NextFrameMode	eAnimationNextFrameMode;	/* Stores which direction the user wants the animation to run in. Only changed by the scheduler tick */
+	bool		lIsAnimationPaused;		/* Stores true if the user paused the animation. Only changed by the scheduler tick */
+	guint		iAnimationCommands;		/* Stores the AnimationCommand bits posted by the buttons and keyboard shortcuts that the scheduler tick did not act on yet. Accessed atomically */
 	GtkWidget*	objAnimationPausePlayBtn;	/* Stores a pointer to the play / pause button to temporarily pause or play the animation */
-	GMutex		objBtnPressedGMutex;		/* Stores the mutex that we use to synchronize the GCond below */
-	GCond		objBtnPressedGCond;		/* Stores a GCond which allows us to wake up the animation thread if the user presses a button (like changing sweep) so we can make the UI feel responsive */
 	gulong		iAnimationKeyboardEventSignalHandlerEventId; /* Stores the signal handler id for the animation key event listener. */
+
+	/* Stopping. The UI thread never waits for the loading task, a stop that has to wait for it finishes from a timeout instead */
+	guint		iAnimationStopSourceId;		/* Stores the id of the timeout waiting for the loading task to return, or 0 if no stop is pending */
+	AnimationStoppedFunc fnAnimationStopped;	/* Stores the function to call once the pending stop finished, or NULL */
+	bool		lUserWantsToAnimateAfterStop;	/* Stores the user's animation choice from before the pending stop, it is restored once the stop finished */
+
+	/* Frame clock scheduler. Frames are loaded by objAnimationLoadTask, but presented on the UI thread from a tick callback on the viewer's frame clock. */
+	guint		iAnimationTickCallbackId;	/* Stores the id of the tick callback registered on the viewer, or 0 if the scheduler is not running. The tick also picks up the loading progress */
+	AnimationLoadChannel objAnimationLoadChannel;	/* Stores the progress snapshots the loading task publishes for the scheduler tick */
+	int		iAnimationFrameIntervalMs;	/* Stores the time between frames. Synced from the user preferences at the end of each loop */
+	int		iAnimationEndFrameHoldMs;	/* Stores the extra time the last frame of the loop is held for. Synced with iAnimationFrameIntervalMs */
+	bool		lAnimationFrameStaged;		/* Stores TRUE if iAnimationCurrentFrame / iAnimationSubframeNbr point to a frame that was prepared but is not visible yet */
+	bool		lAnimationStagedFrameStartsLoop; /* Stores TRUE if the staged frame is the first frame of a new loop */
+	bool		lAnimationPresentAsap;		/* Stores TRUE if the staged frame should be shown as soon as it is ready, ignoring the deadline (user stepped a frame or changed the sweep) */
+	gint64		iAnimationNextFrameDeadline;	/* Stores the frame clock time (microseconds) that the staged frame should be shown at */
+	int		iAnimationStagedVolumeId;	/* Stores the volume id selected in the UI when the staged frame was prepared */
+	float		dAnimationStagedElevation;	/* Stores the elevation selected in the UI when the staged frame was prepared */
+	time_t		iPreliminaryAnimationStartTime;	/* Stores the time the oldest frame of the current loop was captured before it is committed to iAnimationStartTime */
+	time_t		iPreliminaryAnimationFinishTime; /* Stores the time the newest frame of the current loop was captured before it is committed to iAnimationFinishTime */
+
+	/* Scheduler statistics - shown in the progress bar tooltip */
+	guint		iAnimationFramesPresented;	/* Stores the number of frames shown on schedule */
+	guint		iAnimationFramesDropped;	/* Stores the number of frames skipped because we were too late to show them on time */
+	gint64		iAnimationJitterSumUs;		/* Stores the sum of (present time - deadline) for all frames shown on schedule */
+	gint64		iAnimationJitterMaxUs;		/* Stores the largest (present time - deadline) seen */
+
+	/* Memory budget. Frames that do not fit are dropped from memory (aAnimationLevel2Frames[i] == NULL) and read back from the disk cache ahead of the playhead. */
+	gchar**		aAnimationFrameFiles;		/* Stores the path of the cached level2 file of each frame so dropped frames can be read back */
+	gsize*		aAnimationFrameSizes;		/* Stores the estimated memory used by each frame while it is in memory */
+	bool*		aAnimationFrameReadPending;	/* Stores TRUE for frames queued on objAnimationFrameReaderPool that were not installed yet */
+	gsize		iAnimationMemoryBudgetBytes;	/* Stores the memory budget from the user preferences when the animation was started */
+	gsize		iAnimationResidentBytes;	/* Stores the estimated memory used by all frames in memory */
+	int		iAnimationResidentFrames;	/* Stores the number of frames in memory */
+	GThreadPool*	objAnimationFrameReaderPool;	/* Reads dropped frames back from the disk cache. Only created if a frame had to be dropped */
+	GAsyncQueue*	objAnimationFrameReadQueue;	/* Stores AnimationFrameRead results from the reader waiting to be installed on the UI thread */
+	int		iAnimationVisibleSubframeNbr;	/* Stores the subframe of the visible frame, so a staged frame can be undone */
+	bool		lAnimationFrameVisible;		/* Stores TRUE once the scheduler has shown a frame */
 } RadarAnimation;
 
+/* A frame read back from the disk cache by the animation reader, passed to the UI thread through objAnimationFrameReadQueue */
+typedef struct {
+	int		iFrame;
+	AWeatherLevel2*	objLevel2;	/* NULL if the frame could not be read */
+} AnimationFrameRead;
+
+/* Level II animation frames are downloaded on a pool of their own while the loading task decodes the ones before them, see _animation_update_level2 */
+typedef struct {
+	GMutex		objMutex;
+	GCond		objCond;			/* Signalled when a download finishes */
+} AnimationFrameFetches;
+
+/* One frame download, spread across the healthy mirrors */
+typedef struct {
+	RadarSite*		objSite;
+	AnimationFrameFetches*	objFetches;
+	gchar*			cName;		/* Stores the volume file name */
+	gchar*			cMirrorUrl;	/* Stores the mirror to try first, NULL to use the cache only */
+	gchar*			cFile;		/* Stores the cached file once downloaded, NULL if every mirror failed */
+	bool			lDone;		/* Stores TRUE once the download finished. Guarded by objFetches->objMutex, like the fields below */
+	bool			lReadAhead;	/* Stores TRUE once the disk was asked to read the file ahead of decoding it */
+	goffset			iFileBytesDone;
+	goffset			iFileBytesTotal;
+} AnimationFrameFetch;
+
 
 struct _RadarSite {
 	/* Information */
 	city_t         *city;
-	GritsMarker    *marker;      // Map marker for grits
+	gdouble         xyz[3];      // Position of the site, see RadarSiteIndex
 
 	/* Stuff from the parents */
 	GritsViewer    *viewer;
-	GritsHttp      *http;
 	GritsPrefs     *prefs;
+	RadarPool      *pool;        // Worker pool shared by all sites
+	AWeatherDownload *download;  // Volume downloads, shared with the other plugins
+	RadarMirrors   *mirrors;     // Level II mirrors shared by all sites
+	RadarMosaic    *mosaic;      // Mosaic the site's volume is added to
 	GtkWidget      *pconfig;
 
 	/* When loaded */
@@ -211,8 +353,40 @@ struct _RadarSite {
 	gchar          *message;     // Error message set while updating
 	guint           time_id;     // "time-changed"     callback ID
 	guint           refresh_id;  // "refresh"          callback ID
-	guint           location_id; // "locaiton-changed" callback ID
 	guint           idle_source; // _site_update_end idle source
+	RadarPoolTask  *load_task;   // _site_update_thread task on the worker pool
+	gint            generation;  // Bumped for every update request, results of older loads are thrown away
+	gint            load_generation;  // Generation load_task is loading
+	GCancellable   *load_cancellable; // Cancelled once load_task is superseded
+	guint           debounce_id; // Starts the newest load after a burst of update requests
+	gchar          *volume_name; // File name of the volume level2 was loaded from
+	gboolean        level3;      // level2 was decoded from Level III products, volume_name is the reflectivity product
+	gint64          fetch_start; // Monotonic time the Level II fetch of load_task started, 0 when not fetching
+	GCancellable   *fetch_cancellable; // Stops just the Level II fetch of load_task when it is too slow
+	RadarSpool     *spool;       // Local spool volumes are read from instead of nexrad_url, see aweather/spool_dir
+	AWeatherLevel2 *load_level2; // Volume load_task is still decoding, set once its lowest sweep can be shown
+	guint           partial_id;  // _site_update_partial timeout source while loading
+
+	/* Watching for new volumes, see _site_watch_schedule */
+	RadarPoolTask  *watch_task;       // _site_watch_thread task on the worker pool
+	GCancellable   *watch_cancellable;
+	gint            watch_generation; // Generation when watch_task was queued
+	gchar          *watch_have;       // volume_name when watch_task was queued
+	AWeatherLevel2 *watch_level2;     // Newer volume found by watch_task, not added to the viewer yet
+	gchar          *watch_name;       // File name of watch_level2
+	time_t          watch_newest;     // Scan time of the newest volume in the last listing
+	gint            watch_interval;   // Typical seconds between volumes, 0 until known
+	guint           watch_id;         // Next poll timeout source
+	guint           watch_idle;       // _site_watch_end idle source
+	GMutex          watch_lock;       // Held while watch_task sets watch_idle, watch_newest and watch_interval
+
+	/* Real-time chunks, see _site_stream_thread. Only the watch task changes these while it runs */
+	AWeatherLevel2 *stream_level2;    // Volume decoded as its chunks arrive, also level2 once it shows something
+	gint            stream_volume;    // Volume number in the chunk listing, 0 until the newest one is found
+	gint            stream_chunks;    // Chunks of stream_volume decoded so far
+	time_t          stream_time;      // Scan time of stream_volume
+	time_t          stream_since;     // When stream_volume was picked
+	gboolean        stream_done;      // stream_volume ended or could not be decoded
 
 	/* Animation data */
 	RadarAnimation* objRadarAnimation; /* Pointer to the RadarAnimation struct, which contains details about the current state of the level2 animation */
@@ -222,48 +396,6 @@ struct _RadarSite {
 
 /* Animation methods */
 
-/* Call to poke the animation thread to wake it up from its sleep so it can respond to, for example, a change in the sweep elevation */
-void _poke_animation_thread(RadarSite* site){
-	g_mutex_lock(&site->objRadarAnimation->objBtnPressedGMutex);
-	g_cond_signal(&site->objRadarAnimation->objBtnPressedGCond);
-	g_mutex_unlock(&site->objRadarAnimation->objBtnPressedGMutex);
-}
-
-/* Internal function used in _animation_thread_usleep_or_wakeup_from_poke to translate the gpointer to a RadarSite*. */
-static void fOnUiChangedCallback(gpointer _site){
-	RadarSite* site = _site;
-	/* User clicked a different sweep elevation or volume button or changed the isosurface slider. Tell the animation thread about this */
-	_poke_animation_thread(site);
-}
-
-/* Call from the animation thread to sleep for the specified amount of time (microseconds).
- * If the _poke_animation_thread function is called above during the sleep, this function will return early and will return true.
- * If the timeout expires normally (not poked), then false is returned.
- */
-bool _animation_thread_usleep_or_wakeup_from_poke(RadarSite* site, gint64 ipiMicrosecondsToSleep){
-	/* Setup a callback so if the user clicks a button in the UI to change the sweep elevation or volume or changes the isosurface slider, we will automatically wake up the animation thread to apply the change. */
-	site->level2->objAfterSetSweepOneTimeCustomCallbackData = (gpointer) site;
-	site->level2->fAfterSetSweepOneTimeCustomCallback = fOnUiChangedCallback;
-	site->level2->objOnSetIsoOneTimeCustomCallbackData = (gpointer) site;;
-	site->level2->fOnSetIsoOneTimeCustomCallback = fOnUiChangedCallback;
-
-	g_mutex_lock(&site->objRadarAnimation->objBtnPressedGMutex);
-
-	/* Calculate when we should wake up */
-	gint64 iEndTime = g_get_monotonic_time() + ipiMicrosecondsToSleep;
-	bool lReturnValue = g_cond_wait_until(&site->objRadarAnimation->objBtnPressedGCond, &site->objRadarAnimation->objBtnPressedGMutex, iEndTime);
-	
-	g_mutex_unlock(&site->objRadarAnimation->objBtnPressedGMutex);
-
-	/* Clear out the callback function so we don't try to run it when it is not needed. */
-	site->level2->objAfterSetSweepOneTimeCustomCallbackData = NULL;
-	site->level2->fAfterSetSweepOneTimeCustomCallback = NULL;
-	site->level2->objOnSetIsoOneTimeCustomCallbackData = NULL;
-	site->level2->fOnSetIsoOneTimeCustomCallback = NULL;
-
-	return lReturnValue;
-}
-
 /* Called when the user clicks a toggle button to tenable or disable a frame */
 static void _on_animation_frame_selection_toggle_button_toggle(GtkToggleButton *toggleButton, gpointer _site){
 	RadarSite* site = _site;
@@ -290,27 +422,44 @@ void _unpause_animation(RadarSite* site){
 	gtk_button_set_label(GTK_BUTTON(site->objRadarAnimation->objAnimationPausePlayBtn), "\u23f8"); /* Pause button icon */
 }
 
+/* Posts a command for the scheduler tick. The frame buttons only record what the user asked for, the tick acts on it on the next frame. */
+static void _animation_post_command(RadarSite* site, AnimationCommand ipeCommand){
+	g_atomic_int_or(&site->objRadarAnimation->iAnimationCommands, ipeCommand);
+}
+
+/* Acts on the commands posted since the last tick. Must run on the UI thread. */
+static void _animation_apply_commands(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	guint iCommands = g_atomic_int_and(&objRadarAnimation->iAnimationCommands, 0);
+
+	if(iCommands & ANIMATION_COMMAND_TOGGLE_PAUSE){
+		if(objRadarAnimation->lIsAnimationPaused){
+			_unpause_animation(site);
+			objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_FORWARD; /* Play the animation normally */
+			objRadarAnimation->lAnimationPresentAsap = true; /* restart playback right now instead of waiting for the old deadline. */
+		} else {
+			_pause_animation(site);
+			objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_UNCHANGED;
+		}
+	}
+
+	/* Stepping pauses the animation. The step is kept in eAnimationNextFrameMode until the frame can be staged */
+	if(iCommands & (ANIMATION_COMMAND_STEP_FORWARD | ANIMATION_COMMAND_STEP_BACKWARDS)){
+		_pause_animation(site);
+		objRadarAnimation->eAnimationNextFrameMode = (iCommands & ANIMATION_COMMAND_STEP_BACKWARDS ? NEXT_FRAME_BACKWARDS : NEXT_FRAME_FORWARD);
+	}
+}
+
 void _on_previous_frame_btn_clicked(GtkButton* ipobjButton, RadarSite* site){
-	_pause_animation(site);
-	site->objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_BACKWARDS;
-	_poke_animation_thread(site); /* Wake the animation thread up so it animates right away */
+	_animation_post_command(site, ANIMATION_COMMAND_STEP_BACKWARDS);
 }
 
 void _on_next_frame_btn_clicked(GtkButton* ipobjButton, RadarSite* site){
-	_pause_animation(site);
-	site->objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_FORWARD;
-	_poke_animation_thread(site); /* Wake the animation thread up so it animates right away */
+	_animation_post_command(site, ANIMATION_COMMAND_STEP_FORWARD);
 }
 
 void _on_pause_play_frame_btn_clicked(GtkButton* ipobjButton, RadarSite* site){
-	if(site->objRadarAnimation->lIsAnimationPaused){
-		_unpause_animation(site);
-		site->objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_FORWARD; /* Play the animation normally */
-		_poke_animation_thread(site); /* restart playback right now instead of waiting for the animation thread to wake up. */
-	} else {
-		_pause_animation(site);
-		site->objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_UNCHANGED;
-	}
+	_animation_post_command(site, ANIMATION_COMMAND_TOGGLE_PAUSE);
 }
 
 gboolean _on_aweather_gui_key_press(GtkWidget *ipobjWidget, GdkEventKey *ipobjEvent, RadarSite *site){
@@ -367,19 +516,19 @@ void _remove_animation_keybaord_event_listeners(RadarSite* site){
 	}
 }
 
-/* Sync animation UI with backend state. file, cur, total are optional parameters for showing the download status of files.
+/* Sync animation UI with backend state. ipobjProgress is the latest progress published by the loading task while the animation is loading, or NULL.
  * This must run on the main UI thread.
   */
-void _animation_update_status_ui(gchar *file, goffset cur,
-		goffset total, gpointer _site)
+void _animation_update_status_ui(RadarSite* site, const AnimationLoadProgress* ipobjProgress)
 {
-	RadarSite* site = _site;
 	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
+	/* The frame count is owned by the loading task until it is done. Until then, go by its progress snapshot */
+	int iFramesLoaded = (ipobjProgress != NULL ? ipobjProgress->iFramesLoaded : objRadarAnimation->iAnimationFrames);
+
 	if(!objRadarAnimation->lIsAnimating){
 		/* If we are not animating right now, then do not run the logic in this function. The logic in here requires specific UI elements
 		 * to exist, which may not exist if the animation is not running.
-		 * This could be called after the animation stops if there were many scheduled UI thread callbacks waiting to run.
 		 */
 		g_debug("_animation_update_status_ui: This function was called when no animation was running. Exiting the function now.");
 		return;
@@ -388,8 +537,8 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 	/* Show toggle buttons to reflect the frames that are loaded.
 	 * Start at the length of the frame selection buttons array and add any that are missing (iterate to the current number of loaded frames).
 	 */
-	g_debug("_animation_update_status_ui: objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength: %i, objRadarAnimation->iAnimationFrames: %i, cur: %li, total: %li, objRadarAnimation->iAnimationCurrentFrame: %i", objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength, objRadarAnimation->iAnimationFrames, cur, total, objRadarAnimation->iAnimationCurrentFrame);
-	if(objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength < objRadarAnimation->iAnimationFrames
+	g_debug("_animation_update_status_ui: objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength: %i, iFramesLoaded: %i, objRadarAnimation->iAnimationCurrentFrame: %i", objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength, iFramesLoaded, objRadarAnimation->iAnimationCurrentFrame);
+	if(objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength < iFramesLoaded
 		&& objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength == 0){
 
 		/* If we haven't added any frame control buttons to the UI yet, then add the frame selection message to the UI to describe the frame selection boxes. */
@@ -422,7 +571,7 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 		_unpause_animation(site); /* Update the button text */
 	}
 
-	for(int iFrame = objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength; iFrame < objRadarAnimation->iAnimationFrames; ++iFrame){
+	for(int iFrame = objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength; iFrame < iFramesLoaded; ++iFrame){
 		/* Missing frame selection toggle button. Add it to the left side of the hbox, shift other boxes right. */
 		objRadarAnimation->aAnimationFrameSelectionToggleButtons[iFrame] = gtk_toggle_button_new_with_label("");
 		gtk_box_pack_start(GTK_BOX(objRadarAnimation->objAnimationFrameControlHbox), objRadarAnimation->aAnimationFrameSelectionToggleButtons[iFrame], FALSE, FALSE, 0);
@@ -447,13 +596,13 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 
 	if(objRadarAnimation->lAnimationLoading){
 		double dPercent = 0;
-		if(file != NULL){
+		if(ipobjProgress != NULL && ipobjProgress->iFileBytesDone >= 0){
 			/* If wa are active loading a file, display the file download status in the animate button */
-			double dCurrentFrameDownloadPercent = (total == 0 ? 1 : ((double)(cur) / total) ); /* If the server told us the current file is zero bytes, then assume we downloaded the entire file already (set percent to 100). */
-			dPercent = (objRadarAnimation->iAnimationFrames + dCurrentFrameDownloadPercent) / objRadarAnimation->iAnimationFrameLimit;
+			double dCurrentFrameDownloadPercent = (ipobjProgress->iFileBytesTotal == 0 ? 1 : ((double)(ipobjProgress->iFileBytesDone) / ipobjProgress->iFileBytesTotal) ); /* If the server told us the current file is zero bytes, then assume we downloaded the entire file already (set percent to 100). */
+			dPercent = (iFramesLoaded + dCurrentFrameDownloadPercent) / objRadarAnimation->iAnimationFrameLimit;
 		} else {
 			/* If we are not actively loading a file at the moment, show a general progress indicator */
-			dPercent = (double) objRadarAnimation->iAnimationFrames / objRadarAnimation->iAnimationFrameLimit;
+			dPercent = (double) iFramesLoaded / objRadarAnimation->iAnimationFrameLimit;
 		}
 
 		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(objRadarAnimation->objAnimateProgressBar), CLAMP(dPercent, 0, 1)); /* Gtk will throw an error if the percent is < 0 or > 1, hence we use CLAMP. */
@@ -492,10 +641,8 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 		g_free(objRadarAnimation->aAnimationFrameDisabled);
 		objRadarAnimation->aAnimationFrameDisabled = NULL;
 
-		/* Clear the GMutex and GCond as we are done with them */
-		g_mutex_clear(&objRadarAnimation->objBtnPressedGMutex);
-		g_cond_clear(&objRadarAnimation->objBtnPressedGCond);
-		
+		gtk_widget_set_tooltip_text(objRadarAnimation->objAnimateProgressBar, NULL);
+
 		/* We are done animating. Flip the animating flag to false */
 		objRadarAnimation->lIsAnimationCleanupInProgress = false;
 		objRadarAnimation->lIsAnimating = false;
@@ -513,6 +660,18 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 		}
 		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(objRadarAnimation->objAnimateProgressBar), CLAMP(dRunningPercentage, 0, 1));
 
+		/* Show the scheduler statistics so the user can tell if the machine is keeping up with the requested frame interval */
+		gchar *cStats = g_strdup_printf("Frames shown: %u\nFrames dropped: %u\nJitter: %.1f ms average, %.1f ms max\nFrames in memory: %i of %i (%.0f MB)",
+				objRadarAnimation->iAnimationFramesPresented,
+				objRadarAnimation->iAnimationFramesDropped,
+				objRadarAnimation->iAnimationFramesPresented == 0 ? 0 : (double)objRadarAnimation->iAnimationJitterSumUs / objRadarAnimation->iAnimationFramesPresented / 1000,
+				(double)objRadarAnimation->iAnimationJitterMaxUs / 1000,
+				objRadarAnimation->iAnimationResidentFrames,
+				objRadarAnimation->iAnimationFrames,
+				(double)objRadarAnimation->iAnimationResidentBytes / (1024 * 1024));
+		gtk_widget_set_tooltip_text(objRadarAnimation->objAnimateProgressBar, cStats);
+		g_free(cStats);
+
 		gtk_button_set_label(GTK_BUTTON(objRadarAnimation->objAnimateButton), "Stop");
 		
 		/* If we changed frames, then update the button text */
@@ -532,26 +691,40 @@ void _animation_update_status_ui(gchar *file, goffset cur,
 		/* Update the previous frame number so we know which button to update when we move on to the next frame */
 		objRadarAnimation->iAnimationPreviousFrameShownInUi = objRadarAnimation->iAnimationCurrentFrame;
 	}
+}
+
+/* Publishes a progress snapshot to the UI thread. Runs on the loading task. */
+static void _animation_load_channel_push(AnimationLoadChannel* objChannel, int ipiFramesLoaded, goffset ipiFileBytesDone, goffset ipiFileBytesTotal){
+	gint iHead = objChannel->iHead;
+	if(iHead - g_atomic_int_get(&objChannel->iTail) >= ANIMATION_LOAD_PROGRESS_SLOTS)
+		return; /* The UI thread has not caught up. Drop this snapshot, the next one supersedes it */
+
+	AnimationLoadProgress* objProgress = &objChannel->aSlots[iHead % ANIMATION_LOAD_PROGRESS_SLOTS];
+	objProgress->iFramesLoaded = ipiFramesLoaded;
+	objProgress->iFileBytesDone = ipiFileBytesDone;
+	objProgress->iFileBytesTotal = ipiFileBytesTotal;
+
+	/* The slot is filled in before the UI thread can see it */
+	g_atomic_int_set(&objChannel->iHead, iHead + 1);
+}
 
-	/* Update the frame timestamp display if we have a frame timestamp to display and the label exists. */
-	g_debug("_animation_update_status_ui: objRadarAnimation->cAnimationCurrentFrameTimestampMsg: %s, site->level2->date_label: %p", objRadarAnimation->cAnimationCurrentFrameTimestampMsg, site->level2->date_label);
-	if(objRadarAnimation->cAnimationCurrentFrameTimestampMsg != NULL
-		&& site->level2->date_label != NULL){
-		gtk_label_set_markup(GTK_LABEL(site->level2->date_label), objRadarAnimation->cAnimationCurrentFrameTimestampMsg);
+/* Takes the oldest progress snapshot the UI thread did not see yet. Returns false if there is none. Must run on the UI thread. */
+static bool _animation_load_channel_pop(AnimationLoadChannel* objChannel, AnimationLoadProgress* opobjProgress){
+	gint iTail = objChannel->iTail;
+	if(iTail == g_atomic_int_get(&objChannel->iHead))
+		return false;
 
+	*opobjProgress = objChannel->aSlots[iTail % ANIMATION_LOAD_PROGRESS_SLOTS];
 
-		/* Cleanup the timestamp string so it can be regenerated by the animation thread */
-		g_free(objRadarAnimation->cAnimationCurrentFrameTimestampMsg);
-		objRadarAnimation->cAnimationCurrentFrameTimestampMsg = NULL;
-	} /* if there is an animation timestamp string to consumer */
+	/* The slot is copied out before the loading task can reuse it */
+	g_atomic_int_set(&objChannel->iTail, iTail + 1);
+	return true;
 }
 
-/* Calls _animation_update_status_ui, but only requires a site pointer so it can be called from g_idle_add() */
-gboolean _animation_update_status_ui_g_idle_add(gpointer _site){
+/* Download progress callback for the animation frames. Runs on the loading task. */
+static void _animation_on_load_progress(gchar *file, goffset cur, goffset total, gpointer _site){
 	RadarSite* site = _site;
-	_animation_update_status_ui(NULL, 0, 0, site);
-	site->objRadarAnimation->iAnimationFrameChangeIdleSource = 0;
-	return false;
+	_animation_load_channel_push(&site->objRadarAnimation->objAnimationLoadChannel, site->objRadarAnimation->iAnimationFrames, cur, total);
 }
 
 
@@ -618,12 +791,11 @@ bool _animation_goto_next_frame(RadarSite* site, NextFrameMode ipeNextFrameMode)
 	return lDidWeHitTheEndOfTheAnimationLoop;
 }
 
-/* Internal function used in _animation_update_thread to switch to the next frame. This could be run from the UI thread or animation thread. */
-static void switchToNextFrame(gpointer _ipobjRadarAnimation){
-	RadarAnimation* objRadarAnimation = (RadarAnimation*) _ipobjRadarAnimation;
-
-	/* Hide the current frame */
-	grits_object_hide(GRITS_OBJECT(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iPreviousLevel2FrameThatWasVisible]), true);
+/* Internal function used by the animation scheduler to swap the visible frame for the staged one. Must run on the UI thread. */
+static void switchToNextFrame(RadarAnimation* objRadarAnimation){
+	/* Hide the current frame. Before the first frame is shown, this may be a frame that is not in memory */
+	if(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iPreviousLevel2FrameThatWasVisible] != NULL)
+		grits_object_hide(GRITS_OBJECT(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iPreviousLevel2FrameThatWasVisible]), true);
 
 	/* After changing the frame number, show the current frame */
 	grits_object_hide(GRITS_OBJECT(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame]), false);
@@ -632,538 +804,1997 @@ static void switchToNextFrame(gpointer _ipobjRadarAnimation){
 	objRadarAnimation->iPreviousLevel2FrameThatWasVisible = objRadarAnimation->iAnimationCurrentFrame;
 }
 
-gpointer _animation_update_thread(gpointer _site)
-{
-	RadarSite* site = _site;
+/* Call to update the iAnimationFrameIntervalMs and iAnimationEndFrameHoldMs variables from the current user preferences object. */
+static void _animation_update_frame_interval_from_prefs(RadarSite* site){
+	site->objRadarAnimation->iAnimationFrameIntervalMs = grits_prefs_get_integer(site->prefs, "aweather/animation_frame_interval_ms", NULL);
+	site->objRadarAnimation->iAnimationEndFrameHoldMs = grits_prefs_get_integer(site->prefs, "aweather/animation_end_frame_hold_ms", NULL);
+}
+
+/* Returns how many frames forward the playhead has to move to reach the given frame. Frames are played from the highest index down to 0, then the loop wraps. */
+static int _animation_frames_ahead_of_playhead(RadarAnimation* objRadarAnimation, int ipiFrame){
+	return (objRadarAnimation->iAnimationCurrentFrame - ipiFrame + objRadarAnimation->iAnimationFrames) % objRadarAnimation->iAnimationFrames;
+}
+
+/* Adds a loaded frame to the viewer (hidden) and counts it against the memory budget */
+static void _animation_make_frame_resident(RadarSite* site, int ipiFrame, AWeatherLevel2* ipobjLevel2){
 	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
-	g_debug("_animation_update_thread - %s", site->city->code);
-	
-	/* Set the loading flag to indicate that we are loading */
-	objRadarAnimation->lAnimationLoading = true;
-	
-	/* Initialize computed animation start and finish times */
-	objRadarAnimation->iAnimationStartTime = -1;
-	objRadarAnimation->iAnimationFinishTime = -1;
-	objRadarAnimation->iAnimationCurrentFrameTime = -1;
+	/* Enable caching of the sweep textures in each level2 file. This reduces the amount of data we have to send to the GPU on each frame change if each file contains more than one frame */
+	ipobjLevel2->lEnableSweepTextureCache = true;
 
-	/* Update the UI to show that we are loading the animation. */
-	objRadarAnimation->iAnimationFrameChangeIdleSource = g_idle_add(_animation_update_status_ui_g_idle_add, site);
+	grits_object_hide(GRITS_OBJECT(ipobjLevel2), true);
+	grits_viewer_add(site->viewer, GRITS_OBJECT(ipobjLevel2), GRITS_LEVEL_WORLD+3, TRUE);
 
-	gboolean offline = grits_viewer_get_offline(site->viewer);
-	gchar *nexrad_url = grits_prefs_get_string(site->prefs,
-			"aweather/nexrad_url", NULL);
+	objRadarAnimation->aAnimationLevel2Frames[ipiFrame] = ipobjLevel2;
+	objRadarAnimation->aAnimationFrameSizes[ipiFrame] = aweather_level2_get_memory_size(ipobjLevel2);
+	objRadarAnimation->iAnimationResidentBytes += objRadarAnimation->aAnimationFrameSizes[ipiFrame];
+	objRadarAnimation->iAnimationResidentFrames++;
+}
 
-	/* Find nearest volume (temporally) */
-	g_debug("_animation_update_thread - find nearest - %s", site->city->code);
-	gchar *dir_list = g_strconcat(nexrad_url, "/", site->city->code,
-			"/", "dir.list", NULL);
-	GList *files = grits_http_available(site->http,
-			"^\\w{4}_\\d{8}_\\d{6}.bz2$", site->city->code,
-			"\\d+ (.*)", (offline ? NULL : dir_list));
-	g_free(dir_list);
-
-	int iAnimationFrameIntervalMs = 0;
-	int iAnimationEndFrameHoldMs = 0;
-	/* Call to update the iAnimationFrameIntervalMs and iAnimationEndFrameHoldMs variables from the current user preferences object. */
-	void updateIAnimationFrameIntervalMs(){
-		iAnimationFrameIntervalMs = grits_prefs_get_integer(site->prefs, "aweather/animation_frame_interval_ms", NULL);
-		iAnimationEndFrameHoldMs = grits_prefs_get_integer(site->prefs, "aweather/animation_end_frame_hold_ms", NULL);
-	}
-	/* Sync current user preference for animation frame interval ms setting to our local variable */
-	updateIAnimationFrameIntervalMs();
-
-	/* Copy the configured animation frames limit to our local state variable so that if the user changes it while we are loading, we don't go over an array limit */
-	objRadarAnimation->iAnimationFrameLimit = grits_prefs_get_integer(site->prefs, "aweather/animation_frames", NULL);
-	if(objRadarAnimation->iAnimationFrameLimit == 0){
-		g_error("Warning! The animation frame count is set to 0. This is not supported. Please adjust the 'Animation Frames' setting to a larger value in the settings dialog.");
+/* Drops the frames the playhead reaches last from memory until the resident frames fit in the memory budget.
+ * The visible frame, the staged frame and the frames being read ahead are never dropped. If only those are left, we go over the budget rather than stutter.
+ */
+static void _animation_enforce_memory_budget(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+
+	while(objRadarAnimation->iAnimationResidentBytes > objRadarAnimation->iAnimationMemoryBudgetBytes){
+		int iFrameToDrop = -1;
+		int iFrameToDropDistance = ANIMATION_READ_AHEAD_FRAMES;
+		for(int iFrame = 0; iFrame < objRadarAnimation->iAnimationFrames; ++iFrame){
+			if(objRadarAnimation->aAnimationLevel2Frames[iFrame] == NULL
+				|| (objRadarAnimation->lAnimationFrameVisible && iFrame == objRadarAnimation->iPreviousLevel2FrameThatWasVisible)
+				|| iFrame == objRadarAnimation->iAnimationCurrentFrame)
+				continue;
+			int iDistance = _animation_frames_ahead_of_playhead(objRadarAnimation, iFrame);
+			if(iDistance > iFrameToDropDistance){
+				iFrameToDrop = iFrame;
+				iFrameToDropDistance = iDistance;
+			}
+		}
+		if(iFrameToDrop == -1)
+			break;
+
+		g_debug("_animation_enforce_memory_budget: dropping frame %i from memory", iFrameToDrop);
+		grits_object_destroy_pointer(&objRadarAnimation->aAnimationLevel2Frames[iFrameToDrop]);
+		objRadarAnimation->iAnimationResidentBytes -= objRadarAnimation->aAnimationFrameSizes[iFrameToDrop];
+		objRadarAnimation->iAnimationResidentFrames--;
 	}
+}
 
-	/* Allocate memory for the list of Level2 radar objects for this site. We may not fill this array fully, but we could use all of it depending on the files available on the server. */
-	objRadarAnimation->aAnimationLevel2Frames = malloc(sizeof(AWeatherLevel2*) * objRadarAnimation->iAnimationFrameLimit);
-	objRadarAnimation->iAnimationFrames = 0;
-	g_debug("_animation_update_thread: iAnimationFrames set to 0");
+/* Runs on objAnimationFrameReaderPool. Reads a dropped frame back from the disk cache and hands it to the UI thread. */
+static void _animation_frame_reader(gpointer _iFrame, gpointer _site){
+	RadarSite* site = _site;
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
-	/* Ensure the frame selection buttons array is initialized */
-	objRadarAnimation->aAnimationFrameSelectionToggleButtons = malloc(sizeof(GtkWidget*) * objRadarAnimation->iAnimationFrameLimit);
-	objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength = 0;
+	AnimationFrameRead* objRead = g_new0(AnimationFrameRead, 1);
+	objRead->iFrame = GPOINTER_TO_INT(_iFrame) - 1;
+	objRead->objLevel2 = aweather_level2_new_from_spill_file(objRadarAnimation->aAnimationFrameFiles[objRead->iFrame], site->city->code, _get_colormaps(), site->prefs);
+	g_async_queue_push(objRadarAnimation->objAnimationFrameReadQueue, objRead);
+}
 
-	objRadarAnimation->aAnimationFrameDisabled = calloc(sizeof(bool), objRadarAnimation->iAnimationFrameLimit);
+/* Installs the frames the reader finished reading. Must run on the UI thread. */
+static void _animation_install_read_frames(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	if(objRadarAnimation->objAnimationFrameReadQueue == NULL)
+		return;
 
-	/* Reset the cleanup flag so it is in a known state */
-	objRadarAnimation->lIsAnimationCleanupInProgress = false;
+	AnimationFrameRead* objRead;
+	while((objRead = g_async_queue_try_pop(objRadarAnimation->objAnimationFrameReadQueue)) != NULL){
+		objRadarAnimation->aAnimationFrameReadPending[objRead->iFrame] = false;
+		if(objRead->objLevel2 != NULL){
+			_animation_make_frame_resident(site, objRead->iFrame, objRead->objLevel2);
+		} else {
+			/* Disable the frame so it is skipped instead of being requested again on every tick. The user can enable it again to retry. */
+			g_warning("_animation_install_read_frames: failed to read frame %i back from %s, disabling it", objRead->iFrame, objRadarAnimation->aAnimationFrameFiles[objRead->iFrame]);
+			objRadarAnimation->aAnimationFrameDisabled[objRead->iFrame] = true;
+			if(objRead->iFrame < objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength
+				&& objRadarAnimation->aAnimationFrameSelectionToggleButtons[objRead->iFrame] != NULL)
+				gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(objRadarAnimation->aAnimationFrameSelectionToggleButtons[objRead->iFrame]), true);
+		}
+		g_free(objRead);
+	}
 
-	/* Clear out the previous frame id */
-	objRadarAnimation->iAnimationPreviousFrameShownInUi = 0;
+	_animation_enforce_memory_budget(site);
+}
 
-	/* Star the animation in the forwards direction (when it finishes loading) */
-	objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_FORWARD;
+/* Queues a dropped frame on the reader unless it is already queued */
+static void _animation_request_frame(RadarAnimation* objRadarAnimation, int ipiFrame){
+	if(objRadarAnimation->objAnimationFrameReaderPool == NULL
+		|| objRadarAnimation->aAnimationLevel2Frames[ipiFrame] != NULL
+		|| objRadarAnimation->aAnimationFrameReadPending[ipiFrame])
+		return;
 
-	GList* objFilesListByTimeDesc = _find_nearest_return_GList_pointer(site->time, files, 5, true /* Sort the array so it is in a consistent order */);
+	objRadarAnimation->aAnimationFrameReadPending[ipiFrame] = true;
+	g_thread_pool_push(objRadarAnimation->objAnimationFrameReaderPool, GINT_TO_POINTER(ipiFrame + 1), NULL);
+}
 
-	/* We want the file name that is closest to the current set time and the previous N files.
-	 * Hence, we request the list element itself, then iterate forwards in the double-linked list to find the desired file names that are older than the starting file to build up our animation.
-	 */
-	for(GList *nearest = objFilesListByTimeDesc; objRadarAnimation->iAnimationFrames < objRadarAnimation->iAnimationFrameLimit && nearest != NULL; nearest = nearest->next){
-		g_debug("_animation_update_thread: About to fetch frame, prev: %p, curr: '%s', next: %p", nearest->prev, (char*) nearest->data, nearest->next);
-		/* Fetch new volume for the current file. */
-		gchar *local = g_strconcat(site->city->code, "/", nearest->data, NULL);
-		gchar *uri   = g_strconcat(nexrad_url, "/", local,   NULL);
-		g_debug("_animation_update_thread: downloading from URI %s", uri);
-		gchar *file  = grits_http_fetch(site->http, uri, local,
-				offline ? GRITS_LOCAL : GRITS_UPDATE,
-				_animation_update_status_ui, site);
-		g_free(local);
-		g_free(uri);
-		if (file) {
-			/* Load and add new volume to our array of level2 frames. Increment the frames counter so we know how many frames we have. */
-			g_debug("_animation_update_thread - File is good. load - Site: %s, Frame number: %i", site->city->code, objRadarAnimation->iAnimationFrames);
-			AWeatherLevel2* objLevel2 = aweather_level2_new_from_file(file, site->city->code, colormaps, site->prefs);
-			g_debug("_animation_update_thread: parsing level2: %p", objLevel2);
-			objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationFrames] = objLevel2;
+/* Requests the next few enabled frames ahead of the playhead that are not in memory */
+static void _animation_read_ahead(RadarAnimation* objRadarAnimation){
+	int iFramesRequested = 0;
+	for(int iDistance = 0; iDistance < objRadarAnimation->iAnimationFrames && iFramesRequested < ANIMATION_READ_AHEAD_FRAMES; ++iDistance){
+		int iFrame = (objRadarAnimation->iAnimationCurrentFrame - iDistance + objRadarAnimation->iAnimationFrames) % objRadarAnimation->iAnimationFrames;
+		if(objRadarAnimation->aAnimationFrameDisabled[iFrame])
+			continue;
+		_animation_request_frame(objRadarAnimation, iFrame);
+		iFramesRequested++;
+	}
+}
 
-			if (!objLevel2) {
-				g_debug("_animation_update_thread. We failed to load a level2 file. Skipping it. File: %s", file);
-			} else {
-				/* Enable caching of the sweep textures in each level2 file. This reduces the amount of data we have to send to the GPU on each frame change if each file contains more than one frame */
-				objLevel2->lEnableSweepTextureCache = true;
+/* Returns true if the frame _animation_goto_next_frame would move to in the given direction is in memory. If it is not, it is requested from the reader. */
+static bool _animation_is_next_frame_resident(RadarSite* site, NextFrameMode ipeNextFrameMode){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	AWeatherLevel2* objCurrentLevel2 = objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame];
+	int iAnimationFrameIncrementer = (ipeNextFrameMode == NEXT_FRAME_FORWARD ? 1 : -1);
+	int iSubframe = objRadarAnimation->iAnimationSubframeNbr + iAnimationFrameIncrementer;
 
-				grits_object_hide(GRITS_OBJECT(objLevel2), true);
-				g_debug("_animation_update_thread: After hide of frame.");
-				grits_viewer_add(site->viewer, GRITS_OBJECT(objLevel2), GRITS_LEVEL_WORLD+3, TRUE);
-				g_debug("_animation_update_thread: After add to viewer.");
+	/* The next subframe is in the current file, which is in memory */
+	if(objRadarAnimation->aAnimationCurrentFileSortedSubframes != NULL
+		&& objCurrentLevel2 != NULL
+		&& aweatherLevel2AreTheseElevationsTheSame(objCurrentLevel2->dSelectedElevation, site->level2->dSelectedElevation)
+		&& objCurrentLevel2->iSelectedVolumeId == site->level2->iSelectedVolumeId
+		&& iSubframe >= 0 && iSubframe < objRadarAnimation->aAnimationCurrentFileSortedSubframes->len)
+		return true;
+
+	/* Find the next enabled file the same way _animation_goto_next_frame does */
+	int iFrame = objRadarAnimation->iAnimationCurrentFrame;
+	for(int iFrameSearchAttempts = 0; iFrameSearchAttempts < objRadarAnimation->iAnimationFrames; ++iFrameSearchAttempts){
+		iFrame = (iFrame - iAnimationFrameIncrementer + objRadarAnimation->iAnimationFrames) % objRadarAnimation->iAnimationFrames;
+		if(!objRadarAnimation->aAnimationFrameDisabled[iFrame])
+			break;
+	}
 
-				/* Frame successfully added. Increment the num frames counter */
-				objRadarAnimation->iAnimationFrames++;
-			}
-			g_free(file);
-		} /* If a file was returned from the server. */
+	if(objRadarAnimation->aAnimationLevel2Frames[iFrame] != NULL)
+		return true;
+	_animation_request_frame(objRadarAnimation, iFrame);
+	return false;
+}
 
-		/* If there is not already a main thread request ongoing, then create a new request to update the GUI with the latest file. */
-		if(!objRadarAnimation->iAnimationFrameChangeIdleSource){
-			objRadarAnimation->iAnimationFrameChangeIdleSource = g_idle_add(_animation_update_status_ui_g_idle_add, site);
-		}
-	} /* for each file on the server starting at the selected time, walking backwards */
-	g_debug("_animation_update_thread: Done loading level2 frames");
+/* Regenerates the subframe list of the current frame for the sweep / volume selected in the UI. If the frame has no matching sweep, the old list is kept. */
+static void _animation_refresh_current_frame_subframes(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	GArray* aSubframes = aweatherLevel2GetAllSweepsFromVolumeWithElevationSortedBySweepStartTime(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame], site->level2->iSelectedVolumeId, site->level2->dSelectedElevation);
+	if(aSubframes->len == 0 && objRadarAnimation->aAnimationCurrentFileSortedSubframes != NULL){
+		g_array_free(aSubframes, true);
+		return;
+	}
 
-	/* Cleanup */
-	g_free(nexrad_url);
+	if(objRadarAnimation->aAnimationCurrentFileSortedSubframes != NULL) g_array_free(objRadarAnimation->aAnimationCurrentFileSortedSubframes, true);
+	objRadarAnimation->aAnimationCurrentFileSortedSubframes = aSubframes;
+	objRadarAnimation->iAnimationSubframeNbr = CLAMP(objRadarAnimation->iAnimationSubframeNbr, 0, MAX((int)aSubframes->len - 1, 0));
+}
 
-	/* Cleanup the sorted list - contained strings are pointers to 'files' strings and don't need to be deleted. */
-	g_list_free(objFilesListByTimeDesc);
+/* Moves the playhead from the staged frame back to the visible frame */
+static void _animation_unstage_frame(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	if(!objRadarAnimation->lAnimationFrameStaged)
+		return;
 
-	/* Cleanup the list */
-	g_list_foreach(files, (GFunc)g_free, NULL);
-	g_list_free(files);
+	objRadarAnimation->lAnimationFrameStaged = false;
+	if(!objRadarAnimation->lAnimationFrameVisible)
+		return; /* Nothing was shown yet. Stay on the staged frame */
 
+	objRadarAnimation->iAnimationCurrentFrame = objRadarAnimation->iPreviousLevel2FrameThatWasVisible;
+	objRadarAnimation->iAnimationSubframeNbr = objRadarAnimation->iAnimationVisibleSubframeNbr;
+	_animation_refresh_current_frame_subframes(site);
+}
 
-	/* Hide the existing level2 radar scan so our animation frame is the only thing currently visible */
-	grits_object_hide(GRITS_OBJECT(site->level2), true);
-	
-	/* Set the loading flag to indicate that we are done loading */
-	objRadarAnimation->lAnimationLoading = false;
-	objRadarAnimation->iAnimationCurrentFrame = 0;
-	objRadarAnimation->iAnimationSubframeNbr = 0;
+/* Marks the frame iAnimationCurrentFrame / iAnimationSubframeNbr point to as staged and starts preparing it (sweep texture and isosurface),
+ * so it is ready by the time the scheduler has to show it.
+ */
+static void _animation_prepare_current_frame(RadarSite* site, bool iplStartsLoop){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
-	/* Reset the prev frame store, as this stores the Level2 file the user was previously looking at, allowing us to hide it to show the next frame */
-	objRadarAnimation->iPreviousLevel2FrameThatWasVisible = 0;
+	objRadarAnimation->lAnimationFrameStaged = true;
+	objRadarAnimation->lAnimationStagedFrameStartsLoop = iplStartsLoop;
+	objRadarAnimation->iAnimationStagedVolumeId = site->level2->iSelectedVolumeId;
+	objRadarAnimation->dAnimationStagedElevation = site->level2->dSelectedElevation;
 
-	/* Stores the times that the current loop of the animation starts and finishes at before we commit these values to the GUI */
-	time_t iPreliminaryAnimationStartTime = -1;
-	time_t iPreliminaryAnimationFinishTime = -1;
+	/* Switch to the correct sweep of the current level2 file if needed. */
+	RslSweepDateTime objCurrentSweep = g_array_index(objRadarAnimation->aAnimationCurrentFileSortedSubframes, RslSweepDateTime, objRadarAnimation->iAnimationSubframeNbr);
+	AWeatherLevel2* objCurrentLevel2 = objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame];
 
-	/* Stores false unless the GUI thread pokes us while we are sleeping so we know to update which volume / sweep is displayed. */
-	bool lDidWeGetPockedWhileSleeping = false;
+	/* The sweep is changed asynchronously in an idle callback, which runs before the next frame clock tick. The scheduler waits for it to finish before showing the frame. */
+	if(objCurrentLevel2->iSelectedVolumeId != objCurrentSweep.iVolumeId
+		|| objCurrentLevel2->iSelectedSweepId != objCurrentSweep.iSweepId){
+		aweather_level2_set_sweep(objCurrentLevel2, objCurrentSweep.iVolumeId, objCurrentSweep.iSweepId);
+	}
 
-	/* Loop through the frames until we are told to stop animating */
-	while(objRadarAnimation->lUserWantsToAnimate){
-		if(objRadarAnimation->lIsAnimationPaused){
-			if(objRadarAnimation->eAnimationNextFrameMode != NEXT_FRAME_UNCHANGED)
-				/* If the animation is paused and the user requested us to advance to the next frame, then advance one frame (or go back one frame) and clear the frame 'needs to advance flag'. */
-				_animation_goto_next_frame(site, objRadarAnimation->eAnimationNextFrameMode);
-			else {
-				/* If no frame change is needed, then advance by one frame and go back by one frame to ensure we update the selected volume and elevation of the animation on the current frame */
-				_animation_goto_next_frame(site, NEXT_FRAME_FORWARD);
-				_animation_goto_next_frame(site, NEXT_FRAME_BACKWARDS);
-			}
-			objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_UNCHANGED;
-		} else {
-			if(lDidWeGetPockedWhileSleeping){
-				/* We got poked between frames - do not advance to the next frame automatically. Instead, switch to the next frame, then go backwards to refresh what is displayed so we
-				 * keep the displayed sweep / volume in sync with what the user selected.
-				 */
-				_animation_goto_next_frame(site, NEXT_FRAME_FORWARD);
-				_animation_goto_next_frame(site, NEXT_FRAME_BACKWARDS);
-			} else if(_animation_goto_next_frame(site, objRadarAnimation->eAnimationNextFrameMode)){
-				/* We hit the end of the loop. Run end of loop logic here */
-
-				/* If we are starting over, then add an extra delay to let the user know we hit the end of the loop */
-				if(!lDidWeGetPockedWhileSleeping){
-					/* Sync current user preference for animation frame interval ms setting to our local variable when the animation hits the end frame. */
-					updateIAnimationFrameIntervalMs();
-
-					/* As long as we weren't poked during our frame transition sleep, then sleep some more for the end of loop delay */
-					lDidWeGetPockedWhileSleeping = _animation_thread_usleep_or_wakeup_from_poke(site, iAnimationEndFrameHoldMs * 1000);
-				}
+	/* If we need to set the iso on this volume (not in sync with the current site), then set it. This allows us to animate the 3D radar.
+	 * If the volume is not defined on the level2 object, then this means that the iso has not yet been set.
+	 */
+	if(site->level2->volume != NULL
+		&& (objCurrentLevel2->volume == NULL || objCurrentLevel2->volume->level != site->level2->volume->level)){
+		g_debug("_animation_prepare_current_frame: Setting level iso level to %f", site->level2->volume->level);
+		aweather_level2_set_iso(objCurrentLevel2, site->level2->volume->level, true /* generate isosurface asynchronously */);
+	}
+}
 
-				/* Loop finished - commit the start and finish times of this loop to the UI and clear out the variables so we can calculate them again in the next loop */
-				objRadarAnimation->iAnimationStartTime = iPreliminaryAnimationStartTime;
-				objRadarAnimation->iAnimationFinishTime = iPreliminaryAnimationFinishTime;
-				iPreliminaryAnimationStartTime = -1;
-				iPreliminaryAnimationFinishTime = -1;
-			} /* If we hit the end of the loop */
-		} /* If the animation is not paused */
-
-
-		/* Switch to the correct sweep of the current level2 file if needed. */
-		RslSweepDateTime objCurrentSweep = g_array_index(objRadarAnimation->aAnimationCurrentFileSortedSubframes, RslSweepDateTime, objRadarAnimation->iAnimationSubframeNbr);
-		AWeatherLevel2* objCurrentLevel2 = objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame];
-
-		/* If the sweep or volume needs to be changed before displaying this frame, then change it */
-		if(objCurrentLevel2->iSelectedVolumeId != objCurrentSweep.iVolumeId
-			|| objCurrentLevel2->iSelectedSweepId != objCurrentSweep.iSweepId){
-			/* The sweep is changed asynchronously. Thus, we must run the hide / show of the next frame logic after that sweep swap is done by using the callback */
-			objCurrentLevel2->objAfterSetSweepOneTimeCustomCallbackData = (gpointer) objRadarAnimation;
-			objCurrentLevel2->fAfterSetSweepOneTimeCustomCallback = switchToNextFrame;
-			aweather_level2_set_sweep(objCurrentLevel2, objCurrentSweep.iVolumeId, objCurrentSweep.iSweepId);
-		} else {
-			/* No sweep change is needed. Just swap the frames directly */
-			switchToNextFrame((gpointer) objRadarAnimation);
-		}
+/* Moves the animation one frame in the requested direction and stages that frame. NEXT_FRAME_UNCHANGED re-stages the visible frame,
+ * which is used to keep the displayed sweep / volume in sync with what the user selected.
+ * Returns false if the frame is still being read back from the disk cache. Try again on a later tick.
+ */
+static bool _animation_stage_frame(RadarSite* site, NextFrameMode ipeNextFrameMode){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	bool lStartsLoop = false;
+
+	switch(ipeNextFrameMode){
+		case NEXT_FRAME_FORWARD:
+			/* Frames are always staged going forwards, so a staged frame is already the one we want */
+			if(objRadarAnimation->lAnimationFrameStaged)
+				return true;
+			if(!_animation_is_next_frame_resident(site, NEXT_FRAME_FORWARD))
+				return false;
+			lStartsLoop = _animation_goto_next_frame(site, NEXT_FRAME_FORWARD);
+			break;
+		case NEXT_FRAME_BACKWARDS:
+			/* Step back from the staged frame to the visible frame first */
+			_animation_unstage_frame(site);
+			if(!_animation_is_next_frame_resident(site, NEXT_FRAME_BACKWARDS))
+				return false;
+			_animation_goto_next_frame(site, NEXT_FRAME_BACKWARDS);
+			break;
+		case NEXT_FRAME_UNCHANGED:
+			/* Go back to the visible frame and pick its subframes for the elevation or volume the user selected. */
+			_animation_unstage_frame(site);
+			_animation_refresh_current_frame_subframes(site);
+			break;
+	}
 
-		/* If we need to set the iso on this volume (not in sync with the current site), then set it. This allows us to animate the 3D radar.
-		 * If the volume is not defined on the level2 object, then this means that the iso has not yet been set.
-		 */
-		g_debug("_animation_update_thread: Checking if we should set level. objCurrentLevel2->volume: %p, site->level2->volume: %p", objCurrentLevel2->volume, site->level2->volume);
-		if(site->level2->volume != NULL
-			&& (objCurrentLevel2->volume == NULL || objCurrentLevel2->volume->level != site->level2->volume->level)){
-			g_debug("_animation_update_thread: Setting level iso level to %f", site->level2->volume->level);
-			aweather_level2_set_iso(objCurrentLevel2, site->level2->volume->level, false /* generate isosurface synchronously */);
-		}
+	_animation_prepare_current_frame(site, lStartsLoop);
+	return true;
+}
 
-		/* If the timestamp string was consumed by the UI thread, then produce a new timestamp message for the UI */
-		if(objRadarAnimation->cAnimationCurrentFrameTimestampMsg == NULL){
-			objRadarAnimation->cAnimationCurrentFrameTimestampMsg = formatSweepStartAndEndTimeForDisplay(&objCurrentSweep.startDateTime, &objCurrentSweep.finishDateTime);
-			g_debug("_animation_update_thread: Updating animation frame timestamp msg: %s, objRadarAnimation->iAnimationSubframeNbr: %i", objRadarAnimation->cAnimationCurrentFrameTimestampMsg, objRadarAnimation->iAnimationSubframeNbr);
+/* Stages the frame after the one that was just shown and works out when it is due. ipiDueTime is the time the frame that was just shown was due.
+ * The next frame is due one interval later (plus the end of loop hold), which keeps the loop from drifting when a frame is shown late.
+ * If that time has already passed, we are more than a frame behind, so frames are skipped and counted as dropped instead of being shown late.
+ */
+static void _animation_stage_next_frame_on_schedule(RadarSite* site, gint64 ipiDueTime, gint64 ipiNow){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	gint64 iDeadline = ipiDueTime;
+	bool lStartsLoop = false;
+	int iFramesMoved = 0;
+
+	while(iFramesMoved == 0
+		|| (iDeadline <= ipiNow && iFramesMoved <= objRadarAnimation->iAnimationFrames)){
+		/* Frames that are not in memory yet cannot be skipped over */
+		if(!_animation_is_next_frame_resident(site, NEXT_FRAME_FORWARD))
+			break;
+
+		bool lWrapped = _animation_goto_next_frame(site, NEXT_FRAME_FORWARD);
+		if(lWrapped){
+			/* Sync current user preference for animation frame interval ms setting when the animation hits the end frame. */
+			_animation_update_frame_interval_from_prefs(site);
+			iDeadline += (gint64)objRadarAnimation->iAnimationEndFrameHoldMs * 1000;
 		}
+		iDeadline += (gint64)MAX(objRadarAnimation->iAnimationFrameIntervalMs, 1) * 1000;
+		lStartsLoop = lStartsLoop || lWrapped;
+		iFramesMoved++;
+	}
+
+	if(iFramesMoved == 0){
+		/* The next frame is still being read from the disk cache. The tick stages it once it arrives, and it counts as late if it misses this deadline. */
+		objRadarAnimation->iAnimationNextFrameDeadline = ipiDueTime + (gint64)MAX(objRadarAnimation->iAnimationFrameIntervalMs, 1) * 1000;
+		return;
+	}
 
-		objRadarAnimation->iAnimationCurrentFrameTime = getTimeTFromRslDateTime(&objCurrentSweep.startDateTime);
-		iPreliminaryAnimationStartTime = (iPreliminaryAnimationStartTime == -1 ? objRadarAnimation->iAnimationCurrentFrameTime : MIN(iPreliminaryAnimationStartTime, objRadarAnimation->iAnimationCurrentFrameTime));
-		iPreliminaryAnimationFinishTime = (iPreliminaryAnimationFinishTime == -1 ? objRadarAnimation->iAnimationCurrentFrameTime : MAX(iPreliminaryAnimationFinishTime, objRadarAnimation->iAnimationCurrentFrameTime));
+	if(iDeadline <= ipiNow && iFramesMoved > objRadarAnimation->iAnimationFrames){
+		/* We are more than a whole loop behind. This happens when the frame clock stops, e.g. while the window is minimized. Start the schedule over instead of counting drops. */
+		iDeadline = ipiNow + (gint64)MAX(objRadarAnimation->iAnimationFrameIntervalMs, 1) * 1000;
+	} else {
+		objRadarAnimation->iAnimationFramesDropped += iFramesMoved - 1;
+	}
 
+	objRadarAnimation->iAnimationNextFrameDeadline = iDeadline;
+	_animation_prepare_current_frame(site, lStartsLoop);
+}
 
-		/* Trigger the radar images to be redrawn */
-		grits_viewer_queue_draw(site->viewer);
+/* Returns true once the staged frame finished switching to its sweep */
+static bool _animation_is_staged_frame_ready(RadarAnimation* objRadarAnimation){
+	AWeatherLevel2* objCurrentLevel2 = objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame];
+	return objCurrentLevel2->sweep == objCurrentLevel2->objSelectedRslSweep;
+}
 
-		/* If there is not already a main thread request ongoing, then create a new request */
-		if(!objRadarAnimation->iAnimationFrameChangeIdleSource){
-			objRadarAnimation->iAnimationFrameChangeIdleSource = g_idle_add(_animation_update_status_ui_g_idle_add, site);
-		}
+/* Shows the staged frame and syncs the animation UI with it. Must run on the UI thread. */
+static void _animation_present_staged_frame(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	RslSweepDateTime objCurrentSweep = g_array_index(objRadarAnimation->aAnimationCurrentFileSortedSubframes, RslSweepDateTime, objRadarAnimation->iAnimationSubframeNbr);
+
+	if(objRadarAnimation->lAnimationStagedFrameStartsLoop){
+		/* Loop finished - commit the start and finish times of this loop to the UI and clear out the variables so we can calculate them again in the next loop */
+		objRadarAnimation->iAnimationStartTime = objRadarAnimation->iPreliminaryAnimationStartTime;
+		objRadarAnimation->iAnimationFinishTime = objRadarAnimation->iPreliminaryAnimationFinishTime;
+		objRadarAnimation->iPreliminaryAnimationStartTime = -1;
+		objRadarAnimation->iPreliminaryAnimationFinishTime = -1;
+	}
 
-		/* Calculate how long to sleep for in microseconds, then sleep for that long. */
-		gint64 iSleepMilliseconds = iAnimationFrameIntervalMs;
-		if(objRadarAnimation->lIsAnimationPaused == true
-			&& objRadarAnimation->eAnimationNextFrameMode == NEXT_FRAME_UNCHANGED){
-			/* If we are paused, set the sleep time to 10 minutes becuase there is no need to do anything here unless the user presses a button */
-			iSleepMilliseconds = 1000 * 60 * 10;
-		}
-		lDidWeGetPockedWhileSleeping = _animation_thread_usleep_or_wakeup_from_poke(site, iSleepMilliseconds * 1000);
+	switchToNextFrame(objRadarAnimation);
+	objRadarAnimation->iAnimationVisibleSubframeNbr = objRadarAnimation->iAnimationSubframeNbr;
+	objRadarAnimation->lAnimationFrameVisible = true;
+	objRadarAnimation->lAnimationFrameStaged = false;
+	objRadarAnimation->lAnimationPresentAsap = false;
+
+	/* Show the timestamp of the new frame */
+	if(site->level2->date_label != NULL){
+		gchar* cTimestampMsg = formatSweepStartAndEndTimeForDisplay(&objCurrentSweep.startDateTime, &objCurrentSweep.finishDateTime);
+		gtk_label_set_markup(GTK_LABEL(site->level2->date_label), cTimestampMsg);
+		g_free(cTimestampMsg);
 	}
 
-	/* Show the existing static level2 radar scan and ensure our animation frames are hidden. */
-	grits_object_hide(GRITS_OBJECT(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationCurrentFrame]), true);
-	grits_object_hide(GRITS_OBJECT(site->level2), false);
+	objRadarAnimation->iAnimationCurrentFrameTime = getTimeTFromRslDateTime(&objCurrentSweep.startDateTime);
+	objRadarAnimation->iPreliminaryAnimationStartTime = (objRadarAnimation->iPreliminaryAnimationStartTime == -1 ? objRadarAnimation->iAnimationCurrentFrameTime : MIN(objRadarAnimation->iPreliminaryAnimationStartTime, objRadarAnimation->iAnimationCurrentFrameTime));
+	objRadarAnimation->iPreliminaryAnimationFinishTime = (objRadarAnimation->iPreliminaryAnimationFinishTime == -1 ? objRadarAnimation->iAnimationCurrentFrameTime : MAX(objRadarAnimation->iPreliminaryAnimationFinishTime, objRadarAnimation->iAnimationCurrentFrameTime));
 
-	/* Cleanup */
+	/* Trigger the radar images to be redrawn */
+	grits_viewer_queue_draw(site->viewer);
 
-	/* Wait for the set sweep callback we set above to finish running if it hasn't run yet. Since the function exists within the context of this function, it will be gone once this function exits.
-	 * We must check each level2 frame.
-	 */
-	for(int iCurrentLevel2 = 0; iCurrentLevel2 < objRadarAnimation->iAnimationFrames; ++iCurrentLevel2){
-		while(atomic_load(&objRadarAnimation->aAnimationLevel2Frames[iCurrentLevel2]->fAfterSetSweepOneTimeCustomCallback) != NULL){
-			g_usleep(1000); /* Wait 1ms */
+	_animation_update_status_ui(site, NULL);
+}
+
+/* Stops the scheduler, destroys the animation frames and shows the static level2 radar scan again. Must run on the UI thread once the loading thread has finished. */
+static void _animation_cleanup(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+
+	if(objRadarAnimation->iAnimationTickCallbackId){
+		gtk_widget_remove_tick_callback(GTK_WIDGET(site->viewer), objRadarAnimation->iAnimationTickCallbackId);
+		objRadarAnimation->iAnimationTickCallbackId = 0;
+	}
+
+	/* Stop the disk cache reader, dropping any reads that did not start yet, and free the frames it already read */
+	if(objRadarAnimation->objAnimationFrameReaderPool != NULL){
+		g_thread_pool_free(objRadarAnimation->objAnimationFrameReaderPool, TRUE, TRUE);
+		objRadarAnimation->objAnimationFrameReaderPool = NULL;
+	}
+	if(objRadarAnimation->objAnimationFrameReadQueue != NULL){
+		AnimationFrameRead* objRead;
+		while((objRead = g_async_queue_try_pop(objRadarAnimation->objAnimationFrameReadQueue)) != NULL){
+			if(objRead->objLevel2 != NULL)
+				g_object_unref(objRead->objLevel2);
+			g_free(objRead);
 		}
+		g_async_queue_unref(objRadarAnimation->objAnimationFrameReadQueue);
+		objRadarAnimation->objAnimationFrameReadQueue = NULL;
 	}
 
+	/* Show the existing static level2 radar scan and ensure our animation frames are hidden. */
+	if(objRadarAnimation->iAnimationFrames > 0 && objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iPreviousLevel2FrameThatWasVisible] != NULL)
+		grits_object_hide(GRITS_OBJECT(objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iPreviousLevel2FrameThatWasVisible]), true);
+	if(site->level2)
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+
 	if(objRadarAnimation->aAnimationCurrentFileSortedSubframes != NULL) g_array_free(objRadarAnimation->aAnimationCurrentFileSortedSubframes, true);
 	objRadarAnimation->aAnimationCurrentFileSortedSubframes = NULL;
 
 	for(int iFrame = 0; iFrame < objRadarAnimation->iAnimationFrames; ++iFrame){
-		grits_object_destroy_pointer(&objRadarAnimation->aAnimationLevel2Frames[iFrame]);
+		if(objRadarAnimation->aAnimationLevel2Frames[iFrame] != NULL)
+			grits_object_destroy_pointer(&objRadarAnimation->aAnimationLevel2Frames[iFrame]);
 	}
 	g_free(objRadarAnimation->aAnimationLevel2Frames);
 	objRadarAnimation->aAnimationLevel2Frames = NULL;
 
+	g_strfreev(objRadarAnimation->aAnimationFrameFiles);
+	objRadarAnimation->aAnimationFrameFiles = NULL;
+	g_free(objRadarAnimation->aAnimationFrameSizes);
+	objRadarAnimation->aAnimationFrameSizes = NULL;
+	g_free(objRadarAnimation->aAnimationFrameReadPending);
+	objRadarAnimation->aAnimationFrameReadPending = NULL;
+	objRadarAnimation->iAnimationResidentBytes = 0;
+	objRadarAnimation->iAnimationResidentFrames = 0;
+	objRadarAnimation->lAnimationFrameVisible = false;
+
 	objRadarAnimation->iAnimationCurrentFrame = 0;
 	objRadarAnimation->iAnimationFrames = 0;
+	objRadarAnimation->lAnimationFrameStaged = false;
 	objRadarAnimation->lIsAnimationCleanupInProgress = true;
 
 	/* Update the UI one last time to reflect the new animation state. */
-	objRadarAnimation->iAnimationFrameChangeIdleSource = g_idle_add(_animation_update_status_ui_g_idle_add, site);
+	_animation_update_status_ui(site, NULL);
 
 	/* Trigger the original radar image to be redrawn. */
 	grits_viewer_queue_draw(site->viewer);
-
-	return NULL;
 }
 
-/* Starts the animation if site->objRadarAnimation->lUserWantsToAnimate is set to TRUE */
-void _start_animation_if_user_requested_it_to_start(RadarSite* site){
-	/* Start the background thread to load the animation frames and run the animation if the user wants to animate and we are not currently animating.
-	 * Note that if there is no level2 for this current site (radar failed to load / process), then we cannot start the animation, as the container hbox will not exist. */
-	if(site->objRadarAnimation->lUserWantsToAnimate
-		&& !site->objRadarAnimation->lIsAnimating
-		&& site->level2 != NULL
-		/* If a sweep is not yet selected, then there is no sweep to select (a sweep is selected if possible on load). Thus, do not allow the animation to start as doing so could cause the animation loop to get stuck. */
-		&& site->level2->iSelectedSweepId != AWEATHER_LEVEL2_SELECTED_SWEEP_ID_NONE){
-		site->objRadarAnimation->lIsAnimating = true; /* Set to TRUE so the user cannot spawn a new background thread until the previous animation finished completely */
+/* Called by the scheduler tick once the loading task finished loading the animation frames. Starts playing them.
+ * Returns false if there is nothing to play and the animation has to be cleaned up.
+ */
+static bool _animation_on_loading_done(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
-		/* If the previous thread pointer still exists, then clean it up before we start a new thread. */
-		if(site->objRadarAnimation->objAnimationThread != NULL){
-			g_thread_join(site->objRadarAnimation->objAnimationThread);
-			site->objRadarAnimation->objAnimationThread = NULL;
-		}
+	g_clear_object(&objRadarAnimation->objAnimationCancellable);
 
+	/* Set the loading flag to indicate that we are done loading */
+	objRadarAnimation->lAnimationLoading = false;
 
-		/* Initialize the GMutex and GCond so we can interrupt the animation thread between frames */
-		g_mutex_init(&site->objRadarAnimation->objBtnPressedGMutex);
-		g_cond_init(&site->objRadarAnimation->objBtnPressedGCond);
+	if(!objRadarAnimation->lUserWantsToAnimate || objRadarAnimation->iAnimationFrames == 0){
+		/* The user stopped the animation while it was loading or no frames could be loaded */
+		return false;
+	}
 
-		/* Add an event listener so the user can control the animation with their keyboard */
-		_setup_animation_keyboard_event_listeners(site);
+	/* Hide the existing level2 radar scan so our animation frame is the only thing currently visible */
+	grits_object_hide(GRITS_OBJECT(site->level2), true);
 
-		site->objRadarAnimation->objAnimationThread = g_thread_new("animation-update-thread", _animation_update_thread, site);
-	}
-}
+	objRadarAnimation->iAnimationCurrentFrame = 0;
+	objRadarAnimation->iAnimationSubframeNbr = 0;
 
-/* Sends a request to the animation thread, telling it to stop, then waits for it to finish all necessary cleanup. Safes the user's desired animation state to the site->objRadarAnimation->lUserWantsToAnimate variable. */
-void _stop_animation_and_wait_for_animation_to_stop_save_user_choice(RadarSite* site){
-	/* The user selected another time from the time selection list on the right. If the animation is running currently,
-	 * we need to stop it, then restart it when the default layer finishes loading. Thus, the animation will now finish
-	 * at the time the user selected.
-	 */
-	if(site->objRadarAnimation->lIsAnimating){
-		bool lUserWantsToAnimateNow = site->objRadarAnimation->lUserWantsToAnimate;
-		site->objRadarAnimation->lUserWantsToAnimate = false; /* Tell the animation thread to stop running */
-		_poke_animation_thread(site); /* poke the animation thread so that if it is sleeping currently, it will wake up and cleanup the animation */
+	/* Reset the prev frame store, as this stores the Level2 file the user was previously looking at, allowing us to hide it to show the next frame */
+	objRadarAnimation->iPreviousLevel2FrameThatWasVisible = 0;
 
-		/* Wait for the callback that the animation thread triggered to run, which will cleanup the remaining animation objects on the UI thread  */
-		while(atomic_load(&site->objRadarAnimation->lIsAnimating)){
-			gtk_main_iteration();
-		}
+	objRadarAnimation->iPreliminaryAnimationStartTime = -1;
+	objRadarAnimation->iPreliminaryAnimationFinishTime = -1;
 
-		g_thread_join(site->objRadarAnimation->objAnimationThread); /* Wait for the animation process to finish - it should be done running now. */
-		site->objRadarAnimation->objAnimationThread = NULL;
+	objRadarAnimation->iAnimationFramesPresented = 0;
+	objRadarAnimation->iAnimationFramesDropped = 0;
+	objRadarAnimation->iAnimationJitterSumUs = 0;
+	objRadarAnimation->iAnimationJitterMaxUs = 0;
 
-		/* Reset the user wants to animate flag so we can resume the animation later if needed */
-		site->objRadarAnimation->lUserWantsToAnimate = lUserWantsToAnimateNow;
-	}
-}
+	/* Sync current user preference for animation frame interval ms setting */
+	_animation_update_frame_interval_from_prefs(site);
 
-void _on_animateButton_clicked(GtkButton *button, RadarSite* site){
-	site->objRadarAnimation->lUserWantsToAnimate = !site->objRadarAnimation->lUserWantsToAnimate;
-	if(site->objRadarAnimation->lUserWantsToAnimate){
-		_start_animation_if_user_requested_it_to_start(site);
-	} else {
-		_poke_animation_thread(site); /* If we are trying to stop the animation, poke it so it wakes up and finishes right away. */
+	/* Frames that did not fit in the memory budget are read back from the disk cache ahead of the playhead */
+	if(objRadarAnimation->iAnimationResidentFrames < objRadarAnimation->iAnimationFrames){
+		g_debug("_animation_on_loading_done: %i of %i frames fit in the memory budget", objRadarAnimation->iAnimationResidentFrames, objRadarAnimation->iAnimationFrames);
+		objRadarAnimation->objAnimationFrameReadQueue = g_async_queue_new();
+		objRadarAnimation->objAnimationFrameReaderPool = g_thread_pool_new(_animation_frame_reader, site, 1, FALSE, NULL);
 	}
+
+	/* Stage the first frame (stepping forward from the newest frame wraps to the oldest) and show it as soon as it is ready.
+	 * If the first frame is not in memory, the tick stages it once it was read back.
+	 */
+	objRadarAnimation->lAnimationFrameVisible = false;
+	objRadarAnimation->lAnimationFrameStaged = false;
+	objRadarAnimation->iAnimationStagedVolumeId = site->level2->iSelectedVolumeId;
+	objRadarAnimation->dAnimationStagedElevation = site->level2->dSelectedElevation;
+	_animation_stage_frame(site, NEXT_FRAME_FORWARD);
+	objRadarAnimation->lAnimationPresentAsap = true;
+
+	_animation_update_status_ui(site, NULL);
+	return true;
 }
 
-GtkWidget* _getAnimateUi(RadarSite* site){
-	/* Add the animation UI buttons to the scroll box - each button is 5 px apart. */
-	GtkWidget *hbox = gtk_hbox_new(FALSE, 5);
-	site->objRadarAnimation->objAnimateButton = gtk_button_new_with_label("Animate");
-	gtk_widget_set_size_request(site->objRadarAnimation->objAnimateButton, 100, 30);
-	gtk_box_pack_start(GTK_BOX(hbox), site->objRadarAnimation->objAnimateButton, FALSE, FALSE, 0);
+/* Picks up the progress the loading task published since the last tick and starts playing once it is done.
+ * Returns false if the animation has to be cleaned up. Must run on the UI thread.
+ */
+static bool _animation_poll_loading(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
 
-	/* Add click event listener */
-	g_signal_connect(site->objRadarAnimation->objAnimateButton, "clicked", G_CALLBACK(_on_animateButton_clicked), site);
+	if(!objRadarAnimation->lUserWantsToAnimate && !g_cancellable_is_cancelled(objRadarAnimation->objAnimationCancellable)){
+		/* The user stopped the animation while it was loading. Interrupt the download and decode in progress, the task says it is done right after. */
+		g_cancellable_cancel(objRadarAnimation->objAnimationCancellable);
+	}
 
-	/* Add a progress bar to the right of the animate button */
-	site->objRadarAnimation->objAnimateProgressBar = gtk_progress_bar_new();
-	gtk_widget_set_size_request(site->objRadarAnimation->objAnimateProgressBar, 100, 30);
-	gtk_box_pack_start(GTK_BOX(hbox), site->objRadarAnimation->objAnimateProgressBar, FALSE, FALSE, 0);
+	/* Only the latest snapshot is shown */
+	AnimationLoadProgress objProgress;
+	bool lHaveProgress = false;
+	while(_animation_load_channel_pop(&objRadarAnimation->objAnimationLoadChannel, &objProgress))
+		lHaveProgress = true;
+
+	/* The task may still be returning after it said it was done, or still be queued when the user stopped the animation. Either way, it is finished without waiting on it */
+	if((g_atomic_int_get(&objRadarAnimation->objAnimationLoadChannel.lDone) || !objRadarAnimation->lUserWantsToAnimate)
+		&& radar_pool_task_try_finish(site->pool, objRadarAnimation->objAnimationLoadTask)){
+		objRadarAnimation->objAnimationLoadTask = NULL;
+	}
+	if(objRadarAnimation->objAnimationLoadTask != NULL){
+		if(lHaveProgress)
+			_animation_update_status_ui(site, &objProgress);
+		return true;
+	}
+	return _animation_on_loading_done(site);
+}
+
+/* Tick callback on the viewer's frame clock that runs the animation loop. Frames are shown on fixed deadlines, so the time it takes to draw a frame
+ * does not stretch the loop. Runs on the UI thread once per frame, so button presses and sweep changes are picked up right away.
+ * While the frames are loading, it shows the progress of the loading task instead.
+ */
+static gboolean _animation_on_frame_clock_tick(GtkWidget* ipobjWidget, GdkFrameClock* ipobjFrameClock, gpointer _site){
+	RadarSite* site = _site;
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+
+	if(objRadarAnimation->lAnimationLoading){
+		/* Commands posted while the frames are loading are acted on once playback starts */
+		if(_animation_poll_loading(site) && objRadarAnimation->lAnimationLoading)
+			return G_SOURCE_CONTINUE;
+	}
+
+	if(!objRadarAnimation->lUserWantsToAnimate || objRadarAnimation->iAnimationFrames == 0){
+		/* The user stopped the animation or no frames could be loaded. The callback is removed by returning G_SOURCE_REMOVE. */
+		objRadarAnimation->iAnimationTickCallbackId = 0;
+		_animation_cleanup(site);
+		return G_SOURCE_REMOVE;
+	}
+
+	gint64 iNow = gdk_frame_clock_get_frame_time(ipobjFrameClock);
+
+	/* Pick up frames read back from the disk cache and keep reading ahead of the playhead */
+	_animation_install_read_frames(site);
+	_animation_read_ahead(objRadarAnimation);
+
+	/* Act on the buttons the user pressed since the last tick */
+	_animation_apply_commands(site);
+
+	if(objRadarAnimation->lAnimationFrameVisible
+		&& (objRadarAnimation->iAnimationStagedVolumeId != site->level2->iSelectedVolumeId
+		|| !aweatherLevel2AreTheseElevationsTheSame(objRadarAnimation->dAnimationStagedElevation, site->level2->dSelectedElevation))){
+		/* The user selected a different sweep or volume. Refresh the visible frame so it matches and show it right away. */
+		_animation_stage_frame(site, NEXT_FRAME_UNCHANGED);
+		objRadarAnimation->lAnimationPresentAsap = true;
+	} else if(objRadarAnimation->lIsAnimationPaused){
+		if(objRadarAnimation->eAnimationNextFrameMode != NEXT_FRAME_UNCHANGED){
+			/* If the animation is paused and the user requested us to advance to the next frame, then advance one frame (or go back one frame) and clear the frame 'needs to advance flag'.
+			 * If the frame is still being read from the disk cache, keep the request until it arrives.
+			 */
+			if(_animation_stage_frame(site, objRadarAnimation->eAnimationNextFrameMode)){
+				objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_UNCHANGED;
+				objRadarAnimation->lAnimationPresentAsap = true;
+			}
+		}
+	} else if(!objRadarAnimation->lAnimationFrameStaged){
+		_animation_stage_frame(site, NEXT_FRAME_FORWARD);
+	}
+
+	/* Wait for the staged frame to finish switching sweeps. If it misses its deadline, the lateness is recorded as jitter when it is shown. */
+	if(!objRadarAnimation->lAnimationFrameStaged
+		|| !_animation_is_staged_frame_ready(objRadarAnimation)){
+		return G_SOURCE_CONTINUE;
+	}
+
+	gint64 iDueTime = iNow;
+	if(!objRadarAnimation->lAnimationPresentAsap){
+		if(objRadarAnimation->lIsAnimationPaused || iNow < objRadarAnimation->iAnimationNextFrameDeadline){
+			return G_SOURCE_CONTINUE;
+		}
+
+		gint64 iJitterUs = iNow - objRadarAnimation->iAnimationNextFrameDeadline;
+		objRadarAnimation->iAnimationFramesPresented++;
+		objRadarAnimation->iAnimationJitterSumUs += iJitterUs;
+		objRadarAnimation->iAnimationJitterMaxUs = MAX(objRadarAnimation->iAnimationJitterMaxUs, iJitterUs);
+		iDueTime = objRadarAnimation->iAnimationNextFrameDeadline;
+	}
+
+	_animation_present_staged_frame(site);
+
+	/* While playing, start preparing the next frame now so it is ready at its deadline */
+	if(!objRadarAnimation->lIsAnimationPaused){
+		_animation_stage_next_frame_on_schedule(site, iDueTime, iNow);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Adds a frame loaded by _animation_update_thread to the end of the animation, taking ownership of file and objLevel2 (which may be NULL if loading failed) */
+static void _animation_add_loaded_frame(RadarSite* site, gchar* file, AWeatherLevel2* objLevel2){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	objRadarAnimation->aAnimationLevel2Frames[objRadarAnimation->iAnimationFrames] = NULL;
+
+	if (!objLevel2) {
+		g_debug("_animation_add_loaded_frame. We failed to load a frame. Skipping it. File: %s", file);
+		g_free(file);
+		return;
+	}
+
+	int iFrame = objRadarAnimation->iAnimationFrames;
+	gsize iFrameSize = aweather_level2_get_memory_size(objLevel2);
+	objRadarAnimation->aAnimationFrameFiles[iFrame] = file;
+
+	/* If a loop of frames this size will not fit in the memory budget, write the frame to the disk cache in a form that is quick to read back.
+	 * This is done here so the UI thread only has to drop frames, never write them.
+	 */
+	if(iFrameSize * objRadarAnimation->iAnimationFrameLimit > objRadarAnimation->iAnimationMemoryBudgetBytes){
+		aweather_level2_write_spill_file(objLevel2, file, site->prefs);
+	}
+
+	if(objRadarAnimation->iAnimationResidentFrames > 0
+		&& objRadarAnimation->iAnimationResidentBytes + iFrameSize > objRadarAnimation->iAnimationMemoryBudgetBytes){
+		/* Over the memory budget. Keep only the file name, the frame is read back when the playhead gets close to it */
+		g_debug("_animation_add_loaded_frame: frame %i does not fit in the memory budget. Dropping it from memory.", iFrame);
+		g_object_unref(objLevel2);
+	} else {
+		_animation_make_frame_resident(site, iFrame, objLevel2);
+	}
+
+	/* Frame successfully added. Increment the num frames counter */
+	objRadarAnimation->iAnimationFrames++;
+}
+
+/* Loads the animation frames from Level III products, for sites whose volume came from Level III. Walks backwards from the scan nearest to the site's time */
+static void _animation_update_level3(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	gchar *level3_url = grits_prefs_get_string(site->prefs, "aweather/level3_url", NULL);
+
+	GList* objScansByTimeDesc = aweather_level3_scans_list(site->download, SITE_CACHE_PREFIX, level3_url, site->city->code, site->time, objRadarAnimation->iAnimationFrameLimit, offline, objRadarAnimation->objAnimationCancellable);
+	for(GList *nearest = aweather_level3_scans_nearest(objScansByTimeDesc, site->time); !g_cancellable_is_cancelled(objRadarAnimation->objAnimationCancellable) && objRadarAnimation->iAnimationFrames < objRadarAnimation->iAnimationFrameLimit && nearest != NULL; nearest = nearest->next){
+		AWeatherLevel3Scan* objScan = nearest->data;
+		g_debug("_animation_update_level3: About to fetch frame %s", objScan->reflectivity);
+		gchar *file = NULL;
+		AWeatherLevel2* objLevel2 = aweather_level3_fetch(site->download, SITE_CACHE_PREFIX, level3_url, site->city->code, objScan, _get_colormaps(), offline, AWEATHER_DOWNLOAD_BACKGROUND, _animation_on_load_progress, site, objRadarAnimation->objAnimationCancellable, &file);
+		if (file)
+			_animation_add_loaded_frame(site, file, objLevel2);
+		else if (objLevel2)
+			g_object_unref(objLevel2);
+
+		/* Update the GUI with the latest file */
+		_animation_load_channel_push(&objRadarAnimation->objAnimationLoadChannel, objRadarAnimation->iAnimationFrames, -1, -1);
+	}
+
+	aweather_level3_scans_free(objScansByTimeDesc);
+	g_free(level3_url);
+}
+
+/* Download progress callback for the Level II animation frames. Runs on the fetch pool, the loading task publishes it */
+static void _animation_fetch_progress(gchar *file, goffset cur, goffset total, gpointer _fetch){
+	AnimationFrameFetch* objFetch = _fetch;
+	g_mutex_lock(&objFetch->objFetches->objMutex);
+	objFetch->iFileBytesDone = cur;
+	objFetch->iFileBytesTotal = total;
+	g_mutex_unlock(&objFetch->objFetches->objMutex);
+}
+
+/* Asks the disk for the next few frames that are already in the cache, so they are read while this one decodes.
+ * Replays from the cache are bound by reading one volume after another otherwise. */
+static void _animation_read_ahead_files(AnimationFrameFetches* objFetches, AnimationFrameFetch* aFetches, int ipiFrame, int ipiQueued, GritsPrefs* objPrefs){
+	gchar* aFiles[ANIMATION_READ_AHEAD_FRAMES];
+	int iFiles = 0;
+	g_mutex_lock(&objFetches->objMutex);
+	for(int iFrame = ipiFrame + 1; iFrame < ipiQueued && iFrame <= ipiFrame + ANIMATION_READ_AHEAD_FRAMES; iFrame++){
+		AnimationFrameFetch* objFetch = &aFetches[iFrame];
+		if(objFetch->lDone && objFetch->cFile != NULL && !objFetch->lReadAhead){
+			objFetch->lReadAhead = true;
+			aFiles[iFiles++] = g_strdup(objFetch->cFile);
+		}
+	}
+	g_mutex_unlock(&objFetches->objMutex);
+
+	for(int i = 0; i < iFiles; i++){
+		level2_file_readahead(aFiles[i], objPrefs);
+		g_free(aFiles[i]);
+	}
+}
+
+/* Runs on the fetch pool, downloads one Level II animation frame */
+static void _animation_fetch_frame(gpointer _fetch, gpointer _unused){
+	AnimationFrameFetch* objFetch = _fetch;
+	RadarSite* site = objFetch->objSite;
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	g_debug("_animation_fetch_frame: downloading %s from %s", objFetch->cName, objFetch->cMirrorUrl);
+	gchar* file = radar_mirrors_fetch(site->mirrors, site->download, SITE_CACHE_PREFIX,
+			site->city->code, objFetch->cMirrorUrl, objFetch->cName,
+			offline ? GRITS_LOCAL : GRITS_UPDATE, AWEATHER_DOWNLOAD_BACKGROUND,
+			_animation_fetch_progress, objFetch, site->objRadarAnimation->objAnimationCancellable);
+
+	g_mutex_lock(&objFetch->objFetches->objMutex);
+	objFetch->cFile = file;
+	objFetch->lDone = true;
+	g_cond_broadcast(&objFetch->objFetches->objCond);
+	g_mutex_unlock(&objFetch->objFetches->objMutex);
+}
+
+/* Loads the animation frames from Level II volumes, walking backwards from the volume nearest to the site's time.
+ * Frames are downloaded ahead of the one being decoded, round robin from the healthy mirrors so a loop does not wait on the slowest one.
+ */
+static void _animation_update_level2(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	gchar* cMirrorUrl = NULL;
+
+	/* Find nearest volume (temporally) */
+	g_debug("_animation_update_level2 - find nearest - %s", site->city->code);
+	GList *files = NULL;
+	if (site->spool) {
+		files = radar_spool_list(site->spool);
+	} else {
+		files = radar_mirrors_list(site->mirrors, site->download, SITE_CACHE_PREFIX,
+				site->city->code, offline, FALSE,
+				objRadarAnimation->objAnimationCancellable, &cMirrorUrl);
+	}
+
+	GList* objFilesListByTimeDesc = _find_nearest_return_GList_pointer(site->time, files, 5, true /* Sort the array so it is in a consistent order */);
+
+	/* Mirrors the downloads are spread across, the one that listed the volumes first */
+	int iHealthy = 0;
+	gchar** aMirrorUrls = cMirrorUrl ? radar_mirrors_rank(site->mirrors, site->city->code, &iHealthy) : NULL;
+	iHealthy = MAX(iHealthy, 1);
+	int iCandidates = g_list_length(objFilesListByTimeDesc);
+	AnimationFrameFetches objFetches;
+	g_mutex_init(&objFetches.objMutex);
+	g_cond_init(&objFetches.objCond);
+	AnimationFrameFetch* aFetches = g_new0(AnimationFrameFetch, MAX(iCandidates, 1));
+
+	/* One more download than there are mirrors, so the next frame is on its way while this one is decoded */
+	GThreadPool* objFetchPool = site->spool ? NULL : g_thread_pool_new(_animation_fetch_frame, NULL, iHealthy + 1, FALSE, NULL);
+
+	/* We want the file name that is closest to the current set time and the previous N files.
+	 * Hence, we request the list element itself, then iterate forwards in the double-linked list to find the desired file names that are older than the starting file to build up our animation.
+	 * Frames that fail to download are skipped, each one queues the download of one more older volume.
+	 * Stop early if the user stops the animation while we are loading (the scheduler tick cancels objAnimationCancellable).
+	 */
+	int iQueued = 0;
+	GList* objNextToQueue = objFilesListByTimeDesc;
+	for(int iCandidate = 0; !g_cancellable_is_cancelled(objRadarAnimation->objAnimationCancellable) && objRadarAnimation->iAnimationFrames < objRadarAnimation->iAnimationFrameLimit && iCandidate < iCandidates; iCandidate++){
+		/* Keep enough downloads queued to fill the rest of the animation */
+		while(objNextToQueue != NULL && iQueued - iCandidate < objRadarAnimation->iAnimationFrameLimit - objRadarAnimation->iAnimationFrames){
+			AnimationFrameFetch* objFetch = &aFetches[iQueued];
+			objFetch->objSite = site;
+			objFetch->objFetches = &objFetches;
+			objFetch->cName = g_strdup(objNextToQueue->data);
+			if(site->spool){
+				/* Spooled volumes are already local */
+				objFetch->cFile = radar_spool_path(site->spool, objFetch->cName);
+				objFetch->lDone = true;
+			} else {
+				objFetch->cMirrorUrl = g_strdup(aMirrorUrls ? aMirrorUrls[iQueued % iHealthy] : NULL);
+				g_thread_pool_push(objFetchPool, objFetch, NULL);
+			}
+			objNextToQueue = objNextToQueue->next;
+			iQueued++;
+		}
+
+		/* Wait for this frame's download, publishing its progress */
+		AnimationFrameFetch* objFetch = &aFetches[iCandidate];
+		g_debug("_animation_update_level2: Waiting for frame %s", objFetch->cName);
+		g_mutex_lock(&objFetches.objMutex);
+		while(!objFetch->lDone && !g_cancellable_is_cancelled(objRadarAnimation->objAnimationCancellable)){
+			gint64 iWakeUp = g_get_monotonic_time() + ANIMATION_FETCH_PROGRESS_MS * G_TIME_SPAN_MILLISECOND;
+			if(!g_cond_wait_until(&objFetches.objCond, &objFetches.objMutex, iWakeUp))
+				_animation_load_channel_push(&objRadarAnimation->objAnimationLoadChannel, objRadarAnimation->iAnimationFrames, objFetch->iFileBytesDone, objFetch->iFileBytesTotal);
+		}
+		gchar* file = NULL;
+		if(objFetch->lDone){
+			file = objFetch->cFile;
+			objFetch->cFile = NULL;
+		}
+		g_mutex_unlock(&objFetches.objMutex);
+
+		if (file) {
+			_animation_read_ahead_files(&objFetches, aFetches, iCandidate, iQueued, site->prefs);
+
+			/* Load and add new volume to our array of level2 frames. Increment the frames counter so we know how many frames we have. */
+			g_debug("_animation_update_level2 - File is good. load - Site: %s, Frame number: %i", site->city->code, objRadarAnimation->iAnimationFrames);
+			AWeatherLevel2* objLevel2 = aweather_level2_new_from_file(file, site->city->code, _get_colormaps(), site->prefs, objRadarAnimation->objAnimationCancellable);
+			g_debug("_animation_update_level2: parsing level2: %p", objLevel2);
+			_animation_add_loaded_frame(site, file, objLevel2);
+		} /* If a file was returned from the server. */
+
+		/* Update the GUI with the latest file */
+		_animation_load_channel_push(&objRadarAnimation->objAnimationLoadChannel, objRadarAnimation->iAnimationFrames, -1, -1);
+	} /* for each file on the server starting at the selected time, walking backwards */
+	g_debug("_animation_update_level2: Done loading level2 frames");
+
+	/* Downloads that were not started are dropped, the running ones stop quickly once cancelled */
+	if(objFetchPool)
+		g_thread_pool_free(objFetchPool, TRUE, TRUE);
+
+	/* Cleanup */
+	for(int i = 0; i < iQueued; i++){
+		g_free(aFetches[i].cName);
+		g_free(aFetches[i].cMirrorUrl);
+		g_free(aFetches[i].cFile);
+	}
+	g_free(aFetches);
+	g_mutex_clear(&objFetches.objMutex);
+	g_cond_clear(&objFetches.objCond);
+	g_strfreev(aMirrorUrls);
+	g_free(cMirrorUrl);
+
+	/* Cleanup the sorted list - contained strings are pointers to 'files' strings and don't need to be deleted. */
+	g_list_free(objFilesListByTimeDesc);
+
+	/* Cleanup the list */
+	g_list_foreach(files, (GFunc)g_free, NULL);
+	g_list_free(files);
+}
+
+/* Runs on the worker pool, downloads and parses the animation frames. The frames are shown by the frame clock scheduler once they are all loaded.
+ * The task only talks to the UI thread through objAnimationLoadChannel. The frame arrays belong to it until it says it is done.
+ */
+void _animation_update_thread(gpointer _site)
+{
+	RadarSite* site = _site;
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+
+	g_debug("_animation_update_thread - %s", site->city->code);
+
+	/* Update the UI to show that we are loading the animation. */
+	_animation_load_channel_push(&objRadarAnimation->objAnimationLoadChannel, 0, -1, -1);
+
+	/* Allocate memory for the list of Level2 radar objects for this site. We may not fill this array fully, but we could use all of it depending on the files available on the server. */
+	objRadarAnimation->aAnimationLevel2Frames = malloc(sizeof(AWeatherLevel2*) * objRadarAnimation->iAnimationFrameLimit);
+	objRadarAnimation->iAnimationFrames = 0;
+	g_debug("_animation_update_thread: iAnimationFrames set to 0");
+
+	/* Frames beyond the memory budget are dropped after loading and read back later, so keep track of where each frame came from and how big it is. The files array is NULL terminated for g_strfreev. */
+	objRadarAnimation->aAnimationFrameFiles = g_new0(gchar*, objRadarAnimation->iAnimationFrameLimit + 1);
+	objRadarAnimation->aAnimationFrameSizes = g_new0(gsize, objRadarAnimation->iAnimationFrameLimit);
+	objRadarAnimation->aAnimationFrameReadPending = g_new0(bool, objRadarAnimation->iAnimationFrameLimit);
+	objRadarAnimation->iAnimationResidentBytes = 0;
+	objRadarAnimation->iAnimationResidentFrames = 0;
+	int iMemoryBudgetMb = grits_prefs_get_integer(site->prefs, "aweather/animation_memory_budget_mb", NULL);
+	objRadarAnimation->iAnimationMemoryBudgetBytes = (iMemoryBudgetMb > 0 ? (gsize)iMemoryBudgetMb * 1024 * 1024 : G_MAXSIZE);
+
+	if (site->level3)
+		_animation_update_level3(site);
+	else
+		_animation_update_level2(site);
+
+	/* Hand the loaded frames over to the UI thread, which runs the animation. The frames are written before the UI thread can see this */
+	g_atomic_int_set(&objRadarAnimation->objAnimationLoadChannel.lDone, true);
+}
+
+/* Pool priority of the animation loading task. Animations only run on the visible site, so they go behind the visible site's own volume */
+static RadarPoolPriority _animation_update_priority(gpointer _site)
+{
+	RadarSite* site = _site;
+	return site->hidden ? RADAR_POOL_PRIORITY_BACKGROUND : RADAR_POOL_PRIORITY_ANIMATION;
+}
+
+/* Starts the animation if site->objRadarAnimation->lUserWantsToAnimate is set to TRUE */
+void _start_animation_if_user_requested_it_to_start(RadarSite* site){
+	/* Start the background thread to load the animation frames if the user wants to animate and we are not currently animating.
+	 * Note that if there is no level2 for this current site (radar failed to load / process), then we cannot start the animation, as the container hbox will not exist. */
+	if(site->objRadarAnimation->lUserWantsToAnimate
+		&& !site->objRadarAnimation->lIsAnimating
+		&& site->level2 != NULL
+		/* If a sweep is not yet selected, then there is no sweep to select (a sweep is selected if possible on load). Thus, do not allow the animation to start as doing so could cause the animation loop to get stuck. */
+		&& site->level2->iSelectedSweepId != AWEATHER_LEVEL2_SELECTED_SWEEP_ID_NONE){
+		site->objRadarAnimation->lIsAnimating = true; /* Set to TRUE so the user cannot spawn a new background thread until the previous animation finished completely */
+
+		/* If the previous loading task still exists, then clean it up before we start a new one. */
+		if(site->objRadarAnimation->objAnimationLoadTask != NULL){
+			radar_pool_task_finish(site->pool, site->objRadarAnimation->objAnimationLoadTask);
+			site->objRadarAnimation->objAnimationLoadTask = NULL;
+		}
+
+		/* Add an event listener so the user can control the animation with their keyboard */
+		_setup_animation_keyboard_event_listeners(site);
+
+		/* Set the loading flag here rather than in the loading task, the task may wait in the pool queue behind other sites for a while */
+		site->objRadarAnimation->lAnimationLoading = true;
+
+		/* Copy the configured animation frames limit to our local state variable so that if the user changes it while we are loading, we don't go over an array limit */
+		site->objRadarAnimation->iAnimationFrameLimit = grits_prefs_get_integer(site->prefs, "aweather/animation_frames", NULL);
+		if(site->objRadarAnimation->iAnimationFrameLimit == 0){
+			g_error("Warning! The animation frame count is set to 0. This is not supported. Please adjust the 'Animation Frames' setting to a larger value in the settings dialog.");
+		}
+
+		/* The frame selection buttons and the disabled frames belong to the UI thread, so they are set up here rather than in the loading task */
+		site->objRadarAnimation->aAnimationFrameSelectionToggleButtons = malloc(sizeof(GtkWidget*) * site->objRadarAnimation->iAnimationFrameLimit);
+		site->objRadarAnimation->iAnimationFrameSelectionToggleButtonsLength = 0;
+		site->objRadarAnimation->aAnimationFrameDisabled = calloc(sizeof(bool), site->objRadarAnimation->iAnimationFrameLimit);
+
+		/* Reset the cleanup flag so it is in a known state */
+		site->objRadarAnimation->lIsAnimationCleanupInProgress = false;
+
+		/* Clear out the previous frame id */
+		site->objRadarAnimation->iAnimationPreviousFrameShownInUi = 0;
+
+		/* Star the animation in the forwards direction (when it finishes loading) and drop commands left over from the last animation */
+		site->objRadarAnimation->eAnimationNextFrameMode = NEXT_FRAME_FORWARD;
+		g_atomic_int_set(&site->objRadarAnimation->iAnimationCommands, 0);
+
+		/* No task is using the channel, the previous one was finished above */
+		site->objRadarAnimation->objAnimationLoadChannel.iHead = 0;
+		site->objRadarAnimation->objAnimationLoadChannel.iTail = 0;
+		site->objRadarAnimation->objAnimationLoadChannel.lDone = false;
+
+		/* Initialize computed animation start and finish times */
+		site->objRadarAnimation->iAnimationStartTime = -1;
+		site->objRadarAnimation->iAnimationFinishTime = -1;
+		site->objRadarAnimation->iAnimationCurrentFrameTime = -1;
+
+		site->objRadarAnimation->objAnimationCancellable = g_cancellable_new();
+		site->objRadarAnimation->objAnimationLoadTask = radar_pool_push(site->pool,
+				_animation_update_thread, _animation_update_priority, site);
+
+		/* The scheduler tick shows the loading progress and starts playing once the frames are loaded */
+		site->objRadarAnimation->iAnimationTickCallbackId = gtk_widget_add_tick_callback(GTK_WIDGET(site->viewer), _animation_on_frame_clock_tick, site, NULL);
+	}
+}
+
+/* Cleans up once the loading task is no longer running and restores the user's animation choice. Waits for the task if it is still running, only the teardown gets here with a running task.
+ * If ilResume is set, the function given to _animation_stop is called, otherwise the animation is restarted if the site is shown.
+ */
+static void _animation_stop_done(RadarSite* site, bool ilResume){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	AnimationStoppedFunc fnStopped = objRadarAnimation->fnAnimationStopped;
+	objRadarAnimation->fnAnimationStopped = NULL;
+
+	if(objRadarAnimation->objAnimationLoadTask != NULL){
+		radar_pool_task_finish(site->pool, objRadarAnimation->objAnimationLoadTask);
+		objRadarAnimation->objAnimationLoadTask = NULL;
+	}
+	g_clear_object(&objRadarAnimation->objAnimationCancellable);
+	objRadarAnimation->lAnimationLoading = false;
+
+	/* The scheduler runs on this thread, so we can clean up right here instead of waiting for the next tick */
+	_animation_cleanup(site);
+
+	/* Reset the user wants to animate flag so we can resume the animation later if needed */
+	objRadarAnimation->lUserWantsToAnimate = objRadarAnimation->lUserWantsToAnimateAfterStop;
+
+	if(!ilResume)
+		return;
+	if(fnStopped != NULL)
+		fnStopped(site);
+	else if(!site->hidden && site->status == STATUS_LOADED)
+		_start_animation_if_user_requested_it_to_start(site); /* The site was shown again while it stopped */
+}
+
+static gboolean _animation_stop_poll(gpointer _site){
+	RadarSite* site = _site;
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	if(!radar_pool_task_try_finish(site->pool, objRadarAnimation->objAnimationLoadTask))
+		return G_SOURCE_CONTINUE;
+	objRadarAnimation->objAnimationLoadTask = NULL;
+	objRadarAnimation->iAnimationStopSourceId = 0;
+	_animation_stop_done(site, true);
+	return G_SOURCE_REMOVE;
+}
+
+/* Stops the animation without waiting for the loading task and saves the user's desired animation state to site->objRadarAnimation->lUserWantsToAnimate.
+ * ipfnStopped (may be NULL) is called once the animation stopped, right away if the loading task is not running. A pending stop keeps the last function it was given.
+ */
+static void _animation_stop(RadarSite* site, AnimationStoppedFunc ipfnStopped){
+	/* The user selected another time from the time selection list on the right. If the animation is running currently,
+	 * we need to stop it, then restart it when the default layer finishes loading. Thus, the animation will now finish
+	 * at the time the user selected.
+	 */
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	if(ipfnStopped != NULL)
+		objRadarAnimation->fnAnimationStopped = ipfnStopped;
+	if(objRadarAnimation->iAnimationStopSourceId)
+		return;
+	if(!objRadarAnimation->lIsAnimating){
+		AnimationStoppedFunc fnStopped = objRadarAnimation->fnAnimationStopped;
+		objRadarAnimation->fnAnimationStopped = NULL;
+		if(fnStopped != NULL)
+			fnStopped(site);
+		return;
+	}
+
+	objRadarAnimation->lUserWantsToAnimateAfterStop = objRadarAnimation->lUserWantsToAnimate;
+	objRadarAnimation->lUserWantsToAnimate = false; /* Tell the loading task to stop after the current frame */
+
+	/* The stop finishes the animation from here on, the scheduler tick must not clean it up as well */
+	if(objRadarAnimation->iAnimationTickCallbackId){
+		gtk_widget_remove_tick_callback(GTK_WIDGET(site->viewer), objRadarAnimation->iAnimationTickCallbackId);
+		objRadarAnimation->iAnimationTickCallbackId = 0;
+	}
+
+	/* Drops the task if it is still queued, otherwise interrupts the download and decode in progress and checks back until the task returned.
+	 * The site's own volume is never loading while the animation is, a site update waits for the stop.
+	 */
+	if(objRadarAnimation->objAnimationLoadTask != NULL){
+		g_cancellable_cancel(objRadarAnimation->objAnimationCancellable);
+		if(!radar_pool_task_try_finish(site->pool, objRadarAnimation->objAnimationLoadTask)){
+			objRadarAnimation->iAnimationStopSourceId = g_timeout_add(ANIMATION_STOP_POLL_MS, _animation_stop_poll, site);
+			return;
+		}
+		objRadarAnimation->objAnimationLoadTask = NULL;
+	}
+	_animation_stop_done(site, true);
+}
+
+/* Stops the animation and waits for the loading task (if it is still running) to finish, including a stop that is pending. Only for tearing the site down, nothing waiting for the stop is called. */
+void _stop_animation_and_wait_for_animation_to_stop_save_user_choice(RadarSite* site){
+	RadarAnimation* objRadarAnimation = site->objRadarAnimation;
+	if(objRadarAnimation->iAnimationStopSourceId){
+		g_source_remove(objRadarAnimation->iAnimationStopSourceId);
+		objRadarAnimation->iAnimationStopSourceId = 0;
+	} else if(objRadarAnimation->lIsAnimating){
+		objRadarAnimation->lUserWantsToAnimateAfterStop = objRadarAnimation->lUserWantsToAnimate;
+		objRadarAnimation->lUserWantsToAnimate = false;
+		if(objRadarAnimation->objAnimationLoadTask != NULL)
+			g_cancellable_cancel(objRadarAnimation->objAnimationCancellable);
+	} else {
+		return;
+	}
+	_animation_stop_done(site, false);
+}
+
+void _on_animateButton_clicked(GtkButton *button, RadarSite* site){
+	/* While a stop is pending, the choice is the one it restores once it finished */
+	if(site->objRadarAnimation->iAnimationStopSourceId){
+		site->objRadarAnimation->lUserWantsToAnimateAfterStop = !site->objRadarAnimation->lUserWantsToAnimateAfterStop;
+		return;
+	}
+	/* When stopping, the scheduler tick sees the flag, stops the loading task if it is still running and cleans up */
+	site->objRadarAnimation->lUserWantsToAnimate = !site->objRadarAnimation->lUserWantsToAnimate;
+	if(site->objRadarAnimation->lUserWantsToAnimate){
+		_start_animation_if_user_requested_it_to_start(site);
+	}
+}
+
+GtkWidget* _getAnimateUi(RadarSite* site){
+	/* Add the animation UI buttons to the scroll box - each button is 5 px apart. */
+	GtkWidget *hbox = gtk_hbox_new(FALSE, 5);
+	site->objRadarAnimation->objAnimateButton = gtk_button_new_with_label("Animate");
+	gtk_widget_set_size_request(site->objRadarAnimation->objAnimateButton, 100, 30);
+	gtk_box_pack_start(GTK_BOX(hbox), site->objRadarAnimation->objAnimateButton, FALSE, FALSE, 0);
+
+	/* Add click event listener */
+	g_signal_connect(site->objRadarAnimation->objAnimateButton, "clicked", G_CALLBACK(_on_animateButton_clicked), site);
+
+	/* Add a progress bar to the right of the animate button */
+	site->objRadarAnimation->objAnimateProgressBar = gtk_progress_bar_new();
+	gtk_widget_set_size_request(site->objRadarAnimation->objAnimateProgressBar, 100, 30);
+	gtk_box_pack_start(GTK_BOX(hbox), site->objRadarAnimation->objAnimateProgressBar, FALSE, FALSE, 0);
 
 	/* Add an hbox to contain the frain selection toggle buttons */
 	site->objRadarAnimation->objAnimationFrameControlHbox = gtk_hbox_new(FALSE, 5);
 	gtk_box_pack_end(GTK_BOX(hbox), site->objRadarAnimation->objAnimationFrameControlHbox, TRUE, TRUE, 0);
 
-	return hbox;
+	return hbox;
+}
+
+
+
+
+
+
+void _site_update_start(RadarSite *site);
+static void _site_watch_schedule(RadarSite *site);
+static void _site_watch_stop(RadarSite *site, gboolean wait);
+static gboolean _site_watch_end(gpointer _site);
+static void _site_stream_reset(RadarSite *site);
+
+/* Level III is used while Level II downloads are too slow. Level II is tried again
+ * every so often in case the link got better. */
+static gboolean _site_use_level3(RadarSite *site)
+{
+	if (site->spool)
+		return FALSE;
+	gint below = grits_prefs_get_integer(site->prefs, "aweather/level3_below_kbps", NULL);
+	gint rate  = g_atomic_int_get(&level2_rate);
+	gint age   = g_get_monotonic_time()/G_USEC_PER_SEC - g_atomic_int_get(&level2_rate_time);
+	return below > 0 && rate >= 0 && rate < below && age < LEVEL2_RATE_RETRY;
+}
+
+/* format: http://mesonet.agron.iastate.edu/data/nexrd2/raw/KABR/KABR_20090510_0323 */
+void _site_update_loading(gchar *file, goffset cur,
+		goffset total, gpointer _site)
+{
+	RadarSite *site = _site;
+
+	/* Time the download, once it is known to be too slow give up on it and use Level III */
+	gint64 elapsed = g_get_monotonic_time() - site->fetch_start;
+	if (site->fetch_start && elapsed > LEVEL2_RATE_MIN_TIME * G_USEC_PER_SEC) {
+		g_atomic_int_set(&level2_rate, cur * G_USEC_PER_SEC / 1024 / elapsed);
+		g_atomic_int_set(&level2_rate_time, g_get_monotonic_time()/G_USEC_PER_SEC);
+		if (cur < total && _site_use_level3(site)) {
+			g_debug("RadarSite: update_loading - %s - %d KB/s, switching to Level III",
+					site->city->code, g_atomic_int_get(&level2_rate));
+			site->fetch_start = 0;
+			g_cancellable_cancel(site->fetch_cancellable);
+			return;
+		}
+	}
+
+	GtkWidget *progress_bar = gtk_bin_get_child(GTK_BIN(site->config));
+	double percent = (double)cur/total;
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), MIN(percent, 1.0));
+	gchar *msg = g_strdup_printf("Loading... %5.1f%% (%.2f/%.2f MB)",
+			percent*100, (double)cur/1000000, (double)total/1000000);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), msg);
+	g_free(msg);
+}
+/* Shows the options for a newly loaded volume and adds it to the mosaic */
+static void _site_show_config(RadarSite *site)
+{
+	/* UI design:
+	 *  <scroll_window>
+	 *    <vbox> <!-- vertical stack of widgets inside of the scroll window -->
+	 *      <_getAnimateUi/>
+	 *      <aweather_level2_get_config>
+	 *    </vbox>
+	 *  </scroll_window>
+	 */
+
+	/* Wrap the radar sweep / volume UI in a GtkScrolledWindow so that we don't use up too much screen space displaying all radar options on small screens.*/
+	GtkWidget *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	GtkWidget *vbox = gtk_vbox_new(FALSE, 5);
+	GtkWidget *animateUi = _getAnimateUi(site);
+	GtkWidget *sweepSelectionUiWidget = aweather_level2_get_config(site->level2, site->prefs);
+
+
+	/* Automatically show the scrollbars */
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+
+	/* Add the radar animate UI and options UI to the vertical box */
+	gtk_box_pack_start(GTK_BOX(vbox), animateUi, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), sweepSelectionUiWidget, FALSE, FALSE, 0);
+
+	/* Add the vertical box to the scrolled window */
+	gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrolled_window), vbox);
+
+	/* Kept so _site_show_sweeps can swap just the sweep grid */
+	g_object_set_data(G_OBJECT(scrolled_window), "vbox", vbox);
+	g_object_set_data(G_OBJECT(vbox), "sweeps", sweepSelectionUiWidget);
+
+	/* Add the scrolled window to the config bin */
+	aweather_bin_set_child(GTK_BIN(site->config), scrolled_window);
+
+
+	/* Add the new volume to the mosaic. The mosaic reads it on its own thread,
+	 * so a volume still being decoded is only added once aweather_level2_finish is done with it */
+	if (!site->level2->decoder)
+		radar_mosaic_set_site(site->mosaic, site->city->code,
+				site->city->pos.lat, site->city->pos.lon, site->level2);
+}
+
+/* Rebuilds only the sweep grid, for sweeps added to a volume that is still being decoded */
+static void _site_show_sweeps(RadarSite *site)
+{
+	GtkWidget *scrolled_window = gtk_bin_get_child(GTK_BIN(site->config));
+	GtkWidget *vbox = scrolled_window ?
+		g_object_get_data(G_OBJECT(scrolled_window), "vbox") : NULL;
+	if (!vbox) {
+		_site_show_config(site);
+		return;
+	}
+	GtkWidget *old = g_object_get_data(G_OBJECT(vbox), "sweeps");
+	GtkWidget *new = aweather_level2_get_config(site->level2, site->prefs);
+	if (old)
+		gtk_widget_destroy(old);
+	gtk_box_pack_start(GTK_BOX(vbox), new, FALSE, FALSE, 0);
+	gtk_widget_show_all(new);
+	g_object_set_data(G_OBJECT(vbox), "sweeps", new);
+}
+
+static void _site_show_volume(RadarSite *site)
+{
+	_site_show_config(site);
+
+	/* If the user had been running the animation prior to switching the finish time of the animation loop, then restart the animation automatically. */
+	_start_animation_if_user_requested_it_to_start(site);
+}
+
+/* Shows the lower sweeps of the volume being loaded while the rest of it is decoded */
+static gboolean _site_update_partial(gpointer _site)
+{
+	RadarSite *site = _site;
+	AWeatherLevel2 *level2 = g_atomic_pointer_get(&site->load_level2);
+	if (!level2 || site->load_generation != site->generation)
+		return TRUE;
+
+	Level2DecoderChanges changes = aweather_level2_sync(level2);
+	if (site->level2 != level2) {
+		g_debug("RadarSite: update_partial - %s - showing lowest sweep", site->city->code);
+		site->level2 = g_object_ref(level2);
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+		grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
+				GRITS_LEVEL_WORLD+3, TRUE);
+		_site_show_config(site);
+	} else if (changes & LEVEL2_DECODER_SWEEPS) {
+		_site_show_sweeps(site);
+	}
+	return TRUE;
+}
+
+/* Partial sweeps are only shown for the site the user is looking at, the timer runs while it loads */
+static void _site_update_partial_set(RadarSite *site)
+{
+	gboolean want = site->load_task && !site->hidden;
+	if (want && !site->partial_id)
+		site->partial_id = g_timeout_add(SITE_UPDATE_PARTIAL_MS,
+				_site_update_partial, site);
+	if (!want && site->partial_id) {
+		g_source_remove(site->partial_id);
+		site->partial_id = 0;
+	}
+}
+
+/* Called on the loading thread once the lowest sweep is decoded */
+static void _site_update_first_sweep(AWeatherLevel2 *level2, gpointer _site)
+{
+	RadarSite *site = _site;
+	g_atomic_pointer_set(&site->load_level2, g_object_ref(level2));
+}
+
+gboolean _site_update_end(gpointer _site)
+{
+	RadarSite *site = _site;
+	site->idle_source = 0;
+	/* The loading task queued this callback as the last thing it did, so this will not block */
+	if (site->load_task) {
+		radar_pool_task_finish(site->pool, site->load_task);
+		site->load_task = NULL;
+	}
+	g_clear_object(&site->load_cancellable);
+	if (site->partial_id)
+		g_source_remove(site->partial_id);
+	site->partial_id = 0;
+
+	/* Another time was requested while loading, throw this volume away.
+	 * If requests are still coming in, the debounce timer starts the next load. */
+	if (site->load_generation != site->generation) {
+		g_debug("RadarSite: update_end - %s - dropping stale load", site->city->code);
+		g_clear_object(&site->load_level2);
+		grits_object_destroy_pointer(&site->level2);
+		if (!site->debounce_id)
+			_site_update_start(site);
+		return FALSE;
+	}
+	/* A progressively decoded volume that _site_update_partial has not gotten to yet */
+	if (site->load_level2 && site->level2 != site->load_level2) {
+		site->level2 = g_object_ref(site->load_level2);
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+		grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
+				GRITS_LEVEL_WORLD+3, TRUE);
+	}
+	g_clear_object(&site->load_level2);
+	if (site->message) {
+		g_warning("RadarSite: update_end - %s", site->message);
+		const char *fmt = "http://forecast.weather.gov/product.php?site=NWS&product=FTM&format=TXT&issuedby=%s";
+		char       *uri = g_strdup_printf(fmt, site->city->code+1);
+		GtkWidget  *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+		GtkWidget  *msg = gtk_label_new(site->message);
+		GtkWidget  *btn = gtk_link_button_new_with_label(uri, "View Radar Status");
+		gtk_box_set_homogeneous(GTK_BOX(box), TRUE);
+		gtk_box_pack_start(GTK_BOX(box), msg, TRUE, TRUE, 0);
+		gtk_box_pack_start(GTK_BOX(box), btn, TRUE, TRUE, 0);
+		aweather_bin_set_child(GTK_BIN(site->config), box);
+		g_free(uri);
+	} else {
+		/* Publish the rest of a progressively decoded volume */
+		aweather_level2_finish(site->level2);
+		_site_show_volume(site);
+	}
+	site->status = STATUS_LOADED;
+	_site_watch_schedule(site);
+	return FALSE;
+}
+static void _site_cancel_fetch(GCancellable *cancellable, GCancellable *fetch)
+{
+	g_cancellable_cancel(fetch);
+}
+
+/* Finds, fetches and decodes the Level II volume nearest to the site's time.
+ * Sets site->message and returns NULL if that fails. */
+static AWeatherLevel2 *_site_update_level2(RadarSite *site, GCancellable *cancellable)
+{
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	gchar *mirror = NULL;
+
+	/* Find nearest volume (temporally) */
+	g_debug("RadarSite: update_level2 - find nearest - %s", site->city->code);
+	GList *files = NULL;
+	if (site->spool)
+		files = radar_spool_list(site->spool);
+	else
+		files = radar_mirrors_list(site->mirrors, site->download, SITE_CACHE_PREFIX,
+				site->city->code, offline, FALSE, cancellable, &mirror);
+	gchar *nearest = _find_nearest(site->time, files, 5);
+	g_list_foreach(files, (GFunc)g_free, NULL);
+	g_list_free(files);
+	if (!nearest) {
+		g_free(mirror);
+		site->message = "No suitable files found";
+		return NULL;
+	}
+	if (g_cancellable_is_cancelled(cancellable)) {
+		g_free(mirror);
+		g_free(nearest);
+		return NULL;
+	}
+
+	/* Fetch new volume, timing the download when it is not cached. Spooled volumes are decoded in place */
+	g_debug("RadarSite: update_level2 - fetch");
+	gchar *file = NULL;
+	if (site->spool) {
+		file = radar_spool_path(site->spool, nearest);
+	} else {
+		GCancellable *fetch = g_cancellable_new();
+		gulong id = g_cancellable_connect(cancellable,
+				G_CALLBACK(_site_cancel_fetch), fetch, NULL);
+		site->fetch_cancellable = fetch;
+		site->fetch_start = offline ? 0 : g_get_monotonic_time();
+		file = radar_mirrors_fetch(site->mirrors, site->download, SITE_CACHE_PREFIX,
+				site->city->code, mirror, nearest,
+				offline ? GRITS_LOCAL : GRITS_UPDATE,
+				site->hidden ? AWEATHER_DOWNLOAD_BACKGROUND : AWEATHER_DOWNLOAD_VISIBLE,
+				_site_update_loading, site, fetch);
+		site->fetch_start = 0;
+		site->fetch_cancellable = NULL;
+		g_cancellable_disconnect(cancellable, id);
+		/* Given up on for being slow, what was received is resumed next time */
+		if (g_cancellable_is_cancelled(fetch) && !g_cancellable_is_cancelled(cancellable))
+			g_clear_pointer(&file, g_free);
+		g_object_unref(fetch);
+	}
+	g_free(mirror);
+	g_free(site->volume_name);
+	site->volume_name = nearest;
+	if (!file) {
+		site->message = "Fetch failed";
+		return NULL;
+	}
+
+	/* Load new volume */
+	g_debug("RadarSite: update_level2 - load - %s", site->city->code);
+	AWeatherLevel2 *level2 = aweather_level2_new_from_file_progressive(
+			file, site->city->code, _get_colormaps(), site->prefs, cancellable,
+			_site_update_first_sweep, site);
+	g_free(file);
+	if (!level2)
+		site->message = "Load failed";
+	return level2;
+}
+
+/* Like _site_update_level2, but with the lowest tilt Level III products */
+static AWeatherLevel2 *_site_update_level3(RadarSite *site, GCancellable *cancellable)
+{
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	gchar *level3_url = grits_prefs_get_string(site->prefs,
+			"aweather/level3_url", NULL);
+
+	g_debug("RadarSite: update_level3 - find nearest - %s", site->city->code);
+	GList *scans = aweather_level3_scans_list(site->download, SITE_CACHE_PREFIX, level3_url,
+			site->city->code, site->time, 1, offline, cancellable);
+	GList *nearest = aweather_level3_scans_nearest(scans, site->time);
+	AWeatherLevel2 *level2 = NULL;
+	if (!nearest) {
+		site->message = "No suitable files found";
+	} else if (!g_cancellable_is_cancelled(cancellable)) {
+		AWeatherLevel3Scan *scan = nearest->data;
+		g_debug("RadarSite: update_level3 - fetch - %s", scan->reflectivity);
+		level2 = aweather_level3_fetch(site->download, SITE_CACHE_PREFIX, level3_url,
+				site->city->code, scan, _get_colormaps(), offline,
+				site->hidden ? AWEATHER_DOWNLOAD_BACKGROUND : AWEATHER_DOWNLOAD_VISIBLE,
+				_site_update_loading, site, cancellable, NULL);
+		g_free(site->volume_name);
+		site->volume_name = g_strdup(scan->reflectivity);
+		if (!level2)
+			site->message = "Load failed";
+	}
+	aweather_level3_scans_free(scans);
+	g_free(level3_url);
+	return level2;
+}
+
+void _site_update_thread(gpointer _site)
+{
+	RadarSite *site = _site;
+	GCancellable *cancellable = site->load_cancellable;
+	g_debug("RadarSite: update_thread - %s", site->city->code);
+	site->message = NULL;
+
+	gboolean level3 = _site_use_level3(site);
+	AWeatherLevel2 *level2 = level3 ? NULL :
+		_site_update_level2(site, cancellable);
+
+	/* The Level II download was given up on for being too slow */
+	if (!level2 && !level3 && !g_cancellable_is_cancelled(cancellable) &&
+	    _site_use_level3(site)) {
+		site->message = NULL;
+		level3 = TRUE;
+	}
+	if (level3)
+		level2 = _site_update_level3(site, cancellable);
+
+	if (level2 && g_cancellable_is_cancelled(cancellable))
+		g_clear_object(&level2);
+	if (level2 && level2 == g_atomic_pointer_get(&site->load_level2)) {
+		/* Already handed to the UI thread, which adds it to the viewer */
+		site->level3 = level3;
+		g_object_unref(level2);
+	} else if (level2) {
+		site->level2 = level2;
+		site->level3 = level3;
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+		grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
+				GRITS_LEVEL_WORLD+3, TRUE);
+	} else if (!site->message && !g_cancellable_is_cancelled(cancellable)) {
+		site->message = "Load failed";
+	}
+
+	if (!site->idle_source)
+		site->idle_source = g_idle_add(_site_update_end, site);
 }
 
+/* The site the user is looking at is loaded first, hidden sites only use spare workers */
+static RadarPoolPriority _site_update_priority(gpointer _site)
+{
+	RadarSite *site = _site;
+	return site->hidden ? RADAR_POOL_PRIORITY_BACKGROUND : RADAR_POOL_PRIORITY_VISIBLE;
+}
+
+/* Loads the volume once the animation stopped, see _site_update_start */
+static void _site_update_load(RadarSite *site)
+{
+	site->time = grits_viewer_get_time(site->viewer);
+	g_debug("RadarSite: update %s - %d",
+			site->city->code, (gint)site->time);
 
+	_site_watch_stop(site, FALSE);
+	if (!site->watch_task)
+		_site_stream_reset(site);
 
+	/* Add a progress bar */
+	GtkWidget *progress = gtk_progress_bar_new();
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress), "Loading...");
+	aweather_bin_set_child(GTK_BIN(site->config), progress);
 
+	/* Remove old volume */
+	g_debug("RadarSite: update - remove - %s", site->city->code);
+	grits_object_destroy_pointer(&site->level2);
 
+	/* Fork loading right away so updating the
+	 * list of times doesn't take too long */
+	site->load_generation  = site->generation;
+	site->load_cancellable = g_cancellable_new();
+	site->load_task = radar_pool_push(site->pool,
+			_site_update_thread, _site_update_priority, site);
+	_site_update_partial_set(site);
+}
 
-/* format: http://mesonet.agron.iastate.edu/data/nexrd2/raw/KABR/KABR_20090510_0323 */
-void _site_update_loading(gchar *file, goffset cur,
-		goffset total, gpointer _site)
+/* Starts loading the volume for the viewer's current time. Only one load runs per site at a time */
+void _site_update_start(RadarSite *site)
 {
-	RadarSite *site = _site;
-	GtkWidget *progress_bar = gtk_bin_get_child(GTK_BIN(site->config));
-	double percent = (double)cur/total;
-	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), MIN(percent, 1.0));
-	gchar *msg = g_strdup_printf("Loading... %5.1f%% (%.2f/%.2f MB)",
-			percent*100, (double)cur/1000000, (double)total/1000000);
-	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), msg);
-	g_free(msg);
+	site->status = STATUS_LOADING;
+
+	/* Stop the animation if it was running, save off the user's animation choice (running or stopped), then load the new loop end time.
+	 * The load starts once the animation's loading task returned, and the animation is started back up when it finishes if it was running when we got here.
+	 */
+	_animation_stop(site, _site_update_load);
 }
-gboolean _site_update_end(gpointer _site)
+
+static gboolean _site_update_debounced(gpointer _site)
 {
 	RadarSite *site = _site;
-	if (site->message) {
-		g_warning("RadarSite: update_end - %s", site->message);
-		const char *fmt = "http://forecast.weather.gov/product.php?site=NWS&product=FTM&format=TXT&issuedby=%s";
-		char       *uri = g_strdup_printf(fmt, site->city->code+1);
-		GtkWidget  *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-		GtkWidget  *msg = gtk_label_new(site->message);
-		GtkWidget  *btn = gtk_link_button_new_with_label(uri, "View Radar Status");
-		gtk_box_set_homogeneous(GTK_BOX(box), TRUE);
-		gtk_box_pack_start(GTK_BOX(box), msg, TRUE, TRUE, 0);
-		gtk_box_pack_start(GTK_BOX(box), btn, TRUE, TRUE, 0);
-		aweather_bin_set_child(GTK_BIN(site->config), box);
-		g_free(uri);
-	} else {
-		/* UI design:
-		 *  <scroll_window>
-		 *    <vbox> <!-- vertical stack of widgets inside of the scroll window -->
-		 *      <_getAnimateUi/>
-		 *      <aweather_level2_get_config>
-		 *    </vbox>
-		 *  </scroll_window>
+	site->debounce_id = 0;
+	/* If the superseded load is still winding down, _site_update_end starts the new one */
+	if (!site->load_task)
+		_site_update_start(site);
+	return FALSE;
+}
+
+void _site_update(RadarSite *site)
+{
+	/* If we are hidden and the user has configured this application to not reload radar sites that are hidden, then don't reload anything, but instead, set the 'needs to reload when shown' flag. */
+	if(site->hidden
+		&& !grits_prefs_get_boolean(site->prefs, "aweather/download_radar_files_for_non_visible_sites", NULL)){
+		site->lNeedsRefreshWhenShown = true;
+
+		/* If we haven't loaded anything for this site yet, but it isn't visible (so we cannot load anything for it right now),
+		 * then flag the site as 'pending load' so we know that an initial load is still needed, but don't keep adding the site to the notebook.
 		 */
+		if(site->status == STATUS_UNLOADED)
+			site->status = STATUS_PENDING_LOAD;
 
-		/* Wrap the radar sweep / volume UI in a GtkScrolledWindow so that we don't use up too much screen space displaying all radar options on small screens.*/
-		GtkWidget *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
-		GtkWidget *vbox = gtk_vbox_new(FALSE, 5);
-		GtkWidget *animateUi = _getAnimateUi(site);
-		GtkWidget *sweepSelectionUiWidget = aweather_level2_get_config(site->level2, site->prefs);
+		return;
+	}
 
+	/* The streamed volume is newer than any listed one, autoupdate would only throw it away */
+	if (site->stream_level2 && site->level2 == site->stream_level2 &&
+	    ABS(time(NULL) - grits_viewer_get_time(site->viewer)) < SITE_WATCH_LATENCY)
+		return;
 
-		/* Automatically show the scrollbars */
-		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	/* Latest request wins. Older loads see the new generation and stop */
+	site->generation++;
 
-		/* Add the radar animate UI and options UI to the vertical box */
-		gtk_box_pack_start(GTK_BOX(vbox), animateUi, FALSE, FALSE, 0);
-		gtk_box_pack_start(GTK_BOX(vbox), sweepSelectionUiWidget, FALSE, FALSE, 0);
+	if (site->status != STATUS_LOADING) {
+		_site_update_start(site);
+		return;
+	}
 
-		/* Add the vertical box to the scrolled window */
-		gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrolled_window), vbox);
+	/* Already loading: interrupt the old download or decode, and wait for
+	 * the time to settle (eg. holding down a time step key) before loading again */
+	if (site->load_cancellable)
+		g_cancellable_cancel(site->load_cancellable);
+	if (site->debounce_id)
+		g_source_remove(site->debounce_id);
+	site->debounce_id = g_timeout_add(SITE_UPDATE_DEBOUNCE_MS,
+			_site_update_debounced, site);
+}
 
-		/* Add the scrolled window to the config bin */
-		aweather_bin_set_child(GTK_BIN(site->config), scrolled_window);
+static gint _site_watch_compare_gaps(gconstpointer a, gconstpointer b)
+{
+	return *(const gint*)a - *(const gint*)b;
+}
 
+/* Finds the newest volume and the typical time between volumes (which depends on the VCP) from a sorted listing */
+static void _site_watch_cadence(RadarSite *site, GList *files)
+{
+	time_t times[SITE_WATCH_HISTORY];
+	gint   ntimes = 0;
+	for (GList *cur = g_list_last(files); cur && ntimes < SITE_WATCH_HISTORY; cur = cur->prev) {
+		time_t time = radar_mirrors_volume_time(cur->data);
+		if (time && (ntimes == 0 || time < times[ntimes-1]))
+			times[ntimes++] = time;
+	}
+	if (ntimes == 0)
+		return;
 
-		/* If the user had been running the animation prior to switching the finish time of the animation loop, then restart the animation automatically. */
-		_start_animation_if_user_requested_it_to_start(site);
+	/* Median, an outage or a VCP change only moves it a little */
+	gint interval = 0;
+	gint gaps[SITE_WATCH_HISTORY];
+	for (gint i = 0; i < ntimes-1; i++)
+		gaps[i] = times[i] - times[i+1];
+	if (ntimes >= 3) {
+		qsort(gaps, ntimes-1, sizeof(gint), _site_watch_compare_gaps);
+		interval = CLAMP(gaps[(ntimes-1)/2], 60, 20*60);
 	}
-	site->status = STATUS_LOADED;
-	site->idle_source = 0;
-	return FALSE;
+
+	g_mutex_lock(&site->watch_lock);
+	site->watch_newest = times[0];
+	if (interval)
+		site->watch_interval = interval;
+	g_mutex_unlock(&site->watch_lock);
 }
-gpointer _site_update_thread(gpointer _site)
+
+/* Last thing the watch task does. _site_watch_end can run before g_idle_add returns,
+ * the lock keeps it from clearing watch_idle before it is set */
+static void _site_watch_done(RadarSite *site)
 {
-	RadarSite *site = _site;
-	g_debug("RadarSite: update_thread - %s", site->city->code);
-	site->message = NULL;
+	g_mutex_lock(&site->watch_lock);
+	site->watch_idle = g_idle_add(_site_watch_end, site);
+	g_mutex_unlock(&site->watch_lock);
+}
 
-	gboolean offline = grits_viewer_get_offline(site->viewer);
-	gchar *nexrad_url = grits_prefs_get_string(site->prefs,
-			"aweather/nexrad_url", NULL);
+static void _site_watch_loading(gchar *file, goffset cur,
+		goffset total, gpointer _site)
+{
+	/* Polls run in the background, there is no progress bar to update */
+}
 
-	/* Find nearest volume (temporally) */
-	g_debug("RadarSite: update_thread - find nearest - %s", site->city->code);
-	gchar *dir_list = g_strconcat(nexrad_url, "/", site->city->code,
-			"/", "dir.list", NULL);
-	GList *files = grits_http_available(site->http,
-			"^\\w{4}_\\d{8}_\\d{6}.bz2$", site->city->code,
-			"\\d+ (.*)", (offline ? NULL : dir_list));
-	g_free(dir_list);
-	gchar *nearest = _find_nearest(site->time, files, 5);
+/* Lists the volumes and loads the newest one if it is newer than what is shown */
+static void _site_watch_thread(gpointer _site)
+{
+	RadarSite *site = _site;
+	GCancellable *cancellable = site->watch_cancellable;
+	g_debug("RadarSite: watch_thread - %s", site->city->code);
+
+	/* Polls also keep the ranking of the other mirrors current */
+	gchar *mirror = NULL;
+	GList *files  = NULL;
+	if (site->spool) {
+		files = radar_spool_list(site->spool);
+	} else {
+		files = radar_mirrors_list(site->mirrors, site->download, SITE_CACHE_PREFIX,
+				site->city->code, FALSE, TRUE, cancellable, &mirror);
+		files = g_list_sort(files, (GCompareFunc)g_strcmp0);
+	}
+	_site_watch_cadence(site, files);
+	GList *last   = g_list_last(files);
+	gchar *newest = last ? g_strdup(last->data) : NULL;
 	g_list_foreach(files, (GFunc)g_free, NULL);
 	g_list_free(files);
-	if (!nearest) {
-		site->message = "No suitable files found";
+	if (!newest || g_strcmp0(newest, site->watch_have) <= 0 ||
+	    g_cancellable_is_cancelled(cancellable))
 		goto out;
-	}
 
-	/* Fetch new volume */
-	g_debug("RadarSite: update_thread - fetch");
-	gchar *local = g_strconcat(site->city->code, "/", nearest, NULL);
-	gchar *uri   = g_strconcat(nexrad_url, "/", local,   NULL);
-	gchar *file  = grits_http_fetch(site->http, uri, local,
-			offline ? GRITS_LOCAL : GRITS_UPDATE,
-			_site_update_loading, site);
-	g_free(nexrad_url);
-	g_free(nearest);
-	g_free(local);
-	g_free(uri);
-	if (!file) {
-		site->message = "Fetch failed";
+	g_debug("RadarSite: watch_thread - %s - fetch %s", site->city->code, newest);
+	gchar *file = NULL;
+	if (site->spool) {
+		file = radar_spool_path(site->spool, newest);
+	} else {
+		file = radar_mirrors_fetch(site->mirrors, site->download, SITE_CACHE_PREFIX,
+				site->city->code, mirror, newest, GRITS_UPDATE,
+				AWEATHER_DOWNLOAD_BACKGROUND, _site_watch_loading, site, cancellable);
+	}
+	if (!file)
 		goto out;
+
+	/* Decoded straight from the file, nothing is written next to spooled volumes */
+	AWeatherLevel2 *level2 = aweather_level2_new_from_file_progressive(
+			file, site->city->code, _get_colormaps(), site->prefs, cancellable, NULL, NULL);
+	g_free(file);
+	if (level2 && g_cancellable_is_cancelled(cancellable))
+		g_clear_object(&level2);
+	if (level2) {
+		site->watch_level2 = level2;
+		site->watch_name   = newest;
+		newest = NULL;
+	}
+
+out:
+	g_free(newest);
+	g_free(mirror);
+	_site_watch_done(site);
+}
+
+/* Scan time of a real-time chunk, keys look like KLSX/123/20090510-032300-001-S */
+static time_t _site_stream_time(const gchar *key)
+{
+	const gchar *name = strrchr(key, '/');
+	gint year, mon, day, hour, min, sec;
+	if (!name || sscanf(name+1, "%4d%2d%2d-%2d%2d%2d",
+			&year, &mon, &day, &hour, &min, &sec) != 6)
+		return 0;
+	GDateTime *date = g_date_time_new_utc(year, mon, day, hour, min, sec);
+	if (!date)
+		return 0;
+	time_t time = g_date_time_to_unix(date);
+	g_date_time_unref(date);
+	return time;
+}
+
+/* Number of a chunk in its volume, starting at 1 */
+static gint _site_stream_chunk(const gchar *key)
+{
+	const gchar *name = strrchr(key, '/');
+	return name && strlen(name) > 20 ? atoi(name+17) : 0;
+}
+
+static gint _site_stream_compare_volumes(gconstpointer a, gconstpointer b)
+{
+	return atoi(strchr(a, '/')+1) - atoi(strchr(b, '/')+1);
+}
+
+/* Lists the volumes (KLSX/123/) of the site, or the chunks below prefix, at most max if it is not 0.
+ * url is the real-time bucket, or a local directory laid out the same way. */
+static GList *_site_stream_list(RadarSite *site, const gchar *url,
+		const gchar *prefix, gint max)
+{
+	gboolean volumes = !prefix;
+	gchar *filter = volumes ?
+		g_strdup_printf("^%s/\\d+/$", site->city->code) :
+		g_strdup_printf("^%s\\d{8}-\\d{6}-\\d{3}-[SIE]$", prefix);
+	GList *keys = NULL;
+	if (g_str_has_prefix(url, "http")) {
+		gchar *index = volumes ?
+			g_strdup_printf("%s/?prefix=%s/&delimiter=/", url, site->city->code) :
+			g_strdup_printf("%s/?prefix=%s&max-keys=%d", url, prefix, max ? max : 1000);
+		keys = aweather_download_available(site->download, SITE_CACHE_PREFIX, filter,
+				site->city->code, volumes ? "<Prefix>([^<]*)</Prefix>" : "<Key>([^<]*)</Key>",
+				index, AWEATHER_DOWNLOAD_BACKGROUND, site->watch_cancellable, NULL);
+		g_free(index);
+	} else {
+		gchar *path = g_build_filename(url, volumes ? site->city->code : prefix, NULL);
+		GDir  *dir  = g_dir_open(path, 0, NULL);
+		const gchar *name;
+		while (dir && (name = g_dir_read_name(dir))) {
+			gchar *key = volumes ?
+				g_strconcat(site->city->code, "/", name, "/", NULL) :
+				g_strconcat(prefix, name, NULL);
+			if (g_regex_match_simple(filter, key, 0, 0))
+				keys = g_list_prepend(keys, key);
+			else
+				g_free(key);
+		}
+		if (dir)
+			g_dir_close(dir);
+		g_free(path);
+	}
+	g_free(filter);
+	keys = g_list_sort(keys, volumes ? _site_stream_compare_volumes : (GCompareFunc)g_strcmp0);
+	if (max && g_list_length(keys) > max) {
+		GList *rest = g_list_nth(keys, max);
+		rest->prev->next = NULL;
+		g_list_foreach(rest, (GFunc)g_free, NULL);
+		g_list_free(rest);
+	}
+	return keys;
+}
+
+/* Scan time of a volume (KLSX/123/), 0 if it has no chunks */
+static time_t _site_stream_volume_time(RadarSite *site, const gchar *url, const gchar *volume)
+{
+	GList *keys = _site_stream_list(site, url, volume, 1);
+	time_t time = keys ? _site_stream_time(keys->data) : 0;
+	g_list_foreach(keys, (GFunc)g_free, NULL);
+	g_list_free(keys);
+	return time;
+}
+
+/* Finds the number of the volume being scanned. Sorted by number the volumes are in time order,
+ * except where the numbers wrapped around, so the newest one is bisected for. */
+static gint _site_stream_newest(RadarSite *site, const gchar *url)
+{
+	GList *volumes = _site_stream_list(site, url, NULL, 0);
+	gint   newest  = 0;
+	if (volumes) {
+		time_t first = _site_stream_volume_time(site, url, volumes->data);
+		gint lo = 0, hi = g_list_length(volumes)-1;
+		while (lo < hi) {
+			gint   mid  = (lo+hi+1)/2;
+			time_t time = _site_stream_volume_time(site, url, g_list_nth_data(volumes, mid));
+			if (time && time >= first)
+				lo = mid;
+			else
+				hi = mid-1;
+		}
+		newest = atoi(strchr(g_list_nth_data(volumes, lo), '/')+1);
 	}
+	g_list_foreach(volumes, (GFunc)g_free, NULL);
+	g_list_free(volumes);
+	return newest;
+}
 
-	/* Load and add new volume */
-	g_debug("RadarSite: update_thread - load - %s", site->city->code);
-	site->level2 = aweather_level2_new_from_file(
-			file, site->city->code, colormaps, site->prefs);
+/* Reads a chunk, chunks are only needed once so downloaded ones are not kept */
+static gboolean _site_stream_read(RadarSite *site, const gchar *url,
+		const gchar *key, gchar **data, gsize *len)
+{
+	if (!g_str_has_prefix(url, "http")) {
+		gchar *path = g_build_filename(url, key, NULL);
+		gboolean ok = g_file_get_contents(path, data, len, NULL);
+		g_free(path);
+		return ok;
+	}
+	gchar *name  = g_strdelimit(g_strdup(strchr(key, '/')+1), "/", '-');
+	gchar *local = g_strconcat(site->city->code, "/chunks/", name, NULL);
+	gchar *uri   = g_strconcat(url, "/", key, NULL);
+	gchar *file  = aweather_download_fetch(site->download, SITE_CACHE_PREFIX,
+			uri, local, GRITS_ONCE, AWEATHER_DOWNLOAD_BACKGROUND,
+			_site_watch_loading, site, site->watch_cancellable);
+	gboolean ok = file && g_file_get_contents(file, data, len, NULL);
+	if (file)
+		g_remove(file);
 	g_free(file);
-	if (!site->level2) {
-		site->message = "Load failed";
+	g_free(uri);
+	g_free(local);
+	g_free(name);
+	return ok;
+}
+
+/* Decodes the chunks of the volume being scanned that were uploaded since the last poll */
+static void _site_stream_thread(gpointer _site)
+{
+	RadarSite *site = _site;
+	GCancellable *cancellable = site->watch_cancellable;
+	g_debug("RadarSite: stream_thread - %s - volume %d, chunk %d",
+			site->city->code, site->stream_volume, site->stream_chunks);
+
+	gchar *url = grits_prefs_get_string(site->prefs, "aweather/chunks_url", NULL);
+	if (!site->stream_volume) {
+		site->stream_volume = _site_stream_newest(site, url);
+		site->stream_since  = time(NULL);
+	}
+	if (!site->stream_volume || g_cancellable_is_cancelled(cancellable))
 		goto out;
+
+	gchar *prefix = g_strdup_printf("%s/%d/", site->city->code, site->stream_volume);
+	GList *chunks = _site_stream_list(site, url, prefix, 0);
+	g_free(prefix);
+	if (!chunks && time(NULL) - site->stream_since > SITE_STREAM_STALE) {
+		/* The numbers skipped ahead, eg. after an outage */
+		g_debug("RadarSite: stream_thread - %s - volume %d never showed up",
+				site->city->code, site->stream_volume);
+		site->stream_volume = 0;
+	}
+	if (chunks && !site->stream_level2) {
+		site->stream_level2 = aweather_level2_new_decoding(
+				site->city->code, _get_colormaps(), site->prefs);
+		site->stream_time   = _site_stream_time(chunks->data);
 	}
-	grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
-	grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
-			GRITS_LEVEL_WORLD+3, TRUE);
+
+	for (GList *cur = g_list_nth(chunks, site->stream_chunks); cur; cur = cur->next) {
+		/* Chunks have to be decoded in order, wait for one listed out of order */
+		if (_site_stream_chunk(cur->data) != site->stream_chunks+1 ||
+		    site->stream_done || g_cancellable_is_cancelled(cancellable))
+			break;
+		gchar *data;
+		gsize  len;
+		if (!_site_stream_read(site, url, cur->data, &data, &len))
+			break;
+		Level2Decoder *decoder = site->stream_level2->decoder;
+		if (!level2_decoder_feed(decoder, (guint8*)data, len)) {
+			g_warning("RadarSite: stream_thread - %s - cannot decode %s",
+					site->city->code, (gchar*)cur->data);
+			site->stream_done = TRUE;
+		}
+		if (level2_decoder_is_complete(decoder) || g_str_has_suffix(cur->data, "-E"))
+			site->stream_done = TRUE;
+		site->stream_chunks++;
+		g_free(data);
+	}
+	g_list_foreach(chunks, (GFunc)g_free, NULL);
+	g_list_free(chunks);
 
 out:
-	if (!site->idle_source)
-		site->idle_source = g_idle_add(_site_update_end, site);
-	return NULL;
+	g_free(url);
+	_site_watch_done(site);
 }
 
-void _site_update(RadarSite *site)
+/* Shows what has been decoded of the streamed volume. It replaces the shown volume once its first sweep has rays */
+static void _site_stream_end(RadarSite *site, gboolean current)
 {
-	/* If we are hidden and the user has configured this application to not reload radar sites that are hidden, then don't reload anything, but instead, set the 'needs to reload when shown' flag. */
-	if(site->hidden
-		&& !grits_prefs_get_boolean(site->prefs, "aweather/download_radar_files_for_non_visible_sites", NULL)){
-		site->lNeedsRefreshWhenShown = true;
+	AWeatherLevel2 *level2 = site->stream_level2;
+	if (!current || site->status != STATUS_LOADED ||
+	    !grits_prefs_get_boolean(site->prefs, "aweather/realtime", NULL)) {
+		_site_stream_reset(site);
+		return;
+	}
+	if (!level2)
+		return;
 
-		/* If we haven't loaded anything for this site yet, but it isn't visible (so we cannot load anything for it right now),
-		 * then flag the site as 'pending load' so we know that an initial load is still needed, but don't keep adding the site to the notebook.
-		 */
-		if(site->status == STATUS_UNLOADED)
-			site->status = STATUS_PENDING_LOAD;
+	/* Nothing feeds an ended volume any more, it is shown like any other from here on */
+	Level2DecoderChanges changes = site->stream_done ?
+		aweather_level2_finish(level2) : aweather_level2_sync(level2);
+	gboolean animating = site->objRadarAnimation->lIsAnimating;
+	gboolean shown     = FALSE;
+	if (site->level2 != level2 && !animating &&
+	    level2->iSelectedSweepId != AWEATHER_LEVEL2_SELECTED_SWEEP_ID_NONE) {
+		g_debug("RadarSite: stream_end - %s - showing volume %d",
+				site->city->code, site->stream_volume);
+		grits_object_destroy_pointer(&site->level2);
+		site->level2 = g_object_ref(level2);
+		GDateTime *date = g_date_time_new_from_unix_utc(site->stream_time);
+		gchar *time = g_date_time_format(date, "%Y%m%d_%H%M%S");
+		g_free(site->volume_name);
+		site->volume_name = g_strconcat(site->city->code, "_", time, NULL);
+		g_free(time);
+		g_date_time_unref(date);
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+		grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
+				GRITS_LEVEL_WORLD+3, TRUE);
+		_site_show_volume(site);
+		shown = TRUE;
+	} else if (site->level2 == level2 && !animating &&
+	           (changes & LEVEL2_DECODER_SWEEPS) && !site->stream_done) {
+		/* New sweeps to choose from */
+		_site_show_sweeps(site);
+	}
+	if (site->level2 == level2)
+		site->time = time(NULL);
+
+	if (site->stream_done) {
+		if (site->level2 == level2 && !animating && !shown)
+			_site_show_volume(site);
+		g_clear_object(&site->stream_level2);
+		site->stream_volume = site->stream_volume % SITE_STREAM_VOLUMES + 1;
+		site->stream_chunks = 0;
+		site->stream_since  = time(NULL);
+		site->stream_done   = FALSE;
+	}
+}
 
-		return;
+/* Stops following the volume being scanned, the watch task must not be running */
+static void _site_stream_reset(RadarSite *site)
+{
+	g_clear_object(&site->stream_level2);
+	site->stream_volume = 0;
+	site->stream_chunks = 0;
+	site->stream_time   = 0;
+	site->stream_done   = FALSE;
+}
+
+/* Polls are speculative, they never hold up a load the user asked for */
+static RadarPoolPriority _site_watch_priority(gpointer _site)
+{
+	RadarSite *site = _site;
+	return site->hidden ? RADAR_POOL_PRIORITY_BACKGROUND : RADAR_POOL_PRIORITY_ANIMATION;
+}
+
+/* Waits for the poll and throws away anything it found. The idle is only removed once the
+ * task has finished, until then the task can still add it */
+static void _site_watch_reap(RadarSite *site)
+{
+	radar_pool_task_finish(site->pool, site->watch_task);
+	site->watch_task = NULL;
+	if (site->watch_idle)
+		g_source_remove(site->watch_idle);
+	site->watch_idle = 0;
+	g_clear_object(&site->watch_cancellable);
+	g_clear_object(&site->watch_level2);
+	g_free(site->watch_have);
+	g_free(site->watch_name);
+	site->watch_have = NULL;
+	site->watch_name = NULL;
+}
+
+static gboolean _site_watch_wanted(RadarSite *site)
+{
+	/* Level III products are listed differently, those sites pick up new scans on refresh */
+	return !site->hidden && site->status == STATUS_LOADED && !site->level3 &&
+		!grits_viewer_get_offline(site->viewer) &&
+		grits_prefs_get_boolean(site->prefs, "aweather/update_enab", NULL) &&
+		time(NULL) - site->time < SITE_WATCH_LIVE;
+}
+
+static gboolean _site_watch_timeout(gpointer _site)
+{
+	RadarSite *site = _site;
+	site->watch_id = 0;
+	if (!_site_watch_wanted(site) || site->watch_task)
+		return FALSE;
+	/* The animation has its own loop end, try again later */
+	if (site->objRadarAnimation->lIsAnimating) {
+		_site_watch_schedule(site);
+		return FALSE;
 	}
+	site->watch_generation  = site->generation;
+	site->watch_have        = g_strdup(site->volume_name);
+	site->watch_cancellable = g_cancellable_new();
+	site->watch_task = radar_pool_push(site->pool,
+			grits_prefs_get_boolean(site->prefs, "aweather/realtime", NULL) ?
+				_site_stream_thread : _site_watch_thread,
+			_site_watch_priority, site);
+	return FALSE;
+}
 
-	if (site->status == STATUS_LOADING)
+/* Queues the next poll, timed for when the next volume should be listed */
+static void _site_watch_schedule(RadarSite *site)
+{
+	if (site->watch_id)
+		g_source_remove(site->watch_id);
+	site->watch_id = 0;
+	if (!_site_watch_wanted(site) || site->watch_task)
 		return;
-	site->status = STATUS_LOADING;
-	
-	site->time = grits_viewer_get_time(site->viewer);
-	g_debug("RadarSite: update %s - %d",
-			site->city->code, (gint)site->time);
 
-	/* Stop the animation if it was running, save off the user's animation choice (running or stopped), then load the new loop end time.
-	 * We start the animation back up automatically if the animation was running when we got here.
-	 */
-	_stop_animation_and_wait_for_animation_to_stop_save_user_choice(site);
+	/* Spooled volumes are announced by _site_spool_added, there is nothing to poll */
+	gboolean realtime = grits_prefs_get_boolean(site->prefs, "aweather/realtime", NULL);
+	if (site->spool && !realtime) {
+		gchar *newest = radar_spool_newest(site->spool);
+		if (g_strcmp0(newest, site->volume_name) > 0)
+			site->watch_id = site->objRadarAnimation->lIsAnimating ?
+				g_timeout_add_seconds(SITE_WATCH_MIN_POLL, _site_watch_timeout, site) :
+				g_idle_add(_site_watch_timeout, site);
+		g_free(newest);
+		return;
+	}
 
-	/* Add a progress bar */
-	GtkWidget *progress = gtk_progress_bar_new();
-	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress), "Loading...");
-	aweather_bin_set_child(GTK_BIN(site->config), progress);
+	g_mutex_lock(&site->watch_lock);
+	gint interval = site->watch_interval ? site->watch_interval : SITE_WATCH_INTERVAL;
+	gint delay    = SITE_WATCH_MIN_POLL;
+	if (site->watch_newest)
+		delay = site->watch_newest + 2*interval + SITE_WATCH_LATENCY - time(NULL);
+	g_mutex_unlock(&site->watch_lock);
+	delay = CLAMP(delay, SITE_WATCH_MIN_POLL, interval);
+	if (realtime)
+		delay = SITE_STREAM_POLL;
+	g_debug("RadarSite: watch_schedule - %s - %ds", site->city->code, delay);
+	site->watch_id = g_timeout_add_seconds(delay, _site_watch_timeout, site);
+}
 
-	/* Remove old volume */
-	g_debug("RadarSite: update - remove - %s", site->city->code);
-	grits_object_destroy_pointer(&site->level2);
+/* Swaps in the new volume, unless the user moved on while it was loading */
+static gboolean _site_watch_end(gpointer _site)
+{
+	RadarSite *site = _site;
+	g_mutex_lock(&site->watch_lock);
+	site->watch_idle = 0;
+	g_mutex_unlock(&site->watch_lock);
+	AWeatherLevel2 *level2 = site->watch_level2;
+	gchar          *name   = site->watch_name;
+	site->watch_level2 = NULL;
+	site->watch_name   = NULL;
+	gboolean current = site->watch_generation == site->generation;
+	_site_watch_reap(site);
+
+	/* The site was unloaded while polling, nothing uses its spool any more */
+	if (site->status == STATUS_UNLOADED && site->spool) {
+		radar_spool_free(site->spool);
+		site->spool = NULL;
+	}
 
-	/* Fork loading right away so updating the
-	 * list of times doesn't take too long */
-	g_thread_new("site-update-thread", _site_update_thread, site);
+	if (level2 && current && site->status == STATUS_LOADED &&
+	    !site->objRadarAnimation->lIsAnimating) {
+		g_debug("RadarSite: watch_end - %s - new volume %s", site->city->code, name);
+		grits_object_destroy_pointer(&site->level2);
+		site->level2 = level2;
+		site->time   = time(NULL);
+		g_free(site->volume_name);
+		site->volume_name = name;
+		aweather_level2_finish(site->level2);
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+		grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
+				GRITS_LEVEL_WORLD+3, TRUE);
+		_site_show_volume(site);
+	} else {
+		g_clear_object(&level2);
+		g_free(name);
+	}
+	_site_stream_end(site, current);
+	_site_watch_schedule(site);
+	return FALSE;
+}
+
+static void _site_spool_added(const gchar *name, gpointer _site)
+{
+	RadarSite *site = _site;
+	g_debug("RadarSite: spool_added - %s - %s", site->city->code, name);
+	_site_watch_schedule(site);
+}
+
+/* Stops watching. Unless waiting, a running poll is only cancelled and _site_watch_end throws its result away */
+static void _site_watch_stop(RadarSite *site, gboolean wait)
+{
+	if (site->watch_id)
+		g_source_remove(site->watch_id);
+	site->watch_id = 0;
+	if (!site->watch_task)
+		return;
+	g_cancellable_cancel(site->watch_cancellable);
+	if (wait)
+		_site_watch_reap(site);
 }
 
 /* RadarSite methods */
@@ -1183,6 +2814,15 @@ void radar_site_unload(RadarSite *site)
 
 	g_debug("RadarSite: unload %s", site->city->code);
 
+	/* A running poll is only cancelled, _site_watch_end lets go of the spool and stream it uses */
+	_site_watch_stop(site, FALSE);
+	if (!site->watch_task) {
+		_site_stream_reset(site);
+		if (site->spool)
+			radar_spool_free(site->spool);
+		site->spool = NULL;
+	}
+
 	if (site->time_id)
 		g_signal_handler_disconnect(site->viewer, site->time_id);
 	if (site->refresh_id)
@@ -1196,6 +2836,8 @@ void radar_site_unload(RadarSite *site)
 		gtk_widget_destroy(site->config);
 
 	/* Remove radar */
+	radar_mosaic_set_site(site->mosaic, site->city->code,
+			site->city->pos.lat, site->city->pos.lon, NULL);
 	grits_object_destroy_pointer(&site->level2);
 
 	/* Cleanup the animation information */
@@ -1213,12 +2855,21 @@ void radar_site_load(RadarSite *site)
 {
 	g_debug("RadarSite: load %s", site->city->code);
 
+	/* Volumes come from the local spool instead of nexrad_url when there is one.
+	 * A poll that outlived the last unload may still be using the old one */
+	gchar *spool_dir = grits_prefs_get_string(site->prefs, "aweather/spool_dir", NULL);
+	if (spool_dir && *spool_dir && !site->spool) {
+		gchar *dir = g_build_filename(spool_dir, site->city->code, NULL);
+		site->spool = radar_spool_new(dir, _site_spool_added, site);
+		g_free(dir);
+	}
+	g_free(spool_dir);
+
 	/* Initialize animation object in case the user wants to run an animation */
 	site->objRadarAnimation = g_malloc0(sizeof(RadarAnimation));
 
 	/* Initialize animation fields */
-	site->objRadarAnimation->cAnimationCurrentFrameTimestampMsg = NULL;
-	site->objRadarAnimation->objAnimationThread = NULL;
+	site->objRadarAnimation->objAnimationLoadTask = NULL;
 	site->objRadarAnimation->lUserWantsToAnimate = false;
 	site->objRadarAnimation->aAnimationCurrentFileSortedSubframes = NULL;
 
@@ -1234,115 +2885,208 @@ void radar_site_load(RadarSite *site)
 	gtk_widget_show_all(site->config);
 	if (gtk_notebook_get_current_page(GTK_NOTEBOOK(site->pconfig)) == 0)
 		gtk_notebook_set_current_page(GTK_NOTEBOOK(site->pconfig), -1);
-
-	/* Set up radar loading */
-	site->time_id = g_signal_connect_swapped(site->viewer, "time-changed",
-			G_CALLBACK(_site_update), site);
-	site->refresh_id = g_signal_connect_swapped(site->viewer, "refresh",
-			G_CALLBACK(_site_update), site);
-	_site_update(site);
-}
-
-void _site_on_location_changed(GritsViewer *viewer,
-		gdouble lat, gdouble lon, gdouble elev,
-		gpointer _site)
-{
-	static gdouble min_dist = EARTH_R / 30;
-	RadarSite *site = _site;
-
-	/* Calculate distance, could cache xyz values */
-	gdouble eye_xyz[3], site_xyz[3];
-	lle2xyz(lat, lon, elev, &eye_xyz[0], &eye_xyz[1], &eye_xyz[2]);
-	lle2xyz(site->city->pos.lat, site->city->pos.lon, site->city->pos.elev,
-			&site_xyz[0], &site_xyz[1], &site_xyz[2]);
-	gdouble dist = distd(site_xyz, eye_xyz);
-
-	/* Load or unload the site if necessasairy */
-	if (dist <= min_dist && dist < elev*1.25 && site->status == STATUS_UNLOADED)
-		radar_site_load(site);
-	else if (dist > 5*min_dist &&  site->status != STATUS_UNLOADED)
-		radar_site_unload(site);
-}
-
-static gboolean on_marker_clicked(GritsObject *marker, GdkEvent *event, RadarSite *site)
-{
-	GritsViewer *viewer = site->viewer;
-	GritsPoint center = marker->center;
-	grits_viewer_set_location(viewer, center.lat, center.lon, EARTH_R/35);
-	grits_viewer_set_rotation(viewer, 0, 0, 0);
-	/* Recursivly set notebook tabs */
-	GtkWidget *widget, *parent;
-	for (widget = site->config; widget; widget = parent) {
-		parent = gtk_widget_get_parent(widget);
-		if (GTK_IS_NOTEBOOK(parent)) {
-			gint i = gtk_notebook_page_num(GTK_NOTEBOOK(parent), widget);
-			gtk_notebook_set_current_page(GTK_NOTEBOOK(parent), i);
-		}
-	}
-	return TRUE;
+
+	/* Set up radar loading */
+	site->time_id = g_signal_connect_swapped(site->viewer, "time-changed",
+			G_CALLBACK(_site_update), site);
+	site->refresh_id = g_signal_connect_swapped(site->viewer, "refresh",
+			G_CALLBACK(_site_update), site);
+	_site_update(site);
 }
 
+/* Sites are created for every radar at startup, the tab is only made when needed */
 RadarSite *radar_site_new(city_t *city, GtkWidget *pconfig,
-		GritsViewer *viewer, GritsPrefs *prefs, GritsHttp *http)
+		GritsViewer *viewer, GritsPrefs *prefs, RadarPool *pool,
+		AWeatherDownload *download, RadarMirrors *mirrors, RadarMosaic *mosaic)
 {
 	RadarSite *site = g_new0(RadarSite, 1);
 	site->viewer  = g_object_ref(viewer);
 	site->prefs   = g_object_ref(prefs);
-	//site->http    = http;
-	site->http    = grits_http_new(G_DIR_SEPARATOR_S
-			"nexrad" G_DIR_SEPARATOR_S
-			"level2" G_DIR_SEPARATOR_S);
+	site->pool    = pool;
+	site->download = download;
+	site->mirrors = mirrors;
+	site->mosaic  = mosaic;
 	site->city    = city;
 	site->pconfig = pconfig;
 	site->hidden  = TRUE;
+	g_mutex_init(&site->watch_lock);
 
 	/* Ensure the refresh variable is initialized to a known state. */
 	site->lNeedsRefreshWhenShown = false;
 
-	/* Set initial location */
-	gdouble lat, lon, elev;
-	grits_viewer_get_location(viewer, &lat, &lon, &elev);
-	_site_on_location_changed(viewer, lat, lon, elev, site);
-
-	/* Add marker */
-	site->marker = grits_marker_new(site->city->name);
-	GRITS_OBJECT(site->marker)->center = site->city->pos;
-	GRITS_OBJECT(site->marker)->lod    = EARTH_R*0.75*site->city->lod;
-	grits_viewer_add(site->viewer, GRITS_OBJECT(site->marker),
-			GRITS_LEVEL_HUD, FALSE);
-	g_signal_connect(site->marker, "clicked",
-			G_CALLBACK(on_marker_clicked), site);
-	grits_object_set_cursor(GRITS_OBJECT(site->marker), GDK_HAND2);
-
-	/* Connect signals */
-	site->location_id  = g_signal_connect(viewer, "location-changed",
-			G_CALLBACK(_site_on_location_changed), site);
+	/* The site never moves, the index only needs this once */
+	lle2xyz(city->pos.lat, city->pos.lon, city->pos.elev,
+			&site->xyz[0], &site->xyz[1], &site->xyz[2]);
 
 	return site;
 }
 
 void radar_site_free(RadarSite *site)
 {
+	/* Nothing may still be running for this site on the shared pool */
+	if (site->status != STATUS_UNLOADED)
+		_stop_animation_and_wait_for_animation_to_stop_save_user_choice(site);
+	if (site->debounce_id)
+		g_source_remove(site->debounce_id);
+	if (site->load_task) {
+		g_cancellable_cancel(site->load_cancellable);
+		radar_pool_task_finish(site->pool, site->load_task);
+		site->load_task = NULL;
+	}
+	g_clear_object(&site->load_cancellable);
+	if (site->partial_id)
+		g_source_remove(site->partial_id);
+	site->partial_id = 0;
+	g_clear_object(&site->load_level2);
+	if (site->status == STATUS_LOADING)
+		site->status = STATUS_LOADED;
 	radar_site_unload(site);
-	grits_object_destroy_pointer(&site->marker);
-	if (site->location_id)
-		g_signal_handler_disconnect(site->viewer, site->location_id);
-	grits_http_free(site->http);
+	_site_watch_stop(site, TRUE);
+	_site_stream_reset(site);
+	if (site->spool)
+		radar_spool_free(site->spool);
+	g_free(site->volume_name);
+	g_mutex_clear(&site->watch_lock);
 	g_object_unref(site->viewer);
 	g_object_unref(site->prefs);
+	g_free(site);
+}
 
-	/* If the animation was run, be sure to cleanup an old thread pointer */
-	/* This is called when the window is closed. The thread doesn't like being unref-ed when the window is closed */
-	//if(site->objRadarAnimation->objAnimationThread != NULL)
-	//	g_object_unref(site->objRadarAnimation->objAnimationThread);
 
-	g_free(site);
+/******************
+ * RadarSiteIndex *
+ ******************/
+/* Sites are loaded when the eye comes within SITE_LOAD_DIST of them and unloaded again past SITE_UNLOAD_DIST.
+ * Site positions are bucketed into a grid of SITE_LOAD_DIST sized cubes,
+ * so only the 27 cells around the eye can hold sites that need loading. */
+#define SITE_LOAD_DIST   (EARTH_R/30)
+#define SITE_UNLOAD_DIST (5*SITE_LOAD_DIST)
+
+typedef struct {
+	gdouble     size;     // Cell size
+	GHashTable *cells;    // Cell key -> GSList of the sites in that cell
+} SiteGrid;
+
+struct _RadarSiteIndex {
+	SiteGrid    load;     // All sites, for loading
+	GHashTable *nearby;   // Sites loaded by the index that have not been unloaded yet
+};
+
+/* Packs a grid cell into a hash key. Cells further than 127 from the center of the earth get 0, which is never used */
+static guint _site_grid_key(const gint cell[3])
+{
+	guint key = 0;
+	for (int i = 0; i < 3; i++) {
+		if (cell[i] < -127 || cell[i] > 127)
+			return 0;
+		key = key << 8 | (cell[i] + 128);
+	}
+	return key;
+}
+
+static void _site_grid_cell(SiteGrid *grid, const gdouble xyz[3], gint cell[3])
+{
+	for (int i = 0; i < 3; i++)
+		cell[i] = CLAMP(floor(xyz[i] / grid->size), -1000, 1000);
+}
+
+static void _site_grid_add(SiteGrid *grid, RadarSite *site)
+{
+	gint cell[3];
+	_site_grid_cell(grid, site->xyz, cell);
+	gpointer key   = GUINT_TO_POINTER(_site_grid_key(cell));
+	GSList  *sites = g_hash_table_lookup(grid->cells, key);
+	g_hash_table_insert(grid->cells, key, g_slist_prepend(sites, site));
+}
+
+/* Returns the sites in the cells around xyz, the caller frees the list but not the sites */
+static GSList *_site_grid_query(SiteGrid *grid, const gdouble xyz[3])
+{
+	GSList *found = NULL;
+	gint cell[3];
+	_site_grid_cell(grid, xyz, cell);
+	for (gint dx = -1; dx <= 1; dx++)
+	for (gint dy = -1; dy <= 1; dy++)
+	for (gint dz = -1; dz <= 1; dz++) {
+		gint near[3] = {cell[0]+dx, cell[1]+dy, cell[2]+dz};
+		GSList *sites = g_hash_table_lookup(grid->cells,
+				GUINT_TO_POINTER(_site_grid_key(near)));
+		for (GSList *cur = sites; cur; cur = cur->next)
+			found = g_slist_prepend(found, cur->data);
+	}
+	return found;
+}
+
+static void _site_grid_init(SiteGrid *grid, gdouble size)
+{
+	grid->size  = size;
+	grid->cells = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void _site_grid_clear(SiteGrid *grid)
+{
+	GHashTableIter iter;
+	GSList *sites;
+	g_hash_table_iter_init(&iter, grid->cells);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*)&sites))
+		g_slist_free(sites);
+	g_hash_table_destroy(grid->cells);
+}
+
+RadarSiteIndex *radar_site_index_new(void)
+{
+	RadarSiteIndex *index = g_new0(RadarSiteIndex, 1);
+	_site_grid_init(&index->load, SITE_LOAD_DIST);
+	index->nearby  = g_hash_table_new(g_direct_hash, g_direct_equal);
+	return index;
+}
+
+void radar_site_index_add(RadarSiteIndex *index, RadarSite *site)
+{
+	_site_grid_add(&index->load, site);
+}
+
+/* Loads the sites the eye moved close to and unloads the ones it moved away from */
+void radar_site_index_update(RadarSiteIndex *index,
+		gdouble lat, gdouble lon, gdouble elev)
+{
+	gdouble eye[3];
+	lle2xyz(lat, lon, elev, &eye[0], &eye[1], &eye[2]);
+
+	/* Sites that are busy refuse to unload, they are tried again on the next move */
+	GHashTableIter iter;
+	RadarSite *site;
+	g_hash_table_iter_init(&iter, index->nearby);
+	while (g_hash_table_iter_next(&iter, (gpointer*)&site, NULL)) {
+		if (site->status != STATUS_UNLOADED && distd(site->xyz, eye) > SITE_UNLOAD_DIST)
+			radar_site_unload(site);
+		if (site->status == STATUS_UNLOADED)
+			g_hash_table_iter_remove(&iter);
+	}
+
+	GSList *sites = _site_grid_query(&index->load, eye);
+	for (GSList *cur = sites; cur; cur = cur->next) {
+		site = cur->data;
+		gdouble dist = distd(site->xyz, eye);
+		if (dist <= SITE_LOAD_DIST && dist < elev*1.25 && site->status == STATUS_UNLOADED) {
+			radar_site_load(site);
+			g_hash_table_add(index->nearby, site);
+		}
+	}
+	g_slist_free(sites);
 }
 
+void radar_site_index_free(RadarSiteIndex *index)
+{
+	_site_grid_clear(&index->load);
+	g_hash_table_destroy(index->nearby);
+	g_free(index);
+}
 
 /**************
  * RadarConus *
  **************/
+#define CONUS_CACHE_PREFIX G_DIR_SEPARATOR_S "nexrad" G_DIR_SEPARATOR_S "conus" G_DIR_SEPARATOR_S
 #define CONUS_NORTH       53.0
 #define CONUS_WEST       -132.5
 #define CONUS_WIDTH       4000.0
@@ -1350,18 +3094,61 @@ void radar_site_free(RadarSite *site)
 #define CONUS_DEG_PER_PX_VERTICAL  0.0128
 #define CONUS_DEG_PER_PX_HORIZONTAL  0.0166
 
-#define CONUS_TEXTURE_BUFFER_LENGTH 3000
+/* Textures hold one half with a transparent one pixel frame around it */
+#define CONUS_TEXTURE_WIDTH  (CONUS_WIDTH/2+2)
+#define CONUS_TEXTURE_HEIGHT (CONUS_HEIGHT+2)
+
+/* Rows per pool task when reprojecting */
+#define CONUS_BAND_ROWS   100
+
+/* Bump when _unprojectPoint or the border search change so cached remap tables are rebuilt */
+#define CONUS_REMAP_VERSION 1
+
+/* Longest loop and number of evicted frames kept for their buffers.
+ * The GIFs in the disk cache are kept within aweather/cache_conus_mb by the cache manager. */
+#define CONUS_LOOP_FRAMES_MAX  12
+#define CONUS_SPARE_FRAMES     2
+
+/* A reprojected image. Once it is uploaded to its textures the pixels are handed on to the spare frames */
+typedef struct {
+	gchar       *name;        // File name, a refresh that asks for the same file reuses the frame
+	guchar      *pixels[2];   // Reprojected west/east halves, NULL once uploaded
+	gsize        size;        // Size of each half
+	guint        tex[2];      // Textures of the halves, 0 until uploaded on the UI thread
+} ConusFrame;
 
 struct _RadarConus {
 	GritsViewer *viewer;
-	GritsHttp   *http;
+	GritsPrefs  *prefs;
+	AWeatherDownload *download;
+	AWeatherCache *cache;     // Told about cached GIFs the loop keeps using
+	RadarPool   *pool;
 	GtkWidget   *config;
+	GtkWidget   *status;      // Progress bar or the name of the frame shown
+	GtkWidget   *loop_length;
+	gboolean     hidden;
 	time_t       time;
+	guint        nframes;     // Frames to load, 1 unless looping
 	const gchar *message;
 	GMutex       loading;
+	gboolean     again;       // Update again once the current update finishes
+	GThread     *thread;      // Last update thread, joined before the next one starts
+	GCancellable *cancellable; // Stops the update thread's downloads when the conus is freed
+
+	GritsTile   *tile[2];     // Drawn with the textures of the frame shown, the tiles do not own them
 
-	gchar       *path;
-	GritsTile   *tile[2];
+	/* Frames in the loop, oldest first, and the frames the update thread is loading.
+	 * The update thread owns loading_frames and spare until it queues _conus_update_end. */
+	GPtrArray   *frames;
+	GPtrArray   *loading_frames;
+	GSList      *spare;       // Evicted frames whose buffers can be reused
+	guint        frame;       // Index of the frame shown
+	guint        loop_source; // _conus_loop_advance timeout source
+
+	/* Source pixel for every destination pixel, only used by the update thread */
+	guint32     *remap;
+	gint         remap_width;
+	gint         remap_height;
 
 	guint        time_id;     // "time-changed"     callback ID
 	guint        refresh_id;  // "refresh"          callback ID
@@ -1372,7 +3159,7 @@ void _conus_update_loading(gchar *file, goffset cur,
 		goffset total, gpointer _conus)
 {
 	RadarConus *conus = _conus;
-	GtkWidget *progress_bar = gtk_bin_get_child(GTK_BIN(conus->config));
+	GtkWidget *progress_bar = gtk_bin_get_child(GTK_BIN(conus->status));
 	double percent = (double)cur/total;
 	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), MIN(percent, 1.0));
 	gchar *msg = g_strdup_printf("Loading... %5.1f%% (%.2f/%.2f MB)",
@@ -1381,31 +3168,42 @@ void _conus_update_loading(gchar *file, goffset cur,
 	g_free(msg);
 }
 
-/* Copy images to graphics memory */
-static void _conus_update_end_copy(GritsTile *tile, guchar *pixels)
+/* Allocates the texture for one half. The image region is filled in by _conus_texture_upload */
+static guint _conus_texture_new(void)
 {
-	if (!tile->tex)
-		glGenTextures(1, &tile->tex);
+	guint tex;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, 4, CONUS_TEXTURE_WIDTH, CONUS_TEXTURE_HEIGHT, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	/* Only the one pixel frame around the image is ever sampled outside of it (linear filtering), keep it transparent */
+	gint    width  = CONUS_WIDTH/2;
+	gint    height = CONUS_HEIGHT;
+	guchar *clear  = g_malloc0((MAX(width, height)+2)*4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0,        width+2,1, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0,height+1, width+2,1, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0,        1,height+2, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, width+1,0,  1,height+2, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	g_free(clear);
 
-	gchar *clear = g_malloc0(CONUS_TEXTURE_BUFFER_LENGTH*CONUS_TEXTURE_BUFFER_LENGTH*4);
-	glBindTexture(GL_TEXTURE_2D, tile->tex);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
 
+/* Copy an image to graphics memory, only the image region is replaced */
+static void _conus_texture_upload(guint tex, guchar *pixels)
+{
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-	glTexImage2D(GL_TEXTURE_2D, 0, 4, CONUS_TEXTURE_BUFFER_LENGTH, CONUS_TEXTURE_BUFFER_LENGTH, 0,
-			GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	glBindTexture(GL_TEXTURE_2D, tex);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 1,1, CONUS_WIDTH/2,CONUS_HEIGHT,
 			GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-	tile->coords.n = 1.0/(CONUS_WIDTH/2);
-	tile->coords.w = 1.0/ CONUS_HEIGHT;
-	tile->coords.s = tile->coords.n +  CONUS_HEIGHT   / CONUS_TEXTURE_BUFFER_LENGTH;
-	tile->coords.e = tile->coords.w + (CONUS_WIDTH/2) / CONUS_TEXTURE_BUFFER_LENGTH;
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glFlush();
-	g_free(clear);
 }
 
 /* Pixel structure - packed so we can represent the 3-byte pixel */
@@ -1474,105 +3272,361 @@ static void _unprojectPoint(int ipiX, int ipiY, int* opiX, int* opiY){
   *opiY = 2.25170021e+00*y +  6.61600795e-04*y*y +  8.72044698e-08*y*y*y + 8.60491270e-01*x + 5.80511426e-04*x*y + -4.39101569e-08*x*y*y + -5.89743092e-04*x*x + -3.74718041e-07*x*x*y + 6.42016503e-10*x*x*x + -2.84533069e+02;
 }
 
-/* Split the pixbuf into east and west halves (with 2K sides)
- * Also map the pixbuf's alpha values */
-static void _conus_update_end_split(guchar *pixels, guchar *west, guchar *east,
-		gint width, gint height, gint pxsize)
+/* A band of rows reprojected on the worker pool */
+typedef struct {
+	RadarConus   *conus;
+	guchar       *pixels;     // Source image
+	gint          width, height, pxsize;
+	gboolean      build;      // Fill in conus->remap for these rows before using it
+	guchar       *out[2];     // West and east halves
+	gint          y0, y1;
+} ConusBand;
+
+/* Reprojects a band of rows so the map aligns with the globe, splits it into east and west halves (with 2K sides) and maps the alpha values.
+ * The remap table is built from the first image. The map borders it steps around are drawn in the same place on every image.
+ */
+static void _conus_reproject_band(gpointer _band)
 {
-	g_debug("Conus: update_end_split");
-	guchar *out[] = {west,east};
+	ConusBand *band = _band;
+	gint width = band->width;
+	gint half  = width/2;
+	for (gint y = band->y0; y < band->y1; y++)
+	for (gint x = 0; x < 2*half; x++) {
+		guint32 *remap = &band->conus->remap[y*width+x];
+		if (band->build) {
+			int srcX, srcY;
+			_unprojectPoint(x, y, &srcX, &srcY);
+			sPixel *src = _getNearestNonBoarderPixel(band->pixels,
+					width, band->height, band->pxsize, srcX, srcY);
+			*remap = ((guchar*)src - band->pixels) / band->pxsize;
+		}
+
+		guchar *src = &band->pixels[(gsize)*remap * band->pxsize];
+		guchar *dst = &band->out[x/half][(y*half + x%half)*4];
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 0xff * 0.75;
+		/* Make black background transparent */
+		if(src[0] == 0 && src[1] == 0 && src[2] == 0){
+			dst[3] = 0x00;
+		}
+	}
+}
 
+/* The update thread waits on every band, so they never queue behind hidden sites,
+ * even while the CONUS tab is not the one shown */
+static RadarPoolPriority _conus_reproject_priority(gpointer _band)
+{
+	return RADAR_POOL_PRIORITY_VISIBLE;
+}
 
-	/* Change projection of map so it aligns with the globe */
+static gchar *_conus_remap_path(gint width, gint height)
+{
+	gchar *name = g_strdup_printf("remap-%dx%d.bin", width, height);
+	gchar *path = g_build_filename(g_get_user_cache_dir(), "grits",
+			"nexrad", "conus", name, NULL);
+	g_free(name);
+	return path;
+}
 
-	/* Copy the image to a temp memory buffer that we use below to copy from for the source of the projection.
-	 * Without this, the projection can end up being used as source data for the next projected pixel.
-	 */
-	int iArrayLengthBytes = sizeof(guchar) * width * height * pxsize;
-	guchar *aOriginalImage = malloc(iArrayLengthBytes);
-	memcpy(aOriginalImage, pixels, iArrayLengthBytes);
+/* Loads the remap table for images of the given size from the disk cache */
+static gboolean _conus_remap_load(RadarConus *conus, gint width, gint height)
+{
+	gchar  *path = _conus_remap_path(width, height);
+	gchar  *data = NULL;
+	gsize   len  = 0;
+	gsize   size = (gsize)width*height*sizeof(guint32);
+	gboolean ok  = g_file_get_contents(path, &data, &len, NULL);
+	g_free(path);
+	if (!ok)
+		return FALSE;
+	guint32 *header = (guint32*)data;
+	if (len != 3*sizeof(guint32) + size || header[0] != CONUS_REMAP_VERSION ||
+	    header[1] != (guint32)width || header[2] != (guint32)height) {
+		g_free(data);
+		return FALSE;
+	}
+	g_free(conus->remap);
+	conus->remap        = g_malloc(size);
+	conus->remap_width  = width;
+	conus->remap_height = height;
+	memcpy(conus->remap, data + 3*sizeof(guint32), size);
+	g_free(data);
+	return TRUE;
+}
 
-	for(int y = 0; y < height; ++y)
-	for(int x = 0; x < width; ++x){
-		int srcX, srcY;
-		_unprojectPoint(x, y, &srcX, &srcY);
-		sPixel* src = _getNearestNonBoarderPixel(aOriginalImage, width, height, pxsize, srcX, srcY);
-		sPixel* dest = _getPixelAt(pixels, width, height, pxsize, x, y);
-		/* Copy pixel data from source to destination pixel */
-		*dest = *src;
+static void _conus_remap_save(RadarConus *conus)
+{
+	gsize size = (gsize)conus->remap_width*conus->remap_height*sizeof(guint32);
+	guint32 header[3] = {CONUS_REMAP_VERSION, conus->remap_width, conus->remap_height};
+	gchar *data = g_malloc(sizeof(header) + size);
+	memcpy(data, header, sizeof(header));
+	memcpy(data + sizeof(header), conus->remap, size);
+	gchar *path = _conus_remap_path(conus->remap_width, conus->remap_height);
+	GError *error = NULL;
+	if (!g_file_set_contents(path, data, sizeof(header) + size, &error)) {
+		g_warning("Conus: remap_save - %s", error->message);
+		g_error_free(error);
 	}
+	g_free(path);
+	g_free(data);
+}
 
-	free(aOriginalImage);
+typedef enum {
+	CONUS_REPROJECT_OK,
+	CONUS_REPROJECT_FAILED,    // The image could not be decoded and was removed from the cache
+	CONUS_REPROJECT_CANCELLED, // The worker pool is shutting down
+} ConusReprojectResult;
 
+/* Decodes the image and reprojects it into the frame. Runs on the update thread, sets conus->message on failure */
+static ConusReprojectResult _conus_reproject(RadarConus *conus, const gchar *path, ConusFrame *frame)
+{
+	GError *error = NULL;
+	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(path, &error);
+	if (!pixbuf || error) {
+		g_warning("Conus: reproject - error loading pixbuf: %s", path);
+		if (error)
+			g_error_free(error);
+		if (pixbuf)
+			g_object_unref(pixbuf);
+		conus->message = "Error loading pixbuf";
+		g_remove(path);
+		return CONUS_REPROJECT_FAILED;
+	}
 
+	gint width  = gdk_pixbuf_get_width(pixbuf);
+	gint height = gdk_pixbuf_get_height(pixbuf);
+
+	/* The mapping is the same for every image, only work it out once */
+	gboolean build = FALSE;
+	if (!conus->remap || conus->remap_width != width || conus->remap_height != height) {
+		if (!_conus_remap_load(conus, width, height)) {
+			g_debug("Conus: reproject - building remap table");
+			g_free(conus->remap);
+			conus->remap        = g_malloc((gsize)width*height*sizeof(guint32));
+			conus->remap_width  = width;
+			conus->remap_height = height;
+			build = TRUE;
+		}
+	}
 
-	/* Split the image into two and alpha-map the image */
-	for (int y = 0; y < height; y++)
-	for (int x = 0; x < width;  x++) {
-		gint subx = x % (width/2);
-		gint idx  = x / (width/2);
-		guchar *src = &pixels[(y*width+x)*pxsize];
-		guchar *dst = &out[idx][(y*(width/2)+subx)*4];
-		dst[0] = src[0];
-		dst[1] = src[1];
-		dst[2] = src[2];
-		dst[3] = 0xff * 0.75;
-		/* Make black background transparent */
-		if(src[0] == 0 && src[1] == 0 && src[2] == 0){
-			dst[3] = 0x00;
+	/* Recycled frames keep their buffers */
+	gsize pixels_size = 4*(width/2)*height;
+	if (frame->size != pixels_size) {
+		for (int i = 0; i < 2; i++) {
+			g_free(frame->pixels[i]);
+			frame->pixels[i] = g_malloc(pixels_size);
+		}
+		frame->size = pixels_size;
+	}
+
+	gint            nbands = (height + CONUS_BAND_ROWS - 1) / CONUS_BAND_ROWS;
+	ConusBand      *bands  = g_new0(ConusBand, nbands);
+	RadarPoolTask **tasks  = g_new0(RadarPoolTask*, nbands);
+	for (gint i = 0; i < nbands; i++) {
+		bands[i].conus  = conus;
+		bands[i].pixels = gdk_pixbuf_get_pixels(pixbuf);
+		bands[i].width  = width;
+		bands[i].height = height;
+		bands[i].pxsize = gdk_pixbuf_get_has_alpha(pixbuf) ? 4 : 3;
+		bands[i].build  = build;
+		bands[i].out[0] = frame->pixels[0];
+		bands[i].out[1] = frame->pixels[1];
+		bands[i].y0     = i*CONUS_BAND_ROWS;
+		bands[i].y1     = MIN(bands[i].y0 + CONUS_BAND_ROWS, height);
+		tasks[i] = radar_pool_push(conus->pool, _conus_reproject_band,
+				_conus_reproject_priority, &bands[i]);
+	}
+	gboolean complete = TRUE;
+	for (gint i = 0; i < nbands; i++)
+		complete &= radar_pool_task_join(conus->pool, tasks[i]);
+	g_free(tasks);
+	g_free(bands);
+	g_object_unref(pixbuf);
+
+	/* Only happens while shutting down */
+	if (!complete) {
+		if (build) {
+			g_free(conus->remap);
+			conus->remap = NULL;
 		}
+		conus->message = "Cancelled";
+		return CONUS_REPROJECT_CANCELLED;
+	}
+
+	if (build)
+		_conus_remap_save(conus);
+	return CONUS_REPROJECT_OK;
+}
+
+static void _conus_frame_free(ConusFrame *frame)
+{
+	if (frame->tex[0])
+		glDeleteTextures(2, frame->tex);
+	g_free(frame->name);
+	g_free(frame->pixels[0]);
+	g_free(frame->pixels[1]);
+	g_free(frame);
+}
+
+/* Takes a spare frame if there is one so its buffers are reused. Only called from the update thread */
+static ConusFrame *_conus_frame_new(RadarConus *conus, const gchar *name)
+{
+	ConusFrame *frame;
+	if (conus->spare) {
+		frame = conus->spare->data;
+		conus->spare = g_slist_delete_link(conus->spare, conus->spare);
+	} else {
+		frame = g_new0(ConusFrame, 1);
+	}
+	frame->name = g_strdup(name);
+	return frame;
+}
+
+/* Keeps the buffers of a few unused frames for the next refresh. Uploaded frames are only recycled on the UI thread */
+static void _conus_frame_recycle(RadarConus *conus, ConusFrame *frame)
+{
+	if (!frame->pixels[0] || g_slist_length(conus->spare) >= CONUS_SPARE_FRAMES) {
+		_conus_frame_free(frame);
+		return;
+	}
+	g_free(frame->name);
+	frame->name = NULL;
+	conus->spare = g_slist_prepend(conus->spare, frame);
+}
+
+static ConusFrame *_conus_frames_find(GPtrArray *frames, const gchar *name)
+{
+	for (guint i = 0; frames && i < frames->len; i++) {
+		ConusFrame *frame = g_ptr_array_index(frames, i);
+		if (g_str_equal(frame->name, name))
+			return frame;
+	}
+	return NULL;
+}
+
+/* Frees the array, recycling the frames that are not also in keep */
+static void _conus_frames_drop(RadarConus *conus, GPtrArray *frames, GPtrArray *keep)
+{
+	for (guint i = 0; frames && i < frames->len; i++) {
+		ConusFrame *frame = g_ptr_array_index(frames, i);
+		if (_conus_frames_find(keep, frame->name) != frame)
+			_conus_frame_recycle(conus, frame);
+	}
+	if (frames)
+		g_ptr_array_free(frames, TRUE);
+}
+
+/* Copies a new frame to graphics memory, once. Its pixel buffers go to the spare frames. Must run on the UI thread */
+static void _conus_frame_upload(RadarConus *conus, ConusFrame *frame)
+{
+	if (frame->tex[0])
+		return;
+	for (int i = 0; i < 2; i++) {
+		frame->tex[i] = _conus_texture_new();
+		_conus_texture_upload(frame->tex[i], frame->pixels[i]);
+	}
+	ConusFrame *spare = g_new0(ConusFrame, 1);
+	spare->pixels[0] = frame->pixels[0];
+	spare->pixels[1] = frame->pixels[1];
+	spare->size      = frame->size;
+	frame->pixels[0] = frame->pixels[1] = NULL;
+	frame->size      = 0;
+	_conus_frame_recycle(conus, spare);
+}
+
+/* Shows a frame, every frame has its own textures so only the ones the tiles draw change */
+static void _conus_show_frame(RadarConus *conus, guint index)
+{
+	ConusFrame *frame = g_ptr_array_index(conus->frames, index);
+	for (int i = 0; i < 2; i++)
+		conus->tile[i]->tex = frame->tex[i];
+	conus->frame = index;
+
+	GtkWidget *label = gtk_bin_get_child(GTK_BIN(conus->status));
+	if (GTK_IS_LABEL(label))
+		gtk_label_set_text(GTK_LABEL(label), frame->name);
+	grits_viewer_queue_draw(conus->viewer);
+}
+
+static gboolean _conus_loop_advance(gpointer _conus);
+
+/* Same timing as the radar site animations, the newest frame is held a little longer */
+static void _conus_loop_schedule(RadarConus *conus)
+{
+	gint interval = grits_prefs_get_integer(conus->prefs,
+			"aweather/animation_frame_interval_ms", NULL);
+	if (conus->frame == conus->frames->len-1)
+		interval += grits_prefs_get_integer(conus->prefs,
+				"aweather/animation_end_frame_hold_ms", NULL);
+	conus->loop_source = g_timeout_add(MAX(interval, 50),
+			_conus_loop_advance, conus);
+}
+
+static gboolean _conus_loop_advance(gpointer _conus)
+{
+	RadarConus *conus = _conus;
+	conus->loop_source = 0;
+	_conus_show_frame(conus, (conus->frame+1) % conus->frames->len);
+	_conus_loop_schedule(conus);
+	return FALSE;
+}
+
+/* The loop only runs while the page is shown */
+static void _conus_set_hidden(RadarConus *conus, gboolean hidden)
+{
+	conus->hidden = hidden;
+	grits_object_hide(GRITS_OBJECT(conus->tile[0]), hidden);
+	grits_object_hide(GRITS_OBJECT(conus->tile[1]), hidden);
+	if (hidden && conus->loop_source) {
+		g_source_remove(conus->loop_source);
+		conus->loop_source = 0;
+	} else if (!hidden && !conus->loop_source && conus->frames && conus->frames->len > 1) {
+		_conus_loop_schedule(conus);
 	}
 }
 
+void _conus_update(RadarConus *conus);
+
 gboolean _conus_update_end(gpointer _conus)
 {
 	RadarConus *conus = _conus;
 	g_debug("Conus: update_end");
 
-	/* Check error status */
+	/* Check error status, the previous frames are still shown */
 	if (conus->message) {
 		g_warning("Conus: update_end - %s", conus->message);
-		aweather_bin_set_child(GTK_BIN(conus->config), gtk_label_new(conus->message));
+		aweather_bin_set_child(GTK_BIN(conus->status), gtk_label_new(conus->message));
+		_conus_frames_drop(conus, conus->loading_frames, conus->frames);
 		goto out;
 	}
 
-	/* Load and pixbuf */
-	GError *error = NULL;
-	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(conus->path, &error);
-	if (!pixbuf || error) {
-		g_warning("Conus: update_end - error loading pixbuf: %s", conus->path);
-		aweather_bin_set_child(GTK_BIN(conus->config), gtk_label_new("Error loading pixbuf"));
-		g_remove(conus->path);
-		goto out;
+	/* Install the new frames, frames that fell out of the loop are recycled */
+	_conus_frames_drop(conus, conus->frames, conus->loading_frames);
+	conus->frames = conus->loading_frames;
+	if (conus->loop_source) {
+		g_source_remove(conus->loop_source);
+		conus->loop_source = 0;
 	}
 
-	/* Split pixels into east/west parts */
-	guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
-	gint    width  = gdk_pixbuf_get_width(pixbuf);
-	gint    height = gdk_pixbuf_get_height(pixbuf);
-	gint    pxsize = gdk_pixbuf_get_has_alpha(pixbuf) ? 4 : 3;
-	guchar *pixels_west = g_malloc(4*(width/2)*height);
-	guchar *pixels_east = g_malloc(4*(width/2)*height);
-	_conus_update_end_split(pixels, pixels_west, pixels_east,
-			width, height, pxsize);
-	g_object_unref(pixbuf);
-
-	/* Copy pixels to graphics memory */
-	_conus_update_end_copy(conus->tile[0], pixels_west);
-	_conus_update_end_copy(conus->tile[1], pixels_east);
-	g_free(pixels_west);
-	g_free(pixels_east);
-
-	/* Update GUI */
-	gchar *label = g_path_get_basename(conus->path);
-	aweather_bin_set_child(GTK_BIN(conus->config), gtk_label_new(label));
-	grits_viewer_queue_draw(conus->viewer);
-	g_free(label);
+	/* Copy the new frames to graphics memory, the images were reprojected by the update thread.
+	 * Frames kept from the last refresh are already there */
+	for (guint i = 0; i < conus->frames->len; i++)
+		_conus_frame_upload(conus, g_ptr_array_index(conus->frames, i));
+	aweather_bin_set_child(GTK_BIN(conus->status), gtk_label_new(NULL));
+	_conus_show_frame(conus, conus->frames->len-1);
+	if (conus->frames->len > 1 && !conus->hidden)
+		_conus_loop_schedule(conus);
 
 out:
+	conus->loading_frames = NULL;
 	conus->idle_source = 0;
-	g_free(conus->path);
 	g_mutex_unlock(&conus->loading);
+	if (conus->again) {
+		conus->again = FALSE;
+		_conus_update(conus);
+	}
 	return FALSE;
 }
 
@@ -1580,49 +3634,109 @@ gpointer _conus_update_thread(gpointer _conus)
 {
 	RadarConus *conus = _conus;
 	conus->message = NULL;
+	conus->loading_frames = g_ptr_array_new();
 
-	/* Find nearest */
+	/* Find nearest, and the files before it when looping. Oldest first */
 	g_debug("Conus: update_thread - nearest");
 	gboolean offline = grits_viewer_get_offline(conus->viewer);
 	// Could also use: https://radar.weather.gov/ridge/standard/CONUS-LARGE_0.gif
 	gchar *conus_url = "https://atlas.niu.edu/analysis/radar/CONUS/archive_b/";
-	gchar *nearest;
+	GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
 	if (!offline) {
 		struct tm *tm = gmtime(&conus->time);
 		time_t nearest5 = conus->time - 60*(tm->tm_min % 5); /* A new CONUS GIF comes out every 5 minutes. Find the GIF that is closest to the requested time. */
-		tm = gmtime(&nearest5);
-		nearest = g_strdup_printf("usrad_b.%04d%02d%02d.%02d%02d.gif",
-				tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday,
-				tm->tm_hour, tm->tm_min);
+		for (gint i = conus->nframes-1; i >= 0; i--) {
+			time_t slot = nearest5 - 5*60*i;
+			tm = gmtime(&slot);
+			g_ptr_array_add(names, g_strdup_printf("usrad_b.%04d%02d%02d.%02d%02d.gif",
+					tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday,
+					tm->tm_hour, tm->tm_min));
+		}
 	} else {
-		GList *files = grits_http_available(conus->http,
-				"^usrad_b.[^\"]*.gif$", "", NULL, NULL);
-		//GList *files = grits_http_available(conus->http,
-		//		"^CONUS-LARGE.[^\"]*.gif$", "", NULL, NULL);
-		nearest = _find_nearest(conus->time, files, 6);
+		GList *files = aweather_download_available(conus->download, CONUS_CACHE_PREFIX,
+				"^usrad_b.[^\"]*.gif$", "", NULL, NULL,
+				AWEATHER_DOWNLOAD_BACKGROUND, NULL, NULL);
+		//GList *files = aweather_download_available(conus->download, CONUS_CACHE_PREFIX,
+		//		"^CONUS-LARGE.[^\"]*.gif$", "", NULL, NULL,
+		//		AWEATHER_DOWNLOAD_BACKGROUND, NULL, NULL);
+		gchar *nearest = _find_nearest(conus->time, files, 6);
+		if (nearest) {
+			/* The names sort by time, step back from the nearest one */
+			files = g_list_sort(files, (GCompareFunc)g_strcmp0);
+			GList *loop  = NULL;
+			guint  count = 0;
+			for (GList *cur = g_list_find_custom(files, nearest, (GCompareFunc)g_strcmp0);
+			     cur && count < conus->nframes; cur = cur->prev) {
+				if (loop && g_str_equal(loop->data, cur->data))
+					continue; // Cached files that are also on the server
+				loop = g_list_prepend(loop, g_strdup(cur->data));
+				count++;
+			}
+			for (GList *cur = loop; cur; cur = cur->next)
+				g_ptr_array_add(names, cur->data);
+			g_list_free(loop);
+			g_free(nearest);
+		}
 		g_list_foreach(files, (GFunc)g_free, NULL);
 		g_list_free(files);
-		if (!nearest) {
+		if (names->len == 0) {
 			conus->message = "No suitable files";
 			goto out;
 		}
 	}
 
-	/* Fetch the image */
-	g_debug("Conus: update_thread - fetch");
-	gchar *uri  = g_strconcat(conus_url, nearest, NULL);
-	conus->path = grits_http_fetch(conus->http, uri, nearest,
-			offline ? GRITS_LOCAL : GRITS_ONCE,
-			_conus_update_loading, conus);
-	g_free(nearest);
-	g_free(uri);
-	if (!conus->path) {
-		conus->message = "Fetch failed";
-		goto out;
+	for (guint i = 0; i < names->len; i++) {
+		const gchar *name = g_ptr_array_index(names, i);
+		if (g_cancellable_is_cancelled(conus->cancellable)) {
+			conus->message = "Cancelled";
+			goto out;
+		}
+
+		/* Frames that are already decoded are used as they are */
+		ConusFrame *frame = _conus_frames_find(conus->frames, name);
+		if (frame) {
+			g_debug("Conus: update_thread - reuse %s", name);
+			g_ptr_array_add(conus->loading_frames, frame);
+			/* Not fetched, but still in use, the cache manager must not evict it first */
+			gchar *path = g_build_filename(g_get_user_cache_dir(), "grits",
+					CONUS_CACHE_PREFIX, name, NULL);
+			aweather_cache_used(conus->cache, path, TRUE, 0);
+			g_free(path);
+			continue;
+		}
+
+		/* Fetch the image, a missing image only leaves a gap in the loop */
+		g_debug("Conus: update_thread - fetch %s", name);
+		gchar *uri  = g_strconcat(conus_url, name, NULL);
+		gchar *path = aweather_download_fetch(conus->download, CONUS_CACHE_PREFIX,
+				uri, name, offline ? GRITS_LOCAL : GRITS_ONCE,
+				conus->hidden ? AWEATHER_DOWNLOAD_BACKGROUND : AWEATHER_DOWNLOAD_VISIBLE,
+				_conus_update_loading, conus, conus->cancellable);
+		g_free(uri);
+		if (!path) {
+			conus->message = "Fetch failed";
+			continue;
+		}
+
+		/* Decode and reproject here, only the upload is left for the UI thread */
+		g_debug("Conus: update_thread - reproject");
+		frame = _conus_frame_new(conus, name);
+		ConusReprojectResult result = _conus_reproject(conus, path, frame);
+		g_free(path);
+		if (result == CONUS_REPROJECT_OK) {
+			g_ptr_array_add(conus->loading_frames, frame);
+			continue;
+		}
+		_conus_frame_recycle(conus, frame);
+		if (result == CONUS_REPROJECT_CANCELLED)
+			goto out;
 	}
+	if (conus->loading_frames->len > 0)
+		conus->message = NULL;
 
 out:
 	g_debug("Conus: update_thread - done");
+	g_ptr_array_free(names, TRUE);
 	if (!conus->idle_source)
 		conus->idle_source = g_idle_add(_conus_update_end, conus);
 	return NULL;
@@ -1630,27 +3744,55 @@ out:
 
 void _conus_update(RadarConus *conus)
 {
-	if (!g_mutex_trylock(&conus->loading))
+	/* Settings changes must not be lost, time changes only need the last one */
+	if (!g_mutex_trylock(&conus->loading)) {
+		conus->again = TRUE;
 		return;
+	}
 	conus->time = grits_viewer_get_time(conus->viewer);
-	g_debug("Conus: update - %d",
-			(gint)conus->time);
+	conus->nframes = 1;
+	if (grits_prefs_get_boolean(conus->prefs, "aweather/conus_loop", NULL))
+		conus->nframes = CLAMP(grits_prefs_get_integer(conus->prefs,
+				"aweather/conus_loop_frames", NULL), 2, CONUS_LOOP_FRAMES_MAX);
+	g_debug("Conus: update - %d, %u frames",
+			(gint)conus->time, conus->nframes);
 
 	/* Add a progress bar */
 	GtkWidget *progress = gtk_progress_bar_new();
 	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress), "Loading...");
-	aweather_bin_set_child(GTK_BIN(conus->config), progress);
+	aweather_bin_set_child(GTK_BIN(conus->status), progress);
+
+	/* The last thread queued _conus_update_end before it released loading, it is done or about to be */
+	if (conus->thread)
+		g_thread_join(conus->thread);
+	conus->thread = g_thread_new("conus-update-thread", _conus_update_thread, conus);
+}
+
+static void _conus_on_loop_toggled(GtkToggleButton *button, RadarConus *conus)
+{
+	gboolean loop = gtk_toggle_button_get_active(button);
+	grits_prefs_set_boolean(conus->prefs, "aweather/conus_loop", loop);
+	gtk_widget_set_sensitive(conus->loop_length, loop);
+	_conus_update(conus);
+}
 
-	g_thread_new("conus-update-thread", _conus_update_thread, conus);
+static void _conus_on_loop_length_changed(GtkSpinButton *button, RadarConus *conus)
+{
+	grits_prefs_set_integer(conus->prefs, "aweather/conus_loop_frames",
+			gtk_spin_button_get_value_as_int(button));
+	_conus_update(conus);
 }
 
-RadarConus *radar_conus_new(GtkWidget *pconfig,
-		GritsViewer *viewer, GritsHttp *http)
+RadarConus *radar_conus_new(GtkWidget *pconfig, GritsViewer *viewer,
+		GritsPrefs *prefs, AWeatherDownload *download, RadarPool *pool)
 {
 	RadarConus *conus = g_new0(RadarConus, 1);
 	conus->viewer  = g_object_ref(viewer);
-	conus->http    = http;
-	conus->config  = gtk_alignment_new(0, 0, 1, 1);
+	conus->prefs   = g_object_ref(prefs);
+	conus->download = download;
+	conus->cache   = aweather_cache_get(viewer);
+	conus->pool    = pool;
+	conus->cancellable = g_cancellable_new();
 	g_mutex_init(&conus->loading);
 
 	gdouble south =  CONUS_NORTH - CONUS_DEG_PER_PX_VERTICAL*CONUS_HEIGHT;
@@ -1660,6 +3802,13 @@ RadarConus *radar_conus_new(GtkWidget *pconfig,
 	conus->tile[1] = grits_tile_new(NULL, CONUS_NORTH, south, east, mid);
 	conus->tile[0]->zindex = 2;
 	conus->tile[1]->zindex = 1;
+	for (int i = 0; i < 2; i++) {
+		GritsTile *tile = conus->tile[i];
+		tile->coords.n = 1.0/CONUS_TEXTURE_HEIGHT;
+		tile->coords.w = 1.0/CONUS_TEXTURE_WIDTH;
+		tile->coords.s = tile->coords.n +  CONUS_HEIGHT   / CONUS_TEXTURE_HEIGHT;
+		tile->coords.e = tile->coords.w + (CONUS_WIDTH/2) / CONUS_TEXTURE_WIDTH;
+	}
 	grits_viewer_add(viewer, GRITS_OBJECT(conus->tile[0]), GRITS_LEVEL_WORLD+2, FALSE);
 	grits_viewer_add(viewer, GRITS_OBJECT(conus->tile[1]), GRITS_LEVEL_WORLD+2, FALSE);
 
@@ -1668,9 +3817,34 @@ RadarConus *radar_conus_new(GtkWidget *pconfig,
 	conus->refresh_id = g_signal_connect_swapped(viewer, "refresh",
 			G_CALLBACK(_conus_update), conus);
 
+	/* Config */
+	GtkWidget *box    = gtk_box_new(GTK_ORIENTATION_VERTICAL,   5);
+	GtkWidget *hbox   = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+	GtkWidget *loop   = gtk_check_button_new_with_label("Loop");
+	GtkWidget *label  = gtk_label_new("frames");
+	gboolean   looped = grits_prefs_get_boolean(prefs, "aweather/conus_loop", NULL);
+	conus->loop_length = gtk_spin_button_new_with_range(2, CONUS_LOOP_FRAMES_MAX, 1);
+	conus->status      = gtk_alignment_new(0, 0, 1, 1);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(loop), looped);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(conus->loop_length), grits_prefs_get_integer(
+			prefs, "aweather/conus_loop_frames", NULL));
+	gtk_widget_set_sensitive(conus->loop_length, looped);
+	g_signal_connect(loop, "toggled",
+			G_CALLBACK(_conus_on_loop_toggled), conus);
+	g_signal_connect(conus->loop_length, "value-changed",
+			G_CALLBACK(_conus_on_loop_length_changed), conus);
+	gtk_box_pack_start(GTK_BOX(hbox), loop,               FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), conus->loop_length, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), label,              FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box),  conus->status,      FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box),  hbox,               FALSE, FALSE, 0);
+
+	conus->config = gtk_alignment_new(0, 0, 1, 1);
+	gtk_container_add(GTK_CONTAINER(conus->config), box);
 	g_object_set_data(G_OBJECT(conus->config), "conus", conus);
 	gtk_notebook_append_page(GTK_NOTEBOOK(pconfig), conus->config,
 			gtk_label_new("Conus"));
+	gtk_widget_show_all(conus->config);
 
 	_conus_update(conus);
 	return conus;
@@ -1680,12 +3854,34 @@ void radar_conus_free(RadarConus *conus)
 {
 	g_signal_handler_disconnect(conus->viewer, conus->time_id);
 	g_signal_handler_disconnect(conus->viewer, conus->refresh_id);
-	if (conus->idle_source)
+
+	/* Stop the download and wait for the update thread, it always ends by queueing _conus_update_end */
+	g_cancellable_cancel(conus->cancellable);
+	if (conus->thread)
+		g_thread_join(conus->thread);
+	if (conus->idle_source) {
 		g_source_remove(conus->idle_source);
+		_conus_frames_drop(conus, conus->loading_frames, conus->frames);
+		g_mutex_unlock(&conus->loading);
+	}
+	if (conus->loop_source)
+		g_source_remove(conus->loop_source);
 
-	for (int i = 0; i < 2; i++)
+	/* The textures belong to the frames */
+	for (int i = 0; i < 2; i++) {
+		conus->tile[i]->tex = 0;
 		grits_object_destroy_pointer(&conus->tile[i]);
+	}
+	if (conus->frames) {
+		g_ptr_array_foreach(conus->frames, (GFunc)_conus_frame_free, NULL);
+		g_ptr_array_free(conus->frames, TRUE);
+	}
+	g_slist_free_full(conus->spare, (GDestroyNotify)_conus_frame_free);
+	g_free(conus->remap);
 
+	g_object_unref(conus->cancellable);
+	g_mutex_clear(&conus->loading);
+	g_object_unref(conus->prefs);
 	g_object_unref(conus->viewer);
 	g_free(conus);
 }
@@ -1694,6 +3890,9 @@ void radar_conus_free(RadarConus *conus)
 /********************
  * GritsPluginRadar *
  ********************/
+/* Workers shared by all radar sites. One is always kept for the visible site */
+#define RADAR_POOL_THREADS 4
+
 static void _draw_hud(GritsCallback *callback, GritsOpenGL *opengl, gpointer _self)
 {
 	g_debug("GritsPluginRadar: _draw_hud");
@@ -1761,29 +3960,54 @@ out:
 	fclose(file);
 }
 
+static gpointer _load_colormaps(gpointer _)
+{
+	for (int i = 0; colormaps[i].file; i++) {
+		gchar *file = g_build_filename(PKGDATADIR,
+				"colors", colormaps[i].file, NULL);
+		_load_colormap(file, &colormaps[i]);
+		g_free(file);
+	}
+	return NULL;
+}
+
+/* The colormaps are shared by every instance, they are only loaded the first time they are needed.
+ * Everything that decodes a volume gets them from here, so it waits for a load that is still going on */
+static AWeatherColormap *_get_colormaps(void)
+{
+	static GOnce once = G_ONCE_INIT;
+	g_once(&once, _load_colormaps, NULL);
+	return colormaps;
+}
+
 static void _update_hidden(GtkNotebook *notebook,
 		gpointer _, guint page_num, gpointer viewer)
 {
 	g_debug("GritsPluginRadar: _update_hidden - 0..%d = %d",
 			gtk_notebook_get_n_pages(notebook), page_num);
 
+	RadarPool *pool = NULL;
 	for (gint i = 0; i < gtk_notebook_get_n_pages(notebook); i++) {
 		gboolean is_hidden = (i != page_num);
 		GtkWidget  *config = gtk_notebook_get_nth_page(notebook, i);
 		RadarConus *conus  = g_object_get_data(G_OBJECT(config), "conus");
+		RadarMosaic *mosaic = g_object_get_data(G_OBJECT(config), "mosaic");
 		RadarSite  *site   = g_object_get_data(G_OBJECT(config), "site");
 
 		/* Conus */
 		if (conus) {
-			grits_object_hide(GRITS_OBJECT(conus->tile[0]), is_hidden);
-			grits_object_hide(GRITS_OBJECT(conus->tile[1]), is_hidden);
+			_conus_set_hidden(conus, is_hidden);
+		} else if (mosaic) {
+			radar_mosaic_set_hidden(mosaic, is_hidden);
 		} else if (site) {
 			site->hidden = is_hidden;
+			pool = site->pool;
 
-			/* If we are hiding the site while it is animating, then stop the animation and wait for it to finish, otherwise, start the animation back up if it was previously running.  */
-			if(is_hidden)
-				_stop_animation_and_wait_for_animation_to_stop_save_user_choice(site);
-			else {
+			/* If we are hiding the site while it is animating, then stop the animation, otherwise, start the animation back up if it was previously running.  */
+			if(is_hidden) {
+				_animation_stop(site, NULL);
+				_site_watch_stop(site, FALSE);
+			} else {
 				/* If the user has diabled refreshing when the radar site is not visible and refreshed the time when this site was not visible and now the site is visible, go ahead and run the refresh */
 				if(site->lNeedsRefreshWhenShown){
 					_site_update(site);
@@ -1791,7 +4015,9 @@ static void _update_hidden(GtkNotebook *notebook,
 				}
 
 				_start_animation_if_user_requested_it_to_start(site);
+				_site_watch_schedule(site);
 			}
+			_site_update_partial_set(site);
 
 			if (site->level2)
 				grits_object_hide(GRITS_OBJECT(site->level2), is_hidden);
@@ -1799,9 +4025,44 @@ static void _update_hidden(GtkNotebook *notebook,
 			g_warning("GritsPluginRadar: _update_hidden - no site or counus found");
 		}
 	}
+	/* Queued loads for the newly visible site now go first */
+	if (pool)
+		radar_pool_reprioritize(pool);
 	grits_viewer_queue_draw(viewer);
 }
 
+/* Flies to the site and shows its tab */
+static void _on_marker_clicked(city_t *city, gpointer _self)
+{
+	GritsPluginRadar *self = GRITS_PLUGIN_RADAR(_self);
+	grits_viewer_set_location(self->viewer, city->pos.lat, city->pos.lon, EARTH_R/35);
+	grits_viewer_set_rotation(self->viewer, 0, 0, 0);
+	/* Recursivly set notebook tabs, the site was loaded by the move */
+	RadarSite *site = g_hash_table_lookup(self->sites, city->code);
+	GtkWidget *widget, *parent;
+	for (widget = site ? site->config : NULL; widget; widget = parent) {
+		parent = gtk_widget_get_parent(widget);
+		if (GTK_IS_NOTEBOOK(parent)) {
+			gint i = gtk_notebook_page_num(GTK_NOTEBOOK(parent), widget);
+			gtk_notebook_set_current_page(GTK_NOTEBOOK(parent), i);
+		}
+	}
+}
+
+/* Goes ahead of the site loads, which wait for it anyway */
+static RadarPoolPriority _colormaps_priority(gpointer _self)
+{
+	return RADAR_POOL_PRIORITY_VISIBLE;
+}
+
+/* Runs on the pool, so parsing the colormaps does not hold up the window */
+static void _colormaps_load(gpointer _self)
+{
+	GritsPluginRadar *self = _self;
+	_get_colormaps();
+	aweather_startup_done(self->startup, "radar", self->startup_start);
+}
+
 /* Methods */
 GritsPluginRadar *grits_plugin_radar_new(GritsViewer *viewer, GritsPrefs *prefs)
 {
@@ -1811,6 +4072,13 @@ GritsPluginRadar *grits_plugin_radar_new(GritsViewer *viewer, GritsPrefs *prefs)
 	self->viewer = g_object_ref(viewer);
 	self->prefs  = g_object_ref(prefs);
 
+	/* Load colormaps */
+	self->startup        = aweather_startup_get(viewer);
+	self->startup_start  = g_get_monotonic_time();
+	aweather_startup_defer(self->startup);
+	self->colormaps_task = radar_pool_push(self->pool, _colormaps_load,
+			_colormaps_priority, self);
+
 	/* Setup page switching */
 	self->tab_id = g_signal_connect(self->config, "switch-page",
 			G_CALLBACK(_update_hidden), viewer);
@@ -1819,18 +4087,39 @@ GritsPluginRadar *grits_plugin_radar_new(GritsViewer *viewer, GritsPrefs *prefs)
 	self->hud = grits_callback_new(_draw_hud, self);
 	grits_viewer_add(viewer, GRITS_OBJECT(self->hud), GRITS_LEVEL_HUD, FALSE);
 
+	/* Downloads are shared with the other plugins */
+	self->download = aweather_download_ref(viewer, prefs);
+	self->mirrors  = radar_mirrors_new(prefs);
+
 	/* Load Conus */
-	self->conus = radar_conus_new(self->config, self->viewer, self->conus_http);
+	self->conus = radar_conus_new(self->config, self->viewer, self->prefs,
+			self->download, self->pool);
+
+	/* Load Mosaic */
+	self->mosaic = radar_mosaic_new(self->config, self->viewer, self->prefs, self->pool);
 
 	/* Load radar sites */
 	for (city_t *city = cities; city->type; city++) {
 		if (city->type != LOCATION_CITY)
 			continue;
-		RadarSite *site = radar_site_new(city, self->config,
-				self->viewer, self->prefs, self->sites_http);
+		RadarSite *site = radar_site_new(city, self->config, self->viewer,
+				self->prefs, self->pool, self->download, self->mirrors,
+				self->mosaic);
 		g_hash_table_insert(self->sites, city->code, site);
+		radar_site_index_add(self->site_index, site);
 	}
 
+	/* Site markers */
+	self->markers = radar_markers_new(self->viewer, cities,
+			_on_marker_clicked, self);
+
+	/* Load the sites around the initial location */
+	gdouble lat, lon, elev;
+	grits_viewer_get_location(self->viewer, &lat, &lon, &elev);
+	radar_site_index_update(self->site_index, lat, lon, elev);
+	self->location_id = g_signal_connect_swapped(self->viewer, "location-changed",
+			G_CALLBACK(radar_site_index_update), self->site_index);
+
 	return self;
 }
 
@@ -1855,24 +4144,12 @@ static void grits_plugin_radar_init(GritsPluginRadar *self)
 {
 	g_debug("GritsPluginRadar: class_init");
 	/* Set defaults */
-	self->sites_http = grits_http_new(G_DIR_SEPARATOR_S
-			"nexrad" G_DIR_SEPARATOR_S
-			"level2" G_DIR_SEPARATOR_S);
-	self->conus_http = grits_http_new(G_DIR_SEPARATOR_S
-			"nexrad" G_DIR_SEPARATOR_S
-			"conus"  G_DIR_SEPARATOR_S);
+	self->pool       = radar_pool_new(RADAR_POOL_THREADS);
 	self->sites      = g_hash_table_new_full(g_str_hash, g_str_equal,
 				NULL, (GDestroyNotify)radar_site_free);
+	self->site_index = radar_site_index_new();
 	self->config     = g_object_ref(gtk_notebook_new());
 
-	/* Load colormaps */
-	for (int i = 0; colormaps[i].file; i++) {
-		gchar *file = g_build_filename(PKGDATADIR,
-				"colors", colormaps[i].file, NULL);
-		_load_colormap(file, &colormaps[i]);
-		g_free(file);
-	}
-
 	/* Need to position on the top because of Win32 bug */
 	gtk_notebook_set_tab_pos(GTK_NOTEBOOK(self->config), GTK_POS_LEFT);
 }
@@ -1884,9 +4161,21 @@ static void grits_plugin_radar_dispose(GObject *gobject)
 		GritsViewer *viewer = self->viewer;
 		self->viewer = NULL;
 		g_signal_handler_disconnect(self->config, self->tab_id);
+		g_signal_handler_disconnect(viewer, self->location_id);
 		grits_object_destroy_pointer(&self->hud);
 		radar_conus_free(self->conus);
+		radar_markers_free(self->markers);
+		radar_site_index_free(self->site_index);
 		g_hash_table_destroy(self->sites);
+		radar_mosaic_free(self->mosaic);
+		/* The startup phase still has to end if the colormaps were never loaded */
+		if (!radar_pool_task_finish(self->pool, self->colormaps_task))
+			aweather_startup_done(self->startup, "radar", self->startup_start);
+		/* Queued tasks may still download, the pool must be empty before the mirrors and download go */
+		radar_pool_free(self->pool);
+		self->pool = NULL;
+		radar_mirrors_free(self->mirrors);
+		aweather_download_unref(self->download);
 		g_object_unref(self->config);
 		g_object_unref(self->prefs);
 		g_object_unref(viewer);
@@ -1899,8 +4188,8 @@ static void grits_plugin_radar_finalize(GObject *gobject)
 	g_debug("GritsPluginRadar: finalize");
 	GritsPluginRadar *self = GRITS_PLUGIN_RADAR(gobject);
 	/* Free data */
-	grits_http_free(self->conus_http);
-	grits_http_free(self->sites_http);
+	if (self->pool)
+		radar_pool_free(self->pool);
 	gtk_widget_destroy(self->config);
 	G_OBJECT_CLASS(grits_plugin_radar_parent_class)->finalize(gobject);
 
@@ -24,6 +24,12 @@
 #include <grits.h>
 #include "radar-info.h"
 #include "level2.h"
+#include "radar-pool.h"
+#include "mosaic.h"
+#include "markers.h"
+#include "mirrors.h"
+#include "../aweather-download.h"
+#include "../aweather-startup.h"
 
 #define GRITS_TYPE_PLUGIN_RADAR            (grits_plugin_radar_get_type ())
 #define GRITS_PLUGIN_RADAR(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   GRITS_TYPE_PLUGIN_RADAR, GritsPluginRadar))
@@ -37,6 +43,7 @@ typedef struct _GritsPluginRadarClass GritsPluginRadarClass;
 
 typedef struct _RadarConus RadarConus;
 typedef struct _RadarSite  RadarSite;
+typedef struct _RadarSiteIndex RadarSiteIndex;
 
 struct _GritsPluginRadar {
 	GObject parent_instance;
@@ -50,10 +57,19 @@ struct _GritsPluginRadar {
 	GritsCallback    *hud;
 
 	GHashTable  *sites;
-	GritsHttp   *sites_http;
+	RadarSiteIndex *site_index; // Loads and unloads sites as the eye moves
+	RadarMarkers   *markers;    // Site markers
+	guint        location_id;   // "location-changed" callback ID
+	RadarPool   *pool;        // Loads for all sites, see radar-pool.h
+	AWeatherDownload *download; // Downloads shared with the other plugins
+	RadarMirrors     *mirrors;  // Level II mirror rankings shared by the sites
+	AWeatherStartup  *startup;  // Startup timing, the "radar" phase ends once the colormaps are loaded
+	gint64            startup_start;
+	RadarPoolTask    *colormaps_task;
 
 	RadarConus  *conus;
-	GritsHttp   *conus_http;
+
+	RadarMosaic *mosaic;
 };
 
 struct _GritsPluginRadarClass {
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <gio/gio.h>
+
+#include "spool.h"
+
+#define SPOOL_FILTER "^\\w{4}_\\d{8}_\\d{6}(\\.bz2)?$"
+
+struct _RadarSpool {
+	gchar           *dir;
+	GFileMonitor    *monitor;
+	RadarSpoolAdded  added;
+	gpointer         data;
+	GRegex          *filter;
+
+	/* Volume names sorted oldest first, the monitor changes it on the main thread while loads read it */
+	GMutex           mutex;
+	GList           *names;
+};
+
+/* Returns TRUE if name was not listed yet */
+static gboolean _spool_add(RadarSpool *spool, const gchar *name)
+{
+	g_mutex_lock(&spool->mutex);
+	gboolean found = g_list_find_custom(spool->names, name,
+			(GCompareFunc)g_strcmp0) != NULL;
+	if (!found)
+		spool->names = g_list_insert_sorted(spool->names,
+				g_strdup(name), (GCompareFunc)g_strcmp0);
+	g_mutex_unlock(&spool->mutex);
+	return !found;
+}
+
+static void _spool_remove(RadarSpool *spool, const gchar *name)
+{
+	g_mutex_lock(&spool->mutex);
+	GList *link = g_list_find_custom(spool->names, name,
+			(GCompareFunc)g_strcmp0);
+	if (link) {
+		g_free(link->data);
+		spool->names = g_list_delete_link(spool->names, link);
+	}
+	g_mutex_unlock(&spool->mutex);
+}
+
+static void _spool_changed(GFileMonitor *monitor, GFile *file, GFile *other,
+		GFileMonitorEvent event, gpointer _spool)
+{
+	RadarSpool *spool = _spool;
+	gchar *name  = g_file_get_basename(file);
+	gchar *other_name = other ? g_file_get_basename(other) : NULL;
+
+	switch (event) {
+	/* Volumes are added once they are closed, or moved in whole.
+	 * A volume that is written again only changes what is on disk, it was already handed out */
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+		if (g_regex_match(spool->filter, name, 0, NULL) &&
+		    _spool_add(spool, name)) {
+			g_debug("RadarSpool: changed - %s added", name);
+			spool->added(name, spool->data);
+		}
+		break;
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		_spool_remove(spool, name);
+		if (other_name && g_regex_match(spool->filter, other_name, 0, NULL) &&
+		    _spool_add(spool, other_name)) {
+			g_debug("RadarSpool: changed - %s added", other_name);
+			spool->added(other_name, spool->data);
+		}
+		break;
+	/* Scoured */
+	case G_FILE_MONITOR_EVENT_DELETED:
+	case G_FILE_MONITOR_EVENT_MOVED_OUT:
+		_spool_remove(spool, name);
+		break;
+	default:
+		break;
+	}
+	g_free(other_name);
+	g_free(name);
+}
+
+RadarSpool *radar_spool_new(const gchar *dir, RadarSpoolAdded added, gpointer data)
+{
+	g_debug("RadarSpool: new - %s", dir);
+	RadarSpool *spool = g_new0(RadarSpool, 1);
+	spool->dir    = g_strdup(dir);
+	spool->added  = added;
+	spool->data   = data;
+	spool->filter = g_regex_new(SPOOL_FILTER, G_REGEX_OPTIMIZE, 0, NULL);
+	g_mutex_init(&spool->mutex);
+
+	/* Watch first, so nothing written while listing is missed */
+	GError *error = NULL;
+	GFile  *gdir  = g_file_new_for_path(dir);
+	spool->monitor = g_file_monitor_directory(gdir,
+			G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+	g_object_unref(gdir);
+	if (error) {
+		g_warning("RadarSpool: new - %s", error->message);
+		g_error_free(error);
+	} else {
+		g_signal_connect(spool->monitor, "changed",
+				G_CALLBACK(_spool_changed), spool);
+	}
+
+	GDir *list = g_dir_open(dir, 0, NULL);
+	const gchar *name;
+	while (list && (name = g_dir_read_name(list)))
+		if (g_regex_match(spool->filter, name, 0, NULL))
+			_spool_add(spool, name);
+	if (list)
+		g_dir_close(list);
+	return spool;
+}
+
+void radar_spool_free(RadarSpool *spool)
+{
+	g_debug("RadarSpool: free - %s", spool->dir);
+	if (spool->monitor) {
+		g_signal_handlers_disconnect_by_data(spool->monitor, spool);
+		g_file_monitor_cancel(spool->monitor);
+		g_object_unref(spool->monitor);
+	}
+	g_list_free_full(spool->names, g_free);
+	g_mutex_clear(&spool->mutex);
+	g_regex_unref(spool->filter);
+	g_free(spool->dir);
+	g_free(spool);
+}
+
+GList *radar_spool_list(RadarSpool *spool)
+{
+	g_mutex_lock(&spool->mutex);
+	GList *names = g_list_copy_deep(spool->names, (GCopyFunc)g_strdup, NULL);
+	g_mutex_unlock(&spool->mutex);
+	return names;
+}
+
+gchar *radar_spool_newest(RadarSpool *spool)
+{
+	g_mutex_lock(&spool->mutex);
+	GList *last  = g_list_last(spool->names);
+	gchar *name  = last ? g_strdup(last->data) : NULL;
+	g_mutex_unlock(&spool->mutex);
+	return name;
+}
+
+gchar *radar_spool_path(RadarSpool *spool, const gchar *name)
+{
+	return g_build_filename(spool->dir, name, NULL);
+}
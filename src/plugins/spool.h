@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2009-2011 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RADAR_SPOOL_H__
+#define __RADAR_SPOOL_H__
+
+#include <glib.h>
+
+/* Local spool directory of one site, eg. where LDM files Level II volumes.
+ * Volumes are named like the nexrad_url listing (KLSX_20090510_032300.bz2, the extension is optional)
+ * and are decoded where they are instead of being copied into the cache.
+ * The directory is watched (with inotify on Linux) and the list of volumes is kept in memory.
+ * A volume counts as written once it is closed or moved into the directory, so it should be written in one go. */
+typedef struct _RadarSpool RadarSpool;
+
+/* Called on the thread default main context of radar_spool_new once a volume has been written */
+typedef void (*RadarSpoolAdded)(const gchar *name, gpointer data);
+
+RadarSpool *radar_spool_new(const gchar *dir, RadarSpoolAdded added, gpointer data);
+
+void radar_spool_free(RadarSpool *spool);
+
+/* Returns the names of the volumes sorted oldest first, free with g_list_free_full(list, g_free).
+ * Can be called from any thread. */
+GList *radar_spool_list(RadarSpool *spool);
+
+/* Returns the name of the newest volume or NULL, free with g_free. Can be called from any thread. */
+gchar *radar_spool_newest(RadarSpool *spool);
+
+/* Returns the path of a volume, free with g_free */
+gchar *radar_spool_path(RadarSpool *spool, const gchar *name);
+
+#endif
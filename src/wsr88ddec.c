@@ -15,10 +15,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <bzlib.h>
 
 #define SANITY_MAX_SIZE 50*1024*1024 // 50 MB/bzip
+#define STDIO_BUFFER    (1024*1024)  // Volumes are read and written front to back in large pieces
 
 char *bunzip2(char *input, int input_len, int *output_len)
 {
@@ -73,6 +76,11 @@ int main(int argc, char **argv)
 	FILE *output = fopen(argv[2], "wb+");
 	if (!input)  g_error("error opening input");
 	if (!output) g_error("error opening output");
+	setvbuf(input,  NULL, _IOFBF, STDIO_BUFFER);
+	setvbuf(output, NULL, _IOFBF, STDIO_BUFFER);
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fileno(input), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
 	int st;
 	int size = 0;